@@ -0,0 +1,110 @@
+/************************************************************************
+ Compilations per second of the Faust backends
+
+ Compiles the same DSP to C++ repeatedly through FaustBackend::compileCpp()
+ with each requested backend, sequentially in fresh request directories
+ like the FaustCompileTool does, and reports the per-compile latency and
+ the throughput.
+
+ Build (from the repository root, with the other benchmarks; configure
+ with -DFAUST_MCP_LIBFAUST=ON to include the libfaust backend):
+   cmake -S . -B build && cmake --build build --target backend_compile
+
+ Usage:
+   ./backend_compile [iterations] [backend...] [--dsp file.dsp]
+   (default: 20 iterations of docker and worker; the Docker backends need
+   the same host_shared_dir setting as the server). A backend whose
+   compile fails is reported with the compiler's error and not timed; the
+   exit status is then 1.
+ ************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "FaustBackend.hh"
+
+typedef std::chrono::steady_clock Clock;
+
+static const char *DEFAULT_DSP =
+    "import(\"stdfaust.lib\");\n"
+    "process = os.osc(440) : fi.lowpass(3, 2000) * 0.5;\n";
+
+int main(int argc, char *argv[]) {
+  int iterations = 20;
+  std::vector<std::string> backends;
+  std::string source = DEFAULT_DSP;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--dsp" && i + 1 < argc) {
+      std::ifstream file(argv[++i]);
+      source.assign((std::istreambuf_iterator<char>(file)),
+                    std::istreambuf_iterator<char>());
+    } else if (i == 1 && std::atoi(argv[i]) > 0) {
+      iterations = std::atoi(argv[i]);
+    } else {
+      backends.push_back(arg);
+    }
+  }
+  if (backends.empty()) {
+    backends = {"docker", "worker"};
+  }
+  ensureWorkDir();
+
+  int failed = 0;
+  for (const auto &name : backends) {
+    std::unique_ptr<FaustBackend> backend = createFaustBackend(name);
+    if (!backend) {
+      std::cerr << name << ": backend not available in this build"
+                << std::endl;
+      failed++;
+      continue;
+    }
+
+    // The first compile pays for one-time costs (image, worker start,
+    // library loading) and is reported separately. A failed compile stops
+    // the backend: its time (often an early error) would skew the figures
+    std::vector<double> times;
+    double warmup = 0;
+    bool ok = true;
+    auto total = Clock::now();
+    for (int i = 0; ok && i <= iterations; i++) {
+      ScratchDir work;
+      auto start = Clock::now();
+      FaustResult result = backend->compileCpp(
+          source, "bench.dsp", {}, work, CancellationToken(), ProcessLimits());
+      double ms = std::chrono::duration<double, std::milli>(Clock::now() -
+                                                            start)
+                      .count();
+      if (result.exitCode != 0) {
+        std::cerr << name << ": compile " << i + 1 << " failed: "
+                  << result.errorOutput << std::endl;
+        ok = false;
+      } else if (i == 0) {
+        warmup = ms;
+        total = Clock::now();
+      } else {
+        times.push_back(ms);
+      }
+    }
+    if (!ok) {
+      failed++;
+      continue;
+    }
+
+    double seconds =
+        std::chrono::duration<double>(Clock::now() - total).count();
+
+    std::sort(times.begin(), times.end());
+    std::cout << name << ": first " << warmup << " ms, median "
+              << times[times.size() / 2] << " ms, min " << times.front()
+              << " ms, " << (iterations / seconds) << " compiles/s"
+              << std::endl;
+  }
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+/************************************************************************
+ Per-call overhead of launching a child process
+
+ Compares the former runFaustDocker() strategy (shell command through
+ std::system, stdout/stderr redirected to files, read back, removed) with
+ runProcess() (vfork/execvp + pipes drained with poll), using a stub
+ program instead of docker so that only the launch overhead is measured.
+
+ Build (from the repository root):
+   g++ -std=c++17 -O2 -pthread -Isrc -Isrc/tools \
+       bench/process_overhead.cpp src/tools/process.cpp \
+       src/tools/config.cpp src/tools/stats.cpp -o process_overhead
+
+ Usage:
+   ./process_overhead [iterations] [stub program and arguments...]
+   (default: 200 iterations of "echo faust-stub")
+ ************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "process.hh"
+
+typedef std::chrono::steady_clock Clock;
+
+// Former strategy: shell + redirections to files, read back and removed
+static std::string runWithSystem(const std::string &command) {
+  std::string stdoutPath = "/tmp/.bench_stdout";
+  std::string stderrPath = "/tmp/.bench_stderr";
+  std::string shellCmd =
+      command + " > " + stdoutPath + " 2> " + stderrPath;
+  std::system(shellCmd.c_str());
+
+  std::ifstream out(stdoutPath), err(stderrPath);
+  std::string output((std::istreambuf_iterator<char>(out)),
+                     std::istreambuf_iterator<char>());
+  std::string errorOutput((std::istreambuf_iterator<char>(err)),
+                          std::istreambuf_iterator<char>());
+  std::remove(stdoutPath.c_str());
+  std::remove(stderrPath.c_str());
+  return output + errorOutput;
+}
+
+// Prints median and mean of a series of per-call durations (microseconds)
+static void report(const std::string &label, std::vector<double> &samples) {
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (double s : samples) {
+    sum += s;
+  }
+  std::cout << label << ": median " << samples[samples.size() / 2]
+            << " us, mean " << sum / samples.size() << " us, p95 "
+            << samples[samples.size() * 95 / 100] << " us" << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = (argc > 1) ? std::atoi(argv[1]) : 200;
+  std::vector<std::string> stub = {"echo", "faust-stub"};
+  if (argc > 2) {
+    stub.assign(argv + 2, argv + argc);
+  }
+
+  std::string command;
+  for (const auto &arg : stub) {
+    command += (command.empty() ? "" : " ") + arg;
+  }
+
+  std::vector<double> before, after;
+  CancellationToken cancel;
+
+  for (int i = 0; i < iterations; i++) {
+    auto t0 = Clock::now();
+    runWithSystem(command);
+    auto t1 = Clock::now();
+    runProcess(stub, cancel);
+    auto t2 = Clock::now();
+
+    before.push_back(
+        std::chrono::duration<double, std::micro>(t1 - t0).count());
+    after.push_back(std::chrono::duration<double, std::micro>(t2 - t1).count());
+  }
+
+  std::cout << "Stub: " << command << " (" << iterations << " calls)"
+            << std::endl;
+  report("std::system + files", before);
+  report("runProcess (spawn) ", after);
+  return 0;
+}
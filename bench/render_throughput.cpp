@@ -0,0 +1,104 @@
+/************************************************************************
+ Realtime factor of note rendering and audio encoding
+
+ A Faust architecture file: renders the same note as the FaustRenderTool
+ (renderAudio() of spectrogram_synth.hh) with several DSP block sizes and
+ reports the realtime factor (seconds of audio per second of computation),
+ then the time taken to encode the result as 16-bit WAV and FLAC
+ (audio_encoding.hh) with the resulting sizes.
+
+ Build (from the repository root, with a DSP exposing gate/freq/gain):
+   faust -a bench/render_throughput.cpp note.dsp -o render_throughput.cpp
+   g++ -std=c++11 -O3 -Isrc/tools render_throughput.cpp -lm \
+       -o render_throughput
+
+ Usage:
+   ./render_throughput [duration] [iterations] [block_size...]
+   (default: a 440 Hz note of 10 s, 5 iterations, block sizes 1, 32, 256 and 1024)
+ ************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "faust_dsp.hh"
+
+<< includeIntrinsic >>
+
+<< includeclass >>
+
+#include "audio_encoding.hh"
+#include "spectrogram_synth.hh"
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  Options opts;
+  opts.duration = 10.0f;
+  opts.gate_duration = 8.0f;
+  opts.frequency = 440.0f;
+  opts.gain = 0.5f;
+  int iterations = 5;
+  std::vector<int> block_sizes;
+
+  if (argc > 1) {
+    opts.duration = std::max(0.1f, (float)std::atof(argv[1]));
+    opts.gate_duration = opts.duration * 0.8f;
+  }
+  if (argc > 2) {
+    iterations = std::max(1, std::atoi(argv[2]));
+  }
+  for (int i = 3; i < argc; i++) {
+    block_sizes.push_back(std::max(1, std::atoi(argv[i])));
+  }
+  if (block_sizes.empty()) {
+    block_sizes = {1, 32, 256, 1024};
+  }
+
+  mydsp DSP;
+  SpectrogramUI ui;
+  DSP.buildUserInterface(&ui);
+  std::string error;
+  if (!ui.validate(error)) {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+
+  // Best of the iterations: each one restarts from a freshly initialized DSP
+  std::vector<std::vector<float>> channels;
+  for (int block_size : block_sizes) {
+    double best = 1e30;
+    for (int i = 0; i < iterations; i++) {
+      DSP.init(opts.sample_rate);
+      auto start = Clock::now();
+      renderAudio(DSP, ui, opts, block_size, channels);
+      best = std::min(best, secondsSince(start));
+    }
+    std::cout << "block " << block_size << ": " << best * 1000 << " ms, "
+              << "realtime factor " << opts.duration / best << "x"
+              << std::endl;
+  }
+
+  const char *formats[] = {"wav", "flac"};
+  for (const char *format : formats) {
+    std::vector<unsigned char> data;
+    double best = 1e30;
+    for (int i = 0; i < iterations; i++) {
+      auto start = Clock::now();
+      encodeAudio(format, channels, opts.sample_rate, 16, data);
+      best = std::min(best, secondsSince(start));
+    }
+    std::cout << format << ": " << best * 1000 << " ms, " << data.size()
+              << " bytes, realtime factor " << opts.duration / best << "x"
+              << std::endl;
+  }
+  return 0;
+}
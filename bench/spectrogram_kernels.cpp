@@ -0,0 +1,273 @@
+/************************************************************************
+ Microbenchmarks of the spectrogram analysis kernels
+
+ Times each step of spectrogram_analysis.hh in isolation, on a synthetic
+ signal (a sine sweep with harmonics and a little noise) instead of a
+ Faust DSP: createWindow, computeSTFT, createMelFilterbank,
+ applyMelFilterbank, convertToDb, normalizeSpectrogram, applyColormap,
+ renderImage, encodeImagePNG and writePNG, sweeping the FFT size, hop
+ size, number of mel bands, signal duration and image scale. Uses Google
+ Benchmark, so the usual --benchmark_filter, --benchmark_repetitions and
+ --benchmark_out options apply.
+
+ Build (from the repository root, with Google Benchmark installed):
+   g++ -std=c++17 -O3 -Isrc/tools bench/spectrogram_kernels.cpp \
+       -lbenchmark -lfftw3f -lpng -lz -pthread -o spectrogram_kernels
+
+ Usage:
+   ./spectrogram_kernels [--benchmark_filter=regex]
+   ./spectrogram_kernels --benchmark_out=run.json --benchmark_out_format=json
+
+ bench/baselines/spectrogram_kernels.json is the output of a reference run
+ (see the README); compare a run against it with Google Benchmark's
+ tools/compare.py:
+   compare.py benchmarks bench/baselines/spectrogram_kernels.json run.json
+ ************************************************************************/
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "spectrogram_analysis.hh"
+
+static const int SAMPLE_RATE = 44100;
+
+static const char *COLORMAPS[] = {"viridis", "magma", "hot", "gray"};
+
+// Sweep from 100 Hz to 8 kHz with three harmonics and noise at -60 dB, so
+// that the spectrum is neither empty nor flat
+static std::vector<float> testSignal(double duration) {
+  size_t n = (size_t)(duration * SAMPLE_RATE);
+  std::vector<float> signal(n);
+  std::mt19937 random(42);
+  std::uniform_real_distribution<float> noise(-0.001f, 0.001f);
+  double phase = 0;
+  for (size_t i = 0; i < n; i++) {
+    double t = (double)i / n;
+    phase += 2 * M_PI * 100 * std::pow(80.0, t) / SAMPLE_RATE;
+    signal[i] = (float)(0.5 * std::sin(phase) + 0.2 * std::sin(2 * phase) +
+                        0.1 * std::sin(3 * phase)) +
+                noise(random);
+  }
+  return signal;
+}
+
+// Normalized dB mel spectrogram, as drawn by renderImage()
+static std::vector<std::vector<float>> testSpectrogram(double duration,
+                                                       int mel_bands) {
+  std::vector<float> window = createWindow(2048, "hann");
+  std::vector<std::vector<float>> spec = applyMelFilterbank(
+      computeSTFT(testSignal(duration), 2048, 512, window),
+      createMelFilterbank(mel_bands, 2048, SAMPLE_RATE, 0, SAMPLE_RATE / 2));
+  convertToDb(spec, -80);
+  normalizeSpectrogram(spec);
+  return spec;
+}
+
+static Options imageOptions(double scale) {
+  Options opts;
+  opts.scale = (float)scale;
+  return opts;
+}
+
+//==============================================================================
+// STFT
+//==============================================================================
+
+// Args: fft_size
+static void BM_CreateWindow(benchmark::State &state) {
+  int fft_size = (int)state.range(0);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(createWindow(fft_size, "hann"));
+  }
+  state.SetItemsProcessed(state.iterations() * fft_size);
+}
+BENCHMARK(BM_CreateWindow)->ArgName("fft")->Arg(512)->Arg(2048)->Arg(8192);
+
+// Args: fft_size, hop_size, duration (s); items are frames
+static void BM_ComputeSTFT(benchmark::State &state) {
+  int fft_size = (int)state.range(0);
+  int hop_size = (int)state.range(1);
+  std::vector<float> signal = testSignal((double)state.range(2));
+  std::vector<float> window = createWindow(fft_size, "hann");
+  size_t frames = 0;
+  for (auto _ : state) {
+    auto spectrogram = computeSTFT(signal, fft_size, hop_size, window);
+    frames = spectrogram.size();
+    benchmark::DoNotOptimize(spectrogram);
+  }
+  state.SetItemsProcessed(state.iterations() * frames);
+}
+BENCHMARK(BM_ComputeSTFT)
+    ->ArgNames({"fft", "hop", "dur"})
+    ->ArgsProduct({{512, 2048, 8192}, {128, 512}, {1, 10}})
+    ->Unit(benchmark::kMillisecond);
+
+//==============================================================================
+// Mel Filterbank
+//==============================================================================
+
+// Args: fft_size, mel_bands
+static void BM_CreateMelFilterbank(benchmark::State &state) {
+  int fft_size = (int)state.range(0);
+  int mel_bands = (int)state.range(1);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(createMelFilterbank(mel_bands, fft_size,
+                                                 SAMPLE_RATE, 0,
+                                                 SAMPLE_RATE / 2));
+  }
+}
+BENCHMARK(BM_CreateMelFilterbank)
+    ->ArgNames({"fft", "mels"})
+    ->ArgsProduct({{512, 2048, 8192}, {64, 128, 256}})
+    ->Unit(benchmark::kMicrosecond);
+
+// Args: fft_size, mel_bands, duration (s), hop 512; items are frames
+static void BM_ApplyMelFilterbank(benchmark::State &state) {
+  int fft_size = (int)state.range(0);
+  int mel_bands = (int)state.range(1);
+  std::vector<float> window = createWindow(fft_size, "hann");
+  auto spectrogram =
+      computeSTFT(testSignal((double)state.range(2)), fft_size, 512, window);
+  auto filterbank = createMelFilterbank(mel_bands, fft_size, SAMPLE_RATE, 0,
+                                        SAMPLE_RATE / 2);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(applyMelFilterbank(spectrogram, filterbank));
+  }
+  state.SetItemsProcessed(state.iterations() * spectrogram.size());
+}
+BENCHMARK(BM_ApplyMelFilterbank)
+    ->ArgNames({"fft", "mels", "dur"})
+    ->ArgsProduct({{512, 2048, 8192}, {64, 128, 256}, {1, 10}})
+    ->Unit(benchmark::kMillisecond);
+
+//==============================================================================
+// Scaling
+//==============================================================================
+
+// Args: mel_bands, duration (s); the copy of the input is not timed
+static void BM_ConvertToDb(benchmark::State &state) {
+  std::vector<float> window = createWindow(2048, "hann");
+  auto mel_spec = applyMelFilterbank(
+      computeSTFT(testSignal((double)state.range(1)), 2048, 512, window),
+      createMelFilterbank((int)state.range(0), 2048, SAMPLE_RATE, 0,
+                          SAMPLE_RATE / 2));
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto spec = mel_spec;
+    state.ResumeTiming();
+    convertToDb(spec, -80);
+    benchmark::DoNotOptimize(spec);
+  }
+  state.SetItemsProcessed(state.iterations() * mel_spec.size() *
+                          state.range(0));
+}
+BENCHMARK(BM_ConvertToDb)
+    ->ArgNames({"mels", "dur"})
+    ->ArgsProduct({{64, 128, 256}, {1, 10}})
+    ->Unit(benchmark::kMicrosecond);
+
+// Args: mel_bands, duration (s); the copy of the input is not timed
+static void BM_NormalizeSpectrogram(benchmark::State &state) {
+  std::vector<float> window = createWindow(2048, "hann");
+  auto mel_spec = applyMelFilterbank(
+      computeSTFT(testSignal((double)state.range(1)), 2048, 512, window),
+      createMelFilterbank((int)state.range(0), 2048, SAMPLE_RATE, 0,
+                          SAMPLE_RATE / 2));
+  convertToDb(mel_spec, -80);
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto spec = mel_spec;
+    state.ResumeTiming();
+    normalizeSpectrogram(spec);
+    benchmark::DoNotOptimize(spec);
+  }
+  state.SetItemsProcessed(state.iterations() * mel_spec.size() *
+                          state.range(0));
+}
+BENCHMARK(BM_NormalizeSpectrogram)
+    ->ArgNames({"mels", "dur"})
+    ->ArgsProduct({{64, 128, 256}, {1, 10}})
+    ->Unit(benchmark::kMicrosecond);
+
+//==============================================================================
+// Image
+//==============================================================================
+
+// Args: colormap (index in COLORMAPS); items are values mapped
+static void BM_ApplyColormap(benchmark::State &state) {
+  std::string colormap = COLORMAPS[state.range(0)];
+  std::vector<float> values(4096);
+  for (size_t i = 0; i < values.size(); i++) {
+    values[i] = (float)i / (values.size() - 1);
+  }
+  for (auto _ : state) {
+    for (float value : values) {
+      benchmark::DoNotOptimize(applyColormap(value, colormap));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * values.size());
+  state.SetLabel(colormap);
+}
+BENCHMARK(BM_ApplyColormap)->ArgName("colormap")->DenseRange(0, 3);
+
+// Args: scale, duration (s), 128 mel bands; items are pixels
+static void BM_RenderImage(benchmark::State &state) {
+  auto spec = testSpectrogram((double)state.range(1), 128);
+  Options opts = imageOptions((double)state.range(0));
+  size_t pixels = 0;
+  for (auto _ : state) {
+    Image image = renderImage(spec, opts);
+    pixels = image.size() * image[0].size();
+    benchmark::DoNotOptimize(image);
+  }
+  state.SetItemsProcessed(state.iterations() * pixels);
+}
+BENCHMARK(BM_RenderImage)
+    ->ArgNames({"scale", "dur"})
+    ->ArgsProduct({{1, 2, 4}, {1, 10}})
+    ->Unit(benchmark::kMillisecond);
+
+// Args: scale, duration (s), 128 mel bands; bytes are the PNG size
+static void BM_EncodeImagePNG(benchmark::State &state) {
+  Image image = renderImage(testSpectrogram((double)state.range(1), 128),
+                            imageOptions((double)state.range(0)));
+  std::vector<unsigned char> png_data;
+  for (auto _ : state) {
+    encodeImagePNG(image, png_data);
+    benchmark::DoNotOptimize(png_data);
+  }
+  state.SetItemsProcessed(state.iterations() * image.size() * image[0].size());
+  state.counters["png_bytes"] = (double)png_data.size();
+}
+BENCHMARK(BM_EncodeImagePNG)
+    ->ArgNames({"scale", "dur"})
+    ->ArgsProduct({{1, 2, 4}, {1, 10}})
+    ->Unit(benchmark::kMillisecond);
+
+// Args: scale, duration (s), 128 mel bands: renderImage, encodeImagePNG and
+// the file write together, as in the architecture
+static void BM_WritePNG(benchmark::State &state) {
+  auto spec = testSpectrogram((double)state.range(1), 128);
+  Options opts = imageOptions((double)state.range(0));
+  std::string path =
+      "/tmp/spectrogram_kernels_" + std::to_string(getpid()) + ".png";
+  for (auto _ : state) {
+    if (!writePNG(path, spec, opts)) {
+      state.SkipWithError("could not write the PNG file");
+      break;
+    }
+  }
+  std::remove(path.c_str());
+}
+BENCHMARK(BM_WritePNG)
+    ->ArgNames({"scale", "dur"})
+    ->ArgsProduct({{1, 2, 4}, {1, 10}})
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,155 @@
+/************************************************************************
+ Cold-start latency of the server
+
+ MCP clients launch a new server per session (with the Docker image, a
+ new container), so the time from launch to the first response matters.
+ Launches each server command <runs> times (alternating between commands
+ so that they see the same system state), sends an initialize request as
+ soon as the process exists and measures the time until its response
+ line, then closes stdin and waits for the exit.
+
+ Build (from the repository root):
+   g++ -std=c++17 -O2 bench/startup_time.cpp -o startup_time
+
+ Usage:
+   ./startup_time [runs] <server command>...
+   (default: 50 runs; a command with spaces is split into arguments, e.g.
+   ./startup_time 20 build/mcpFaustServer build-static/mcpFaustServer
+   "docker run -i --rm mcpfaustdocker")
+ ************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <spawn.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char **environ;
+
+typedef std::chrono::steady_clock Clock;
+
+static const char *INITIALIZE_REQUEST =
+    "{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"initialize\",\"params\":"
+    "{\"protocolVersion\":\"2024-11-05\",\"clientInfo\":"
+    "{\"name\":\"startup_time\",\"version\":\"1\"}}}\n";
+
+static std::vector<std::string> splitCommand(const std::string &command) {
+  std::istringstream words(command);
+  std::vector<std::string> args;
+  std::string word;
+  while (words >> word) {
+    args.push_back(word);
+  }
+  return args;
+}
+
+// Milliseconds from launch to the initialize response, negative on error
+static double timeToInitialize(const std::vector<std::string> &command) {
+  int in[2], out[2];
+  if (pipe(in) != 0 || pipe(out) != 0) {
+    return -1;
+  }
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+  posix_spawn_file_actions_addclose(&actions, in[1]);
+  posix_spawn_file_actions_addclose(&actions, out[0]);
+
+  std::vector<char *> argv;
+  for (const auto &arg : command) {
+    argv.push_back(const_cast<char *>(arg.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  auto start = Clock::now();
+  pid_t pid;
+  int error = posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(),
+                           environ);
+  posix_spawn_file_actions_destroy(&actions);
+  close(in[0]);
+  close(out[1]);
+  if (error != 0) {
+    close(in[1]);
+    close(out[0]);
+    return -1;
+  }
+
+  // The request waits in the pipe until the server reads it
+  bool ok = write(in[1], INITIALIZE_REQUEST, strlen(INITIALIZE_REQUEST)) > 0;
+  char c = 0;
+  while (ok && read(out[0], &c, 1) == 1 && c != '\n') {
+  }
+  double ms =
+      std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+  close(in[1]);
+  close(out[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return (ok && c == '\n') ? ms : -1;
+}
+
+static void report(const std::string &command, std::vector<double> &samples,
+                   int failures) {
+  std::cout << command;
+  struct stat st;
+  if (stat(splitCommand(command)[0].c_str(), &st) == 0) {
+    std::cout << " (" << st.st_size / 1024 << " KiB)";
+  }
+  std::cout << std::endl;
+  if (samples.empty()) {
+    std::cout << "  no response" << std::endl;
+    return;
+  }
+  std::sort(samples.begin(), samples.end());
+  std::cout << "  first response: median " << samples[samples.size() / 2]
+            << " ms, min " << samples.front() << " ms, p90 "
+            << samples[samples.size() * 90 / 100] << " ms";
+  if (failures > 0) {
+    std::cout << ", " << failures << " failed";
+  }
+  std::cout << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  int first = 1;
+  int runs = 50;
+  if (argc > 1 && std::atoi(argv[1]) > 0) {
+    runs = std::atoi(argv[1]);
+    first = 2;
+  }
+  if (first >= argc) {
+    std::cerr << "Usage: " << argv[0] << " [runs] <server command>..."
+              << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> commands(argv + first, argv + argc);
+  std::vector<std::vector<double>> samples(commands.size());
+  std::vector<int> failures(commands.size(), 0);
+  for (int run = 0; run < runs; run++) {
+    for (size_t i = 0; i < commands.size(); i++) {
+      double ms = timeToInitialize(splitCommand(commands[i]));
+      if (ms < 0) {
+        failures[i]++;
+      } else {
+        samples[i].push_back(ms);
+      }
+    }
+  }
+
+  std::cout << runs << " launches per command" << std::endl;
+  for (size_t i = 0; i < commands.size(); i++) {
+    report(commands[i], samples[i], failures[i]);
+  }
+  return 0;
+}
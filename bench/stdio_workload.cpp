@@ -0,0 +1,595 @@
+/************************************************************************
+ End-to-end latency and throughput of the server over stdio
+
+ Launches mcpFaustServer as an MCP client would (JSON-RPC lines on its
+ stdin/stdout), replays a workload of requests with up to <concurrency>
+ requests in flight, and reports, per method (tools/call per tool), the
+ number of requests, errors and latency percentiles, plus the overall
+ throughput, as JSON on stdout so that runs can be compared.
+
+ By default the Faust compiler is replaced by a stub (this program, run by
+ the local backend): it answers -v and -h, writes a small C++ class for
+ compilations, one SVG file per diagram request, and fills architecture
+ files with a sine oscillator DSP exposing gate/freq/gain, so that what
+ is measured is the server itself (plus g++ and the generator for the
+ compile engine of FaustSpectrogramTool).
+
+ Build (from the repository root):
+   g++ -std=c++17 -O2 -pthread -Isrc bench/stdio_workload.cpp \
+       -o stdio_workload
+
+ Usage:
+   ./stdio_workload <server> [--concurrency n] [--iterations n]
+                    [--warmup n] [--workload file.jsonl] [--backend name]
+                    [--arch-dir dir] [--baseline previous.json]
+   (default: concurrency 4, 10 iterations after 1 warmup iteration of the
+   built-in workload: initialize, tools/list, FaustVersionTool,
+   FaustCompileTool, FaustSVGTool and a 0.5 s FaustSpectrogramTool note;
+   stub Faust backend; architectures from src/tools)
+
+ A workload file holds one JSON-RPC message per line (e.g. a recorded
+ client session); request ids are renumbered, notifications are sent but
+ not timed. --backend runs a real backend (docker, worker, local) instead
+ of the stub. --baseline prints the change of throughput and of each
+ method's p50/p95 against a previous output on stderr.
+ ************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <regex>
+#include <spawn.h>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+extern char **environ;
+
+typedef std::chrono::steady_clock Clock;
+
+// Set in the server's environment: this program then acts as the Faust
+// compiler of the local backend
+static const char *STUB_VARIABLE = "FAUST_MCP_BENCH_STUB";
+
+static const char *DSP_SOURCE =
+    "import(\"stdfaust.lib\");\n"
+    "process = os.osc(hslider(\"freq\",440,20,2000,1)) * "
+    "hslider(\"gain\",0.5,0,1,0.01) * button(\"gate\");\n";
+
+// DSP class inserted in architecture files by the stub
+static const char *STUB_DSP_CLASS = R"(
+class mydsp : public dsp {
+  FAUSTFLOAT fGate, fFreq, fGain;
+  float fPhase, fEnv;
+  int fSampleRate;
+
+public:
+  void buildUserInterface(UI *ui) {
+    ui->openVerticalBox("stub");
+    ui->addButton("gate", &fGate);
+    ui->addHorizontalSlider("freq", &fFreq, 440, 20, 20000, 1);
+    ui->addHorizontalSlider("gain", &fGain, 0.5, 0, 1, 0.01);
+    ui->closeBox();
+  }
+  void compute(int count, FAUSTFLOAT **inputs, FAUSTFLOAT **outputs) {
+    for (int i = 0; i < count; i++) {
+      fEnv += ((fGate > 0 ? 1.0f : 0.0f) - fEnv) * 0.001f;
+      fPhase += fFreq / fSampleRate;
+      fPhase -= (fPhase >= 1.0f) ? 1.0f : 0.0f;
+      outputs[0][i] = std::sin(6.2831853f * fPhase) * fGain * fEnv;
+    }
+  }
+  void init(int sample_rate) { instanceInit(sample_rate); }
+  void instanceClear() { fPhase = 0; fEnv = 0; }
+  void instanceConstants(int sample_rate) { fSampleRate = sample_rate; }
+  void instanceInit(int sample_rate) {
+    instanceConstants(sample_rate);
+    instanceResetUserInterface();
+    instanceClear();
+  }
+  void instanceResetUserInterface() { fGate = 0; fFreq = 440; fGain = 0.5; }
+  int getNumInputs() { return 0; }
+  int getNumOutputs() { return 1; }
+  int getSampleRate() { return fSampleRate; }
+  mydsp *clone() { return new mydsp(); }
+};
+)";
+
+//==============================================================================
+// Stub Faust compiler
+//==============================================================================
+
+static std::string readFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+}
+
+static bool writeFile(const std::string &path, const std::string &content) {
+  std::ofstream file(path, std::ios::binary);
+  file << content;
+  return file.good();
+}
+
+// Command line of the Faust compiler, as used by the server's tools
+static int stubFaust(int argc, char *argv[]) {
+  std::string output, arch, source;
+  bool svg = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "-v") {
+      std::cout << "FAUST Version 2.99.0 (benchmark stub)" << std::endl;
+      return 0;
+    } else if (arg == "-h") {
+      std::cout << "FAUST benchmark stub: -o <file>, -a <arch>, -svg"
+                << std::endl;
+      return 0;
+    } else if (arg == "-o" && i + 1 < argc) {
+      output = argv[++i];
+    } else if (arg == "-a" && i + 1 < argc) {
+      arch = argv[++i];
+    } else if (arg == "-svg") {
+      svg = true;
+    } else if (arg[0] != '-') {
+      source = arg;
+    }
+  }
+
+  struct stat st;
+  if (source.empty() || stat(source.c_str(), &st) != 0) {
+    std::cerr << "ERROR : " << source << " not found" << std::endl;
+    return 1;
+  }
+  if (svg) {
+    std::string dir = source.substr(0, source.find_last_of('.')) + "-svg";
+    mkdir(dir.c_str(), 0755);
+    return writeFile(dir + "/process.svg",
+                     "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"80\" "
+                     "height=\"40\"><text x=\"4\" y=\"24\">process</text>"
+                     "</svg>\n")
+               ? 0
+               : 1;
+  }
+  if (!arch.empty()) {
+    std::string code = readFile(arch);
+    code = std::regex_replace(code, std::regex("<<\\s*includeIntrinsic\\s*>>"),
+                              "");
+    code = std::regex_replace(code, std::regex("<<\\s*includeclass\\s*>>"),
+                              STUB_DSP_CLASS);
+    return writeFile(output, code) ? 0 : 1;
+  }
+  if (!output.empty() && output != "/dev/null") {
+    return writeFile(output, "/* benchmark stub */\nclass mydsp {};\n") ? 0
+                                                                         : 1;
+  }
+  return 0;
+}
+
+//==============================================================================
+// Workload
+//==============================================================================
+
+static json toolCall(const std::string &tool, const json &arguments) {
+  return {{"jsonrpc", "2.0"},
+          {"id", 0},
+          {"method", "tools/call"},
+          {"params", {{"name", tool}, {"arguments", arguments}}}};
+}
+
+static std::vector<json> builtinWorkload() {
+  return {
+      {{"jsonrpc", "2.0"},
+       {"id", 0},
+       {"method", "initialize"},
+       {"params",
+        {{"protocolVersion", "2024-11-05"},
+         {"clientInfo", {{"name", "stdio_workload"}, {"version", "1"}}}}}},
+      {{"jsonrpc", "2.0"}, {"method", "notifications/initialized"}},
+      {{"jsonrpc", "2.0"}, {"id", 0}, {"method", "tools/list"}},
+      toolCall("FaustVersionTool", json::object()),
+      toolCall("FaustCompileTool", {{"value", DSP_SOURCE}}),
+      toolCall("FaustSVGTool", {{"value", DSP_SOURCE}}),
+      toolCall("FaustSpectrogramTool", {{"value", DSP_SOURCE},
+                                        {"duration", 0.5},
+                                        {"gate_duration", 0.3},
+                                        {"engine", "compile"}}),
+  };
+}
+
+// One JSON-RPC message per line, blank lines ignored
+static bool readWorkload(const std::string &path, std::vector<json> &workload) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.find_first_not_of(" \t\r") != std::string::npos) {
+      workload.push_back(json::parse(line));
+    }
+  }
+  return true;
+}
+
+// Statistics key of a request: its method, or tools/call:<tool>
+static std::string methodKey(const json &request) {
+  std::string method = request.value("method", "");
+  if (method == "tools/call") {
+    return method + ":" +
+           request.value("params", json::object()).value("name", "");
+  }
+  return method;
+}
+
+// JSON-RPC errors, and tool results reporting an error in their content
+static bool isError(const json &response) {
+  if (response.contains("error")) {
+    return true;
+  }
+  json content = response.value("result", json::object())
+                     .value("content", json::array());
+  if (!content.is_array() || content.empty() || !content[0].is_object()) {
+    return false;
+  }
+  std::string text = content[0].value("text", "");
+  return text.compare(0, 5, "Error") == 0 ||
+         text.compare(0, 8, "{\"error\"") == 0;
+}
+
+//==============================================================================
+// Server process
+//==============================================================================
+
+class ServerProcess {
+public:
+  bool start(const std::string &path, const std::vector<std::string> &env) {
+    int in[2], out[2];
+    if (pipe(in) != 0 || pipe(out) != 0) {
+      return false;
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, in[1]);
+    posix_spawn_file_actions_addclose(&actions, out[0]);
+
+    std::vector<char *> envp;
+    for (const auto &variable : env) {
+      envp.push_back(const_cast<char *>(variable.c_str()));
+    }
+    envp.push_back(nullptr);
+    char *argv[] = {const_cast<char *>(path.c_str()), nullptr};
+    int error = posix_spawn(&fPid, path.c_str(), &actions, nullptr, argv,
+                            envp.data());
+    posix_spawn_file_actions_destroy(&actions);
+    close(in[0]);
+    close(out[1]);
+    if (error != 0) {
+      close(in[1]);
+      close(out[0]);
+      return false;
+    }
+    fInput = fdopen(in[1], "w");
+    fOutput = fdopen(out[0], "r");
+    return true;
+  }
+
+  void send(const std::string &line) {
+    std::fputs(line.c_str(), fInput);
+    std::fputc('\n', fInput);
+    std::fflush(fInput);
+  }
+
+  // false at end of output
+  bool receive(std::string &line) {
+    line.clear();
+    char buffer[65536];
+    while (std::fgets(buffer, sizeof(buffer), fOutput)) {
+      line += buffer;
+      if (!line.empty() && line.back() == '\n') {
+        line.pop_back();
+        return true;
+      }
+    }
+    return !line.empty();
+  }
+
+  // Closes stdin (the server finishes its calls and exits)
+  int finish() {
+    std::fclose(fInput);
+    int status = 0;
+    waitpid(fPid, &status, 0);
+    std::fclose(fOutput);
+    return status;
+  }
+
+private:
+  pid_t fPid = -1;
+  FILE *fInput = nullptr;
+  FILE *fOutput = nullptr;
+};
+
+// Environment of the server: ours, with the settings of the benchmark
+static std::vector<std::string>
+serverEnvironment(const std::map<std::string, std::string> &settings) {
+  std::vector<std::string> env;
+  for (char **variable = environ; *variable; variable++) {
+    std::string entry = *variable;
+    std::string name = entry.substr(0, entry.find('='));
+    if (settings.find(name) == settings.end()) {
+      env.push_back(entry);
+    }
+  }
+  for (const auto &setting : settings) {
+    env.push_back(setting.first + "=" + setting.second);
+  }
+  return env;
+}
+
+//==============================================================================
+// Statistics
+//==============================================================================
+
+struct MethodStats {
+  std::vector<double> latencies; // ms
+  int errors = 0;
+};
+
+// Nearest-rank percentile of sorted values
+static double percentile(const std::vector<double> &sorted, double q) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  size_t rank = (size_t)std::ceil(q * sorted.size());
+  return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+static double round3(double value) { return std::round(value * 1000) / 1000; }
+
+static json methodJson(MethodStats stats, double wallSeconds) {
+  std::vector<double> &sorted = stats.latencies;
+  std::sort(sorted.begin(), sorted.end());
+  double total = 0;
+  for (double latency : sorted) {
+    total += latency;
+  }
+  return {{"count", sorted.size()},
+          {"errors", stats.errors},
+          {"throughput_rps", round3(sorted.size() / wallSeconds)},
+          {"mean_ms", round3(sorted.empty() ? 0 : total / sorted.size())},
+          {"p50_ms", round3(percentile(sorted, 0.50))},
+          {"p95_ms", round3(percentile(sorted, 0.95))},
+          {"p99_ms", round3(percentile(sorted, 0.99))},
+          {"max_ms", round3(sorted.empty() ? 0 : sorted.back())}};
+}
+
+// Relative change of a value, e.g. "+12.5%"
+static std::string change(double previous, double current) {
+  if (previous <= 0) {
+    return "n/a";
+  }
+  char text[32];
+  std::snprintf(text, sizeof(text), "%+.1f%%",
+                100.0 * (current - previous) / previous);
+  return text;
+}
+
+static void compareWithBaseline(const json &baseline, const json &report) {
+  std::cerr << "vs baseline: throughput "
+            << change(baseline.value("throughput_rps", 0.0),
+                      report.value("throughput_rps", 0.0))
+            << std::endl;
+  for (const auto &method : report["methods"].items()) {
+    if (!baseline["methods"].contains(method.key())) {
+      continue;
+    }
+    const json &previous = baseline["methods"][method.key()];
+    std::cerr << "  " << method.key() << ": p50 "
+              << change(previous.value("p50_ms", 0.0),
+                        method.value().value("p50_ms", 0.0))
+              << ", p95 "
+              << change(previous.value("p95_ms", 0.0),
+                        method.value().value("p95_ms", 0.0))
+              << std::endl;
+  }
+}
+
+//==============================================================================
+// Main
+//==============================================================================
+
+int main(int argc, char *argv[]) {
+  if (std::getenv(STUB_VARIABLE)) {
+    return stubFaust(argc, argv);
+  }
+
+  std::string server;
+  int concurrency = 4, iterations = 10, warmup = 1;
+  std::string workloadPath, backend, archDir = "src/tools", baselinePath;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--concurrency" && hasValue) {
+      concurrency = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--iterations" && hasValue) {
+      iterations = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--warmup" && hasValue) {
+      warmup = std::max(0, std::atoi(argv[++i]));
+    } else if (arg == "--workload" && hasValue) {
+      workloadPath = argv[++i];
+    } else if (arg == "--backend" && hasValue) {
+      backend = argv[++i];
+    } else if (arg == "--arch-dir" && hasValue) {
+      archDir = argv[++i];
+    } else if (arg == "--baseline" && hasValue) {
+      baselinePath = argv[++i];
+    } else if (server.empty() && arg[0] != '-') {
+      server = arg;
+    } else {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      return 1;
+    }
+  }
+  if (server.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " <server> [--concurrency n] [--iterations n] [--warmup n]"
+                 " [--workload file.jsonl] [--backend name]"
+                 " [--arch-dir dir] [--baseline previous.json]"
+              << std::endl;
+    return 1;
+  }
+
+  std::vector<json> workload;
+  if (workloadPath.empty()) {
+    workload = builtinWorkload();
+  } else if (!readWorkload(workloadPath, workload)) {
+    std::cerr << "Could not read " << workloadPath << std::endl;
+    return 1;
+  }
+
+  // The stub is this program, found through /proc/self/exe
+  char self[PATH_MAX];
+  ssize_t length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+  self[std::max<ssize_t>(length, 0)] = '\0';
+  char arch[PATH_MAX];
+  std::map<std::string, std::string> settings = {
+      {"FAUST_MCP_ARCH_DIR",
+       realpath(archDir.c_str(), arch) ? arch : archDir}};
+  if (backend.empty()) {
+    settings["FAUST_MCP_BACKEND"] = "local";
+    settings["FAUST_MCP_FAUST_BINARY"] = self;
+    settings[STUB_VARIABLE] = "1";
+  } else {
+    settings["FAUST_MCP_BACKEND"] = backend;
+  }
+
+  ServerProcess process;
+  if (!process.start(server, serverEnvironment(settings))) {
+    std::cerr << "Could not start " << server << std::endl;
+    return 1;
+  }
+
+  // Requests in flight: send time and statistics key, by id
+  struct Pending {
+    Clock::time_point sent;
+    std::string key;
+    bool measured;
+  };
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::map<long, Pending> pending;
+  std::map<std::string, MethodStats> stats;
+  bool serverGone = false;
+
+  std::thread reader([&]() {
+    std::string line;
+    while (process.receive(line)) {
+      auto received = Clock::now();
+      json response = json::parse(line, nullptr, false);
+      if (response.is_discarded() || !response.contains("id") ||
+          !response["id"].is_number_integer()) {
+        continue;
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      auto found = pending.find(response["id"].get<long>());
+      if (found == pending.end()) {
+        continue;
+      }
+      if (found->second.measured) {
+        MethodStats &method = stats[found->second.key];
+        method.latencies.push_back(
+            std::chrono::duration<double, std::milli>(received -
+                                                      found->second.sent)
+                .count());
+        method.errors += isError(response) ? 1 : 0;
+      }
+      pending.erase(found);
+      changed.notify_all();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    serverGone = true;
+    changed.notify_all();
+  });
+
+  long nextId = 1;
+  Clock::time_point start;
+  for (int iteration = 0; iteration < warmup + iterations; iteration++) {
+    bool measured = iteration >= warmup;
+    if (iteration == warmup) {
+      // Measured iterations start once the warmup requests are answered
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [&]() { return pending.empty() || serverGone; });
+      start = Clock::now();
+    }
+    for (json request : workload) {
+      if (!request.contains("id")) {
+        process.send(request.dump());
+        continue;
+      }
+      long id = nextId++;
+      request["id"] = id;
+      std::unique_lock<std::mutex> lock(mutex);
+      changed.wait(lock, [&]() {
+        return (int)pending.size() < concurrency || serverGone;
+      });
+      if (serverGone) {
+        break;
+      }
+      pending[id] = {Clock::now(), methodKey(request), measured};
+      lock.unlock();
+      process.send(request.dump());
+    }
+  }
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&]() { return pending.empty() || serverGone; });
+  }
+  double wallSeconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+  process.finish();
+  reader.join();
+
+  size_t requests = 0;
+  json methods = json::object();
+  for (const auto &method : stats) {
+    requests += method.second.latencies.size();
+    methods[method.first] = methodJson(method.second, wallSeconds);
+  }
+  json report = {{"server", server},
+                 {"backend", backend.empty() ? "stub" : backend},
+                 {"concurrency", concurrency},
+                 {"iterations", iterations},
+                 {"requests", requests},
+                 {"wall_s", round3(wallSeconds)},
+                 {"throughput_rps", round3(requests / wallSeconds)},
+                 {"methods", methods}};
+  std::cout << report.dump(2) << std::endl;
+
+  if (!baselinePath.empty()) {
+    std::ifstream file(baselinePath);
+    json baseline = json::parse(file, nullptr, false);
+    if (baseline.is_discarded()) {
+      std::cerr << "Could not read " << baselinePath << std::endl;
+      return 1;
+    }
+    compareWithBaseline(baseline, report);
+  }
+  return 0;
+}
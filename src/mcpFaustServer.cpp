@@ -6,6 +6,9 @@
 #include "FaustSVGTool.hh"
 #include "FaustHelpTool.hh"
 #include "FaustSpectrogramTool.hh"
+#include "FaustRenderTool.hh"
+#include "FaustAnalyzeTool.hh"
+#include "ServerStatsTool.hh"
 #include "json.hpp"
 #include "mcpServer.hh"
 
@@ -19,6 +22,9 @@ int main() {
   server.registerTool(std::make_unique<FaustSVGTool>());
   server.registerTool(std::make_unique<FaustHelpTool>());
   server.registerTool(std::make_unique<FaustSpectrogramTool>());
+  server.registerTool(std::make_unique<FaustRenderTool>());
+  server.registerTool(std::make_unique<FaustAnalyzeTool>());
+  server.registerTool(std::make_unique<ServerStatsTool>());
   server.run();
   return 0;
 }
\ No newline at end of file
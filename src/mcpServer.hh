@@ -1,15 +1,27 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
 #include "json.hpp"
+#include "tools/artifacts.hh"
+#include "tools/config.hh"
+#include "tools/jsonrpc.hh"
+#include "tools/logger.hh"
 #include "tools/mcpTool.hh"
+#include "tools/stats.hh"
 
 using json = nlohmann::json;
 
@@ -19,8 +31,17 @@ using json = nlohmann::json;
  * This class implements a server that:
  * - Communicates via JSON-RPC 2.0 protocol over stdin/stdout
  * - Manages a collection of tools that can be called by MCP clients
+ * - Runs each tools/call on its own thread so that the input loop keeps
+ *   reading, and honors notifications/cancelled by cancelling the request
  * - Handles model context interactions
- * - Logs all exchanges to a file for debugging
+ * - Scans request lines without building a JSON tree (the tool arguments
+ *   are passed on as text) and streams responses to stdout, see jsonrpc.hh
+ * - Serves the tool outputs kept as resources (resources/list and
+ *   resources/read) when results are returned by reference, see
+ *   artifacts.hh
+ * - Records the duration of every tool call (ServerStatsTool)
+ * - Logs one structured line per request (id, method, tool, sizes, stages,
+ *   exit codes, cache lookups) to a rotating file, see logger.hh
  */
 class SimpleMCPServer {
 private:
@@ -30,25 +51,85 @@ private:
   std::string fServerName;    ///< Server name for MCP identification
   std::string fServerVersion; ///< Server version for MCP identification
 
-  // Message handling methods
-  void sendResponse(const json &id, const json &result) {
-    json response = {{"jsonrpc", "2.0"}, {"id", id}, {"result", result}};
+  // In-flight tool calls, indexed by serialized request id
+  std::mutex fOutputMutex;   ///< Serializes writes to stdout
+  std::mutex fInFlightMutex; ///< Protects fInFlight
+  std::condition_variable fInFlightDone; ///< Signaled when a call ends
+  std::map<std::string, CancellationToken> fInFlight;
+  int fActiveCalls = 0; ///< Number of running worker threads
+  int fMaxToolCalls;    ///< Most worker threads at a time (max_tool_calls)
 
-    std::string responseStr = response.dump();
-    std::cout << responseStr << std::endl;
+  // Writes one message line to stdout and returns its size: write(writer)
+  // serializes it straight to the stream (see JsonWriter), under the output
+  // lock so that the lines of concurrent calls do not interleave. Members
+  // are in json::dump() order.
+  template <typename Write>
+  size_t sendLine(const StreamedContent *streamed, Write write) {
+    std::lock_guard<std::mutex> lock(fOutputMutex);
+    JsonWriter writer(std::cout, streamed);
+    write(writer);
+    writer.raw("\n");
+    writer.flush();
+    std::cout.flush();
+    return writer.size();
   }
 
-  void sendError(const json &id, int code, const std::string &message) {
-    json response = {{"jsonrpc", "2.0"},
-                     {"id", id},
-                     {"error", {{"code", code}, {"message", message}}}};
+  // Message handling methods (they return the size of the response line)
+  size_t sendResponse(const json &id, const json &result,
+                      const StreamedContent *streamed = nullptr) {
+    return sendLine(streamed, [&](JsonWriter &writer) {
+      writer.raw("{\"id\":").value(id);
+      writer.raw(",\"jsonrpc\":\"2.0\",\"result\":").value(result).raw("}");
+    });
+  }
+
+  // Result of a tools/call, written without copying the content into a
+  // result object; its streamed values (files, bytes) are written from
+  // their source
+  size_t sendToolResult(const json &id, const json &content,
+                        const StreamedContent &streamed) {
+    return sendLine(&streamed, [&](JsonWriter &writer) {
+      writer.raw("{\"id\":").value(id);
+      writer.raw(",\"jsonrpc\":\"2.0\",\"result\":{\"content\":");
+      writer.value(content).raw("}}");
+    });
+  }
+
+  size_t sendError(const json &id, int code, const std::string &message) {
+    return sendLine(nullptr, [&](JsonWriter &writer) {
+      writer.raw("{\"error\":{\"code\":" + std::to_string(code));
+      writer.raw(",\"message\":").string(message).raw("},\"id\":");
+      writer.value(id).raw(",\"jsonrpc\":\"2.0\"}");
+    });
+  }
+
+  // Milliseconds since 'start', rounded to the microsecond
+  static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    return std::round(ms * 1000) / 1000;
+  }
 
-    std::string responseStr = response.dump();
-    std::cout << responseStr << std::endl;
+  // Whether tool content reports an error (tools return errors as text
+  // starting with "Error", limit errors as a JSON object)
+  static bool isErrorContent(const json &content) {
+    if (!content.is_array() || content.empty() ||
+        content[0].value("type", "") != "text") {
+      return false;
+    }
+    // Streamed values (see StreamedContent) are not strings
+    auto text = content[0].find("text");
+    if (text == content[0].end() || !text->is_string()) {
+      return false;
+    }
+    const std::string &value = text->get_ref<const std::string &>();
+    return value.compare(0, 5, "Error") == 0 ||
+           value.compare(0, 8, "{\"error\"") == 0;
   }
 
   // Request processing methods
-  void handleToolsListRequest(const json &id) {
+  size_t handleToolsListRequest(const json &id) {
     json tools = json::array();
 
     for (const auto &toolPair : fRegisteredTools) {
@@ -58,32 +139,202 @@ private:
     }
 
     json result = {{"tools", tools}};
-    sendResponse(id, result);
+    return sendResponse(id, result);
+  }
+
+  // Calls a tool and sends its result, returns the size of the response
+  // (0 if none is sent) and the outcome in status
+  size_t runToolCall(const json &id, const std::string &toolName,
+                     const std::string &arguments,
+                     const CancellationToken &cancel,
+                     const StreamedContent &streamed, std::string &status) {
+    auto tool = fRegisteredTools.find(toolName);
+    if (tool == fRegisteredTools.end()) {
+      releaseRequestId(id);
+      status = "unknown_tool";
+      return sendError(id, -32602, "Method not found: " + toolName);
+    }
+
+    // Call the tool with JSON arguments (timed per tool, see stats.hh)
+    auto start = std::chrono::steady_clock::now();
+    json toolResponse;
+    try {
+      toolResponse = tool->second->call(arguments, cancel);
+      recordToolTime(toolName, elapsedMs(start));
+    } catch (const std::exception &e) {
+      releaseRequestId(id);
+      status = cancel.isCancelled() ? "cancelled" : "exception";
+      if (!cancel.isCancelled()) {
+        return sendError(id, -32603,
+                         "Internal error: " + std::string(e.what()));
+      }
+      return 0;
+    }
+    releaseRequestId(id);
+
+    // A cancelled request gets no response (MCP cancellation semantics)
+    if (cancel.isCancelled()) {
+      status = "cancelled";
+      return 0;
+    }
+
+    // Tool returns MCP content array directly (with its large outputs
+    // moved to the artifact store in reference mode)
+    if (resultsByReference()) {
+      toolResponse =
+          linkArtifacts(toolName, std::move(toolResponse), streamed);
+    }
+    status = isErrorContent(toolResponse) ? "error" : "ok";
+    return sendToolResult(id, toolResponse, streamed);
   }
 
+  // Runs a tools/call and logs it with the stages it went through (the log
+  // line is queued after the response is sent, see logger.hh)
   void handleToolCall(const json &id, const std::string &toolName,
-                      const json &arguments) {
-    if (fRegisteredTools.find(toolName) == fRegisteredTools.end()) {
-      sendError(id, -32602, "Method not found: " + toolName);
+                      const std::string &arguments,
+                      const CancellationToken &cancel, size_t bytesIn) {
+    RequestTrace trace;
+    RequestTrace::Scope scope(trace);
+    StreamedContent streamed;
+    StreamedContent::Scope streamedScope(streamed);
+    auto start = std::chrono::steady_clock::now();
+    std::string status;
+    size_t bytesOut =
+        runToolCall(id, toolName, arguments, cancel, streamed, status);
+
+    logRequest({{"id", id},
+                {"method", "tools/call"},
+                {"tool", toolName},
+                {"bytes_in", bytesIn},
+                {"bytes_out", bytesOut},
+                {"ms", elapsedMs(start)},
+                {"status", status},
+                {"stages", trace.stages},
+                {"caches", trace.caches}});
+  }
+
+  // Runs a tools/call on a worker thread, registered for cancellation
+  // (arguments: JSON text, parsed by the tool). Returns 0 when the call is
+  // started, otherwise the size of the error sent: a request with the same
+  // id is still running (-32600), or max_tool_calls calls are (-32000)
+  size_t startToolCall(const json &id, const std::string &toolName,
+                       const std::string &arguments, size_t bytesIn) {
+    CancellationToken cancel;
+    std::string key = id.dump();
+    {
+      std::lock_guard<std::mutex> lock(fInFlightMutex);
+      if (fInFlight.count(key)) {
+        return sendError(id, -32600,
+                         "Invalid Request: request " + key +
+                             " is already in progress");
+      }
+      if (fActiveCalls >= fMaxToolCalls) {
+        return sendError(id, -32000,
+                         "Server busy: " + std::to_string(fActiveCalls) +
+                             " tool calls in progress");
+      }
+      fInFlight[key] = cancel;
+      fActiveCalls++;
+    }
+
+    std::thread([this, id, toolName, arguments, cancel, bytesIn]() {
+      handleToolCall(id, toolName, arguments, cancel, bytesIn);
+
+      std::lock_guard<std::mutex> lock(fInFlightMutex);
+      fActiveCalls--;
+      fInFlightDone.notify_all();
+    }).detach();
+    return 0;
+  }
+
+  // Unregisters the id of a call whose tool has returned, before its
+  // response is sent: the client may reuse the id once it has the response
+  // (a cancellation then comes too late and is ignored)
+  void releaseRequestId(const json &id) {
+    std::lock_guard<std::mutex> lock(fInFlightMutex);
+    fInFlight.erase(id.dump());
+  }
+
+  // Handles notifications/cancelled: kills the work of the given request
+  void handleCancelled(const json &params) {
+    if (!params.is_object()) {
       return;
     }
+    json requestId = params.value("requestId", json());
+    std::lock_guard<std::mutex> lock(fInFlightMutex);
+    auto it = fInFlight.find(requestId.dump());
+    if (it != fInFlight.end()) {
+      it->second.cancel();
+    }
+  }
+  // Lists the stored artifacts (none in inline mode)
+  size_t handleResourcesList(const json &id) {
+    json resources = json::array();
+    for (const auto &artifact : listArtifacts()) {
+      resources.push_back(artifact.toJson());
+    }
+    return sendResponse(id, {{"resources", resources}});
+  }
 
-    // Call the tool with JSON arguments
-    json toolResponse = fRegisteredTools[toolName]->call(arguments.dump());
+  // Sends the content of an artifact (streamed from its file if it is not
+  // compressed): the whole artifact, or the range of bytes given by the
+  // optional offset and length parameters (described in _meta; byte
+  // offsets, not characters, for text artifacts too)
+  size_t handleResourcesRead(const json &id, const json &params) {
+    if (!params.is_object() || !params.contains("uri") ||
+        !params["uri"].is_string()) {
+      return sendError(id, -32602, "Invalid params: uri is required");
+    }
+    json offset = params.value("offset", json(size_t(0)));
+    json length = params.value("length", json(SIZE_MAX));
+    if (!offset.is_number_unsigned() || !length.is_number_unsigned()) {
+      return sendError(id, -32602,
+                       "Invalid params: offset and length are byte counts");
+    }
+    std::string uri = params["uri"];
+    auto artifact = findArtifact(uri);
 
-    // Tool returns MCP content array directly
-    json result = {{"content", toolResponse}};
+    StreamedContent streamed;
+    StreamedContent::Scope streamedScope(streamed);
+    json data;
+    if (artifact) {
+      data = artifactContent(*artifact, offset.get<size_t>(),
+                             length.get<size_t>());
+    }
+    if (data.is_null()) {
+      return sendError(id, -32002, "Resource not found: " + uri);
+    }
 
-    sendResponse(id, result);
+    json result = {{"contents",
+                    {{{"uri", uri},
+                      {"mimeType", artifact->mimeType},
+                      {artifact->text ? "text" : "blob", std::move(data)}}}}};
+    if (params.contains("offset") || params.contains("length")) {
+      size_t start = std::min(offset.get<size_t>(), artifact->size);
+      result["_meta"] = {
+          {"offset", start},
+          {"length", std::min(length.get<size_t>(), artifact->size - start)},
+          {"size", artifact->size}};
+    }
+    return sendResponse(id, result, &streamed);
   }
 
-  void handleInitialize(const json &id) {
+  // Answers with the protocol version chosen for the session (see
+  // negotiateProtocolVersion()), which decides the content types the tools
+  // return
+  size_t handleInitialize(const json &id, const json &params) {
+    std::string requested;
+    if (params.is_object() && params.contains("protocolVersion") &&
+        params["protocolVersion"].is_string()) {
+      requested = params["protocolVersion"];
+    }
     json result = {
-        {"protocolVersion", "2024-11-05"},
-        {"capabilities", {{"tools", json::object()}}},
+        {"protocolVersion", negotiateProtocolVersion(requested)},
+        {"capabilities",
+         {{"tools", json::object()}, {"resources", json::object()}}},
         {"serverInfo", {{"name", fServerName}, {"version", fServerVersion}}}};
 
-    sendResponse(id, result);
+    return sendResponse(id, result);
   }
 
 public:
@@ -91,7 +342,11 @@ public:
    * @brief Constructor with default server information
    */
   SimpleMCPServer(std::string name)
-      : fServerName(name), fServerVersion("1.0.0") {}
+      : fServerName(name), fServerVersion("1.0.0"),
+        fMaxToolCalls(std::max(
+            1, std::atoi(configValue("max_tool_calls",
+                                     std::to_string(MAX_TOOL_CALLS))
+                             .c_str()))) {}
 
   /**
    * @brief Set the server name for MCP identification
@@ -123,7 +378,9 @@ public:
    * and sending responses to stdout. The server handles:
    * - initialize: Server capability negotiation
    * - tools/list: Returns available tools
-   * - tools/call: Executes a specific tool with arguments
+   * - tools/call: Executes a specific tool with arguments (asynchronously)
+   * - resources/list, resources/read: Stored tool outputs
+   * - notifications/cancelled: Cancels an in-flight tools/call
    */
   void run() {
 
@@ -134,34 +391,71 @@ public:
         continue;
       }
 
-      try {
-        json request = json::parse(line);
-
-        // Extract fields from JSON
-        json id = request.value("id", json());
-        std::string method = request.value("method", "");
-
-        if (method == "initialize") {
-          handleInitialize(id);
-        } else if (method == "notifications/cancelled") {
-          // nothing to do
-        } else if (method == "notifications/initialized") {
-          // nothing to do
-        } else if (method == "tools/list") {
-          handleToolsListRequest(id);
-        } else if (method == "tools/call") {
-          // Extract tool name and arguments
-          json params = request.value("params", json::object());
-          std::string toolName = params.value("name", "");
-          json arguments = params.value("arguments", json::object());
-
-          handleToolCall(id, toolName, arguments);
-        } else {
-          sendError(id, -32601, "Method not found: " + method);
+      // Requests other than tools/call are answered here and logged with
+      // the size of their response (tools/call: by the worker thread,
+      // unless it is rejected)
+      auto start = std::chrono::steady_clock::now();
+      size_t bytesOut = 0;
+      RequestFields request;
+      std::string parseError;
+      json id;
+      if (scanRequest(line, request, parseError) && !request.id.empty()) {
+        // Valid JSON, but json cannot hold a number out of double range
+        id = json::parse(request.id, nullptr, false);
+        parseError = id.is_discarded() ? "id out of range" : "";
+      }
+      if (!parseError.empty()) {
+        bytesOut = sendError(json(), -32700, "Parse error: " + parseError);
+        logRequest({{"bytes_in", line.size() + 1},
+                    {"bytes_out", bytesOut},
+                    {"ms", elapsedMs(start)},
+                    {"status", "parse_error"}});
+        continue;
+      }
+      const std::string &method = request.method;
+
+      if (!request.isObject) {
+        bytesOut = sendError(id, -32600, "Invalid Request");
+      } else if (method == "initialize") {
+        bytesOut = handleInitialize(
+            id, json::parse(request.params, nullptr, false));
+      } else if (method == "notifications/cancelled") {
+        handleCancelled(json::parse(request.params, nullptr, false));
+      } else if (method == "notifications/initialized") {
+        // nothing to do
+      } else if (method == "tools/list") {
+        bytesOut = handleToolsListRequest(id);
+      } else if (method == "resources/list") {
+        bytesOut = handleResourcesList(id);
+      } else if (method == "resources/read") {
+        bytesOut = handleResourcesRead(
+            id, json::parse(request.params, nullptr, false));
+      } else if (method == "tools/call") {
+        std::string arguments = request.arguments.empty()
+                                    ? "{}"
+                                    : std::string(request.arguments);
+        bytesOut =
+            startToolCall(id, request.toolName, arguments, line.size() + 1);
+        if (bytesOut == 0) {
+          continue;
         }
-      } catch (const json::parse_error &e) {
-        sendError(json(), -32700, "Parse error: " + std::string(e.what()));
+      } else {
+        bytesOut = sendError(id, -32601, "Method not found: " + method);
       }
+
+      logRequest({{"id", id},
+                  {"method", method},
+                  {"bytes_in", line.size() + 1},
+                  {"bytes_out", bytesOut},
+                  {"ms", elapsedMs(start)}});
+    }
+
+    // End of input: let the running tool calls finish and send their
+    // results, then write what remains of the request log
+    {
+      std::unique_lock<std::mutex> lock(fInFlightMutex);
+      fInFlightDone.wait(lock, [this]() { return fActiveCalls == 0; });
     }
+    flushRequestLog();
   }
 };
\ No newline at end of file
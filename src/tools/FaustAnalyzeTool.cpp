@@ -0,0 +1,328 @@
+#include "FaustAnalyzeTool.hh"
+#include "architecture.hh"
+#include "utils.hh"
+#include "process.hh"
+#include <chrono>
+#include <sstream>
+
+#ifdef FAUST_MCP_LIBFAUST
+#include "JitDsp.hh"
+#include "audio_features.hh"
+#include "spectrogram_synth.hh"
+#endif
+
+// Constructor
+FaustAnalyzeTool::FaustAnalyzeTool() {
+  // Resource limits of each stage (config.hh defaults, env overrides)
+  fFaustLimits = stageLimits("analyze_faust");
+  fCompileLimits = stageLimits("analyze_cxx");
+  fRunLimits = stageLimits("analyze_run");
+}
+
+// Formats a number argument of the analyzer command line
+static std::string formatNumber(double value) {
+  std::ostringstream oss;
+  oss << value;
+  return oss.str();
+}
+
+// MCP content of the features: the analyzer JSON, as compact text
+static json featuresContent(const std::string &features) {
+  if (!json::accept(features)) {
+    return json::array(
+        {{{"type", "text"}, {"text", "Error: Invalid analyzer output"}}});
+  }
+  return json::array({{{"type", "text"}, {"text", features}}});
+}
+
+#ifdef FAUST_MCP_LIBFAUST
+typedef std::chrono::steady_clock Clock;
+
+// Note rendered and analysed in-process by a DSP compiled with libfaust
+// (factory cached by source)
+static json jitAnalyze(const std::string &engine, const std::string &srcCode,
+                       const Options &opts, bool withFrames,
+                       const CancellationToken &cancel,
+                       const ProcessLimits &runLimits) {
+  std::string error;
+  std::shared_ptr<dsp_factory> factory = jitFactory(engine, srcCode, error);
+  if (!factory) {
+    return json::array(
+        {{{"type", "text"},
+          {"text", "Error: Faust compilation failed: " + error}}});
+  }
+
+  std::unique_ptr<dsp> instance = createJitInstance(*factory);
+  if (!instance) {
+    return json::array(
+        {{{"type", "text"}, {"text", "Error: Could not create DSP instance"}}});
+  }
+
+  // gate, freq and gain are driven when the DSP exposes them
+  SpectrogramUI ui;
+  instance->buildUserInterface(&ui);
+  instance->init(opts.sample_rate);
+
+  // Cancellation and the wall-clock limit of the run stage are checked
+  // between blocks (CPU and memory limits need a separate process)
+  auto start = Clock::now();
+  bool timedOut = false;
+  auto interrupted = [&]() {
+    long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       Clock::now() - start)
+                       .count();
+    timedOut = runLimits.timeoutMs > 0 && elapsed > runLimits.timeoutMs;
+    return timedOut || cancel.isCancelled();
+  };
+
+  std::vector<std::vector<float>> channels;
+  if (!renderAudio(*instance, ui, opts, RENDER_BLOCK_SIZE, channels,
+                   interrupted)) {
+    if (timedOut) {
+      ProcessResult run = {-1, false, true, runLimits.timeoutMs, "", ""};
+      return limitErrorContent("analyze_run", run, runLimits);
+    }
+    return json::array({{{"type", "text"}, {"text", "Error: Cancelled"}}});
+  }
+
+  std::string features;
+  if (!analyzeChannels(channels, opts, opts.channel_mode, withFrames,
+                       features, error)) {
+    return json::array(
+        {{{"type", "text"}, {"text", "Error: Analysis failed: " + error}}});
+  }
+  return featuresContent(features);
+}
+#endif
+
+// Returns the tool name for MCP registration
+std::string FaustAnalyzeTool::name() const { return "FaustAnalyzeTool"; }
+
+// Returns the tool description and schema for MCP
+std::string FaustAnalyzeTool::describe() const {
+  // Build tool description using JSON object
+  json description = {
+      {"name", name()},
+      {"description",
+       "Renders one note of Faust DSP code and returns its audio features as "
+       "compact JSON: per-frame RMS, spectral centroid, rolloff (85% of the "
+       "energy), flatness and fundamental (f0, null when unvoiced), plus "
+       "peak level, attack time (to 90% of the peak) and release time (from "
+       "gate off to -40 dB). Parameters named 'gate' (button), 'freq' and "
+       "'gain' are driven when the DSP exposes them. Much cheaper to read "
+       "than a spectrogram image."},
+      {"inputSchema",
+       {{"type", "object"},
+        {"properties",
+         {{"value",
+           {{"type", "string"}, {"description", "Faust DSP source code"}}},
+          {"duration",
+           {{"type", "number"},
+            {"description", "Total duration in seconds"},
+            {"default", 2.0}}},
+          {"gate_duration",
+           {{"type", "number"},
+            {"description", "Gate=1 duration in seconds (from start)"},
+            {"default", 0.5}}},
+          {"frequency",
+           {{"type", "number"},
+            {"description", "Frequency in Hz"},
+            {"default", 440.0}}},
+          {"gain",
+           {{"type", "number"},
+            {"description", "Gain value (0.0 to 1.0)"},
+            {"default", 0.8}}},
+          {"sample_rate",
+           {{"type", "number"},
+            {"description", "Sample rate in Hz (at most 384000)"},
+            {"default", 44100}}},
+          {"fft_size",
+           {{"type", "number"},
+            {"description", "FFT size (power of 2, 16 to 65536)"},
+            {"default", 2048}}},
+          {"hop_size",
+           {{"type", "number"},
+            {"description", "Hop size in samples (one frame per hop)"},
+            {"default", 512}}},
+          {"padding",
+           {{"type", "string"},
+            {"description",
+             "Framing: none (frames inside the signal), zero or reflect "
+             "(frames centered on each hop, signal padded at both ends)"},
+            {"default", "none"}}},
+          {"channels",
+           {{"type", "string"},
+            {"description",
+             "Output channels analysed: first, each, mid_side or sum"},
+            {"default", "first"}}},
+          {"frames",
+           {{"type", "boolean"},
+            {"description",
+             "Include the per-frame arrays (false: summary only)"},
+            {"default", true}}},
+          {"engine",
+           {{"type", "string"},
+            {"description",
+             "compile (Faust -> C++ -> g++), llvm (in-process JIT) or "
+             "interp (in-process interpreter); llvm and interp need a "
+             "server built with libfaust"},
+            {"default", configValue("spectrogram_engine",
+                                    SPECTROGRAM_ENGINE)}}}}},
+        {"required", json::array({"value"})}}}};
+
+  return description.dump();
+}
+
+// Renders a note of Faust DSP code and extracts its features
+json FaustAnalyzeTool::call(const std::string &args,
+                            const CancellationToken &cancel) {
+  try {
+    // Parse the JSON arguments
+    json arguments = json::parse(args);
+
+    // Extract parameters
+    std::string srcCode = arguments.value("value", "process = _;");
+    double duration = arguments.value("duration", 2.0);
+    double gate_duration = arguments.value("gate_duration", 0.5);
+    double frequency = arguments.value("frequency", 440.0);
+    double gain = arguments.value("gain", 0.8);
+    int sample_rate = arguments.value("sample_rate", 44100);
+    int fft_size = arguments.value("fft_size", 2048);
+    int hop_size = arguments.value("hop_size", 512);
+    std::string channels = arguments.value("channels", "first");
+    std::string padding = arguments.value("padding", "none");
+    bool frames = arguments.value("frames", true);
+    std::string engine = arguments.value(
+        "engine", configValue("spectrogram_engine", SPECTROGRAM_ENGINE));
+
+    // Validate before compiling anything
+    int maxSeconds =
+        std::atoi(configValue("render_max_seconds",
+                              std::to_string(RENDER_MAX_SECONDS))
+                      .c_str());
+    std::string error;
+    if (duration <= 0 || duration > maxSeconds) {
+      error = "duration must be in (0, " + std::to_string(maxSeconds) +
+              "] seconds";
+    } else if (sample_rate <= 0 || sample_rate > MAX_SAMPLE_RATE) {
+      error = "sample_rate must be in [1, " +
+              std::to_string(MAX_SAMPLE_RATE) + "] Hz";
+    } else if (fft_size < 16 || fft_size > MAX_FFT_SIZE ||
+               (fft_size & (fft_size - 1)) != 0) {
+      error = "fft_size must be a power of two from 16 to " +
+              std::to_string(MAX_FFT_SIZE);
+    } else if (hop_size <= 0) {
+      error = "hop_size must be positive";
+    } else if (duration * sample_rate > MAX_RENDER_SAMPLES) {
+      error = "the note would have more than " +
+              std::to_string(MAX_RENDER_SAMPLES) +
+              " samples: reduce duration or sample_rate";
+    }
+    if (!error.empty()) {
+      return json::array({{{"type", "text"}, {"text", "Error: " + error}}});
+    }
+    if (padding != "none" && padding != "zero" && padding != "reflect") {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: padding must be none, zero or reflect"}}});
+    }
+    if (padding == "none" && (long)(duration * sample_rate) < fft_size) {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: duration is shorter than one FFT frame (use "
+                     "zero or reflect padding)"}}});
+    }
+    if (channels != "first" && channels != "each" && channels != "mid_side" &&
+        channels != "sum") {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: channels must be first, each, mid_side or "
+                     "sum"}}});
+    }
+
+    if (engine != "compile") {
+#ifdef FAUST_MCP_LIBFAUST
+      if (isJitEngine(engine)) {
+        Options opts;
+        opts.duration = duration;
+        opts.gate_duration = gate_duration;
+        opts.frequency = frequency;
+        opts.gain = gain;
+        opts.sample_rate = sample_rate;
+        opts.channel_mode = channels;
+        opts.fft_size = fft_size;
+        opts.hop_size = hop_size;
+        opts.padding = padding;
+        return jitAnalyze(engine, srcCode, opts, frames, cancel, fRunLimits);
+      }
+#endif
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: Unsupported engine '" + engine +
+                         "' (llvm and interp need a server built with "
+                         "libfaust)"}}});
+    }
+
+    // Per-request work directory, removed on return (or cancellation)
+    ScratchDir work;
+    if (!work.valid()) {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: Could not create work directory"}}});
+    }
+
+    // Steps 1-2: Faust -> C++ with the analyze.cpp architecture -> g++
+    json buildError;
+    if (!buildArchitectureProgram(srcCode, "analyze.cpp",
+                                  {"-lfftw3f", "-pthread"}, "analyze", work,
+                                  cancel, fFaustLimits, fCompileLimits,
+                                  buildError)) {
+      return buildError;
+    }
+
+    // Step 3: Render and analyse; the JSON comes back through stdout
+    std::vector<std::string> execCmd = {
+        work.file("analyze_exe"),
+        formatNumber(duration),
+        formatNumber(gate_duration),
+        formatNumber(frequency),
+        formatNumber(gain),
+        "-sr", std::to_string(sample_rate),
+        "-fft", std::to_string(fft_size),
+        "-hop", std::to_string(hop_size),
+        "-channels", channels,
+        "-pad", padding};
+    if (!frames) {
+      execCmd.push_back("-no-frames");
+    }
+
+    ProcessResult execRun = runProcess(execCmd, cancel, fRunLimits);
+    if (limitExceeded(execRun)) {
+      return limitErrorContent("analyze_run", execRun, fRunLimits);
+    }
+    if (execRun.exitCode < 0 && !execRun.cancelled) {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: Could not execute audio analyzer"}}});
+    }
+    if (execRun.exitCode != 0) {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: Analysis failed: " + execRun.errorOutput}}});
+    }
+
+    std::string features = execRun.output;
+    while (!features.empty() && isspace((unsigned char)features.back())) {
+      features.pop_back();
+    }
+    return featuresContent(features);
+
+  } catch (const json::parse_error &e) {
+    // Handle parse error
+    return json::array(
+        {{{"type", "text"}, {"text", "Error: Invalid arguments"}}});
+  } catch (const std::exception &e) {
+    return json::array(
+        {{{"type", "text"}, {"text", std::string("Error: ") + e.what()}}});
+  }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "mcpTool.hh"
+#include "process.hh"
+
+class FaustAnalyzeTool : public McpTool {
+public:
+  FaustAnalyzeTool();
+  std::string name() const override;
+  std::string describe() const override;
+  json call(const std::string &args,
+            const CancellationToken &cancel) override;
+
+private:
+  ProcessLimits fFaustLimits;   ///< Faust run ("analyze_faust" stage)
+  ProcessLimits fCompileLimits; ///< g++ run ("analyze_cxx" stage)
+  ProcessLimits fRunLimits;     ///< Analyzer run ("analyze_run" stage)
+};
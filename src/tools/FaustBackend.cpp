@@ -0,0 +1,337 @@
+#include "FaustBackend.hh"
+#include "LibFaustBackend.hh"
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+// Last component of the request directory (e.g. "req-AbC123")
+static std::string requestName(const ScratchDir &workDir) {
+  return workDir.path().substr(workDir.path().find_last_of('/') + 1);
+}
+
+// Reads a whole file into a string (empty if missing)
+static std::string readFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+}
+
+// Writes a string to a file
+static bool writeFile(const std::string &path, const std::string &content) {
+  std::ofstream file(path, std::ios::binary);
+  file << content;
+  return file.good();
+}
+
+// Name without extension, e.g. "source" for "source.dsp"
+static std::string baseName(const std::string &dspName) {
+  return dspName.substr(0, dspName.find_last_of('.'));
+}
+
+// ----------------------------------------------------------------------------
+// File-based defaults
+// ----------------------------------------------------------------------------
+
+FaustResult FaustBackend::compileCpp(const std::string &source,
+                                     const std::string &dspName,
+                                     const std::vector<std::string> &options,
+                                     const ScratchDir &workDir,
+                                     const CancellationToken &cancel,
+                                     const ProcessLimits &limits) {
+  std::string cppName = baseName(dspName) + ".cpp";
+  writeFile(workDir.file(dspName), source);
+
+  std::vector<std::string> args = {"-o", cppName, dspName};
+  args.insert(args.end(), options.begin(), options.end());
+
+  return run(args, workDir, cancel, limits);
+}
+
+FaustResult FaustBackend::generateSVG(const std::string &source,
+                                      const std::string &dspName,
+                                      const ScratchDir &workDir,
+                                      const CancellationToken &cancel,
+                                      const ProcessLimits &limits) {
+  writeFile(workDir.file(dspName), source);
+  return run({"-o", "/dev/null", "-svg", dspName}, workDir, cancel, limits);
+}
+
+FaustResult FaustBackend::compileWithArchitecture(
+    const std::string &source, const std::string &dspName,
+    const std::string &archPath, const std::string &outputName,
+    const ScratchDir &workDir, const CancellationToken &cancel,
+    const ProcessLimits &limits) {
+  writeFile(workDir.file(dspName), source);
+
+  // The architecture must be in the request directory for the backend
+  std::string archName = archPath.substr(archPath.find_last_of('/') + 1);
+  std::string archContent = readFile(archPath);
+  if (archContent.empty()) {
+    return FaustResult{-1, false, false, 0, "",
+                       "Could not read architecture file " + archPath};
+  }
+  writeFile(workDir.file(archName), archContent);
+
+  return run({"-a", archName, "-o", outputName, dspName}, workDir, cancel,
+             limits);
+}
+
+// ----------------------------------------------------------------------------
+// Docker backend
+// ----------------------------------------------------------------------------
+
+// Runs Faust compiler via docker run command (Docker-in-Docker architecture)
+// This works because the MCP container has docker CLI and socket mounted
+FaustResult DockerFaustBackend::run(const std::vector<std::string> &faustArgs,
+                                    const ScratchDir &workDir,
+                                    const CancellationToken &cancel,
+                                    const ProcessLimits &limits) {
+  // The container is named after the request directory so that it can be
+  // removed if the request is cancelled while the docker CLI is running
+  std::string containerName = "faust-mcp-" + requestName(workDir);
+
+  // Build Docker command
+  // The trick: we need to mount the request directory from the HOST (not from
+  // MCP container). Since MCP container has HOST_SHARED_DIR mounted at
+  // WORK_DIR, we mount the matching HOST path to /tmp in the Faust container
+  std::vector<std::string> dockerArgs = {"docker", "run", "--rm",
+                                         "--name", containerName};
+
+  // CPU and memory limits must be set on the container: the docker CLI
+  // itself does no work
+  if (limits.cpuSeconds > 0) {
+    dockerArgs.push_back("--ulimit");
+    dockerArgs.push_back("cpu=" + std::to_string(limits.cpuSeconds) + ":" +
+                         std::to_string(limits.cpuSeconds + 1));
+  }
+  if (limits.memoryMB > 0) {
+    dockerArgs.push_back("--memory");
+    dockerArgs.push_back(std::to_string(limits.memoryMB) + "m");
+  }
+
+  dockerArgs.push_back("-v");
+  dockerArgs.push_back(workDir.hostPath() + ":/tmp");
+  dockerArgs.push_back("-w");
+  dockerArgs.push_back("/tmp");
+  dockerArgs.push_back(fImage);
+  dockerArgs.insert(dockerArgs.end(), faustArgs.begin(), faustArgs.end());
+
+  // Execute command (killable child process, wall-clock limit only)
+  ProcessLimits cliLimits;
+  cliLimits.timeoutMs = limits.timeoutMs;
+  cliLimits.stage = limits.stage;
+  FaustResult result = runProcess(dockerArgs, cancel, cliLimits);
+
+  if (result.cancelled || result.timedOut) {
+    // Killing the docker CLI does not always stop the container itself
+    runProcess({"docker", "rm", "-f", containerName}, CancellationToken());
+  }
+
+  return result;
+}
+
+// ----------------------------------------------------------------------------
+// Local backend
+// ----------------------------------------------------------------------------
+
+// Runs the host's faust binary directly in the request directory
+FaustResult LocalFaustBackend::run(const std::vector<std::string> &faustArgs,
+                                   const ScratchDir &workDir,
+                                   const CancellationToken &cancel,
+                                   const ProcessLimits &limits) {
+  std::vector<std::string> args = {fBinary};
+  args.insert(args.end(), faustArgs.begin(), faustArgs.end());
+  return runProcess(args, cancel, limits, workDir.path());
+}
+
+// The compiler runs on the host: no option may name a file outside the
+// request directory
+std::string
+LocalFaustBackend::checkOptions(const std::vector<std::string> &options) const {
+  return hostOptionsError(options);
+}
+
+// ----------------------------------------------------------------------------
+// Worker backend
+// ----------------------------------------------------------------------------
+
+// Script run by docker exec: records the compiler pid (so that it can be
+// killed from outside), applies the CPU/memory limits, then runs faust with
+// the remaining arguments (passed as "$@", never interpreted)
+static const char *WORKER_SCRIPT =
+    "echo $$ > .faust_pid; "
+    "[ \"$FAUST_CPU\" -gt 0 ] && ulimit -t \"$FAUST_CPU\"; "
+    "[ \"$FAUST_MEM\" -gt 0 ] && ulimit -v \"$FAUST_MEM\"; "
+    "exec \"$@\"";
+
+WorkerFaustBackend::~WorkerFaustBackend() {
+  if (fStarted) {
+    runProcess({"docker", "rm", "-f", fName}, CancellationToken());
+  }
+}
+
+// Starts the persistent container (or restarts it if it went away)
+bool WorkerFaustBackend::ensureStarted(bool restart) {
+  std::lock_guard<std::mutex> lock(fMutex);
+  if (fStarted && !restart) {
+    return true;
+  }
+
+  // Remove a stale container left by a previous server
+  runProcess({"docker", "rm", "-f", fName}, CancellationToken());
+
+  // The whole shared directory is mounted: requests use /tmp/req-XXXXXX
+  std::string hostDir = configValue("host_shared_dir", HOST_SHARED_DIR);
+  FaustResult start = runProcess(
+      {"docker", "run", "-d", "--rm", "--name", fName, "-v", hostDir + ":/tmp",
+       "--entrypoint", "tail", fImage, "-f", "/dev/null"},
+      CancellationToken());
+
+  fStarted = (start.exitCode == 0);
+  if (!fStarted) {
+    std::cerr << "Faust worker container failed to start: "
+              << start.errorOutput << std::endl;
+  }
+  return fStarted;
+}
+
+// Runs faust in the persistent container through docker exec
+FaustResult WorkerFaustBackend::run(const std::vector<std::string> &faustArgs,
+                                    const ScratchDir &workDir,
+                                    const CancellationToken &cancel,
+                                    const ProcessLimits &limits) {
+  std::vector<std::string> args = {
+      "docker", "exec",
+      "-w", "/tmp/" + requestName(workDir),
+      "-e", "FAUST_CPU=" + std::to_string(limits.cpuSeconds),
+      "-e", "FAUST_MEM=" + std::to_string(limits.memoryMB * 1024),
+      fName, "sh", "-c", WORKER_SCRIPT, "sh", fBinary};
+  args.insert(args.end(), faustArgs.begin(), faustArgs.end());
+
+  ProcessLimits cliLimits;
+  cliLimits.timeoutMs = limits.timeoutMs;
+  cliLimits.stage = limits.stage;
+
+  FaustResult result;
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (!ensureStarted(attempt > 0)) {
+      result = FaustResult{-1, false, false, 0, "",
+                           "Error: Faust worker container is not running"};
+      return result;
+    }
+    result = runProcess(args, cancel, cliLimits);
+
+    // docker exec fails this way when the container has gone away
+    bool containerGone =
+        result.exitCode != 0 &&
+        (result.errorOutput.find("No such container") != std::string::npos ||
+         result.errorOutput.find("is not running") != std::string::npos);
+    if (!containerGone) {
+      break;
+    }
+  }
+
+  if (result.cancelled || result.timedOut) {
+    // Killing docker exec does not stop the process inside the container
+    std::ifstream pidFile(workDir.file(".faust_pid"));
+    std::string pid;
+    if (pidFile >> pid) {
+      runProcess({"docker", "exec", fName, "kill", "-9", pid},
+                 CancellationToken());
+    }
+  }
+  std::remove(workDir.file(".faust_pid").c_str());
+
+  return result;
+}
+
+// ----------------------------------------------------------------------------
+// Options of host backends
+// ----------------------------------------------------------------------------
+
+// Faust options whose value is a file or a directory (glued values such
+// as "-I/dir" are paths, rejected as such)
+static const char *PATH_OPTIONS[] = {"-o", "-a", "-I", "-A", "-O",
+                                     "--import-dir", "--architecture-dir",
+                                     "--output-dir"};
+
+std::string hostOptionsError(const std::vector<std::string> &options) {
+  for (const auto &option : options) {
+    std::string flag = option.substr(0, option.find('='));
+    for (const char *pathOption : PATH_OPTIONS) {
+      if (flag == pathOption) {
+        return "option " + flag +
+               " is not allowed (the Faust compiler runs on the server's "
+               "host)";
+      }
+    }
+    if (option.find('/') != std::string::npos ||
+        option.find("..") != std::string::npos) {
+      return "paths are not allowed in options (the Faust compiler runs "
+             "on the server's host): " +
+             option;
+    }
+  }
+  return "";
+}
+
+std::string dspFileName(const std::string &filename) {
+  std::string name = filename.substr(filename.find_last_of('/') + 1);
+  if (name.empty() || name == "." || name == "..") {
+    return "source.dsp";
+  }
+  return name;
+}
+
+// ----------------------------------------------------------------------------
+// Backend selection
+// ----------------------------------------------------------------------------
+
+std::unique_ptr<FaustBackend> createFaustBackend(const std::string &name) {
+  if (name == "docker") {
+    return std::make_unique<DockerFaustBackend>();
+  }
+  if (name == "local") {
+    return std::make_unique<LocalFaustBackend>();
+  }
+  if (name == "worker") {
+    return std::make_unique<WorkerFaustBackend>();
+  }
+#ifdef FAUST_MCP_LIBFAUST
+  if (name == "libfaust") {
+    // Command lines that have no in-process equivalent (e.g. -v, -h) go
+    // through an external backend
+    auto fallback =
+        createFaustBackend(configValue("libfaust_fallback", FAUST_BACKEND));
+    if (!fallback) {
+      fallback = std::make_unique<DockerFaustBackend>();
+    }
+    return std::make_unique<LibFaustBackend>(std::move(fallback));
+  }
+#endif
+  return nullptr;
+}
+
+// Creates the backend named by the "backend" setting
+static std::unique_ptr<FaustBackend> createBackend() {
+  std::string name = configValue("backend", FAUST_BACKEND);
+  std::unique_ptr<FaustBackend> backend = createFaustBackend(name);
+  if (!backend) {
+    std::cerr << "Unknown Faust backend '" << name << "', using docker"
+              << std::endl;
+    backend = std::make_unique<DockerFaustBackend>();
+  }
+  return backend;
+}
+
+FaustBackend &faustBackend() {
+  static std::unique_ptr<FaustBackend> backend = createBackend();
+  return *backend;
+}
+
+FaustResult runFaust(const std::vector<std::string> &faustArgs,
+                     const ScratchDir &workDir, const CancellationToken &cancel,
+                     const ProcessLimits &limits) {
+  return faustBackend().run(faustArgs, workDir, cancel, limits);
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "cancellation.hh"
+#include "process.hh"
+#include "utils.hh"
+
+// ============================================================================
+// Faust Compiler Backends
+// ============================================================================
+
+// Result of a Faust run: exitCode, output (stdout), errorOutput (stderr),
+// cancelled, timedOut and elapsedMs
+using FaustResult = ProcessResult;
+
+/**
+ * @brief Abstract interface of a way to run the Faust compiler
+ *
+ * run() executes the compiler with command line arguments whose paths are
+ * relative to the request directory: every backend runs the compiler with
+ * that directory as current directory, and kills it if the request is
+ * cancelled or if it exceeds its limits.
+ *
+ * The compile/generate methods take the Faust source as a string. Their
+ * default implementations write it to the request directory and call run();
+ * an in-process backend (libfaust) overrides them to skip the files.
+ */
+class FaustBackend {
+public:
+  virtual ~FaustBackend() = default;
+
+  /**
+   * @brief Backend name as used in the "backend" setting
+   */
+  virtual std::string name() const = 0;
+
+  /**
+   * @brief Run the Faust compiler
+   * @param faustArgs Compiler arguments (paths relative to workDir)
+   * @param workDir Request directory, current directory of the compiler
+   * @param cancel Cancellation token of the request
+   * @param limits Wall-clock, CPU and memory limits of the run
+   */
+  virtual FaustResult run(const std::vector<std::string> &faustArgs,
+                          const ScratchDir &workDir,
+                          const CancellationToken &cancel,
+                          const ProcessLimits &limits) = 0;
+
+  /**
+   * @brief Check user-provided compiler options (e.g. those of
+   *        FaustCompileTool) before passing them to compileCpp()
+   *
+   * The compiler of a container backend only sees the request directory,
+   * so any option is accepted. Backends that run the compiler on the
+   * server's host (local, libfaust) override this with hostOptionsError().
+   * Only the options are checked: the DSP source itself can still import,
+   * library() or component() any file the server can read.
+   * @return Why the options are rejected, empty if they are accepted
+   */
+  virtual std::string checkOptions(const std::vector<std::string> &) const {
+    return "";
+  }
+
+  /**
+   * @brief Compile Faust source code to C++
+   * @param dspName Name of the DSP file, e.g. "source.dsp"
+   * @param options Additional compiler options
+   * @return On success, the generated C++ code is in output, or in
+   *         workDir/<dspName without extension>.cpp when output is empty
+   *         (left there by the file-based backends, so that it can be
+   *         streamed into the response without being read)
+   */
+  virtual FaustResult compileCpp(const std::string &source,
+                                 const std::string &dspName,
+                                 const std::vector<std::string> &options,
+                                 const ScratchDir &workDir,
+                                 const CancellationToken &cancel,
+                                 const ProcessLimits &limits);
+
+  /**
+   * @brief Generate the SVG block diagrams of a Faust program
+   *
+   * Diagrams are written to workDir/<dspName without extension>-svg/.
+   */
+  virtual FaustResult generateSVG(const std::string &source,
+                                  const std::string &dspName,
+                                  const ScratchDir &workDir,
+                                  const CancellationToken &cancel,
+                                  const ProcessLimits &limits);
+
+  /**
+   * @brief Compile Faust source code wrapped in an architecture file
+   * @param archPath Path of the architecture file
+   * @param outputName The complete C++ file is written to workDir/outputName
+   */
+  virtual FaustResult compileWithArchitecture(const std::string &source,
+                                              const std::string &dspName,
+                                              const std::string &archPath,
+                                              const std::string &outputName,
+                                              const ScratchDir &workDir,
+                                              const CancellationToken &cancel,
+                                              const ProcessLimits &limits);
+};
+
+/**
+ * @brief One `docker run` of the Faust image per call (Docker-in-Docker)
+ */
+class DockerFaustBackend : public FaustBackend {
+public:
+  std::string name() const override { return "docker"; }
+  FaustResult run(const std::vector<std::string> &faustArgs,
+                  const ScratchDir &workDir, const CancellationToken &cancel,
+                  const ProcessLimits &limits) override;
+
+private:
+  std::string fImage = configValue("docker_image", FAUST_DOCKER_IMAGE);
+};
+
+/**
+ * @brief Faust binary installed on the host, no container involved
+ */
+class LocalFaustBackend : public FaustBackend {
+public:
+  std::string name() const override { return "local"; }
+  std::string
+  checkOptions(const std::vector<std::string> &options) const override;
+  FaustResult run(const std::vector<std::string> &faustArgs,
+                  const ScratchDir &workDir, const CancellationToken &cancel,
+                  const ProcessLimits &limits) override;
+
+private:
+  std::string fBinary = configValue("faust_binary", FAUST_BINARY);
+};
+
+/**
+ * @brief Persistent Faust container reused through `docker exec`
+ *
+ * The container is started on first use with the whole shared directory
+ * mounted as /tmp and removed when the server exits. Each call pays for a
+ * docker exec instead of a container creation.
+ */
+class WorkerFaustBackend : public FaustBackend {
+public:
+  ~WorkerFaustBackend() override;
+  std::string name() const override { return "worker"; }
+  FaustResult run(const std::vector<std::string> &faustArgs,
+                  const ScratchDir &workDir, const CancellationToken &cancel,
+                  const ProcessLimits &limits) override;
+
+private:
+  bool ensureStarted(bool restart);
+
+  std::mutex fMutex;    ///< Serializes container (re)starts
+  bool fStarted = false;
+  std::string fImage = configValue("docker_image", FAUST_DOCKER_IMAGE);
+  std::string fName = configValue("worker_name", FAUST_WORKER_NAME);
+  std::string fBinary = configValue("faust_binary", FAUST_BINARY);
+};
+
+/**
+ * @brief Rejects the compiler options that name files or directories, for
+ *        the backends whose compiler runs on the server's host
+ *
+ * -o, -a, -I, -A, -O (and their long forms) and any argument that is a
+ * path out of the request directory (with a '/' or "..") would let a
+ * request read or write any file of the host. This does not confine the
+ * source: import("/path"), library("/path") and component("/path") still
+ * read host files, so untrusted code belongs to the docker or worker
+ * backend.
+ * @return Why the options are rejected, empty if they are accepted
+ */
+std::string hostOptionsError(const std::vector<std::string> &options);
+
+/**
+ * @brief Name of a DSP file given by a request, reduced to its last
+ *        component ("source.dsp" if nothing is left), so that it stays in
+ *        the request directory
+ */
+std::string dspFileName(const std::string &filename);
+
+/**
+ * @brief Create a backend by name: docker, worker, local, or libfaust when
+ * the server is built with libfaust (nullptr for an unknown name)
+ */
+std::unique_ptr<FaustBackend> createFaustBackend(const std::string &name);
+
+/**
+ * @brief The backend selected by the "backend" setting (created once)
+ */
+FaustBackend &faustBackend();
+
+/**
+ * @brief Run the Faust compiler with the selected backend
+ */
+FaustResult runFaust(const std::vector<std::string> &faustArgs,
+                     const ScratchDir &workDir, const CancellationToken &cancel,
+                     const ProcessLimits &limits = ProcessLimits());
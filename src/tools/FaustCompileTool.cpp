@@ -1,9 +1,11 @@
 #include "FaustCompileTool.hh"
+#include "FaustBackend.hh"
 #include "utils.hh"
 
 // Constructor
 FaustCompileTool::FaustCompileTool() {
-  // Initialize tool-specific data here
+  // Resource limits of the Faust run (config.hh defaults, env overrides)
+  fLimits = stageLimits("compile");
 }
 
 // Returns the tool name for MCP registration
@@ -33,10 +35,12 @@ std::string FaustCompileTool::describe() const {
 }
 
 // Compiles Faust DSP code to C++ and returns the result
-json FaustCompileTool::call(const std::string &args) {
+json FaustCompileTool::call(const std::string &args,
+                            const CancellationToken &cancel) {
   try {
-    // Ensure work directory exists
-    if (!ensureWorkDir()) {
+    // Per-request work directory, removed on return (or cancellation)
+    ScratchDir work;
+    if (!work.valid()) {
       return json::array(
           {{{"type", "text"},
             {"text", "Error: Could not create work directory"}}});
@@ -49,52 +53,54 @@ json FaustCompileTool::call(const std::string &args) {
     std::string srcCode = arguments.value("value", "process = _;");
     std::string compileOptions = arguments.value("options", "");
 
-    // filenames to use for output files (in work directory)
-    std::string dspfilename = arguments.value("filename", "source.dsp");
-    std::string baseName = dspfilename.substr(0, dspfilename.find_last_of('.'));
-    
-    // Create full paths in work directory
-    std::string dspPath = getWorkPath(dspfilename);
-    std::string cppPath = getWorkPath(baseName + ".cpp");
-    std::string errPath = getWorkPath(baseName + ".txt");
-
-    // Store the faust code into file
-    std::ofstream outFile(dspPath);
-    outFile << srcCode;
-    outFile.close();
-
-    // Call the Faust compiler via Docker
-    // Use /tmp paths since the work directory is mounted to /tmp in the container
-    std::string faustArgs = "-o /tmp/" + baseName + ".cpp /tmp/" + dspfilename;
-    if (!compileOptions.empty()) {
-      faustArgs += " " + compileOptions;
+    // filename of the DSP (names the generated class metadata), a file of
+    // the work directory
+    std::string dspfilename =
+        dspFileName(arguments.value("filename", "source.dsp"));
+
+    // Options are passed as separate arguments, never through a shell, and
+    // checked by the backend (no host paths when faust runs on the host)
+    std::vector<std::string> options = splitArguments(compileOptions);
+    std::string optionsError = faustBackend().checkOptions(options);
+    if (!optionsError.empty()) {
+      return json::array(
+          {{{"type", "text"}, {"text", "Error: " + optionsError}}});
     }
 
-    auto result = runFaustDocker(faustArgs);
+    // Call the Faust compiler with the selected backend
+    auto result = faustBackend().compileCpp(srcCode, dspfilename, options,
+                                            work, cancel, fLimits);
+
+    if (limitExceeded(result)) {
+      return limitErrorContent("compile", result, fLimits);
+    }
 
     // Check for compilation error
     if (result.exitCode != 0) {
-      // Write stderr to error file for consistency with existing code
-      std::ofstream errFile(errPath);
-      errFile << result.errorOutput;
-      errFile.close();
-
-      auto errData = encodeFile(errPath);
-      json resource = *errData;
+      json resource = {{"mimeType", "text/plain"},
+                       {"text", result.errorOutput}};
       return json::array({{{"type", "resource"}, {"resource", resource}}});
     }
 
-    // Read the generated cpp file
-    auto fileData = encodeFile(cppPath);
-
-    if (!fileData) {
-      return json::array(
-          {{{"type", "text"},
-            {"text", "Error: Could not read generated file"}}}); 
+    // Generated code: in-process (libfaust), or streamed from the file
+    // left in the work directory
+    json code;
+    if (!result.output.empty()) {
+      code = std::move(result.output);
+    } else {
+      std::string cppName =
+          dspfilename.substr(0, dspfilename.find_last_of('.')) + ".cpp";
+      auto fileData = streamFileContent(work.file(cppName));
+      if (!fileData) {
+        return json::array(
+            {{{"type", "text"},
+              {"text", "Error: Could not read generated file"}}});
+      }
+      code = std::move((*fileData)["text"]);
     }
 
     // Return as MCP content array with resource
-    json resource = *fileData;
+    json resource = {{"mimeType", "text/x-c++src"}, {"text", std::move(code)}};
 
     return json::array({{{"type", "resource"}, {"resource", resource}}});
 
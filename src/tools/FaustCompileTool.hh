@@ -1,11 +1,16 @@
 #pragma once
 
 #include "mcpTool.hh"
+#include "process.hh"
 
 class FaustCompileTool : public McpTool {
 public:
   FaustCompileTool();
   std::string name() const override;
   std::string describe() const override;
-  json call(const std::string &args) override;
+  json call(const std::string &args,
+            const CancellationToken &cancel) override;
+
+private:
+  ProcessLimits fLimits; ///< Limits of the Faust run ("compile" stage)
 };
\ No newline at end of file
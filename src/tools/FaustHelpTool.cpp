@@ -1,10 +1,12 @@
 #include "FaustHelpTool.hh"
+#include "FaustBackend.hh"
 #include "utils.hh"
 #include <cstdlib>
 
 // Constructor
 FaustHelpTool::FaustHelpTool() {
-  // Initialize tool-specific data here
+  // Resource limits of the Faust run (config.hh defaults, env overrides)
+  fLimits = stageLimits("help");
 }
 
 // Returns the tool name for MCP registration
@@ -25,23 +27,29 @@ std::string FaustHelpTool::describe() const {
 }
 
 // Executes faust -h and returns help information
-json FaustHelpTool::call(const std::string &args) {
+json FaustHelpTool::call(const std::string &args,
+                         const CancellationToken &cancel) {
   try {
-    // Ensure work directory exists
-    if (!ensureWorkDir()) {
+    // Per-request work directory, removed on return (or cancellation)
+    ScratchDir work;
+    if (!work.valid()) {
       return json::array(
           {{{"type", "text"},
             {"text", "Error: Could not create work directory"}}});
     }
 
-    // Call Faust via Docker to get help
-    auto result = runFaustDocker("-h");
+    // Call Faust to get help
+    auto result = runFaust({"-h"}, work, cancel, fLimits);
+
+    if (limitExceeded(result)) {
+      return limitErrorContent("help", result, fLimits);
+    }
 
     // Note: faust -h returns non-zero exit code even on success
     // So we don't check the result value here
 
     // Create path in work directory to store help info
-    std::string helpPath = getWorkPath("help.txt");
+    std::string helpPath = work.file("help.txt");
 
     // Write help output to file
     std::ofstream helpFile(helpPath);
@@ -0,0 +1,312 @@
+#include "FaustRenderTool.hh"
+#include "architecture.hh"
+#include "utils.hh"
+#include "jsonrpc.hh"
+#include "process.hh"
+#include <chrono>
+#include <sstream>
+
+#ifdef FAUST_MCP_LIBFAUST
+#include "JitDsp.hh"
+#include "audio_encoding.hh"
+#include "spectrogram_synth.hh"
+#endif
+
+// Constructor
+FaustRenderTool::FaustRenderTool() {
+  // Resource limits of each stage (config.hh defaults, env overrides)
+  fFaustLimits = stageLimits("render_faust");
+  fCompileLimits = stageLimits("render_cxx");
+  fRunLimits = stageLimits("render_run");
+}
+
+// Formats a number argument of the renderer command line
+static std::string formatNumber(double value) {
+  std::ostringstream oss;
+  oss << value;
+  return oss.str();
+}
+
+// MCP audio content item (data: base64 string or streamed placeholder), or
+// an embedded resource with the audio as blob for protocol versions without
+// audio content (2024-11-05)
+static json audioContent(json data, const std::string &format) {
+  std::string mimeType = (format == "flac") ? "audio/flac" : "audio/wav";
+  if (!protocolAtLeast("2025-03-26")) {
+    json resource = {{"uri", "faust-mcp://render/note." + format},
+                     {"mimeType", mimeType},
+                     {"blob", std::move(data)}};
+    return json::array({{{"type", "resource"}, {"resource", resource}}});
+  }
+  return json::array({{{"type", "audio"},
+                       {"data", std::move(data)},
+                       {"mimeType", mimeType}}});
+}
+
+#ifdef FAUST_MCP_LIBFAUST
+typedef std::chrono::steady_clock Clock;
+
+// Note rendered in-process by a DSP compiled with libfaust (factory cached
+// by source), encoded in memory
+static json jitRender(const std::string &engine, const std::string &srcCode,
+                      const Options &note, int blockSize,
+                      const std::string &format, int bitDepth,
+                      const CancellationToken &cancel,
+                      const ProcessLimits &runLimits) {
+  std::string error;
+  std::shared_ptr<dsp_factory> factory = jitFactory(engine, srcCode, error);
+  if (!factory) {
+    return json::array(
+        {{{"type", "text"},
+          {"text", "Error: Faust compilation failed: " + error}}});
+  }
+
+  std::unique_ptr<dsp> instance = createJitInstance(*factory);
+  if (!instance) {
+    return json::array(
+        {{{"type", "text"}, {"text", "Error: Could not create DSP instance"}}});
+  }
+
+  // The whole note is kept in memory, one buffer per output
+  if ((double)instance->getNumOutputs() * note.duration * note.sample_rate >
+      MAX_RENDER_SAMPLES) {
+    return json::array(
+        {{{"type", "text"},
+          {"text", "Error: " + std::to_string(instance->getNumOutputs()) +
+                       " channels of this note would have more than " +
+                       std::to_string(MAX_RENDER_SAMPLES) +
+                       " samples: reduce duration or sample_rate"}}});
+  }
+
+  // gate, freq and gain are driven when the DSP exposes them
+  SpectrogramUI ui;
+  instance->buildUserInterface(&ui);
+  instance->init(note.sample_rate);
+
+  // Cancellation and the wall-clock limit of the run stage are checked
+  // between blocks (CPU and memory limits need a separate process)
+  auto start = Clock::now();
+  bool timedOut = false;
+  auto interrupted = [&]() {
+    long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       Clock::now() - start)
+                       .count();
+    timedOut = runLimits.timeoutMs > 0 && elapsed > runLimits.timeoutMs;
+    return timedOut || cancel.isCancelled();
+  };
+
+  std::vector<std::vector<float>> channels;
+  if (!renderAudio(*instance, ui, note, blockSize, channels, interrupted)) {
+    if (timedOut) {
+      ProcessResult run = {-1, false, true, runLimits.timeoutMs, "", ""};
+      return limitErrorContent("render_run", run, runLimits);
+    }
+    return json::array({{{"type", "text"}, {"text", "Error: Cancelled"}}});
+  }
+
+  std::vector<unsigned char> encoded;
+  if (!encodeAudio(format, channels, note.sample_rate, bitDepth, encoded)) {
+    return json::array(
+        {{{"type", "text"},
+          {"text", "Error: Cannot encode " + std::to_string(channels.size()) +
+                       " channel(s) as " + format +
+                       " (at most 8 channels in FLAC, 4 GiB of data in "
+                       "WAV)"}}});
+  }
+
+  return audioContent(
+      streamBytes(std::move(encoded), StreamEncoding::Base64), format);
+}
+#endif
+
+// Returns the tool name for MCP registration
+std::string FaustRenderTool::name() const { return "FaustRenderTool"; }
+
+// Returns the tool description and schema for MCP
+std::string FaustRenderTool::describe() const {
+  // Build tool description using JSON object
+  json description = {
+      {"name", name()},
+      {"description",
+       "Renders one note of Faust DSP code to audio (WAV or FLAC, all output "
+       "channels). Parameters named 'gate' (button), 'freq' and 'gain' are "
+       "driven when the DSP exposes them: gate is on for gate_duration, then "
+       "off until duration."},
+      {"inputSchema",
+       {{"type", "object"},
+        {"properties",
+         {{"value",
+           {{"type", "string"}, {"description", "Faust DSP source code"}}},
+          {"duration",
+           {{"type", "number"},
+            {"description", "Total duration in seconds"},
+            {"default", 2.0}}},
+          {"gate_duration",
+           {{"type", "number"},
+            {"description", "Gate=1 duration in seconds (from start)"},
+            {"default", 0.5}}},
+          {"frequency",
+           {{"type", "number"},
+            {"description", "Frequency in Hz"},
+            {"default", 440.0}}},
+          {"gain",
+           {{"type", "number"},
+            {"description", "Gain value (0.0 to 1.0)"},
+            {"default", 0.8}}},
+          {"sample_rate",
+           {{"type", "number"},
+            {"description", "Sample rate in Hz (at most 384000)"},
+            {"default", 44100}}},
+          {"format",
+           {{"type", "string"},
+            {"description", "Audio format: wav or flac"},
+            {"default", "wav"}}},
+          {"bit_depth",
+           {{"type", "number"},
+            {"description", "PCM sample size: 16 or 24"},
+            {"default", 16}}},
+          {"block_size",
+           {{"type", "number"},
+            {"description", "Samples computed per DSP call (at most 8192)"},
+            {"default", 256}}},
+          {"engine",
+           {{"type", "string"},
+            {"description",
+             "compile (Faust -> C++ -> g++), llvm (in-process JIT) or "
+             "interp (in-process interpreter); llvm and interp need a "
+             "server built with libfaust"},
+            {"default", configValue("spectrogram_engine",
+                                    SPECTROGRAM_ENGINE)}}}}},
+        {"required", json::array({"value"})}}}};
+
+  return description.dump();
+}
+
+// Renders a note of Faust DSP code to WAV or FLAC
+json FaustRenderTool::call(const std::string &args,
+                           const CancellationToken &cancel) {
+  try {
+    // Parse the JSON arguments
+    json arguments = json::parse(args);
+
+    // Extract parameters
+    std::string srcCode = arguments.value("value", "process = _;");
+    double duration = arguments.value("duration", 2.0);
+    double gate_duration = arguments.value("gate_duration", 0.5);
+    double frequency = arguments.value("frequency", 440.0);
+    double gain = arguments.value("gain", 0.8);
+    int sample_rate = arguments.value("sample_rate", 44100);
+    std::string format = arguments.value("format", "wav");
+    int bit_depth = arguments.value("bit_depth", 16);
+    int block_size = arguments.value("block_size", 256);
+    std::string engine = arguments.value(
+        "engine", configValue("spectrogram_engine", SPECTROGRAM_ENGINE));
+
+    // Validate before compiling anything
+    int maxSeconds =
+        std::atoi(configValue("render_max_seconds",
+                              std::to_string(RENDER_MAX_SECONDS))
+                      .c_str());
+    std::string error;
+    if (duration <= 0 || duration > maxSeconds) {
+      error = "duration must be in (0, " + std::to_string(maxSeconds) +
+              "] seconds";
+    } else if (sample_rate <= 0 || sample_rate > MAX_SAMPLE_RATE) {
+      error = "sample_rate must be in [1, " +
+              std::to_string(MAX_SAMPLE_RATE) + "] Hz";
+    } else if (block_size <= 0 || block_size > MAX_BLOCK_SIZE) {
+      error = "block_size must be in [1, " + std::to_string(MAX_BLOCK_SIZE) +
+              "]";
+    } else if (duration * sample_rate > MAX_RENDER_SAMPLES) {
+      error = "the note would have more than " +
+              std::to_string(MAX_RENDER_SAMPLES) +
+              " samples: reduce duration or sample_rate";
+    }
+    if (!error.empty()) {
+      return json::array({{{"type", "text"}, {"text", "Error: " + error}}});
+    }
+    if ((format != "wav" && format != "flac") ||
+        (bit_depth != 16 && bit_depth != 24)) {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: format must be wav or flac, bit_depth 16 or "
+                     "24"}}});
+    }
+
+    if (engine != "compile") {
+#ifdef FAUST_MCP_LIBFAUST
+      if (isJitEngine(engine)) {
+        Options note;
+        note.duration = duration;
+        note.gate_duration = gate_duration;
+        note.frequency = frequency;
+        note.gain = gain;
+        note.sample_rate = sample_rate;
+        return jitRender(engine, srcCode, note, block_size, format, bit_depth,
+                         cancel, fRunLimits);
+      }
+#endif
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: Unsupported engine '" + engine +
+                         "' (llvm and interp need a server built with "
+                         "libfaust)"}}});
+    }
+
+    // Per-request work directory, removed on return (or cancellation)
+    ScratchDir work;
+    if (!work.valid()) {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: Could not create work directory"}}});
+    }
+
+    // Steps 1-2: Faust -> C++ with the render.cpp architecture -> g++
+    json buildError;
+    if (!buildArchitectureProgram(srcCode, "render.cpp", {}, "render", work,
+                                  cancel, fFaustLimits, fCompileLimits,
+                                  buildError)) {
+      return buildError;
+    }
+
+    // Step 3: Render; the encoded audio comes back through the stdout pipe,
+    // it is never written to a file
+    std::vector<std::string> execCmd = {
+        work.file("render_exe"),
+        formatNumber(duration),
+        formatNumber(gate_duration),
+        formatNumber(frequency),
+        formatNumber(gain),
+        "-sr", std::to_string(sample_rate),
+        "-block", std::to_string(block_size),
+        "-format", format,
+        "-bits", std::to_string(bit_depth)};
+
+    ProcessResult execRun = runProcess(execCmd, cancel, fRunLimits);
+    if (limitExceeded(execRun)) {
+      return limitErrorContent("render_run", execRun, fRunLimits);
+    }
+    if (execRun.exitCode < 0 && !execRun.cancelled) {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: Could not execute audio renderer"}}});
+    }
+    if (execRun.exitCode != 0 || execRun.output.empty()) {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: Audio rendering failed: " + execRun.errorOutput}}});
+    }
+
+    return audioContent(
+        streamBytes(std::move(execRun.output), StreamEncoding::Base64),
+        format);
+
+  } catch (const json::parse_error &e) {
+    // Handle parse error
+    return json::array(
+        {{{"type", "text"}, {"text", "Error: Invalid arguments"}}});
+  } catch (const std::exception &e) {
+    return json::array(
+        {{{"type", "text"}, {"text", std::string("Error: ") + e.what()}}});
+  }
+}
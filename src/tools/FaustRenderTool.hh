@@ -0,0 +1,18 @@
+#pragma once
+
+#include "mcpTool.hh"
+#include "process.hh"
+
+class FaustRenderTool : public McpTool {
+public:
+  FaustRenderTool();
+  std::string name() const override;
+  std::string describe() const override;
+  json call(const std::string &args,
+            const CancellationToken &cancel) override;
+
+private:
+  ProcessLimits fFaustLimits;   ///< Faust run ("render_faust" stage)
+  ProcessLimits fCompileLimits; ///< g++ run ("render_cxx" stage)
+  ProcessLimits fRunLimits;     ///< Renderer run ("render_run" stage)
+};
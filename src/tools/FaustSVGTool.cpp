@@ -1,9 +1,50 @@
 #include "FaustSVGTool.hh"
+#include "FaustBackend.hh"
+#include "artifacts.hh"
 #include "utils.hh"
 
+// Diagram names listed in a result (all of them are in resources/list)
+static const size_t MAX_LISTED_DIAGRAMS = 100;
+
+// Text item describing a stored diagram set and how to fetch its diagrams
+static json diagramIndex(const std::string &set,
+                         const std::vector<std::string> &names) {
+  std::string text =
+      "Diagram set " + set + ": " + std::to_string(names.size()) +
+      " diagram(s), fetch one with FaustSVGTool {\"diagram_set\": \"" + set +
+      "\", \"diagram\": \"<name>\"} or resources/read " +
+      diagramUri(set, "<name>") + ":";
+  for (size_t i = 0; i < names.size() && i < MAX_LISTED_DIAGRAMS; i++) {
+    text += "\n" + names[i];
+  }
+  if (names.size() > MAX_LISTED_DIAGRAMS) {
+    text += "\n... and " +
+            std::to_string(names.size() - MAX_LISTED_DIAGRAMS) +
+            " more (resources/list)";
+  }
+  return {{"type", "text"}, {"text", text}};
+}
+
+// A diagram stored by a previous call
+static json storedDiagram(const std::string &set, const std::string &name) {
+  auto artifact = findArtifact(diagramUri(set, name));
+  json svg = artifact ? artifactContent(*artifact) : json();
+  if (svg.is_null()) {
+    return json::array(
+        {{{"type", "text"},
+          {"text", "Error: No diagram " + name + " in diagram set " + set +
+                       " (unknown or expired)"}}});
+  }
+  json resource = {{"uri", artifact->uri},
+                   {"mimeType", artifact->mimeType},
+                   {"text", std::move(svg)}};
+  return json::array({{{"type", "resource"}, {"resource", resource}}});
+}
+
 // Constructor
 FaustSVGTool::FaustSVGTool() {
-  // Initialize tool-specific data here
+  // Resource limits of the Faust run (config.hh defaults, env overrides)
+  fLimits = stageLimits("svg");
 }
 
 // Returns the tool name for MCP registration
@@ -15,48 +56,73 @@ std::string FaustSVGTool::describe() const {
   json description = {
       {"name", name()},
       {"description", "Compiles Faust DSP code and generates SVG block diagram "
-                      "visualization using 'faust -svg'"},
+                      "visualization using 'faust -svg'. Returns process.svg; "
+                      "with keep_diagrams, also keeps the diagrams of all "
+                      "sub-blocks as a diagram set, from which any diagram "
+                      "can be fetched later without compiling again"},
       {"inputSchema",
        {{"type", "object"},
         {"properties",
          {{"value",
            {{"type", "string"},
             {"description", "Faust DSP source code to compile and visualize as "
-                            "SVG diagram"}}}}},
-        {"required", json::array({"value"})}}}};
+                            "SVG diagram (not needed with diagram_set)"}}},
+          {"keep_diagrams",
+           {{"type", "boolean"},
+            {"description", "Keep all the diagrams as a diagram set "
+                            "(default: true with result_mode = reference, "
+                            "false otherwise)"}}},
+          {"diagram_set",
+           {{"type", "string"},
+            {"description", "Diagram set returned by a previous call: "
+                            "fetch one of its diagrams instead of "
+                            "compiling"}}},
+          {"diagram",
+           {{"type", "string"},
+            {"description", "Name of the diagram to fetch from "
+                            "diagram_set (default: process.svg)"}}}}}}}};
 
   return description.dump();
 }
 
 // Generates SVG diagram from Faust DSP code
-json FaustSVGTool::call(const std::string &args) {
+json FaustSVGTool::call(const std::string &args,
+                        const CancellationToken &cancel) {
   try {
-    // Ensure work directory exists
-    if (!ensureWorkDir()) {
+    // Parse the JSON arguments
+    json arguments = json::parse(args);
+
+    // A diagram of a previous call: no compilation
+    if (arguments.contains("diagram_set")) {
+      const json &set = arguments["diagram_set"];
+      return storedDiagram(set.is_string() ? set.get<std::string>()
+                                           : set.dump(),
+                           arguments.value("diagram", "process.svg"));
+    }
+
+    // Per-request work directory, removed on return (or cancellation)
+    ScratchDir work;
+    if (!work.valid()) {
       return json::array(
           {{{"type", "text"},
             {"text", "Error: Could not create work directory"}}});
     }
 
-    // Parse the JSON arguments
-    json arguments = json::parse(args);
-
     // Extract the 'value' field
     std::string srcCode = arguments.value("value", "process = _;");
 
     // Create paths in work directory
-    std::string dspPath = getWorkPath("source.dsp");
-    std::string errPath = getWorkPath("source.txt");
-    std::string svgPath = getWorkPath("source-svg/process.svg");
-
-    // Store the faust code into file
-    std::ofstream outFile(dspPath);
-    outFile << srcCode;
-    outFile.close();
+    std::string errPath = work.file("source.txt");
+    std::string svgPath = work.file("source-svg/process.svg");
 
-    // Call the Faust compiler via Docker to generate SVG
+    // Call the Faust compiler to generate SVG
     // SVG files are created in a subdirectory named source-svg/
-    auto result = runFaustDocker("-o /dev/null -svg /tmp/source.dsp");
+    auto result = faustBackend().generateSVG(srcCode, "source.dsp", work,
+                                             cancel, fLimits);
+
+    if (limitExceeded(result)) {
+      return limitErrorContent("svg", result, fLimits);
+    }
 
     if (result.exitCode != 0) {
       // Write stderr to error file
@@ -75,17 +141,33 @@ json FaustSVGTool::call(const std::string &args) {
             {"text", "Error: Failed to execute faust command"}}});
     }
     // Read the generated SVG file
-    auto fileData = encodeFile(svgPath);
+    auto fileData = streamFileContent(svgPath);
 
     if (!fileData) {
       return json::array(
           {{{"type", "text"}, {"text", "Error: Could not read SVG file"}}});
     }
 
-    // Return as MCP content array with resource
-    json resource = *fileData;
+    // Keep all the diagrams (process.svg and one per sub-block) when asked,
+    // so that they can be fetched later without compiling again
+    std::vector<std::string> names;
+    std::string set;
+    json keep = arguments.value("keep_diagrams", json());
+    if (keep.is_boolean() ? keep.get<bool>() : resultsByReference()) {
+      set = storeDiagrams(work.file("source-svg"), names);
+    }
 
-    return json::array({{{"type", "resource"}, {"resource", resource}}});
+    // Return as MCP content array with resource, and the diagram set
+    json resource = *fileData;
+    if (!set.empty()) {
+      resource["uri"] = diagramUri(set, "process.svg");
+    }
+    json content =
+        json::array({{{"type", "resource"}, {"resource", resource}}});
+    if (!set.empty()) {
+      content.push_back(diagramIndex(set, names));
+    }
+    return content;
 
   } catch (const json::parse_error &e) {
     // Handle parse error
@@ -1,11 +1,16 @@
 #pragma once
 
 #include "mcpTool.hh"
+#include "process.hh"
 
 class FaustSVGTool : public McpTool {
 public:
   FaustSVGTool();
   std::string name() const override;
   std::string describe() const override;
-  json call(const std::string &args) override;
+  json call(const std::string &args,
+            const CancellationToken &cancel) override;
+
+private:
+  ProcessLimits fLimits; ///< Limits of the Faust run ("svg" stage)
 };
\ No newline at end of file
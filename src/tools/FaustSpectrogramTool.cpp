@@ -1,13 +1,425 @@
 #include "FaustSpectrogramTool.hh"
+#include "FaustBackend.hh"
+#include "architecture.hh"
 #include "utils.hh"
+#include "jsonrpc.hh"
+#include "process.hh"
+#include "stats.hh"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
 #include <sstream>
 
+#ifdef FAUST_MCP_LIBFAUST
+#include "JitDsp.hh"
+#include "LibFaustBackend.hh"
+#include "spectrogram_matrix.hh"
+#include "spectrogram_synth.hh"
+#endif
+
 // Constructor
 FaustSpectrogramTool::FaustSpectrogramTool() {
-  // Initialize tool-specific data here
+  // Resource limits of each stage (config.hh defaults, env overrides)
+  fFaustLimits = stageLimits("spectrogram_faust");
+  fCompileLimits = stageLimits("spectrogram_cxx");
+  fRunLimits = stageLimits("spectrogram_run");
+}
+
+// Formats a number argument like the former shell command line did
+static std::string formatNumber(double value) {
+  std::ostringstream oss;
+  oss << value;
+  return oss.str();
+}
+
+// Notes of a sweep: frequency, gain and gate_duration given as lists, all
+// combinations are rendered (frequency varying fastest, then gain)
+struct SweepRequest {
+  bool enabled = false;
+  bool images = false;
+  std::vector<double> frequencies;
+  std::vector<double> gains;
+  std::vector<double> gateDurations;
+
+  size_t size() const {
+    return frequencies.size() * gains.size() * gateDurations.size();
+  }
+};
+
+// Reads a number argument that may also be a list of numbers
+static bool numberList(const json &arguments, const std::string &key,
+                       double defaultValue, std::vector<double> &values) {
+  values.clear();
+  if (!arguments.contains(key)) {
+    values.push_back(defaultValue);
+    return true;
+  }
+  const json &value = arguments[key];
+  if (value.is_number()) {
+    values.push_back(value.get<double>());
+    return true;
+  }
+  if (!value.is_array() || value.empty()) {
+    return false;
+  }
+  for (const auto &item : value) {
+    if (!item.is_number()) {
+      return false;
+    }
+    values.push_back(item.get<double>());
+  }
+  return true;
 }
 
+// Checks the sizes of a request before anything is compiled (see
+// MAX_SPECTROGRAM_CELLS, for all the notes of a sweep): returns the error
+// of the first parameter out of range, empty if there is none. The number
+// of frames is bounded by that of centered framing, the rows by those of
+// the transform (mel_bands, or bins_per_octave per octave from C1 to 0.4 x
+// sample_rate).
+static std::string spectrogramSizeError(double duration, int maxSeconds,
+                                        int sample_rate, int fft_size,
+                                        int hop_size, int mel_bands,
+                                        const std::string &transform,
+                                        int bins_per_octave, size_t notes) {
+  if (duration <= 0 || duration > maxSeconds) {
+    return "duration must be in (0, " + std::to_string(maxSeconds) +
+           "] seconds";
+  }
+  if (sample_rate <= 0 || sample_rate > MAX_SAMPLE_RATE) {
+    return "sample_rate must be in [1, " + std::to_string(MAX_SAMPLE_RATE) +
+           "] Hz";
+  }
+  if (fft_size < 16 || fft_size > MAX_FFT_SIZE ||
+      (fft_size & (fft_size - 1)) != 0) {
+    return "fft_size must be a power of two from 16 to " +
+           std::to_string(MAX_FFT_SIZE);
+  }
+  if (hop_size <= 0) {
+    return "hop_size must be positive";
+  }
+  if (mel_bands <= 0 || mel_bands > fft_size / 2 + 1) {
+    return "mel_bands must be in [1, fft_size / 2 + 1] (" +
+           std::to_string(fft_size / 2 + 1) + ")";
+  }
+  long frames = 1 + (long)(duration * sample_rate) / hop_size;
+  long rows = mel_bands;
+  if (transform == "cqt") {
+    rows = (long)(bins_per_octave *
+                  std::log2(0.4 * sample_rate / 32.703)) + 1;
+  }
+  if (notes == 0 ||
+      frames * std::max(1L, rows) > MAX_SPECTROGRAM_CELLS / (long)notes) {
+    return "the spectrogram would have " + std::to_string(frames) +
+           " frames of " + std::to_string(rows) + " rows" +
+           (notes > 1 ? " for each of " + std::to_string(notes) + " notes"
+                      : "") +
+           ", more than " +
+           std::to_string(MAX_SPECTROGRAM_CELLS) +
+           " values: increase hop_size, or reduce duration, sample_rate or "
+           "the rows";
+  }
+  return "";
+}
+
+// Comma-separated list of numbers for the generator command line
+static std::string joinNumbers(const std::vector<double> &values) {
+  std::string joined;
+  for (double value : values) {
+    joined += (joined.empty() ? "" : ",") + formatNumber(value);
+  }
+  return joined;
+}
+
+// MCP content of a sweep: the contact sheet preceded by its layout, or each
+// image preceded by the parameters of its note
+static json sweepContent(const SweepRequest &sweep,
+                         std::vector<json> images) {
+  json content = json::array();
+  if (!sweep.images) {
+    content.push_back(
+        {{"type", "text"},
+         {"text", "Contact sheet of " + std::to_string(sweep.size()) +
+                      " spectrograms (common color scale): one column per "
+                      "frequency [" + joinNumbers(sweep.frequencies) +
+                      "] Hz, one row per gain [" + joinNumbers(sweep.gains) +
+                      "] for each gate_duration [" +
+                      joinNumbers(sweep.gateDurations) + "] s"}});
+    content.push_back({{"type", "image"},
+                       {"data", std::move(images[0])},
+                       {"mimeType", "image/png"}});
+    return content;
+  }
+
+  size_t i = 0;
+  for (double gateDuration : sweep.gateDurations) {
+    for (double gain : sweep.gains) {
+      for (double frequency : sweep.frequencies) {
+        content.push_back(
+            {{"type", "text"},
+             {"text", "frequency=" + formatNumber(frequency) +
+                          " gain=" + formatNumber(gain) +
+                          " gate_duration=" + formatNumber(gateDuration)}});
+        content.push_back({{"type", "image"},
+                           {"data", std::move(images[i++])},
+                           {"mimeType", "image/png"}});
+      }
+    }
+  }
+  return content;
+}
+
+// MCP content of a multichannel spectrogram: the image preceded by the
+// order of its panels
+static json channelContent(const std::string &channelMode, json image) {
+  std::string layout;
+  if (channelMode == "each") {
+    layout = "One spectrogram per output channel, left to right from "
+             "channel 0 (common color scale)";
+  } else if (channelMode == "mid_side") {
+    layout = "Mid (left) and side (right) spectrograms of the first two "
+             "output channels (common color scale)";
+  } else {
+    layout = "Spectrogram of the sum of all output channels";
+  }
+  return json::array({{{"type", "text"}, {"text", layout}},
+                      {{"type", "image"},
+                       {"data", std::move(image)},
+                       {"mimeType", "image/png"}}});
+}
+
+// Little-endian 32-bit field of a matrix header
+static uint32_t matrixField(const std::string &data, size_t offset) {
+  uint32_t value = 0;
+  for (int i = 3; i >= 0; i--) {
+    value = (value << 8) | (unsigned char)data[offset + i];
+  }
+  return value;
+}
+
+// Name of the rows of a matrix for its frequency scale field
+static std::string matrixRowName(char scale) {
+  switch (scale) {
+  case 1:
+    return "constant-Q bins";
+  case 2:
+    return "linear rows";
+  case 3:
+    return "log rows";
+  default:
+    return "mel bands";
+  }
+}
+
+// MCP content of a spectrogram matrix (spectrogram_matrix.hh layout): its
+// shape as text (from the 36-byte header), then the matrix of 'size' bytes
+// as an embedded binary resource
+static json matrixContent(const std::string &data, size_t size, json blob) {
+  if (data.size() < 36 || data.compare(0, 4, "FSPM") != 0) {
+    return json::array(
+        {{{"type", "text"}, {"text", "Error: Invalid spectrogram matrix"}}});
+  }
+  std::string summary =
+      "Spectrogram matrix (FSPM): " + std::to_string(matrixField(data, 8)) +
+      " signal(s) x " + std::to_string(matrixField(data, 12)) +
+      " frames x " + std::to_string(matrixField(data, 16)) +
+      " " + matrixRowName(data[6]) + ", " +
+      (data[5] == 2 ? "float16" : "float32") + ((data[7] & 1) ? ", dB" : "") +
+      ((data[7] & 2) ? ", zlib" : "") +
+      ((data[7] & 4) ? ", centered frames" : "") + ", " +
+      std::to_string(size) + " bytes";
+  return json::array(
+      {{{"type", "text"}, {"text", summary}},
+       {{"type", "resource"},
+        {"resource",
+         {{"uri", "faust-mcp://spectrogram/matrix.fspm"},
+          {"mimeType", "application/x-faust-spectrogram-matrix"},
+          {"blob", std::move(blob)}}}}});
+}
+
+#ifdef FAUST_MCP_LIBFAUST
+typedef std::chrono::steady_clock Clock;
+
+// Sweep rendered on clones of the instance, one per thread (sweep_threads);
+// clones are created under the libfaust lock like instances
+static json jitSweep(dsp &instance, const Options &opts,
+                     const SweepRequest &sweep,
+                     const std::function<bool()> &interrupted) {
+  std::vector<float> frequencies(sweep.frequencies.begin(),
+                                 sweep.frequencies.end());
+  std::vector<float> gains(sweep.gains.begin(), sweep.gains.end());
+  std::vector<float> gateDurations(sweep.gateDurations.begin(),
+                                   sweep.gateDurations.end());
+  std::vector<SweepPoint> points =
+      sweepPoints(frequencies, gains, gateDurations);
+
+  int threads = std::atoi(
+      configValue("sweep_threads", std::to_string(SWEEP_THREADS)).c_str());
+  std::vector<dsp *> instances;
+  {
+    std::lock_guard<std::mutex> lock(libfaustMutex());
+    instances = cloneInstances(instance, threads);
+  }
+  std::vector<std::unique_ptr<dsp>> clones;
+  for (size_t i = 1; i < instances.size(); i++) {
+    clones.emplace_back(instances[i]);
+  }
+
+  std::vector<std::vector<std::vector<float>>> melSpecs;
+  if (!renderSweep(instances, opts, points, melSpecs, interrupted)) {
+    return nullptr;
+  }
+
+  std::vector<Image> tiles;
+  for (const auto &melSpec : melSpecs) {
+    tiles.push_back(renderImage(melSpec, opts));
+  }
+  std::vector<Image> images;
+  if (sweep.images) {
+    images.swap(tiles);
+  } else {
+    images.push_back(
+        composeContactSheet(tiles, (int)sweep.frequencies.size()));
+  }
+
+  std::vector<json> pngImages;
+  for (const auto &image : images) {
+    std::vector<unsigned char> png;
+    if (!encodeImagePNG(image, png)) {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: Spectrogram generation failed"}}});
+    }
+    pngImages.push_back(streamBytes(std::move(png), StreamEncoding::Base64));
+  }
+  return sweepContent(sweep, std::move(pngImages));
+}
+
+// Spectrogram computed in-process: DSP compiled by libfaust (factory cached
+// by source), synthesis and analysis in the server, PNG encoded in memory
+static json jitSpectrogram(const std::string &engine,
+                           const std::string &srcCode, const Options &opts,
+                           const SweepRequest &sweep,
+                           const CancellationToken &cancel,
+                           const ProcessLimits &runLimits) {
+  std::string error;
+  std::shared_ptr<dsp_factory> factory = jitFactory(engine, srcCode, error);
+  if (!factory) {
+    return json::array(
+        {{{"type", "text"},
+          {"text", "Error: Faust compilation failed: " + error}}});
+  }
+
+  std::unique_ptr<dsp> instance = createJitInstance(*factory);
+  if (!instance) {
+    return json::array(
+        {{{"type", "text"}, {"text", "Error: Could not create DSP instance"}}});
+  }
+
+  SpectrogramUI ui;
+  instance->buildUserInterface(&ui);
+  if (!ui.validate(error)) {
+    return json::array(
+        {{{"type", "text"},
+          {"text", "Error: Spectrogram generation failed: " + error}}});
+  }
+  instance->init(opts.sample_rate);
+
+  // Cancellation and the wall-clock limit of the run stage are checked
+  // during synthesis (CPU and memory limits need a separate process)
+  auto start = Clock::now();
+  bool timedOut = false;
+  auto interrupted = [&]() {
+    long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       Clock::now() - start)
+                       .count();
+    timedOut = runLimits.timeoutMs > 0 && elapsed > runLimits.timeoutMs;
+    return timedOut || cancel.isCancelled();
+  };
+
+  // A sweep renders its notes on clones of the instance, the first channel
+  // is analysed while it is synthesized, the other channel modes need every
+  // output channel
+  json sweepResult;
+  std::vector<std::vector<float>> mel_spec;
+  std::vector<std::vector<float>> channels;
+  bool completed;
+  if (sweep.enabled) {
+    StageTimer timer("spectrogram_sweep");
+    sweepResult = jitSweep(*instance, opts, sweep, interrupted);
+    completed = !sweepResult.is_null();
+  } else if (opts.channel_mode == "first" && opts.matrix_type.empty()) {
+    SpectrogramTimes times;
+    completed = renderSpectrogram(*instance, ui, opts, mel_spec, true,
+                                  interrupted, &times);
+    recordStageTime("spectrogram_synthesis", times.synthesis_ms);
+    recordStageTime("spectrogram_analysis", times.analysis_ms);
+  } else {
+    StageTimer timer("spectrogram_synthesis");
+    completed = renderAudio(*instance, ui, opts, RENDER_BLOCK_SIZE, channels,
+                            interrupted);
+  }
+  if (!completed) {
+    if (timedOut) {
+      ProcessResult run = {-1, false, true, runLimits.timeoutMs, "", ""};
+      return limitErrorContent("spectrogram_run", run, runLimits);
+    }
+    return json::array({{{"type", "text"}, {"text", "Error: Cancelled"}}});
+  }
+  if (sweep.enabled) {
+    return sweepResult;
+  }
+
+  // Numeric output: no image is built
+  if (!opts.matrix_type.empty()) {
+    StageTimer timer("spectrogram_analysis");
+    std::vector<unsigned char> matrix;
+    if (!channelSpectrogramMatrix(channels, opts, opts.channel_mode,
+                                  opts.matrix_type == "float16",
+                                  opts.matrix_zlib, matrix, error)) {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: Spectrogram generation failed: " + error}}});
+    }
+    std::string header(matrix.begin(),
+                       matrix.begin() + std::min<size_t>(matrix.size(), 36));
+    size_t size = matrix.size();
+    return matrixContent(
+        header, size, streamBytes(std::move(matrix), StreamEncoding::Base64));
+  }
+
+  std::vector<unsigned char> png;
+  if (opts.channel_mode != "first") {
+    std::vector<std::string> labels;
+    StageTimer analysisTimer("spectrogram_analysis");
+    Image image = channelSpectrogramImage(channels, opts, opts.channel_mode,
+                                          labels, error);
+    analysisTimer.stop();
+    StageTimer pngTimer("spectrogram_png");
+    if (image.empty() || !encodeImagePNG(image, png)) {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: Spectrogram generation failed: " + error}}});
+    }
+    return channelContent(opts.channel_mode,
+                          streamBytes(std::move(png), StreamEncoding::Base64));
+  }
+
+  StageTimer pngTimer("spectrogram_png");
+  if (!encodePNG(mel_spec, opts, png)) {
+    return json::array(
+        {{{"type", "text"},
+          {"text", "Error: Spectrogram generation failed"}}});
+  }
+
+  return json::array(
+      {{{"type", "image"},
+        {"data", streamBytes(std::move(png), StreamEncoding::Base64)},
+        {"mimeType", "image/png"}}});
+}
+#endif
+
 // Returns the tool name for MCP registration
 std::string FaustSpectrogramTool::name() const {
   return "FaustSpectrogramTool";
@@ -19,9 +431,10 @@ std::string FaustSpectrogramTool::describe() const {
   json description = {
       {"name", name()},
       {"description",
-       "Generates mel-scale spectrogram PNG from Faust DSP code. The DSP must "
-       "expose three parameters: 'gate' (button), 'freq' (frequency), and "
-       "'gain' (amplitude)."},
+       "Generates mel-scale (or constant-Q) spectrogram PNG from Faust DSP "
+       "code. The DSP must expose three parameters: 'gate' (button), 'freq' "
+       "(frequency), and 'gain' (amplitude). Lists of frequencies, gains or "
+       "gate durations render a sweep of notes from a single compilation."},
       {"inputSchema",
        {{"type", "object"},
         {"properties",
@@ -34,33 +447,68 @@ std::string FaustSpectrogramTool::describe() const {
             {"description", "Total duration in seconds"},
             {"default", 2.0}}},
           {"gate_duration",
-           {{"type", "number"},
-            {"description", "Gate=1 duration in seconds (from start)"},
+           {{"type", json::array({"number", "array"})},
+            {"items", {{"type", "number"}}},
+            {"description", "Gate=1 duration in seconds (from start), or a "
+                            "list for a sweep"},
             {"default", 0.5}}},
           {"frequency",
-           {{"type", "number"},
-            {"description", "Frequency in Hz"},
+           {{"type", json::array({"number", "array"})},
+            {"items", {{"type", "number"}}},
+            {"description", "Frequency in Hz, or a list for a sweep"},
             {"default", 440.0}}},
           {"gain",
-           {{"type", "number"},
-            {"description", "Gain value (0.0 to 1.0)"},
+           {{"type", json::array({"number", "array"})},
+            {"items", {{"type", "number"}}},
+            {"description", "Gain value (0.0 to 1.0), or a list for a "
+                            "sweep"},
             {"default", 0.8}}},
           {"sample_rate",
            {{"type", "number"},
-            {"description", "Sample rate in Hz"},
+            {"description", "Sample rate in Hz (at most 384000)"},
             {"default", 44100}}},
           {"fft_size",
            {{"type", "number"},
-            {"description", "FFT size (power of 2)"},
+            {"description", "FFT size (power of 2, 16 to 65536)"},
             {"default", 2048}}},
           {"hop_size",
            {{"type", "number"},
             {"description", "Hop size in samples"},
             {"default", 512}}},
+          {"padding",
+           {{"type", "string"},
+            {"description",
+             "Framing: none (frames inside the signal, at least fft_size "
+             "samples needed), zero or reflect (frames centered on each "
+             "hop, signal padded at both ends; short notes and the release "
+             "tail are fully analysed)"},
+            {"default", "none"}}},
           {"mel_bands",
            {{"type", "number"},
-            {"description", "Number of mel bands"},
+            {"description",
+             "Number of mel bands (rows of the linear and log scales), "
+             "at most fft_size / 2 + 1"},
             {"default", 128}}},
+          {"scale",
+           {{"type", "string"},
+            {"description",
+             "Frequency scale of the stft transform: mel (filterbank), "
+             "linear or log (FFT bins grouped into rows without filterbank; "
+             "linear gives one row per bin when mel_bands is at least "
+             "fft_size / 2 + 1)"},
+            {"default", "mel"}}},
+          {"transform",
+           {{"type", "string"},
+            {"description",
+             "stft (mel bands of fft_size frames) or cqt (constant-Q: "
+             "bins_per_octave log-spaced bins from C1, long windows in the "
+             "bass and short ones in the treble; fft_size and mel_bands are "
+             "ignored)"},
+            {"default", "stft"}}},
+          {"bins_per_octave",
+           {{"type", "number"},
+            {"description", "Bins per octave of the cqt transform"},
+            {"default", 24}}},
           {"colormap",
            {{"type", "string"},
             {"description", "Colormap: viridis, magma, hot, gray"},
@@ -68,17 +516,53 @@ std::string FaustSpectrogramTool::describe() const {
           {"use_db",
            {{"type", "boolean"},
             {"description", "Display in decibels"},
-            {"default", false}}}}},
+            {"default", false}}},
+          {"channels",
+           {{"type", "string"},
+            {"description",
+             "Output channels analysed: first, each (one spectrogram per "
+             "channel, side by side), mid_side (mid and side of channels 0 "
+             "and 1) or sum"},
+            {"default", "first"}}},
+          {"output",
+           {{"type", "string"},
+            {"description",
+             "png (image), or float32 / float16: the mel magnitudes as a "
+             "binary matrix resource (FSPM header with shape, sample rate, "
+             "hop and band edges), cheaper than the image"},
+            {"default", "png"}}},
+          {"compress",
+           {{"type", "boolean"},
+            {"description", "zlib-compress the data of a matrix output"},
+            {"default", false}}},
+          {"sweep_output",
+           {{"type", "string"},
+            {"description",
+             "When frequency, gain or gate_duration is a list, every "
+             "combination is rendered from one compilation: sheet (one "
+             "contact sheet PNG, a column per frequency) or images (one PNG "
+             "per note)"},
+            {"default", "sheet"}}},
+          {"engine",
+           {{"type", "string"},
+            {"description",
+             "compile (Faust -> C++ -> g++), llvm (in-process JIT) or "
+             "interp (in-process interpreter, fastest to compile); llvm "
+             "and interp need a server built with libfaust"},
+            {"default", configValue("spectrogram_engine",
+                                    SPECTROGRAM_ENGINE)}}}}},
         {"required", json::array({"value"})}}}};
 
   return description.dump();
 }
 
 // Generates spectrogram PNG from Faust DSP code
-json FaustSpectrogramTool::call(const std::string &args) {
+json FaustSpectrogramTool::call(const std::string &args,
+                                const CancellationToken &cancel) {
   try {
-    // Ensure work directory exists
-    if (!ensureWorkDir()) {
+    // Per-request work directory, removed on return (or cancellation)
+    ScratchDir work;
+    if (!work.valid()) {
       return json::array(
           {{{"type", "text"},
             {"text", "Error: Could not create work directory"}}});
@@ -90,115 +574,233 @@ json FaustSpectrogramTool::call(const std::string &args) {
     // Extract parameters
     std::string srcCode = arguments.value("value", "process = _;");
     double duration = arguments.value("duration", 2.0);
-    double gate_duration = arguments.value("gate_duration", 0.5);
-    double frequency = arguments.value("frequency", 440.0);
-    double gain = arguments.value("gain", 0.8);
     int sample_rate = arguments.value("sample_rate", 44100);
     int fft_size = arguments.value("fft_size", 2048);
     int hop_size = arguments.value("hop_size", 512);
     int mel_bands = arguments.value("mel_bands", 128);
     std::string colormap = arguments.value("colormap", "hot");
     bool use_db = arguments.value("use_db", false);
+    std::string engine = arguments.value(
+        "engine", configValue("spectrogram_engine", SPECTROGRAM_ENGINE));
 
-    // Create paths in work directory
-    std::string dspPath = getWorkPath("spectrogram_source.dsp");
-    std::string archPath = getWorkPath("spectrogram.cpp");
-    std::string cppPath = getWorkPath("spectrogram_source.cpp");
-    std::string exePath = getWorkPath("spectrogram_exe");
-    std::string pngPath = getWorkPath("spectrogram.png");
-    std::string errPath = getWorkPath("spectrogram_error.txt");
-
-    // Store the Faust code into file
-    std::ofstream outFile(dspPath);
-    outFile << srcCode;
-    outFile.close();
-
-    // Copy spectrogram.cpp architecture to work directory (shared volume)
-    // It needs to be in the shared directory for faustdocker to access it
-    std::ifstream archIn("/usr/local/share/faust/spectrogram.cpp", std::ios::binary);
-    if (!archIn) {
+    std::string channels = arguments.value("channels", "first");
+    if (channels != "first" && channels != "each" && channels != "mid_side" &&
+        channels != "sum") {
       return json::array(
           {{{"type", "text"},
-            {"text", "Error: Could not read spectrogram.cpp architecture"}}});
+            {"text", "Error: channels must be first, each, mid_side or "
+                     "sum"}}});
+    }
+    std::string padding = arguments.value("padding", "none");
+    if (padding != "none" && padding != "zero" && padding != "reflect") {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: padding must be none, zero or reflect"}}});
     }
-    std::ofstream archOut(archPath, std::ios::binary);
-    archOut << archIn.rdbuf();
-    archIn.close();
-    archOut.close();
-
-    // Step 1: Compile DSP to C++ using spectrogram.cpp architecture via Docker
-    // All files must be in work directory (mounted as /tmp in faustdocker)
-    auto result = runFaustDocker("-a spectrogram.cpp -o spectrogram_source.cpp spectrogram_source.dsp");
 
-    if (result.exitCode != 0) {
-      // Write stderr to error file
-      std::ofstream errFile(errPath);
-      errFile << "Faust compilation error:\n" << result.errorOutput;
-      errFile.close();
+    std::string scale = arguments.value("scale", "mel");
+    if (scale != "mel" && scale != "linear" && scale != "log") {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: scale must be mel, linear or log"}}});
+    }
+    std::string transform = arguments.value("transform", "stft");
+    int bins_per_octave = arguments.value("bins_per_octave", 24);
+    if ((transform != "stft" && transform != "cqt") || bins_per_octave < 1 ||
+        bins_per_octave > 96) {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: transform must be stft or cqt, bins_per_octave "
+                     "between 1 and 96"}}});
+    }
 
+    // Sweep: lists of frequencies, gains or gate durations
+    SweepRequest sweep;
+    if (!numberList(arguments, "frequency", 440.0, sweep.frequencies) ||
+        !numberList(arguments, "gain", 0.8, sweep.gains) ||
+        !numberList(arguments, "gate_duration", 0.5, sweep.gateDurations)) {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: frequency, gain and gate_duration must be "
+                     "numbers or non-empty lists of numbers"}}});
+    }
+    sweep.enabled = arguments.value("frequency", json()).is_array() ||
+                    arguments.value("gain", json()).is_array() ||
+                    arguments.value("gate_duration", json()).is_array();
+    std::string sweepOutput = arguments.value("sweep_output", "sheet");
+    sweep.images = (sweepOutput == "images");
+    int maxPoints = std::atoi(
+        configValue("sweep_max_points", std::to_string(SWEEP_MAX_POINTS))
+            .c_str());
+    if (sweep.enabled && (sweep.size() > (size_t)std::max(0, maxPoints) ||
+                          (sweepOutput != "sheet" && !sweep.images))) {
       return json::array(
           {{{"type", "text"},
-            {"text", "Error: Faust compilation failed: " + result.errorOutput}}});
+            {"text", "Error: A sweep has at most " +
+                         std::to_string(maxPoints) +
+                         " notes and sweep_output is sheet or images"}}});
     }
 
-    // Step 2: Compile C++ to executable using g++ in the MCP container
-    std::ostringstream compileCmd;
-    compileCmd << "g++ " << cppPath << " -o " << exePath
-               << " -std=c++11 -O3"
-               << " -I/usr/local/include"
-               << " -L/usr/local/lib"
-               << " -lfftw3f -lpng -lm"
-               << " 2>&1";
+    // Validate the sizes before compiling anything: the llvm/interp engines
+    // render and analyse in the server process
+    int maxSeconds =
+        std::atoi(configValue("render_max_seconds",
+                              std::to_string(RENDER_MAX_SECONDS))
+                      .c_str());
+    std::string sizeError =
+        spectrogramSizeError(duration, maxSeconds, sample_rate, fft_size,
+                             hop_size, mel_bands, transform, bins_per_octave,
+                             sweep.size());
+    if (!sizeError.empty()) {
+      return json::array(
+          {{{"type", "text"}, {"text", "Error: " + sizeError}}});
+    }
 
-    FILE *pipe = popen(compileCmd.str().c_str(), "r");
-    if (!pipe) {
+    // Without padding, the STFT needs at least one full FFT frame (constant-Q
+    // frames are always centered)
+    if (transform == "stft" && padding == "none" &&
+        (long)(duration * sample_rate) < fft_size) {
       return json::array(
           {{{"type", "text"},
-            {"text", "Error: Could not execute g++ compiler"}}});
+            {"text", "Error: duration is shorter than one FFT frame (use "
+                     "zero or reflect padding)"}}});
     }
 
-    char buffer[256];
-    std::string compileOutput;
-    while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-      compileOutput += buffer;
+    std::string output = arguments.value("output", "png");
+    bool compress = arguments.value("compress", false);
+    if (output != "png" && output != "float32" && output != "float16") {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: output must be png, float32 or float16"}}});
     }
-    int compileStatus = pclose(pipe);
-
-    if (compileStatus != 0) {
-      std::ofstream errFile(errPath);
-      errFile << "C++ compilation error:\n" << compileOutput;
-      errFile.close();
+    if (sweep.enabled && output != "png") {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: Sweeps are rendered as images only"}}});
+    }
+    if (sweep.enabled && channels != "first") {
+      return json::array(
+          {{{"type", "text"},
+            {"text", "Error: Sweeps analyse the first channel only"}}});
+    }
+    double frequency = sweep.frequencies[0];
+    double gain = sweep.gains[0];
+    double gate_duration = sweep.gateDurations[0];
 
+    if (engine != "compile") {
+#ifdef FAUST_MCP_LIBFAUST
+      if (isJitEngine(engine)) {
+        Options opts;
+        opts.duration = duration;
+        opts.gate_duration = gate_duration;
+        opts.frequency = frequency;
+        opts.gain = gain;
+        opts.sample_rate = sample_rate;
+        opts.channel_mode = channels;
+        opts.fft_size = fft_size;
+        opts.hop_size = hop_size;
+        opts.padding = padding;
+        opts.mel_bands = mel_bands;
+        opts.transform = transform;
+        opts.frequency_scale = scale;
+        opts.bins_per_octave = bins_per_octave;
+        opts.fmax = sample_rate / 2.0;
+        opts.colormap = colormap;
+        opts.use_db = use_db;
+        if (output != "png") {
+          opts.matrix_type = output;
+          opts.matrix_zlib = compress;
+        }
+        return jitSpectrogram(engine, srcCode, opts, sweep, cancel,
+                              fRunLimits);
+      }
+#endif
       return json::array(
           {{{"type", "text"},
-            {"text", "Error: C++ compilation failed: " + compileOutput}}});
+            {"text", "Error: Unsupported spectrogram engine '" + engine +
+                         "' (llvm and interp need a server built with "
+                         "libfaust)"}}});
+    }
+
+    // Create paths in work directory
+    std::string exePath = work.file("spectrogram_exe");
+    std::string pngPath = work.file("spectrogram.png");
+    std::string matrixPath = work.file("spectrogram.fspm");
+    std::string errPath = work.file("spectrogram_error.txt");
+
+    // Steps 1-2: Faust -> C++ with the spectrogram.cpp architecture -> g++
+    json buildError;
+    if (!buildArchitectureProgram(srcCode, "spectrogram.cpp",
+                                  {"-lfftw3f", "-lpng", "-lz", "-pthread"},
+                                  "spectrogram", work,
+                                  cancel, fFaustLimits, fCompileLimits,
+                                  buildError)) {
+      return buildError;
     }
 
     // Step 3: Execute the spectrogram generator
-    std::ostringstream execCmd;
-    execCmd << exePath << " " << duration << " " << gate_duration << " "
-            << frequency << " " << gain << " -sr " << sample_rate << " -fft "
-            << fft_size << " -hop " << hop_size << " -mel " << mel_bands
-            << " -cmap " << colormap << " -o " << pngPath;
+    std::vector<std::string> execCmd = {
+        exePath,
+        formatNumber(duration),
+        formatNumber(gate_duration),
+        formatNumber(frequency),
+        formatNumber(gain),
+        "-sr", std::to_string(sample_rate),
+        "-fft", std::to_string(fft_size),
+        "-hop", std::to_string(hop_size),
+        "-mel", std::to_string(mel_bands),
+        "-cmap", colormap,
+        "-o", (output == "png") ? pngPath : matrixPath};
 
     if (use_db) {
-      execCmd << " -db";
+      execCmd.push_back("-db");
+    }
+    if (transform == "cqt") {
+      execCmd.insert(execCmd.end(),
+                     {"-cqt", "-bpo", std::to_string(bins_per_octave)});
+    }
+    if (scale != "mel") {
+      execCmd.insert(execCmd.end(), {"-fscale", scale});
+    }
+    if (channels != "first") {
+      execCmd.insert(execCmd.end(), {"-channels", channels});
+    }
+    if (padding != "none") {
+      execCmd.insert(execCmd.end(), {"-pad", padding});
+    }
+    if (output != "png") {
+      execCmd.insert(execCmd.end(), {"-matrix", output});
+      if (compress) {
+        execCmd.push_back("-zlib");
+      }
+    }
+    if (sweep.enabled) {
+      execCmd.insert(execCmd.end(),
+                     {"-freqs", joinNumbers(sweep.frequencies), "-gains",
+                      joinNumbers(sweep.gains), "-gates",
+                      joinNumbers(sweep.gateDurations), "-threads",
+                      configValue("sweep_threads",
+                                  std::to_string(SWEEP_THREADS))});
+      if (sweep.images) {
+        execCmd.push_back("-images");
+      }
     }
 
-    execCmd << " 2>&1";
-
-    pipe = popen(execCmd.str().c_str(), "r");
-    if (!pipe) {
+    ProcessResult execRun = runProcess(execCmd, cancel, fRunLimits);
+    if (limitExceeded(execRun)) {
+      return limitErrorContent("spectrogram_run", execRun, fRunLimits);
+    }
+    if (execRun.exitCode < 0 && !execRun.cancelled) {
       return json::array(
           {{{"type", "text"},
             {"text", "Error: Could not execute spectrogram generator"}}});
     }
 
-    std::string execOutput;
-    while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-      execOutput += buffer;
-    }
-    int execStatus = pclose(pipe);
+    // Synthesis, analysis and PNG times reported by the generator
+    recordReportedTimes("spectrogram", execRun.output);
+
+    std::string execOutput = execRun.output + execRun.errorOutput;
+    int execStatus = execRun.exitCode;
 
     if (execStatus != 0) {
       std::ofstream errFile(errPath);
@@ -210,27 +812,62 @@ json FaustSpectrogramTool::call(const std::string &args) {
             {"text", "Error: Spectrogram generation failed: " + execOutput}}});
     }
 
-    // Step 4: Read the generated PNG file
-    auto fileData = encodeFile(pngPath);
+    // Step 4: Read the generated matrix, or PNG file(s)
+    // (streamed into the response from the files)
+    if (output != "png") {
+      std::ifstream file(matrixPath, std::ios::binary);
+      std::string header(36, '\0');
+      file.read(&header[0], header.size());
+      header.resize((size_t)file.gcount());
+      struct stat st;
+      size_t size = stat(matrixPath.c_str(), &st) == 0 ? st.st_size : 0;
+      return matrixContent(header, size,
+                           streamFile(matrixPath, StreamEncoding::Base64));
+    }
+
+    if (sweep.enabled) {
+      std::vector<json> images;
+      for (size_t i = 0; i < (sweep.images ? sweep.size() : 1); i++) {
+        std::string path =
+            sweep.images
+                ? work.file("spectrogram-" + std::to_string(i) + ".png")
+                : pngPath;
+        auto imageData = streamFileContent(path);
+        if (!imageData || !imageData->contains("data")) {
+          return json::array(
+              {{{"type", "text"},
+                {"text", "Error: Could not read PNG file at: " + path}}});
+        }
+        images.push_back(std::move((*imageData)["data"]));
+      }
+      return sweepContent(sweep, std::move(images));
+    }
+
+    auto fileData = streamFileContent(pngPath);
 
     if (!fileData) {
       return json::array(
           {{{"type", "text"}, {"text", "Error: Could not read PNG file at: " + pngPath}}});
     }
 
-    // Extract base64 data and mimeType from encodeFile result
-    json imageData = *fileData;
-    std::string base64Data = imageData.value("data", "");
+    // Extract the data and mimeType from the streamFileContent result
+    json imageData = std::move(*fileData);
     std::string mimeType = imageData.value("mimeType", "image/png");
 
-    if (base64Data.empty()) {
+    if (!imageData.contains("data")) {
       return json::array(
           {{{"type", "text"}, {"text", "Error: PNG file is empty or could not be encoded"}}});
     }
 
+    if (channels != "first") {
+      return channelContent(channels, std::move(imageData["data"]));
+    }
+
     // Return as MCP content array with only the image
     return json::array({
-      {{"type", "image"}, {"data", base64Data}, {"mimeType", mimeType}}
+      {{"type", "image"},
+       {"data", std::move(imageData["data"])},
+       {"mimeType", mimeType}}
     });
 
   } catch (const json::parse_error &e) {
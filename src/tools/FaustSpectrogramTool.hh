@@ -1,11 +1,18 @@
 #pragma once
 
 #include "mcpTool.hh"
+#include "process.hh"
 
 class FaustSpectrogramTool : public McpTool {
 public:
   FaustSpectrogramTool();
   std::string name() const override;
   std::string describe() const override;
-  json call(const std::string &args) override;
+  json call(const std::string &args,
+            const CancellationToken &cancel) override;
+
+private:
+  ProcessLimits fFaustLimits;   ///< Faust run ("spectrogram_faust" stage)
+  ProcessLimits fCompileLimits; ///< g++ run ("spectrogram_cxx" stage)
+  ProcessLimits fRunLimits;     ///< Generator run ("spectrogram_run" stage)
 };
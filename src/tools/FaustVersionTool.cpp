@@ -1,10 +1,12 @@
 #include "FaustVersionTool.hh"
+#include "FaustBackend.hh"
 #include "utils.hh"
 #include <cstdlib>
 
 // Constructor
 FaustVersionTool::FaustVersionTool() {
-  // Initialize tool-specific data here
+  // Resource limits of the Faust run (config.hh defaults, env overrides)
+  fLimits = stageLimits("version");
 }
 
 // Returns the tool name for MCP registration
@@ -25,17 +27,23 @@ std::string FaustVersionTool::describe() const {
 }
 
 // Executes faust -v and returns version information
-json FaustVersionTool::call(const std::string &args) {
+json FaustVersionTool::call(const std::string &args,
+                            const CancellationToken &cancel) {
   try {
-    // Ensure work directory exists
-    if (!ensureWorkDir()) {
+    // Per-request work directory, removed on return (or cancellation)
+    ScratchDir work;
+    if (!work.valid()) {
       return json::array(
           {{{"type", "text"},
             {"text", "Error: Could not create work directory"}}});
     }
 
-    // Call Faust via Docker to get version
-    auto result = runFaustDocker("-v");
+    // Call Faust to get version
+    auto result = runFaust({"-v"}, work, cancel, fLimits);
+
+    if (limitExceeded(result)) {
+      return limitErrorContent("version", result, fLimits);
+    }
 
     if (result.exitCode != 0) {
       return json::array(
@@ -44,7 +52,7 @@ json FaustVersionTool::call(const std::string &args) {
     }
 
     // Create path in work directory to store version info
-    std::string versionPath = getWorkPath("version.txt");
+    std::string versionPath = work.file("version.txt");
 
     // Write version output to file
     std::ofstream versionFile(versionPath);
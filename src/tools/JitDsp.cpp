@@ -0,0 +1,126 @@
+#ifdef FAUST_MCP_LIBFAUST
+
+#include "JitDsp.hh"
+#include "LibFaustBackend.hh"
+#include "config.hh"
+#include "stats.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include <faust/dsp/interpreter-dsp.h>
+#include <faust/dsp/llvm-dsp.h>
+
+// A cached factory with the text it was compiled from (to rule out hash
+// collisions)
+struct CacheEntry {
+  size_t hash;
+  std::string engine;
+  std::string source;
+  std::shared_ptr<dsp_factory> factory;
+};
+
+// LRU list, most recently used first, indexed by hash
+static std::mutex gCacheMutex;
+static std::list<CacheEntry> gCache;
+static std::unordered_map<size_t, std::list<CacheEntry>::iterator>
+    gCacheIndex;
+
+// Capacity of the cache (jit_cache_size setting, 0 disables caching)
+static size_t cacheCapacity() {
+  static int capacity = std::atoi(
+      configValue("jit_cache_size", std::to_string(JIT_CACHE_SIZE)).c_str());
+  return (size_t)std::max(0, capacity);
+}
+
+// Factories are released with the libfaust function matching their engine
+static void deleteFactory(dsp_factory *factory, bool llvm) {
+  std::lock_guard<std::mutex> lock(libfaustMutex());
+  if (llvm) {
+    deleteDSPFactory(static_cast<llvm_dsp_factory *>(factory));
+  } else {
+    deleteInterpreterDSPFactory(
+        static_cast<interpreter_dsp_factory *>(factory));
+  }
+}
+
+// Compiles a factory with the requested engine (timed as the jit_<engine>
+// stage, cache hits are not)
+static std::shared_ptr<dsp_factory>
+compileFactory(const std::string &engine, const std::string &source,
+               std::string &error) {
+  StageTimer timer("jit_" + engine);
+  const char *argv[] = {nullptr};
+  bool llvm = (engine == "llvm");
+  dsp_factory *factory;
+  {
+    std::lock_guard<std::mutex> lock(libfaustMutex());
+    if (llvm) {
+      // Empty target: the host machine, -1: highest optimization level
+      factory = createDSPFactoryFromString("jit", source, 0, argv, "", error,
+                                           -1);
+    } else {
+      factory = createInterpreterDSPFactoryFromString("jit", source, 0, argv,
+                                                      error);
+    }
+  }
+  if (!factory) {
+    return nullptr;
+  }
+  return std::shared_ptr<dsp_factory>(
+      factory, [llvm](dsp_factory *f) { deleteFactory(f, llvm); });
+}
+
+bool isJitEngine(const std::string &engine) {
+  return engine == "llvm" || engine == "interp";
+}
+
+std::shared_ptr<dsp_factory> jitFactory(const std::string &engine,
+                                        const std::string &source,
+                                        std::string &error) {
+  size_t hash = std::hash<std::string>()(engine + '\n' + source);
+
+  {
+    std::lock_guard<std::mutex> lock(gCacheMutex);
+    auto found = gCacheIndex.find(hash);
+    if (found != gCacheIndex.end() && found->second->engine == engine &&
+        found->second->source == source) {
+      gCache.splice(gCache.begin(), gCache, found->second);
+      recordCacheLookup("jit", true);
+      return found->second->factory;
+    }
+  }
+  recordCacheLookup("jit", false);
+
+  // Compiled outside of the cache lock so that hits are never delayed by a
+  // compilation (concurrent misses on the same source compile twice, the
+  // last one is kept)
+  std::shared_ptr<dsp_factory> factory = compileFactory(engine, source, error);
+  if (!factory || cacheCapacity() == 0) {
+    return factory;
+  }
+
+  std::lock_guard<std::mutex> lock(gCacheMutex);
+  auto found = gCacheIndex.find(hash);
+  if (found != gCacheIndex.end()) {
+    gCache.erase(found->second);
+  }
+  gCache.push_front(CacheEntry{hash, engine, source, factory});
+  gCacheIndex[hash] = gCache.begin();
+  while (gCache.size() > cacheCapacity()) {
+    gCacheIndex.erase(gCache.back().hash);
+    gCache.pop_back();
+  }
+  return factory;
+}
+
+std::unique_ptr<dsp> createJitInstance(dsp_factory &factory) {
+  std::lock_guard<std::mutex> lock(libfaustMutex());
+  return std::unique_ptr<dsp>(factory.createDSPInstance());
+}
+
+#endif
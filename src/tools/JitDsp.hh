@@ -0,0 +1,44 @@
+#pragma once
+
+#ifdef FAUST_MCP_LIBFAUST
+
+#include <memory>
+#include <string>
+
+#include <faust/dsp/dsp.h>
+#include <faust/gui/UI.h>
+
+// ============================================================================
+// In-process DSP Compilation (libfaust LLVM JIT / interpreter)
+// ============================================================================
+
+/**
+ * @brief Whether an engine name selects in-process compilation
+ *
+ * "llvm" JIT-compiles the DSP to native code (slower to compile, runs at
+ * full speed), "interp" uses the Faust interpreter (compiles in a few
+ * milliseconds, slower to run, for quick previews).
+ */
+bool isJitEngine(const std::string &engine);
+
+/**
+ * @brief DSP factory of a Faust program compiled in-process
+ *
+ * Factories are kept in an LRU cache keyed by a hash of the engine and the
+ * source (jit_cache_size entries), so that renders of the same DSP with
+ * other parameters reuse the compiled code. A factory stays valid while a
+ * caller holds it, even if it is evicted meanwhile.
+ *
+ * @param engine "llvm" or "interp"
+ * @param error Compiler messages when the result is nullptr
+ */
+std::shared_ptr<dsp_factory> jitFactory(const std::string &engine,
+                                        const std::string &source,
+                                        std::string &error);
+
+/**
+ * @brief New DSP instance of a factory (nullptr on failure)
+ */
+std::unique_ptr<dsp> createJitInstance(dsp_factory &factory);
+
+#endif
@@ -0,0 +1,162 @@
+#ifdef FAUST_MCP_LIBFAUST
+
+#include "LibFaustBackend.hh"
+#include "stats.hh"
+
+#include <chrono>
+#include <fstream>
+#include <regex>
+
+#include <faust/dsp/libfaust-box.h>
+#include <faust/dsp/libfaust.h>
+
+typedef std::chrono::steady_clock Clock;
+
+// Result of an in-process compilation started at 'start'
+static FaustResult libfaustResult(bool ok, const std::string &output,
+                                  const std::string &error,
+                                  Clock::time_point start) {
+  long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     Clock::now() - start)
+                     .count();
+  return FaustResult{ok ? 0 : 1, false, false, elapsed, output, error};
+}
+
+// Result of a request cancelled before the compilation started
+static FaustResult cancelledResult() {
+  return FaustResult{-1, true, false, 0, "", ""};
+}
+
+// C-style argv view of a list of options
+static std::vector<const char *> toArgv(const std::vector<std::string> &args) {
+  std::vector<const char *> argv;
+  for (const auto &arg : args) {
+    argv.push_back(arg.c_str());
+  }
+  argv.push_back(nullptr);
+  return argv;
+}
+
+std::mutex &libfaustMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+LibFaustBackend::LibFaustBackend(std::unique_ptr<FaustBackend> fallback)
+    : fFallback(std::move(fallback)) {}
+
+FaustResult LibFaustBackend::run(const std::vector<std::string> &faustArgs,
+                                 const ScratchDir &workDir,
+                                 const CancellationToken &cancel,
+                                 const ProcessLimits &limits) {
+  return fFallback->run(faustArgs, workDir, cancel, limits);
+}
+
+// Faust source -> boxes -> C++ class, entirely in memory
+FaustResult
+LibFaustBackend::generateClass(const std::string &source,
+                               const std::string &dspName,
+                               const std::vector<std::string> &options) {
+  auto start = Clock::now();
+  std::vector<const char *> argv = toArgv(options);
+  int argc = (int)options.size();
+  std::string error;
+  std::string code;
+
+  createLibContext();
+  int inputs = 0, outputs = 0;
+  Box box = DSPToBoxes(dspName, source, argc, argv.data(), &inputs, &outputs,
+                       error);
+  if (box) {
+    code = createSourceFromBoxes(dspName, box, "cpp", argc, argv.data(),
+                                 error);
+  }
+  destroyLibContext();
+
+  return libfaustResult(!code.empty(), code, error, start);
+}
+
+FaustResult LibFaustBackend::compileCpp(const std::string &source,
+                                        const std::string &dspName,
+                                        const std::vector<std::string> &options,
+                                        const ScratchDir &workDir,
+                                        const CancellationToken &cancel,
+                                        const ProcessLimits &limits) {
+  StageTimer timer(limits.stage);
+  std::lock_guard<std::mutex> lock(libfaustMutex());
+  if (cancel.isCancelled()) {
+    return cancelledResult();
+  }
+  return generateClass(source, dspName, options);
+}
+
+FaustResult LibFaustBackend::generateSVG(const std::string &source,
+                                         const std::string &dspName,
+                                         const ScratchDir &workDir,
+                                         const CancellationToken &cancel,
+                                         const ProcessLimits &limits) {
+  StageTimer timer(limits.stage);
+  std::lock_guard<std::mutex> lock(libfaustMutex());
+  if (cancel.isCancelled()) {
+    return cancelledResult();
+  }
+
+  // Diagrams go to <output dir>/<name>-svg/, like the command line compiler
+  auto start = Clock::now();
+  std::string name = dspName.substr(0, dspName.find_last_of('.'));
+  std::vector<std::string> options = {"-svg", "-O", workDir.path()};
+  std::vector<const char *> argv = toArgv(options);
+  std::string error;
+  bool ok = generateAuxFilesFromString(name, source, (int)options.size(),
+                                       argv.data(), error);
+
+  return libfaustResult(ok && error.empty(), "", error, start);
+}
+
+FaustResult LibFaustBackend::compileWithArchitecture(
+    const std::string &source, const std::string &dspName,
+    const std::string &archPath, const std::string &outputName,
+    const ScratchDir &workDir, const CancellationToken &cancel,
+    const ProcessLimits &limits) {
+  StageTimer timer(limits.stage);
+  std::ifstream archFile(archPath, std::ios::binary);
+  std::string arch((std::istreambuf_iterator<char>(archFile)),
+                   std::istreambuf_iterator<char>());
+  if (arch.empty()) {
+    return FaustResult{-1, false, false, 0, "",
+                       "Could not read architecture file " + archPath};
+  }
+
+  FaustResult result;
+  {
+    std::lock_guard<std::mutex> lock(libfaustMutex());
+    if (cancel.isCancelled()) {
+      return cancelledResult();
+    }
+    result = generateClass(source, dspName, {});
+  }
+  if (result.exitCode != 0) {
+    return result;
+  }
+
+  // Fill the architecture markers, as faust -a does (scalar code needs no
+  // intrinsic section)
+  static const std::regex intrinsicMarker("<<\\s*includeIntrinsic\\s*>>");
+  static const std::regex classMarker("<<\\s*includeclass\\s*>>");
+  arch = std::regex_replace(arch, intrinsicMarker, "");
+  std::smatch marker;
+  if (std::regex_search(arch, marker, classMarker)) {
+    arch.replace(marker.position(0), marker.length(0), result.output);
+  }
+
+  std::ofstream output(workDir.file(outputName), std::ios::binary);
+  output << arch;
+  if (!output.good()) {
+    result.exitCode = 1;
+    result.errorOutput = "Could not write " + outputName;
+  }
+  result.output.clear();
+  return result;
+}
+
+#endif
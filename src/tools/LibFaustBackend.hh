@@ -0,0 +1,76 @@
+#pragma once
+
+#ifdef FAUST_MCP_LIBFAUST
+
+#include <memory>
+#include <mutex>
+
+#include "FaustBackend.hh"
+
+/**
+ * @brief In-process Faust compiler (libfaust), optional build
+ *
+ * Available when the server is compiled with -DFAUST_MCP_LIBFAUST and linked
+ * with -lfaust, selected with backend = libfaust. compileCpp() and
+ * compileWithArchitecture() call the compiler API on the source string: no
+ * DSP file, no process, and the architecture file is filled in memory.
+ * generateSVG() also runs in-process, but libfaust can only write the
+ * diagrams to disk (in the request directory). run(), used for command
+ * lines with no in-process equivalent (-v, -h), goes to the external
+ * fallback backend (libfaust_fallback setting, default docker).
+ *
+ * libfaust is not reentrant, so compilations are serialized. An in-process
+ * compilation cannot be killed: cancellation is checked before it starts
+ * and the stage limits do not apply.
+ */
+class LibFaustBackend : public FaustBackend {
+public:
+  explicit LibFaustBackend(std::unique_ptr<FaustBackend> fallback);
+
+  std::string name() const override { return "libfaust"; }
+
+  // The compiler runs in the server: see hostOptionsError()
+  std::string
+  checkOptions(const std::vector<std::string> &options) const override {
+    return hostOptionsError(options);
+  }
+
+  FaustResult run(const std::vector<std::string> &faustArgs,
+                  const ScratchDir &workDir, const CancellationToken &cancel,
+                  const ProcessLimits &limits) override;
+
+  FaustResult compileCpp(const std::string &source, const std::string &dspName,
+                         const std::vector<std::string> &options,
+                         const ScratchDir &workDir,
+                         const CancellationToken &cancel,
+                         const ProcessLimits &limits) override;
+
+  FaustResult generateSVG(const std::string &source, const std::string &dspName,
+                          const ScratchDir &workDir,
+                          const CancellationToken &cancel,
+                          const ProcessLimits &limits) override;
+
+  FaustResult compileWithArchitecture(const std::string &source,
+                                      const std::string &dspName,
+                                      const std::string &archPath,
+                                      const std::string &outputName,
+                                      const ScratchDir &workDir,
+                                      const CancellationToken &cancel,
+                                      const ProcessLimits &limits) override;
+
+private:
+  // Generates the C++ class of a DSP (caller holds libfaustMutex())
+  FaustResult generateClass(const std::string &source,
+                            const std::string &dspName,
+                            const std::vector<std::string> &options);
+
+  std::unique_ptr<FaustBackend> fFallback; ///< For run()
+};
+
+/**
+ * @brief Lock serializing every libfaust compiler call of the server
+ * (C++ generation, SVG, JIT factories)
+ */
+std::mutex &libfaustMutex();
+
+#endif
@@ -0,0 +1,41 @@
+#include "ServerStatsTool.hh"
+#include "stats.hh"
+
+// Returns the tool name for MCP registration
+std::string ServerStatsTool::name() const { return "ServerStatsTool"; }
+
+// Returns the tool description and schema for MCP
+std::string ServerStatsTool::describe() const {
+  // Build tool description using JSON object
+  json description = {
+      {"name", name()},
+      {"description",
+       "Returns timing statistics of the server as JSON: per tool and per "
+       "processing stage (Faust compiler, g++, generator runs, JIT "
+       "compilation, synthesis, analysis, PNG encoding), the number of "
+       "calls, total, mean, min, p50, p95, p99 and max durations in "
+       "milliseconds, and the CPU time of child processes."},
+      {"inputSchema",
+       {{"type", "object"},
+        {"properties",
+         {{"reset",
+           {{"type", "boolean"},
+            {"description", "Clear the statistics after reading them"},
+            {"default", false}}}}},
+        {"required", json::array()}}}};
+
+  return description.dump();
+}
+
+// Returns the statistics recorded since the start (or the last reset)
+json ServerStatsTool::call(const std::string &args,
+                           const CancellationToken &) {
+  try {
+    json arguments = json::parse(args);
+    json stats = statsSnapshot(arguments.value("reset", false));
+    return json::array({{{"type", "text"}, {"text", stats.dump()}}});
+  } catch (const json::exception &e) {
+    return json::array(
+        {{{"type", "text"}, {"text", "Error: Invalid arguments"}}});
+  }
+}
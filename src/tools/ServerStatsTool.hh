@@ -0,0 +1,11 @@
+#pragma once
+
+#include "mcpTool.hh"
+
+class ServerStatsTool : public McpTool {
+public:
+  std::string name() const override;
+  std::string describe() const override;
+  json call(const std::string &args,
+            const CancellationToken &cancel) override;
+};
@@ -0,0 +1,62 @@
+#include "architecture.hh"
+#include "FaustBackend.hh"
+
+bool buildArchitectureProgram(const std::string &srcCode,
+                              const std::string &archName,
+                              const std::vector<std::string> &libs,
+                              const std::string &stage,
+                              const ScratchDir &work,
+                              const CancellationToken &cancel,
+                              const ProcessLimits &faustLimits,
+                              const ProcessLimits &cxxLimits, json &error) {
+  std::string archDir = configValue("arch_dir", ARCH_DIR);
+  std::string dspName = stage + "_source.dsp";
+  std::string cppName = stage + "_source.cpp";
+
+  // Step 1: Compile DSP to C++ with the architecture file
+  // The complete C++ file is written to the request directory
+  auto result = faustBackend().compileWithArchitecture(
+      srcCode, dspName, archDir + "/" + archName, cppName, work, cancel,
+      faustLimits);
+
+  if (limitExceeded(result)) {
+    error = limitErrorContent(stage + "_faust", result, faustLimits);
+    return false;
+  }
+
+  if (result.exitCode != 0) {
+    error = json::array(
+        {{{"type", "text"},
+          {"text", "Error: Faust compilation failed: " + result.errorOutput}}});
+    return false;
+  }
+
+  // Step 2: Compile C++ to executable using g++ in the MCP container
+  // (the architecture includes the headers installed next to it)
+  std::vector<std::string> compileCmd = {
+      "g++", work.file(cppName), "-o", work.file(stage + "_exe"), "-std=c++11",
+      "-O3", "-I" + archDir, "-I/usr/local/include", "-L/usr/local/lib"};
+  compileCmd.insert(compileCmd.end(), libs.begin(), libs.end());
+  compileCmd.push_back("-lm");
+
+  ProcessResult compileRun = runProcess(compileCmd, cancel, cxxLimits);
+  if (limitExceeded(compileRun)) {
+    error = limitErrorContent(stage + "_cxx", compileRun, cxxLimits);
+    return false;
+  }
+  if (compileRun.exitCode < 0 && !compileRun.cancelled) {
+    error = json::array({{{"type", "text"},
+                          {"text", "Error: Could not execute g++ compiler"}}});
+    return false;
+  }
+
+  if (compileRun.exitCode != 0) {
+    error = json::array(
+        {{{"type", "text"},
+          {"text", "Error: C++ compilation failed: " + compileRun.output +
+                       compileRun.errorOutput}}});
+    return false;
+  }
+
+  return true;
+}
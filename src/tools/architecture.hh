@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+#include "process.hh"
+#include "utils.hh"
+
+using json = nlohmann::json;
+
+// ============================================================================
+// Architecture Programs
+// ============================================================================
+
+/**
+ * @brief Build the executable of a DSP with one of the server's
+ * architecture files
+ *
+ * The source is compiled by the Faust backend with arch_dir/<archName>
+ * (stage "<stage>_faust") into <stage>_source.cpp, then g++ -O3 builds
+ * the executable <stage>_exe in the request directory (stage
+ * "<stage>_cxx"), with arch_dir on the include path for the shared
+ * architecture headers.
+ *
+ * @param libs Additional link options, e.g. {"-lfftw3f", "-lpng"}
+ * @param error MCP error content when the build fails
+ * @return true if the executable was built
+ */
+bool buildArchitectureProgram(const std::string &srcCode,
+                              const std::string &archName,
+                              const std::vector<std::string> &libs,
+                              const std::string &stage,
+                              const ScratchDir &work,
+                              const CancellationToken &cancel,
+                              const ProcessLimits &faustLimits,
+                              const ProcessLimits &cxxLimits, json &error);
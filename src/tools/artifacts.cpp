@@ -0,0 +1,640 @@
+#include "artifacts.hh"
+#include "config.hh"
+#include "utils.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef FAUST_MCP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+// Beginning of a text artifact shown in the tools/call response
+static const size_t PREVIEW_BYTES = 1024;
+
+// Reads an integer setting
+static long intSetting(const std::string &key, long defaultValue) {
+  std::string value = configValue(key, std::to_string(defaultValue));
+  return value.empty() ? defaultValue : std::atol(value.c_str());
+}
+
+// File extension of the artifacts of a MIME type
+static std::string mimeExtension(const std::string &mimeType) {
+  static const std::map<std::string, std::string> extensions = {
+      {"text/x-c++src", "cpp"},
+      {"image/svg+xml", "svg"},
+      {"image/png", "png"},
+      {"audio/wav", "wav"},
+      {"audio/flac", "flac"},
+      {"application/x-faust-spectrogram-matrix", "fspm"},
+      {"application/json", "json"},
+      {"text/plain", "txt"}};
+  auto it = extensions.find(mimeType);
+  return (it != extensions.end()) ? it->second : "bin";
+}
+
+// Prefix of the artifact names of a tool, e.g. "spectrogram" for
+// FaustSpectrogramTool
+static std::string artifactPrefix(const std::string &tool) {
+  std::string prefix = tool;
+  if (prefix.compare(0, 5, "Faust") == 0) {
+    prefix.erase(0, 5);
+  }
+  if (prefix.size() > 4 &&
+      prefix.compare(prefix.size() - 4, 4, "Tool") == 0) {
+    prefix.erase(prefix.size() - 4);
+  }
+  for (char &c : prefix) {
+    c = std::tolower((unsigned char)c);
+  }
+  return prefix.empty() ? "output" : prefix;
+}
+
+// 64-bit FNV-1a hash of a content (contents with the same hash and size
+// are compared before they are shared, see ArtifactStore::sameContent())
+static uint64_t contentHash(const unsigned char *data, size_t size) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= data[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+// An open file mapped in memory, unmapped on destruction
+class MappedFile {
+public:
+  explicit MappedFile(int fd) {
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+      return;
+    }
+    fSize = st.st_size;
+    if (fSize > 0) {
+      void *map = mmap(nullptr, fSize, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map == MAP_FAILED) {
+        return;
+      }
+      madvise(map, fSize, MADV_SEQUENTIAL);
+      fData = (const unsigned char *)map;
+    }
+    fValid = true;
+  }
+  ~MappedFile() {
+    if (fData) {
+      munmap((void *)fData, fSize);
+    }
+  }
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool valid() const { return fValid; }
+  const unsigned char *data() const { return fData; }
+  size_t size() const { return fSize; }
+
+private:
+  const unsigned char *fData = nullptr;
+  size_t fSize = 0;
+  bool fValid = false;
+};
+
+// Writes a content to a file, gzip-compressed or not
+static bool writeContent(const std::string &path, const unsigned char *data,
+                         size_t size, bool compress) {
+#ifdef FAUST_MCP_HAVE_ZLIB
+  if (compress) {
+    gzFile file = gzopen(path.c_str(), "wb");
+    if (!file) {
+      return false;
+    }
+    // gzwrite() takes an unsigned count
+    bool written = true;
+    for (size_t done = 0; written && done < size;) {
+      unsigned chunk = (unsigned)std::min<size_t>(size - done, 1 << 20);
+      written = gzwrite(file, data + done, chunk) == (int)chunk;
+      done += chunk;
+    }
+    return gzclose(file) == Z_OK && written;
+  }
+#endif
+  std::ofstream file(path, std::ios::binary);
+  file.write((const char *)data, size);
+  file.close();
+  return !file.fail();
+}
+
+// Reads a range of the content of an artifact (clipped to its size)
+static bool readContent(const Artifact &artifact, size_t offset,
+                        size_t length, std::string &bytes) {
+  offset = std::min(offset, artifact.size);
+  length = std::min(length, artifact.size - offset);
+  bytes.assign(length, '\0');
+#ifdef FAUST_MCP_HAVE_ZLIB
+  if (artifact.compressed) {
+    gzFile file = gzopen(artifact.path.c_str(), "rb");
+    if (!file) {
+      return false;
+    }
+    // Seeking forward decompresses up to the offset
+    bool read = gzseek(file, (z_off_t)offset, SEEK_SET) == (z_off_t)offset;
+    for (size_t done = 0; read && done < length;) {
+      unsigned chunk = (unsigned)std::min<size_t>(length - done, 1 << 20);
+      read = gzread(file, &bytes[done], chunk) == (int)chunk;
+      done += chunk;
+    }
+    gzclose(file);
+    return read;
+  }
+#endif
+  std::ifstream file(artifact.path, std::ios::binary);
+  file.seekg(offset);
+  file.read(&bytes[0], length);
+  return file.gcount() == (std::streamsize)length;
+}
+
+// The stored artifacts, in a directory of the work directory removed when
+// the server exits. Contents are files named by their hash and size, with
+// a count of the artifacts that refer to them. Artifacts are stored in two
+// steps: their contents (storeValue(), storeFile()), then the artifacts
+// themselves, listed together as a group (add()), e.g. the outputs of one
+// tool call or a diagram set.
+class ArtifactStore {
+public:
+  // An artifact and the content file it refers to
+  struct Entry {
+    Artifact artifact;
+    std::string key;  ///< of its Content
+    size_t group = 0; ///< artifacts added together
+  };
+
+  ArtifactStore()
+      : fDir("artifacts"),
+        fTtl(std::chrono::seconds(intSetting("artifact_ttl", ARTIFACT_TTL))),
+        fMaxBytes((size_t)intSetting("artifact_max_mb", ARTIFACT_MAX_MB) *
+                  1024 * 1024) {
+#ifdef FAUST_MCP_HAVE_ZLIB
+    fCompress = intSetting("artifact_gzip", ARTIFACT_GZIP) != 0;
+#endif
+  }
+
+  bool valid() const { return fDir.valid(); }
+
+  // Unique id, for the URIs of artifacts and diagram sets
+  std::string nextId() {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return std::to_string(++fLastId);
+  }
+
+  // Unique temporary file of the store directory
+  std::string tempPath() {
+    std::lock_guard<std::mutex> lock(fMutex);
+    return fDir.file("tmp-" + std::to_string(++fLastTemp));
+  }
+
+  // Stores a value of a tool result: a text string, or the placeholder of
+  // a streamed value (see StreamedContent), copied to a temporary file
+  std::optional<Entry> storeValue(Artifact artifact, const json &value,
+                                  const StreamedContent &streamed) {
+    if (value.is_string()) {
+      const std::string &bytes = value.get_ref<const std::string &>();
+      return storeContent(std::move(artifact),
+                          (const unsigned char *)bytes.data(), bytes.size());
+    }
+    std::string temp = tempPath();
+    int fd = open(temp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    std::optional<Entry> stored;
+    if (fd >= 0 && streamed.copy(value, fd)) {
+      MappedFile content(fd);
+      if (content.valid()) {
+        stored = storeContent(std::move(artifact), content.data(),
+                              content.size());
+      }
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+    std::remove(temp.c_str());
+    return stored;
+  }
+
+  // Stores the content of a file
+  std::optional<Entry> storeFile(Artifact artifact, const std::string &path) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    std::optional<Entry> stored;
+    MappedFile content(fd);
+    if (content.valid()) {
+      stored = storeContent(std::move(artifact), content.data(),
+                            content.size());
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+    return stored;
+  }
+
+  // Lists artifacts whose contents are stored, as one group: they expire
+  // together, and the store only removes a group before it expires to
+  // make room for a newer one, as a whole
+  void add(std::vector<Entry> entries) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    size_t group = ++fLastGroup;
+    auto expires = Clock::now() + fTtl;
+    for (auto &entry : entries) {
+      entry.artifact.expires = expires;
+      entry.group = group;
+      fEntries.push_back(std::move(entry));
+    }
+    prune();
+  }
+
+  std::vector<Artifact> list() {
+    std::lock_guard<std::mutex> lock(fMutex);
+    prune();
+    std::vector<Artifact> artifacts;
+    for (const auto &entry : fEntries) {
+      artifacts.push_back(entry.artifact);
+    }
+    return artifacts;
+  }
+
+  std::optional<Artifact> find(const std::string &uri) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    prune();
+    for (const auto &entry : fEntries) {
+      if (entry.artifact.uri == uri) {
+        return entry.artifact;
+      }
+    }
+    return std::nullopt;
+  }
+
+private:
+  struct Content {
+    std::string path;
+    size_t storedSize; ///< size of the file (compressed)
+    int references;
+  };
+
+  // Whether a content file holds these bytes: contents with the same hash
+  // are compared, as FNV-1a collisions are easy to make
+  bool sameContent(const std::string &path, const unsigned char *data,
+                   size_t size) const {
+    if (fCompress) {
+      Artifact stored;
+      stored.path = path;
+      stored.size = size;
+      stored.compressed = true;
+      std::string bytes;
+      return readContent(stored, 0, size, bytes) &&
+             (size == 0 || memcmp(bytes.data(), data, size) == 0);
+    }
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    MappedFile content(fd);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return content.valid() && content.size() == size &&
+           (size == 0 || memcmp(content.data(), data, size) == 0);
+  }
+
+  // Stores the content of an artifact: an existing content file with the
+  // same bytes is shared, a new one is written (without the lock, calls
+  // store concurrently) and renamed to its final name. The content counts
+  // the artifact as a reference from now on; the artifact is listed by
+  // add().
+  std::optional<Entry> storeContent(Artifact artifact,
+                                    const unsigned char *data, size_t size) {
+    if (!fDir.valid()) {
+      return std::nullopt;
+    }
+    char hash[17];
+    std::snprintf(hash, sizeof(hash), "%016llx",
+                  (unsigned long long)contentHash(data, size));
+    std::string base = std::string(hash) + "-" + std::to_string(size);
+    artifact.size = size;
+    artifact.compressed = fCompress;
+
+    std::string temp;
+    bool known;
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      known = fContents.count(base) > 0;
+    }
+    if (!known) {
+      temp = tempPath();
+      if (!writeContent(temp, data, size, fCompress)) {
+        std::remove(temp.c_str());
+        return std::nullopt;
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(fMutex);
+    // A content with the same hash and size but other bytes (a collision)
+    // gets the next key: <base>-1, <base>-2...
+    std::string key = base;
+    auto content = fContents.find(key);
+    for (int n = 1; content != fContents.end() &&
+                    !sameContent(content->second.path, data, size);
+         n++) {
+      key = base + "-" + std::to_string(n);
+      content = fContents.find(key);
+    }
+    artifact.path = fDir.file(key + (fCompress ? ".gz" : ""));
+    if (content == fContents.end()) {
+      // (known but removed since it was looked up, or a collision: written
+      // now, under the lock)
+      bool written = true;
+      if (temp.empty()) {
+        temp = fDir.file("tmp-" + std::to_string(++fLastTemp));
+        written = writeContent(temp, data, size, fCompress);
+      }
+      if (!written ||
+          std::rename(temp.c_str(), artifact.path.c_str()) != 0) {
+        std::remove(temp.c_str());
+        return std::nullopt;
+      }
+      struct stat st;
+      size_t storedSize = stat(artifact.path.c_str(), &st) == 0 ? st.st_size
+                                                                 : size;
+      content = fContents.emplace(key, Content{artifact.path, storedSize, 0})
+                    .first;
+      fStoredBytes += storedSize;
+    } else if (!temp.empty()) {
+      // Written concurrently by another call
+      std::remove(temp.c_str());
+    }
+    content->second.references++;
+    return Entry{std::move(artifact), key, 0};
+  }
+
+  // Drops an artifact's reference to its content, removing the content
+  // file when it was the last one
+  void release(const Entry &entry) {
+    auto content = fContents.find(entry.key);
+    if (--content->second.references == 0) {
+      std::remove(content->second.path.c_str());
+      fStoredBytes -= content->second.storedSize;
+      fContents.erase(content);
+    }
+  }
+
+  // Removes the expired artifacts, then, while the content files are over
+  // the size of the store, the oldest groups of artifacts, as a whole (the
+  // last group added is kept), under the lock
+  void prune() {
+    auto now = Clock::now();
+    for (size_t i = 0; i < fEntries.size();) {
+      if (fEntries[i].artifact.expires > now) {
+        i++;
+        continue;
+      }
+      release(fEntries[i]);
+      fEntries.erase(fEntries.begin() + i);
+    }
+    while (fStoredBytes > fMaxBytes && !fEntries.empty() &&
+           fEntries.front().group != fLastGroup) {
+      size_t group = fEntries.front().group;
+      for (size_t i = 0; i < fEntries.size();) {
+        if (fEntries[i].group != group) {
+          i++;
+          continue;
+        }
+        release(fEntries[i]);
+        fEntries.erase(fEntries.begin() + i);
+      }
+    }
+  }
+
+  ScratchDir fDir;
+  Clock::duration fTtl;
+  size_t fMaxBytes;
+  bool fCompress = false;
+  std::mutex fMutex;
+  std::vector<Entry> fEntries; ///< oldest first
+  std::map<std::string, Content> fContents;
+  size_t fStoredBytes = 0;
+  size_t fLastId = 0;
+  size_t fLastTemp = 0;
+  size_t fLastGroup = 0;
+};
+
+static ArtifactStore &artifactStore() {
+  static ArtifactStore store;
+  return store;
+}
+
+json Artifact::toJson() const {
+  return {{"uri", uri}, {"name", name}, {"mimeType", mimeType},
+          {"size", size}};
+}
+
+bool resultsByReference() {
+  return configValue("result_mode", RESULT_MODE) == "reference";
+}
+
+// Beginning of a text artifact, up to the last line break that fits
+static std::string head(const Artifact &artifact) {
+  std::string text;
+  readContent(artifact, 0, PREVIEW_BYTES, text);
+  if (text.size() < artifact.size) {
+    size_t lineEnd = text.find_last_of('\n');
+    if (lineEnd != std::string::npos && lineEnd >= text.size() / 2) {
+      text.resize(lineEnd + 1);
+    }
+  }
+  return text;
+}
+
+// How to read an artifact
+static std::string readHint(const Artifact &artifact) {
+  return std::to_string(artifact.size) +
+         " bytes, read with resources/read (whole, or a range of bytes with "
+         "offset and length)";
+}
+
+// Content items standing for a stored artifact: a resource_link (since
+// 2025-06-18), preceded for text by its beginning; or, for clients of
+// 2024-11-05, which have no resource_link, an embedded resource with the
+// URI of the artifact and, as text, its beginning (text) or how to read it
+static void appendLink(json &linked, const Artifact &artifact) {
+  if (!protocolAtLeast("2025-06-18")) {
+    json resource = {{"uri", artifact.uri}};
+    if (artifact.text) {
+      linked.push_back({{"type", "text"},
+                        {"text", artifact.name + ": " + readHint(artifact) +
+                                     ", beginning below"}});
+      resource["mimeType"] = artifact.mimeType;
+      resource["text"] = head(artifact);
+    } else {
+      resource["mimeType"] = "text/plain";
+      resource["text"] = artifact.name + " (" + artifact.mimeType +
+                         "): " + readHint(artifact);
+    }
+    linked.push_back({{"type", "resource"}, {"resource", resource}});
+    return;
+  }
+
+  if (artifact.text) {
+    std::string text = head(artifact);
+    linked.push_back({{"type", "text"},
+                      {"text", "Beginning of " + artifact.name + " (" +
+                                   std::to_string(text.size()) + " of " +
+                                   std::to_string(artifact.size) +
+                                   " bytes):\n" + text}});
+  }
+  json link = artifact.toJson();
+  link["type"] = "resource_link";
+  link["description"] = readHint(artifact);
+  linked.push_back(std::move(link));
+}
+
+json linkArtifacts(const std::string &tool, json content,
+                   const StreamedContent &streamed) {
+  if (!content.is_array()) {
+    return content;
+  }
+  size_t inlineMax =
+      (size_t)intSetting("inline_max_kb", INLINE_MAX_KB) * 1024;
+  std::string prefix = artifactPrefix(tool);
+  std::vector<ArtifactStore::Entry> stored;
+
+  json linked = json::array();
+  for (auto &item : content) {
+    // Value of the item that may be moved: resource text or blob, image
+    // or audio data (only streamed values for the base64 ones)
+    json *value = nullptr;
+    bool text = false;
+    std::string mimeType;
+    std::string type = item.is_object() ? item.value("type", "") : "";
+    if (type == "resource" && item.contains("resource") &&
+        item["resource"].is_object()) {
+      json &resource = item["resource"];
+      text = resource.contains("text");
+      if (text || resource.contains("blob")) {
+        value = &resource[text ? "text" : "blob"];
+      }
+      mimeType = resource.value("mimeType", "");
+    } else if ((type == "image" || type == "audio") &&
+               item.contains("data")) {
+      value = &item["data"];
+      mimeType = item.value("mimeType", "");
+    }
+    size_t size = 0;
+    if (value && value->is_string() && text) {
+      size = value->get_ref<const std::string &>().size();
+    } else if (value) {
+      size = streamed.size(*value);
+    }
+    if (size <= inlineMax) {
+      linked.push_back(std::move(item));
+      continue;
+    }
+
+    Artifact artifact;
+    artifact.name = prefix +
+                    (stored.empty() ? ""
+                                    : "-" + std::to_string(stored.size())) +
+                    "." +
+                    mimeExtension(mimeType);
+    artifact.uri = "faust-mcp://artifacts/" + artifactStore().nextId() + "/" +
+                   artifact.name;
+    artifact.mimeType = mimeType;
+    artifact.text = text;
+    auto entry =
+        artifactStore().storeValue(std::move(artifact), *value, streamed);
+    if (!entry) {
+      // No store: the value stays inline
+      linked.push_back(std::move(item));
+      continue;
+    }
+    appendLink(linked, entry->artifact);
+    stored.push_back(std::move(*entry));
+  }
+  // The artifacts of a result are kept (and expire) together
+  if (!stored.empty()) {
+    artifactStore().add(std::move(stored));
+  }
+  return linked;
+}
+
+std::string diagramUri(const std::string &set, const std::string &name) {
+  return "faust-mcp://diagrams/" + set + "/" + name;
+}
+
+std::string storeDiagrams(const std::string &dir,
+                          std::vector<std::string> &names) {
+  names.clear();
+  ArtifactStore &store = artifactStore();
+  DIR *directory = opendir(dir.c_str());
+  if (!store.valid() || !directory) {
+    if (directory) {
+      closedir(directory);
+    }
+    return "";
+  }
+  std::vector<std::string> files;
+  while (struct dirent *entry = readdir(directory)) {
+    std::string name = entry->d_name;
+    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".svg") == 0) {
+      files.push_back(name);
+    }
+  }
+  closedir(directory);
+  std::sort(files.begin(), files.end(),
+            [](const std::string &a, const std::string &b) {
+              return (a == "process.svg") != (b == "process.svg")
+                         ? a == "process.svg"
+                         : a < b;
+            });
+
+  // Listed as one group once all its diagrams are stored: the set is
+  // fetched, then expires or is removed, as a whole
+  std::string set = store.nextId();
+  std::vector<ArtifactStore::Entry> entries;
+  for (const auto &name : files) {
+    Artifact artifact;
+    artifact.uri = diagramUri(set, name);
+    artifact.name = name;
+    artifact.mimeType = "image/svg+xml";
+    artifact.text = true;
+    auto entry = store.storeFile(std::move(artifact), dir + "/" + name);
+    if (entry) {
+      entries.push_back(std::move(*entry));
+      names.push_back(name);
+    }
+  }
+  store.add(std::move(entries));
+  return set;
+}
+
+std::vector<Artifact> listArtifacts() { return artifactStore().list(); }
+
+std::optional<Artifact> findArtifact(const std::string &uri) {
+  return artifactStore().find(uri);
+}
+
+json artifactContent(const Artifact &artifact, size_t offset, size_t length) {
+  StreamEncoding encoding =
+      artifact.text ? StreamEncoding::Text : StreamEncoding::Base64;
+  if (!artifact.compressed) {
+    return streamFile(artifact.path, encoding, offset, length);
+  }
+  std::string bytes;
+  if (!readContent(artifact, offset, length, bytes)) {
+    return json();
+  }
+  return streamBytes(std::move(bytes), encoding);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+#include "jsonrpc.hh"
+
+using json = nlohmann::json;
+
+// ============================================================================
+// Artifact Store
+// ============================================================================
+
+// Tool outputs kept by the server as MCP resources, read with
+// resources/read (whole or by byte range):
+// - with result_mode = reference, the large outputs of the tools (generated
+//   code, diagrams, images, matrices, audio) are not inlined in the
+//   tools/call response, which holds a resource_link to each one with a
+//   short preview
+// - the SVG diagrams generated by FaustSVGTool with keep_diagrams (the
+//   default in reference mode), so that sub-diagrams can be fetched without
+//   generating them again
+// Contents are stored once per distinct content (files named by a hash of
+// the content, shared by the artifacts that have the same bytes),
+// gzip-compressed with artifact_gzip. The artifacts of a tool result, or
+// of a diagram set, are kept together: they expire artifact_ttl seconds
+// after they were stored, and the oldest groups are also removed, as a
+// whole, when the files exceed artifact_max_mb.
+
+/**
+ * @brief A stored tool output
+ */
+struct Artifact {
+  std::string uri;      ///< faust-mcp://artifacts/<id>/<name>, or
+                        ///< faust-mcp://diagrams/<set>/<name>
+  std::string name;     ///< e.g. "spectrogram.png"
+  std::string mimeType;
+  bool text = false;    ///< read as text, otherwise as a base64 blob
+  size_t size = 0;      ///< bytes (uncompressed)
+  std::string path;     ///< content file in the store directory
+  bool compressed = false; ///< path is gzip-compressed
+  std::chrono::steady_clock::time_point expires;
+
+  // uri, name, mimeType and size, as in resources/list
+  json toJson() const;
+};
+
+/**
+ * @brief Whether tool results are returned by reference
+ *        (result_mode = reference, default inline)
+ */
+bool resultsByReference();
+
+/**
+ * @brief Replaces the large values of a tool result by links to artifacts
+ *
+ * Resource text and blobs, and image and audio data, of more than
+ * inline_max_kb (default 64) are moved to the store; each such item is
+ * replaced by a resource_link, preceded by a text item with the beginning
+ * of the artifact for text. Protocol 2024-11-05 has no resource_link: the
+ * item is then an embedded resource with the URI of the artifact and its
+ * beginning (text) or how to read it. Other items are left as they are.
+ * @param tool Name of the tool, used to name the artifacts
+ * @param streamed Sources of the streamed values of content
+ */
+json linkArtifacts(const std::string &tool, json content,
+                   const StreamedContent &streamed);
+
+/**
+ * @brief Stores the SVG files of a directory as a diagram set, kept (and
+ *        expired) as a whole
+ * @param names Names of the stored files, process.svg first
+ * @return Id of the set, empty if the store is not available
+ */
+std::string storeDiagrams(const std::string &dir,
+                          std::vector<std::string> &names);
+
+/**
+ * @brief URI of a diagram of a set
+ */
+std::string diagramUri(const std::string &set, const std::string &name);
+
+/**
+ * @brief The artifacts that have not expired, oldest first
+ */
+std::vector<Artifact> listArtifacts();
+
+/**
+ * @brief An artifact by URI (none if unknown or expired)
+ */
+std::optional<Artifact> findArtifact(const std::string &uri);
+
+/**
+ * @brief Placeholder of a range of the content of an artifact (null if it
+ *        cannot be read), see StreamedContent
+ *
+ * Plain files are streamed from the file; compressed ones are decompressed
+ * first. offset and length count bytes, for text artifacts too: a range may
+ * begin or end inside a UTF-8 sequence, whose bytes JsonWriter then writes
+ * as U+FFFD.
+ */
+json artifactContent(const Artifact &artifact, size_t offset = 0,
+                     size_t length = SIZE_MAX);
@@ -0,0 +1,444 @@
+/************************************************************************
+ FAUST Architecture File - Audio Encoding
+ Copyright (C) 2026 Yann Orlarey
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************
+ ************************************************************************/
+
+/*
+ Encodes planar float audio (one buffer per channel, [-1, 1]) as 16 or
+ 24-bit PCM, in a WAV or FLAC container, into a byte buffer. No external
+ library: FLAC frames use fixed predictors (order 0-4) with Rice-coded
+ residuals, each channel coded independently, no MD5 signature.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//==============================================================================
+// PCM Conversion
+//==============================================================================
+
+// Float sample to signed integer PCM (clipped)
+inline int32_t quantizeSample(float value, int bits) {
+  float scale = (float)((1 << (bits - 1)) - 1);
+  value = std::max(-1.0f, std::min(1.0f, value));
+  return (int32_t)std::lrint(value * scale);
+}
+
+// Appends an unsigned integer in little-endian byte order
+inline void appendLE(std::vector<unsigned char> &out, uint32_t value,
+                     int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    out.push_back((unsigned char)((value >> (8 * i)) & 0xFF));
+  }
+}
+
+//==============================================================================
+// WAV
+//==============================================================================
+
+// Largest data chunk of a WAV file: the RIFF chunk size (36 + data size)
+// is a 32-bit field
+const uint64_t WAV_MAX_DATA_SIZE = 0xFFFFFFFFull - 36;
+
+// Returns false, without writing anything, when the samples do not fit in
+// a WAV file (WAV_MAX_DATA_SIZE)
+inline bool encodeWAV(const std::vector<std::vector<float>> &channels,
+                      int sample_rate, int bits,
+                      std::vector<unsigned char> &out) {
+  uint64_t size = (uint64_t)(channels.empty() ? 0 : channels[0].size()) *
+                  channels.size() * (bits / 8);
+  if (size > WAV_MAX_DATA_SIZE) {
+    return false;
+  }
+  uint32_t num_channels = channels.size();
+  uint32_t num_frames = channels.empty() ? 0 : channels[0].size();
+  uint32_t bytes_per_sample = bits / 8;
+  uint32_t data_size = (uint32_t)size;
+
+  out.clear();
+  out.reserve(44 + data_size);
+
+  // RIFF header
+  out.insert(out.end(), {'R', 'I', 'F', 'F'});
+  appendLE(out, 36 + data_size, 4);
+  out.insert(out.end(), {'W', 'A', 'V', 'E'});
+
+  // Format chunk (integer PCM)
+  out.insert(out.end(), {'f', 'm', 't', ' '});
+  appendLE(out, 16, 4);
+  appendLE(out, 1, 2);
+  appendLE(out, num_channels, 2);
+  appendLE(out, sample_rate, 4);
+  appendLE(out, (uint32_t)sample_rate * num_channels * bytes_per_sample, 4);
+  appendLE(out, num_channels * bytes_per_sample, 2);
+  appendLE(out, bits, 2);
+
+  // Interleaved samples
+  out.insert(out.end(), {'d', 'a', 't', 'a'});
+  appendLE(out, data_size, 4);
+  for (uint32_t i = 0; i < num_frames; i++) {
+    for (uint32_t c = 0; c < num_channels; c++) {
+      appendLE(out, (uint32_t)quantizeSample(channels[c][i], bits),
+               bytes_per_sample);
+    }
+  }
+  return true;
+}
+
+//==============================================================================
+// FLAC
+//==============================================================================
+
+// Samples per FLAC frame
+const int FLAC_BLOCK_SIZE = 4096;
+
+// Highest sample rate of a FLAC stream: STREAMINFO has 20 bits, but a
+// frame header codes at most 655350 Hz (in tens of Hz), the limit that
+// decoders may assume
+const int FLAC_MAX_SAMPLE_RATE = 655350;
+
+// Big-endian bit writer
+class FlacBitWriter {
+public:
+  explicit FlacBitWriter(std::vector<unsigned char> &out)
+      : fOut(out), fAccumulator(0), fBits(0) {}
+
+  // Writes the 'bits' low bits of value (bits <= 32)
+  void write(uint32_t value, int bits) {
+    if (bits == 0) {
+      return;
+    }
+    fAccumulator = (fAccumulator << bits) |
+                   (bits == 32 ? value : (value & ((1u << bits) - 1)));
+    fBits += bits;
+    while (fBits >= 8) {
+      fBits -= 8;
+      fOut.push_back((unsigned char)(fAccumulator >> fBits));
+    }
+  }
+
+  // Unary code: 'count' zeros followed by a one
+  void writeUnary(uint32_t count) {
+    while (count >= 32) {
+      write(0, 32);
+      count -= 32;
+    }
+    write(1, count + 1);
+  }
+
+  // Pads with zeros up to the next byte boundary
+  void align() {
+    if (fBits > 0) {
+      write(0, 8 - fBits);
+    }
+  }
+
+private:
+  std::vector<unsigned char> &fOut;
+  uint64_t fAccumulator;
+  int fBits;
+};
+
+inline uint8_t flacCRC8(const unsigned char *data, size_t size) {
+  uint8_t crc = 0;
+  for (size_t i = 0; i < size; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+inline uint16_t flacCRC16(const unsigned char *data, size_t size) {
+  uint16_t crc = 0;
+  for (size_t i = 0; i < size; i++) {
+    crc ^= (uint16_t)(data[i] << 8);
+    for (int b = 0; b < 8; b++) {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x8005)
+                           : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+// Residual of the fixed polynomial predictor of the given order at index i
+inline int64_t flacFixedResidual(const int32_t *x, int i, int order) {
+  switch (order) {
+  case 0:
+    return x[i];
+  case 1:
+    return (int64_t)x[i] - x[i - 1];
+  case 2:
+    return (int64_t)x[i] - 2 * (int64_t)x[i - 1] + x[i - 2];
+  case 3:
+    return (int64_t)x[i] - 3 * (int64_t)x[i - 1] + 3 * (int64_t)x[i - 2] -
+           x[i - 3];
+  default:
+    return (int64_t)x[i] - 4 * (int64_t)x[i - 1] + 6 * (int64_t)x[i - 2] -
+           4 * (int64_t)x[i - 3] + x[i - 4];
+  }
+}
+
+// Rice parameter minimizing the size of a partition, and that size in bits
+inline int flacRiceParameter(const uint32_t *folded, int count, int max_param,
+                             uint64_t &bits) {
+  uint64_t sum = 0;
+  for (int i = 0; i < count; i++) {
+    sum += folded[i];
+  }
+  int estimate = 0;
+  while (estimate < max_param && ((uint64_t)count << (estimate + 1)) <= sum) {
+    estimate++;
+  }
+
+  int best = estimate;
+  bits = UINT64_MAX;
+  for (int k = std::max(0, estimate - 1);
+       k <= std::min(max_param, estimate + 1); k++) {
+    uint64_t total = (uint64_t)count * (k + 1);
+    for (int i = 0; i < count; i++) {
+      total += folded[i] >> k;
+    }
+    if (total < bits) {
+      bits = total;
+      best = k;
+    }
+  }
+  return best;
+}
+
+// Writes one subframe (constant, fixed predictor or verbatim)
+inline void encodeFlacSubframe(FlacBitWriter &writer, const int32_t *x, int n,
+                               int bits) {
+  uint32_t mask = (bits == 32) ? 0xFFFFFFFFu : ((1u << bits) - 1);
+
+  // Constant signal
+  bool constant = true;
+  for (int i = 1; i < n && constant; i++) {
+    constant = (x[i] == x[0]);
+  }
+  if (constant) {
+    writer.write(0x00, 8);
+    writer.write((uint32_t)x[0] & mask, bits);
+    return;
+  }
+
+  // Predictor order with the smallest residual energy
+  int max_order = std::min(4, n - 1);
+  int order = 0;
+  uint64_t best_sum = UINT64_MAX;
+  for (int o = 0; o <= max_order; o++) {
+    uint64_t sum = 0;
+    for (int i = o; i < n; i++) {
+      int64_t r = flacFixedResidual(x, i, o);
+      sum += (uint64_t)(r < 0 ? -r : r);
+    }
+    if (sum < best_sum) {
+      best_sum = sum;
+      order = o;
+    }
+  }
+
+  // Zigzag-folded residuals
+  std::vector<uint32_t> folded(n, 0);
+  for (int i = order; i < n; i++) {
+    int64_t r = flacFixedResidual(x, i, order);
+    folded[i] = (uint32_t)(((uint64_t)r << 1) ^ (uint64_t)(r >> 63));
+  }
+
+  // Partition order (one Rice parameter per partition) giving the smallest
+  // size; Rice parameters above 14 need the 5-bit (RICE2) coding
+  int best_partition_order = 0;
+  uint64_t best_bits = UINT64_MAX;
+  bool best_rice2 = false;
+  std::vector<int> best_params;
+  for (int p = 0; p <= 8; p++) {
+    int partitions = 1 << p;
+    if (n % partitions != 0 || (n >> p) <= order) {
+      break;
+    }
+    std::vector<int> params(partitions);
+    uint64_t total = 0;
+    bool rice2 = false;
+    for (int part = 0; part < partitions; part++) {
+      int start = (part == 0) ? order : part * (n >> p);
+      int end = (part + 1) * (n >> p);
+      uint64_t part_bits;
+      params[part] =
+          flacRiceParameter(&folded[start], end - start, 30, part_bits);
+      rice2 = rice2 || params[part] > 14;
+      total += part_bits;
+    }
+    total += (uint64_t)partitions * (rice2 ? 5 : 4);
+    if (total < best_bits) {
+      best_bits = total;
+      best_partition_order = p;
+      best_rice2 = rice2;
+      best_params = params;
+    }
+  }
+
+  // Uncompressible signal
+  if (best_bits + (uint64_t)order * bits >= (uint64_t)n * bits) {
+    writer.write(0x02, 8);
+    for (int i = 0; i < n; i++) {
+      writer.write((uint32_t)x[i] & mask, bits);
+    }
+    return;
+  }
+
+  // Fixed predictor: type 001xxx, warm-up samples, residual
+  writer.write((uint32_t)((0x08 | order) << 1), 8);
+  for (int i = 0; i < order; i++) {
+    writer.write((uint32_t)x[i] & mask, bits);
+  }
+  writer.write(best_rice2 ? 1 : 0, 2);
+  writer.write(best_partition_order, 4);
+  int partitions = 1 << best_partition_order;
+  for (int part = 0; part < partitions; part++) {
+    int start = (part == 0) ? order : part * (n >> best_partition_order);
+    int end = (part + 1) * (n >> best_partition_order);
+    int k = best_params[part];
+    writer.write(k, best_rice2 ? 5 : 4);
+    for (int i = start; i < end; i++) {
+      writer.writeUnary(folded[i] >> k);
+      writer.write(folded[i], k);
+    }
+  }
+}
+
+// Returns false, without writing anything, when the stream cannot be coded
+// (1 to 8 channels, a sample rate up to FLAC_MAX_SAMPLE_RATE)
+inline bool encodeFLAC(const std::vector<std::vector<float>> &channels,
+                       int sample_rate, int bits,
+                       std::vector<unsigned char> &out) {
+  if (channels.empty() || channels.size() > 8 || sample_rate <= 0 ||
+      sample_rate > FLAC_MAX_SAMPLE_RATE) {
+    return false;
+  }
+  int num_channels = channels.size();
+  uint64_t num_frames = channels.empty() ? 0 : channels[0].size();
+
+  out.clear();
+  out.insert(out.end(), {'f', 'L', 'a', 'C'});
+
+  // STREAMINFO metadata block (last block), no frame sizes, no MD5
+  {
+    FlacBitWriter writer(out);
+    writer.write(0x80, 8);
+    writer.write(34, 24);
+    writer.write(FLAC_BLOCK_SIZE, 16);
+    writer.write(FLAC_BLOCK_SIZE, 16);
+    writer.write(0, 24);
+    writer.write(0, 24);
+    writer.write(sample_rate, 20);
+    writer.write(num_channels - 1, 3);
+    writer.write(bits - 1, 5);
+    writer.write((uint32_t)(num_frames >> 32), 4);
+    writer.write((uint32_t)num_frames, 32);
+    for (int i = 0; i < 4; i++) {
+      writer.write(0, 32);
+    }
+  }
+
+  int sample_size_code = (bits == 16) ? 4 : (bits == 24) ? 6 : 0;
+  std::vector<int32_t> samples(FLAC_BLOCK_SIZE);
+
+  uint32_t frame_number = 0;
+  for (uint64_t pos = 0; pos < num_frames;
+       pos += FLAC_BLOCK_SIZE, frame_number++) {
+    int n = (int)std::min<uint64_t>(FLAC_BLOCK_SIZE, num_frames - pos);
+    size_t frame_start = out.size();
+    FlacBitWriter writer(out);
+
+    // Frame header: sync code, fixed block size, 16-bit block size at the
+    // end of the header, sample rate from STREAMINFO, independent channels
+    writer.write(0xFFF8, 16);
+    writer.write(0x7, 4);
+    writer.write(0x0, 4);
+    writer.write(num_channels - 1, 4);
+    writer.write(sample_size_code, 3);
+    writer.write(0, 1);
+
+    // Frame number, UTF-8 coded
+    if (frame_number < 0x80) {
+      writer.write(frame_number, 8);
+    } else {
+      int extra = (frame_number < 0x800)       ? 1
+                  : (frame_number < 0x10000)   ? 2
+                  : (frame_number < 0x200000)  ? 3
+                  : (frame_number < 0x4000000) ? 4
+                                               : 5;
+      uint32_t lead = (0xFF00u >> (extra + 1)) & 0xFF;
+      writer.write(lead | (frame_number >> (6 * extra)), 8);
+      for (int i = extra - 1; i >= 0; i--) {
+        writer.write(0x80 | ((frame_number >> (6 * i)) & 0x3F), 8);
+      }
+    }
+    writer.write(n - 1, 16);
+    writer.write(flacCRC8(&out[frame_start], out.size() - frame_start), 8);
+
+    // One subframe per channel
+    for (int c = 0; c < num_channels; c++) {
+      for (int i = 0; i < n; i++) {
+        samples[i] = quantizeSample(channels[c][pos + i], bits);
+      }
+      encodeFlacSubframe(writer, samples.data(), n, bits);
+    }
+
+    writer.align();
+    uint16_t crc = flacCRC16(&out[frame_start], out.size() - frame_start);
+    writer.write(crc, 16);
+  }
+  return true;
+}
+
+//==============================================================================
+// Format Selection
+//==============================================================================
+
+// Encodes in "wav" or "flac" with 16 or 24 bits per sample (false if the
+// format or sample size is not supported, or the audio does not fit in
+// the format: more than 4 GiB of WAV data, more than 8 channels or a
+// sample rate over 655350 Hz in FLAC)
+inline bool encodeAudio(const std::string &format,
+                        const std::vector<std::vector<float>> &channels,
+                        int sample_rate, int bits,
+                        std::vector<unsigned char> &out) {
+  if (channels.empty() || (bits != 16 && bits != 24)) {
+    return false;
+  }
+  if (format == "wav") {
+    return encodeWAV(channels, sample_rate, bits, out);
+  }
+  if (format == "flac") {
+    return encodeFLAC(channels, sample_rate, bits, out);
+  }
+  return false;
+}
@@ -0,0 +1,395 @@
+/************************************************************************
+ FAUST Architecture File - Audio Features
+ Copyright (C) 2026 Yann Orlarey
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************
+ ************************************************************************/
+
+/*
+ Feature extraction of a rendered note: per-frame RMS, spectral centroid,
+ rolloff, flatness and fundamental estimate, computed in one pass over the
+ STFT frames, plus attack and release times around the gate edges. The
+ result is written as compact JSON without any JSON library, so that the
+ analyze.cpp architecture and the in-process engines of the MCP server
+ share it.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "spectrogram_analysis.hh"
+
+// Fraction of the spectral energy below the rolloff frequency
+const float ROLLOFF_FRACTION = 0.85f;
+
+// Frames quieter than this RMS have no spectral features (null)
+const float SILENCE_RMS = 1e-5f;
+
+// Fundamental search range (Hz) and lowest normalized autocorrelation of a
+// voiced frame
+const float F0_MIN = 40.0f;
+const float F0_MAX = 4000.0f;
+const float F0_MIN_CLARITY = 0.5f;
+
+// Samples per value of the envelope used for attack and release times
+const int ENVELOPE_BLOCK = 64;
+
+// Attack ends at this fraction of the peak level; release ends when the
+// level falls below this fraction of its value at gate off (-40 dB)
+const float ATTACK_FRACTION = 0.9f;
+const float RELEASE_FRACTION = 0.01f;
+
+// Features of one STFT frame (NAN when undefined: silent or unvoiced)
+struct FrameFeatures {
+  float time; // center of the frame, in seconds
+  float rms;
+  float centroid;
+  float rolloff;
+  float flatness;
+  float f0;
+};
+
+// Features of one analysed signal
+struct SignalFeatures {
+  std::string label;
+  std::vector<FrameFeatures> frames;
+  float peak_rms;
+  float peak_time;
+  float attack_time;  // from note start to ATTACK_FRACTION of the peak
+  float release_time; // from gate off to RELEASE_FRACTION of the level
+  float centroid;     // means over non-silent frames, weighted by RMS
+  float rolloff;
+  float flatness;
+  float f0; // median over voiced frames
+};
+
+// Circular autocorrelation of the window (normalizes the autocorrelation
+// of windowed frames, which is tapered by the window itself)
+inline std::vector<float> windowAutocorrelation(const std::vector<float> &window,
+                                                int max_lag) {
+  int n = window.size();
+  std::vector<float> ac(max_lag + 1, 0.0f);
+  for (int lag = 0; lag <= max_lag; lag++) {
+    double sum = 0;
+    for (int i = 0; i < n; i++) {
+      sum += window[i] * window[(i + lag) % n];
+    }
+    ac[lag] = sum;
+  }
+  return ac;
+}
+
+// Attack and release times from a block RMS envelope of the signal
+inline void envelopeTimes(const std::vector<float> &audio, int sample_rate,
+                          float gate_duration, SignalFeatures &features) {
+  std::vector<float> envelope;
+  for (size_t start = 0; start < audio.size(); start += ENVELOPE_BLOCK) {
+    size_t end = std::min(audio.size(), start + ENVELOPE_BLOCK);
+    double sum = 0;
+    for (size_t i = start; i < end; i++) {
+      sum += audio[i] * audio[i];
+    }
+    envelope.push_back(std::sqrt(sum / (end - start)));
+  }
+  float block_time = (float)ENVELOPE_BLOCK / sample_rate;
+  size_t gate_block =
+      std::min(envelope.size(), (size_t)(gate_duration / block_time));
+
+  features.attack_time = NAN;
+  float peak = 0;
+  for (size_t b = 0; b < gate_block; b++) {
+    peak = std::max(peak, envelope[b]);
+  }
+  for (size_t b = 0; b < gate_block && peak > SILENCE_RMS; b++) {
+    if (envelope[b] >= ATTACK_FRACTION * peak) {
+      features.attack_time = (b + 1) * block_time;
+      break;
+    }
+  }
+
+  features.release_time = NAN;
+  if (gate_block > 0 && gate_block < envelope.size()) {
+    float level = envelope[gate_block - 1];
+    for (size_t b = gate_block; b < envelope.size() && level > SILENCE_RMS;
+         b++) {
+      if (envelope[b] < RELEASE_FRACTION * level) {
+        features.release_time = (b - gate_block) * block_time;
+        break;
+      }
+    }
+  }
+}
+
+// Features of a signal: one pass over its STFT frames, each frame giving
+// its RMS (input samples), centroid, rolloff and flatness (magnitude
+// spectrum) and fundamental (autocorrelation, the inverse FFT of the power
+// spectrum, normalized by the window autocorrelation)
+inline SignalFeatures analyzeSignal(const std::vector<float> &audio,
+                                    const Options &opts,
+                                    const std::string &label) {
+  SignalFeatures features;
+  features.label = label;
+  int n = opts.fft_size;
+  int n_bins = n / 2 + 1;
+  float bin_hz = (float)opts.sample_rate / n;
+  std::vector<float> window = createWindow(n, opts.window_type);
+
+  int min_lag = std::max(2, (int)(opts.sample_rate / F0_MAX));
+  int max_lag = std::min(n / 2 - 1, (int)(opts.sample_rate / F0_MIN) + 1);
+  std::vector<float> window_ac = windowAutocorrelation(window, max_lag + 1);
+
+  fftwf_complex *power =
+      (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n_bins);
+  float *ac = (float *)fftwf_malloc(sizeof(float) * n);
+  fftwf_plan inverse;
+  {
+    std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+    inverse = fftwf_plan_dft_c2r_1d(n, power, ac, FFTW_ESTIMATE);
+  }
+
+  std::vector<float> normalized(max_lag + 2, 0.0f);
+  forEachSTFTFrame(
+      audio, n, opts.hop_size, window, opts.padding,
+      [&](int frame, const float *samples,
+          const std::vector<float> &magnitudes) {
+        FrameFeatures f;
+        f.time = (stftFrameStart(frame, n, opts.hop_size, opts.padding) +
+                  n / 2.0f) /
+                 opts.sample_rate;
+        double energy = 0;
+        for (int i = 0; i < n; i++) {
+          energy += samples[i] * samples[i];
+        }
+        f.rms = std::sqrt(energy / n);
+        f.centroid = f.rolloff = f.flatness = f.f0 = NAN;
+
+        if (f.rms > SILENCE_RMS) {
+          double sum = 0, weighted = 0, total_power = 0, log_power = 0;
+          for (int i = 0; i < n_bins; i++) {
+            double p = (double)magnitudes[i] * magnitudes[i];
+            sum += magnitudes[i];
+            weighted += magnitudes[i] * i * bin_hz;
+            total_power += p;
+            log_power += std::log(p + 1e-20);
+          }
+          f.centroid = weighted / sum;
+          f.flatness = std::exp(log_power / n_bins) /
+                       (total_power / n_bins + 1e-20);
+          double cumulated = 0;
+          for (int i = 0; i < n_bins; i++) {
+            cumulated += (double)magnitudes[i] * magnitudes[i];
+            if (cumulated >= ROLLOFF_FRACTION * total_power) {
+              f.rolloff = i * bin_hz;
+              break;
+            }
+          }
+
+          // Autocorrelation of the windowed frame
+          for (int i = 0; i < n_bins; i++) {
+            power[i][0] = magnitudes[i] * magnitudes[i];
+            power[i][1] = 0;
+          }
+          fftwf_execute(inverse);
+          for (int lag = 1; lag <= max_lag + 1; lag++) {
+            normalized[lag] = (ac[lag] / ac[0]) / (window_ac[lag] / window_ac[0]);
+          }
+
+          // Best peak, then the shortest lag with a peak almost as high
+          // (avoids octave errors)
+          float best = 0;
+          for (int lag = min_lag; lag <= max_lag; lag++) {
+            best = std::max(best, normalized[lag]);
+          }
+          for (int lag = min_lag; lag <= max_lag && best >= F0_MIN_CLARITY;
+               lag++) {
+            if (normalized[lag] >= 0.9f * best &&
+                normalized[lag] >= normalized[lag - 1] &&
+                normalized[lag] >= normalized[lag + 1]) {
+              // Parabolic interpolation of the peak
+              float a = normalized[lag - 1], b = normalized[lag],
+                    c = normalized[lag + 1];
+              float denom = a - 2 * b + c;
+              float shift = (denom != 0) ? 0.5f * (a - c) / denom : 0;
+              f.f0 = opts.sample_rate / (lag + shift);
+              break;
+            }
+          }
+        }
+        features.frames.push_back(f);
+      });
+
+  {
+    std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+    fftwf_destroy_plan(inverse);
+  }
+  fftwf_free(power);
+  fftwf_free(ac);
+
+  // Summary
+  features.peak_rms = 0;
+  features.peak_time = NAN;
+  double weight = 0, centroid = 0, rolloff = 0, flatness = 0;
+  std::vector<float> f0s;
+  for (const auto &f : features.frames) {
+    if (f.rms > features.peak_rms) {
+      features.peak_rms = f.rms;
+      features.peak_time = f.time;
+    }
+    if (!std::isnan(f.centroid)) {
+      weight += f.rms;
+      centroid += f.rms * f.centroid;
+      rolloff += f.rms * f.rolloff;
+      flatness += f.rms * f.flatness;
+    }
+    if (!std::isnan(f.f0)) {
+      f0s.push_back(f.f0);
+    }
+  }
+  features.centroid = (weight > 0) ? centroid / weight : NAN;
+  features.rolloff = (weight > 0) ? rolloff / weight : NAN;
+  features.flatness = (weight > 0) ? flatness / weight : NAN;
+  features.f0 = NAN;
+  if (!f0s.empty()) {
+    std::nth_element(f0s.begin(), f0s.begin() + f0s.size() / 2, f0s.end());
+    features.f0 = f0s[f0s.size() / 2];
+  }
+
+  envelopeTimes(audio, opts.sample_rate, opts.gate_duration, features);
+  return features;
+}
+
+// Appends a number with 5 significant digits (null when undefined)
+inline void appendJSONNumber(std::string &out, double value) {
+  if (std::isnan(value) || std::isinf(value)) {
+    out += "null";
+    return;
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.5g", value);
+  out += buffer;
+}
+
+// Appends "name":[values] for one feature of every frame
+template <typename Getter>
+inline void appendFrameArray(std::string &out, const char *name,
+                             const std::vector<FrameFeatures> &frames,
+                             Getter get) {
+  out += std::string("\"") + name + "\":[";
+  for (size_t i = 0; i < frames.size(); i++) {
+    if (i > 0) {
+      out += ',';
+    }
+    appendJSONNumber(out, get(frames[i]));
+  }
+  out += ']';
+}
+
+// Compact JSON of the features of the analysed signals; per-frame arrays
+// are included when 'with_frames' is true
+inline std::string featuresToJSON(const std::vector<SignalFeatures> &signals,
+                                  const Options &opts, bool with_frames) {
+  std::string out = "{\"sample_rate\":" + std::to_string(opts.sample_rate) +
+                    ",\"fft_size\":" + std::to_string(opts.fft_size) +
+                    ",\"hop_size\":" + std::to_string(opts.hop_size) +
+                    ",\"signals\":[";
+  for (size_t s = 0; s < signals.size(); s++) {
+    const SignalFeatures &f = signals[s];
+    out += (s > 0 ? ",{" : "{");
+    out += "\"signal\":\"" + f.label + "\",\"peak_rms\":";
+    appendJSONNumber(out, f.peak_rms);
+    out += ",\"peak_time\":";
+    appendJSONNumber(out, f.peak_time);
+    out += ",\"attack_time\":";
+    appendJSONNumber(out, f.attack_time);
+    out += ",\"release_time\":";
+    appendJSONNumber(out, f.release_time);
+    out += ",\"centroid\":";
+    appendJSONNumber(out, f.centroid);
+    out += ",\"rolloff\":";
+    appendJSONNumber(out, f.rolloff);
+    out += ",\"flatness\":";
+    appendJSONNumber(out, f.flatness);
+    out += ",\"f0\":";
+    appendJSONNumber(out, f.f0);
+    if (with_frames) {
+      out += ",\"frames\":{";
+      appendFrameArray(out, "time", f.frames,
+                       [](const FrameFeatures &x) { return x.time; });
+      out += ',';
+      appendFrameArray(out, "rms", f.frames,
+                       [](const FrameFeatures &x) { return x.rms; });
+      out += ',';
+      appendFrameArray(out, "centroid", f.frames,
+                       [](const FrameFeatures &x) { return x.centroid; });
+      out += ',';
+      appendFrameArray(out, "rolloff", f.frames,
+                       [](const FrameFeatures &x) { return x.rolloff; });
+      out += ',';
+      appendFrameArray(out, "flatness", f.frames,
+                       [](const FrameFeatures &x) { return x.flatness; });
+      out += ',';
+      appendFrameArray(out, "f0", f.frames,
+                       [](const FrameFeatures &x) { return x.f0; });
+      out += '}';
+    }
+    out += '}';
+  }
+  out += "]}";
+  return out;
+}
+
+// Features of the signals of a channel mode (see channelSignals()), one
+// thread per signal, as JSON; false with an error message on failure
+inline bool analyzeChannels(const std::vector<std::vector<float>> &channels,
+                            const Options &opts, const std::string &mode,
+                            bool with_frames, std::string &json_out,
+                            std::string &error) {
+  std::vector<std::vector<float>> signals;
+  std::vector<std::string> labels;
+  if (!channelSignals(channels, mode, signals, labels, error)) {
+    return false;
+  }
+  if (stftFrameCount(signals[0].size(), opts.fft_size, opts.hop_size,
+                     opts.padding) == 0) {
+    error = "duration is shorter than one FFT frame";
+    return false;
+  }
+
+  std::vector<SignalFeatures> features(signals.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < signals.size(); i++) {
+    threads.emplace_back([&, i]() {
+      features[i] = analyzeSignal(signals[i], opts, labels[i]);
+    });
+  }
+  features[0] = analyzeSignal(signals[0], opts, labels[0]);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  json_out = featuresToJSON(features, opts, with_frames);
+  return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <signal.h>
+#include <sys/types.h>
+
+// ============================================================================
+// Request Cancellation
+// ============================================================================
+
+/**
+ * @brief Shared cancellation flag for one in-flight MCP request
+ *
+ * The server creates one token per tools/call and keeps a copy indexed by
+ * request id. Copies share the same state, so cancelling the server's copy
+ * is seen by the tool running on the worker thread. Child processes launched
+ * on behalf of the request register their process group so that cancel()
+ * can terminate them immediately instead of waiting for them to finish.
+ */
+class CancellationToken {
+private:
+  struct State {
+    std::atomic<bool> cancelled{false};
+    std::mutex mutex;
+    std::set<pid_t> processGroups; ///< Process groups to signal on cancel
+  };
+
+  std::shared_ptr<State> fState;
+
+public:
+  CancellationToken() : fState(std::make_shared<State>()) {}
+
+  /**
+   * @brief Check whether the request has been cancelled
+   */
+  bool isCancelled() const {
+    return fState->cancelled.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Cancel the request and send SIGTERM to its child processes
+   *
+   * The process runner escalates to SIGKILL if a child ignores SIGTERM.
+   */
+  void cancel() {
+    std::lock_guard<std::mutex> lock(fState->mutex);
+    fState->cancelled.store(true, std::memory_order_release);
+    for (pid_t pgid : fState->processGroups) {
+      kill(-pgid, SIGTERM);
+    }
+  }
+
+  /**
+   * @brief Register a child process group owned by this request
+   * @return false if the request is already cancelled (caller must kill it)
+   */
+  bool attach(pid_t pgid) const {
+    std::lock_guard<std::mutex> lock(fState->mutex);
+    if (fState->cancelled.load(std::memory_order_acquire)) {
+      return false;
+    }
+    fState->processGroups.insert(pgid);
+    return true;
+  }
+
+  /**
+   * @brief Unregister a child process group once it has been reaped
+   */
+  void detach(pid_t pgid) const {
+    std::lock_guard<std::mutex> lock(fState->mutex);
+    fState->processGroups.erase(pgid);
+  }
+};
@@ -0,0 +1,50 @@
+#include "config.hh"
+
+#include <cctype>
+#include <fstream>
+#include <map>
+
+// Removes leading and trailing whitespace
+static std::string trim(const std::string &text) {
+  size_t first = text.find_first_not_of(" \t\r");
+  if (first == std::string::npos) {
+    return "";
+  }
+  size_t last = text.find_last_not_of(" \t\r");
+  return text.substr(first, last - first + 1);
+}
+
+// Reads "key = value" lines of the config file ('#' starts a comment)
+static std::map<std::string, std::string> readConfigFile() {
+  std::map<std::string, std::string> settings;
+
+  const char *path = std::getenv("FAUST_MCP_CONFIG");
+  std::ifstream file(path ? path : CONFIG_FILE);
+  std::string line;
+  while (std::getline(file, line)) {
+    line = trim(line.substr(0, line.find('#')));
+    size_t equal = line.find('=');
+    if (equal != std::string::npos) {
+      settings[trim(line.substr(0, equal))] = trim(line.substr(equal + 1));
+    }
+  }
+  return settings;
+}
+
+// Returns a setting: environment first, then config file, then default
+std::string configValue(const std::string &key,
+                        const std::string &defaultValue) {
+  std::string variable = "FAUST_MCP_" + key;
+  for (char &c : variable) {
+    c = std::toupper((unsigned char)c);
+  }
+  if (const char *value = std::getenv(variable.c_str())) {
+    return value;
+  }
+
+  // The file is read once, on first use
+  static const std::map<std::string, std::string> fileSettings =
+      readConfigFile();
+  auto it = fileSettings.find(key);
+  return (it != fileSettings.end()) ? it->second : defaultValue;
+}
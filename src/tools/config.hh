@@ -13,3 +13,114 @@ const std::string FAUST_DOCKER_IMAGE = "ghcr.io/orlarey/faustdocker:main";
 
 // Host shared directory (for Docker-in-Docker mounting)
 const std::string HOST_SHARED_DIR = "/tmp/faust-shared";
+
+// The constants above and below are defaults: each setting can be changed
+// at runtime, see configValue()
+
+// Server config file (overridden by the FAUST_MCP_CONFIG variable)
+const std::string CONFIG_FILE = "/etc/faust-mcp.conf";
+
+// Faust compiler backend: docker (one container per call), worker
+// (persistent container + docker exec) or local (faust binary on PATH).
+// local and libfaust compile on the host: the DSP source can import any
+// file the server can read, use docker or worker for untrusted code
+const std::string FAUST_BACKEND = "docker";
+
+// Faust binary used by the local backend (and inside the worker container)
+const std::string FAUST_BINARY = "faust";
+
+// Name of the persistent Faust container of the worker backend
+const std::string FAUST_WORKER_NAME = "faust-mcp-worker";
+
+// Directory of the architecture files (spectrogram.cpp)
+const std::string ARCH_DIR = "/usr/local/share/faust";
+
+// Spectrogram engine: compile (Faust -> C++ -> g++ -> executable), or, when
+// the server is built with libfaust, llvm (JIT) or interp (interpreter)
+const std::string SPECTROGRAM_ENGINE = "compile";
+
+// Number of DSP factories kept by the llvm/interp engines
+const int JIT_CACHE_SIZE = 16;
+
+// Longest note rendered by FaustSpectrogramTool, FaustRenderTool and
+// FaustAnalyzeTool, in seconds
+const int RENDER_MAX_SECONDS = 300;
+
+// Bounds of the rendering tools, fixed (not settings): the llvm and interp
+// engines render and analyse in the server process, where every buffer of
+// a request must stay bounded. A spectrogram has at most
+// MAX_SPECTROGRAM_CELLS values (frames x rows), a rendered note at most
+// MAX_RENDER_SAMPLES samples (duration x sample rate x channels).
+const int MAX_SAMPLE_RATE = 384000;
+const int MAX_FFT_SIZE = 65536;
+const long MAX_SPECTROGRAM_CELLS = 1L << 24;
+const int MAX_BLOCK_SIZE = 8192;
+const long MAX_RENDER_SAMPLES = 1L << 27;
+
+// Largest number of notes of a spectrogram sweep
+const int SWEEP_MAX_POINTS = 64;
+
+// Render threads of a spectrogram sweep (0: one per core)
+const int SWEEP_THREADS = 0;
+
+// Largest number of tools/call requests running at a time (one thread
+// each); further calls are rejected until one ends
+const int MAX_TOOL_CALLS = 16;
+
+// Request log: one JSON line per request (empty: no log), rotated when it
+// exceeds LOG_MAX_MB, keeping LOG_FILES old files
+const std::string LOG_FILE = WORK_DIR + "/requests.log";
+const int LOG_MAX_MB = 10;
+const int LOG_FILES = 3;
+
+// Tool results: inline (the whole output in the tools/call response) or
+// reference (outputs over INLINE_MAX_KB kept as resources, read with
+// resources/read), see artifacts.hh
+const std::string RESULT_MODE = "inline";
+const int INLINE_MAX_KB = 64;
+
+// Lifetime of a stored artifact in seconds, size of the store, and
+// whether its files are gzip-compressed (1) or not (0)
+const int ARTIFACT_TTL = 600;
+const int ARTIFACT_MAX_MB = 256;
+const int ARTIFACT_GZIP = 0;
+
+/**
+ * @brief Returns a server setting
+ *
+ * Looks up the environment variable FAUST_MCP_<KEY> (upper-cased key), then
+ * "key = value" lines of the config file, and returns defaultValue if the
+ * setting is defined in neither. Keys: backend, faust_binary, docker_image,
+ * host_shared_dir, worker_name, arch_dir, libfaust_fallback,
+ * spectrogram_engine, jit_cache_size, render_max_seconds, sweep_max_points,
+ * sweep_threads, max_tool_calls, log_file, log_max_mb, log_files,
+ * result_mode, inline_max_kb, artifact_ttl, artifact_max_mb, artifact_gzip,
+ * timeout_<stage>, cpu_<stage>, memory_<stage>.
+ */
+std::string configValue(const std::string &key,
+                        const std::string &defaultValue);
+
+// Default resource limits of each processing stage (see stageLimits())
+// timeout and CPU time in seconds, memory in MB, 0 means unlimited
+struct StageLimitDefaults {
+  const char *stage;
+  int timeout;
+  int cpu;
+  int memory;
+};
+
+const StageLimitDefaults STAGE_LIMIT_DEFAULTS[] = {
+    {"version", 30, 10, 512},
+    {"help", 30, 10, 512},
+    {"compile", 60, 60, 1024},
+    {"svg", 60, 60, 1024},
+    {"spectrogram_faust", 60, 60, 1024},
+    {"spectrogram_cxx", 120, 120, 2048},
+    {"spectrogram_run", 60, 60, 1024},
+    {"render_faust", 60, 60, 1024},
+    {"render_cxx", 120, 120, 2048},
+    {"render_run", 60, 60, 1024},
+    {"analyze_faust", 60, 60, 1024},
+    {"analyze_cxx", 120, 120, 2048},
+    {"analyze_run", 60, 60, 1024},
+};
@@ -0,0 +1,119 @@
+/************************************************************************
+ FAUST Architecture File - Minimal Faust Definitions
+ Copyright (C) 2026 Yann Orlarey
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************
+ ************************************************************************/
+
+/*
+ The UI, Meta and dsp interfaces expected by a Faust-generated class,
+ without the Faust headers. Included by the architecture files of the
+ server before the generated class.
+ */
+
+#pragma once
+
+#ifndef FAUSTFLOAT
+#define FAUSTFLOAT float
+#endif
+
+#ifndef FAUSTCLASS
+#define FAUSTCLASS mydsp
+#endif
+
+#ifdef __APPLE__
+#define exp10f __exp10f
+#define exp10 __exp10
+#endif
+
+#if defined(_WIN32)
+#define RESTRICT __restrict
+#else
+#define RESTRICT __restrict__
+#endif
+
+//==============================================================================
+// Minimal Faust definitions (from plotarch_header.cpp)
+//==============================================================================
+
+// Dummy Soundfile for compatibility
+struct Soundfile {
+  void *fBuffers;
+  int *fLength;
+  int *fSR;
+  int *fOffset;
+  int fChannels;
+  int fParts;
+  bool fIsDouble;
+};
+
+// Abstract UI class
+class UI {
+public:
+  virtual ~UI() {}
+  virtual void openTabBox(const char *label) = 0;
+  virtual void openHorizontalBox(const char *label) = 0;
+  virtual void openVerticalBox(const char *label) = 0;
+  virtual void closeBox() = 0;
+  virtual void addButton(const char *label, FAUSTFLOAT *zone) = 0;
+  virtual void addCheckButton(const char *label, FAUSTFLOAT *zone) = 0;
+  virtual void addVerticalSlider(const char *label, FAUSTFLOAT *zone,
+                                 FAUSTFLOAT init, FAUSTFLOAT min,
+                                 FAUSTFLOAT max, FAUSTFLOAT step) = 0;
+  virtual void addHorizontalSlider(const char *label, FAUSTFLOAT *zone,
+                                   FAUSTFLOAT init, FAUSTFLOAT min,
+                                   FAUSTFLOAT max, FAUSTFLOAT step) = 0;
+  virtual void addNumEntry(const char *label, FAUSTFLOAT *zone, FAUSTFLOAT init,
+                           FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step) = 0;
+  virtual void addHorizontalBargraph(const char *label, FAUSTFLOAT *zone,
+                                     FAUSTFLOAT min, FAUSTFLOAT max) = 0;
+  virtual void addVerticalBargraph(const char *label, FAUSTFLOAT *zone,
+                                   FAUSTFLOAT min, FAUSTFLOAT max) = 0;
+  virtual void addSoundfile(const char *label, const char *filename,
+                            Soundfile **sf_zone) = 0;
+  virtual void declare(FAUSTFLOAT *zone, const char *key,
+                       const char *value) = 0;
+};
+
+// Abstract Meta class
+class Meta {
+public:
+  virtual ~Meta() {}
+  virtual void declare(const char *key, const char *value) = 0;
+};
+
+// Abstract DSP class
+class dsp {
+public:
+  virtual ~dsp() {}
+  virtual void buildUserInterface(UI *ui_interface) = 0;
+  virtual void compute(int count, FAUSTFLOAT **inputs,
+                       FAUSTFLOAT **outputs) = 0;
+  virtual void init(int samplingFreq) = 0;
+  virtual void instanceClear() = 0;
+  virtual void instanceConstants(int samplingFreq) = 0;
+  virtual void instanceInit(int samplingFreq) = 0;
+  virtual void instanceResetUserInterface() = 0;
+  virtual int getNumInputs() = 0;
+  virtual int getNumOutputs() = 0;
+  virtual int getSampleRate() = 0;
+  virtual dsp *clone() = 0;
+};
@@ -0,0 +1,798 @@
+#include "jsonrpc.hh"
+#include "utils.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Nesting limit of the scanner (the server's requests are a few levels deep)
+static const int MAX_DEPTH = 512;
+
+// Number of bytes at p that begin a well-formed UTF-8 sequence (all of it,
+// or the start of a truncated one), and the length of that sequence; 0 if
+// p[0] starts none (no overlong forms, surrogates or code points above
+// U+10FFFF)
+static size_t utf8Prefix(const unsigned char *p, size_t available,
+                         size_t &length) {
+  unsigned char c = p[0];
+  if (c < 0x80) {
+    length = 1;
+    return 1;
+  }
+  unsigned char low = 0x80, high = 0xBF;
+  if (c >= 0xC2 && c <= 0xDF) {
+    length = 2;
+  } else if (c >= 0xE0 && c <= 0xEF) {
+    length = 3;
+    low = (c == 0xE0) ? 0xA0 : low;
+    high = (c == 0xED) ? 0x9F : high;
+  } else if (c >= 0xF0 && c <= 0xF4) {
+    length = 4;
+    low = (c == 0xF0) ? 0x90 : low;
+    high = (c == 0xF4) ? 0x8F : high;
+  } else {
+    length = 0;
+    return 0;
+  }
+  if (available < 2 || p[1] < low || p[1] > high) {
+    return 1;
+  }
+  size_t i = 2;
+  while (i < length && i < available && p[i] >= 0x80 && p[i] <= 0xBF) {
+    i++;
+  }
+  return i;
+}
+
+// Length of the well-formed UTF-8 sequence at p, 0 if it is not one
+static size_t utf8Length(const unsigned char *p, size_t available) {
+  size_t length;
+  return (utf8Prefix(p, available, length) == length) ? length : 0;
+}
+
+static void appendUtf8(std::string &out, unsigned long code) {
+  if (code < 0x80) {
+    out += (char)code;
+  } else if (code < 0x800) {
+    out += (char)(0xC0 | (code >> 6));
+    out += (char)(0x80 | (code & 0x3F));
+  } else if (code < 0x10000) {
+    out += (char)(0xE0 | (code >> 12));
+    out += (char)(0x80 | ((code >> 6) & 0x3F));
+    out += (char)(0x80 | (code & 0x3F));
+  } else {
+    out += (char)(0xF0 | (code >> 18));
+    out += (char)(0x80 | ((code >> 12) & 0x3F));
+    out += (char)(0x80 | ((code >> 6) & 0x3F));
+    out += (char)(0x80 | (code & 0x3F));
+  }
+}
+
+// ============================================================================
+// Scanner
+// ============================================================================
+
+namespace {
+
+// Validating JSON scanner over a text: values are checked and skipped,
+// objects report their members as raw text, strings can be decoded
+class Scanner {
+public:
+  explicit Scanner(std::string_view text) : fText(text) {}
+
+  const std::string &error() const { return fError; }
+
+  void skipSpace() {
+    while (!atEnd() && (peek() == ' ' || peek() == '\t' || peek() == '\n' ||
+                        peek() == '\r')) {
+      fPos++;
+    }
+  }
+
+  bool atEnd() const { return fPos >= fText.size(); }
+
+  char peek() const { return atEnd() ? '\0' : fText[fPos]; }
+
+  // Checks and skips one value (and the spaces before it)
+  bool value(int depth) {
+    skipSpace();
+    if (depth > MAX_DEPTH) {
+      return fail("too deeply nested");
+    }
+    switch (peek()) {
+    case '{':
+      return object(depth, [](const std::string &, std::string_view) {});
+    case '[':
+      return array(depth);
+    case '"':
+      return string(nullptr);
+    case 't':
+      return literal("true");
+    case 'f':
+      return literal("false");
+    case 'n':
+      return literal("null");
+    default:
+      if (peek() == '-' || (peek() >= '0' && peek() <= '9')) {
+        return number();
+      }
+      return fail(atEnd() ? "unexpected end of input" : "unexpected character");
+    }
+  }
+
+  // Checks an object, calling member(key, raw value) for each member
+  template <typename Member> bool object(int depth, Member member) {
+    fPos++; // '{'
+    skipSpace();
+    if (peek() == '}') {
+      fPos++;
+      return true;
+    }
+    while (true) {
+      skipSpace();
+      if (peek() != '"') {
+        return fail("expected a member name");
+      }
+      std::string key;
+      if (!string(&key)) {
+        return false;
+      }
+      skipSpace();
+      if (peek() != ':') {
+        return fail("expected ':'");
+      }
+      fPos++;
+      skipSpace();
+      size_t start = fPos;
+      if (!value(depth + 1)) {
+        return false;
+      }
+      member(key, fText.substr(start, fPos - start));
+      skipSpace();
+      if (peek() == ',') {
+        fPos++;
+      } else if (peek() == '}') {
+        fPos++;
+        return true;
+      } else {
+        return fail("expected ',' or '}'");
+      }
+    }
+  }
+
+  // Checks a string, decoding it into 'decoded' if not null
+  bool string(std::string *decoded) {
+    fPos++; // '"'
+    const unsigned char *text = (const unsigned char *)fText.data();
+    size_t size = fText.size();
+    while (true) {
+      // Run of characters standing for themselves
+      size_t run = fPos;
+      while (run < size) {
+        unsigned char c = text[run];
+        if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') {
+          run++;
+        } else if (c >= 0x80) {
+          size_t length = utf8Length(text + run, size - run);
+          if (length == 0) {
+            fPos = run;
+            return fail("invalid UTF-8");
+          }
+          run += length;
+        } else {
+          break;
+        }
+      }
+      if (decoded) {
+        decoded->append(fText.data() + fPos, run - fPos);
+      }
+      fPos = run;
+
+      if (atEnd()) {
+        return fail("unterminated string");
+      } else if (peek() == '"') {
+        fPos++;
+        return true;
+      } else if (peek() != '\\') {
+        return fail("control character in string");
+      }
+
+      fPos++;
+      if (atEnd()) {
+        return fail("unterminated string");
+      }
+      static const char names[] = "\"\\/bfnrt";
+      static const char values[] = "\"\\/\b\f\n\r\t";
+      char escape = peek();
+      fPos++;
+      const char *simple = std::strchr(names, escape);
+      if (simple && escape != '\0') {
+        if (decoded) {
+          *decoded += values[simple - names];
+        }
+      } else if (escape == 'u') {
+        unsigned long code;
+        if (!hex4(code)) {
+          return false;
+        }
+        if (code >= 0xD800 && code <= 0xDBFF) {
+          unsigned long low;
+          if (fText.substr(fPos, 2) != "\\u") {
+            return fail("missing low surrogate");
+          }
+          fPos += 2;
+          if (!hex4(low)) {
+            return false;
+          }
+          if (low < 0xDC00 || low > 0xDFFF) {
+            return fail("invalid low surrogate");
+          }
+          code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        } else if (code >= 0xDC00 && code <= 0xDFFF) {
+          return fail("unexpected low surrogate");
+        }
+        if (decoded) {
+          appendUtf8(*decoded, code);
+        }
+      } else {
+        fPos--;
+        return fail("invalid escape");
+      }
+    }
+  }
+
+private:
+  bool fail(const char *cause) {
+    if (fError.empty()) {
+      fError = std::string("syntax error at byte ") + std::to_string(fPos) +
+               ": " + cause;
+    }
+    return false;
+  }
+
+  bool array(int depth) {
+    fPos++; // '['
+    skipSpace();
+    if (peek() == ']') {
+      fPos++;
+      return true;
+    }
+    while (true) {
+      if (!value(depth + 1)) {
+        return false;
+      }
+      skipSpace();
+      if (peek() == ',') {
+        fPos++;
+      } else if (peek() == ']') {
+        fPos++;
+        return true;
+      } else {
+        return fail("expected ',' or ']'");
+      }
+    }
+  }
+
+  bool literal(const char *word) {
+    size_t length = std::strlen(word);
+    if (fText.substr(fPos, length) != word) {
+      return fail("invalid literal");
+    }
+    fPos += length;
+    return true;
+  }
+
+  // -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+  bool number() {
+    auto digits = [this]() {
+      size_t start = fPos;
+      while (peek() >= '0' && peek() <= '9') {
+        fPos++;
+      }
+      return fPos > start;
+    };
+    if (peek() == '-') {
+      fPos++;
+    }
+    if (peek() == '0') {
+      fPos++;
+    } else if (!digits()) {
+      return fail("invalid number");
+    }
+    if (peek() == '.') {
+      fPos++;
+      if (!digits()) {
+        return fail("invalid number");
+      }
+    }
+    if (peek() == 'e' || peek() == 'E') {
+      fPos++;
+      if (peek() == '+' || peek() == '-') {
+        fPos++;
+      }
+      if (!digits()) {
+        return fail("invalid number");
+      }
+    }
+    return true;
+  }
+
+  bool hex4(unsigned long &code) {
+    code = 0;
+    for (int i = 0; i < 4; i++, fPos++) {
+      char c = peek();
+      int digit = (c >= '0' && c <= '9')   ? c - '0'
+                  : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+                  : (c >= 'A' && c <= 'F') ? c - 'A' + 10
+                                           : -1;
+      if (digit < 0) {
+        return fail("invalid \\u escape");
+      }
+      code = code * 16 + digit;
+    }
+    return true;
+  }
+
+  std::string_view fText;
+  size_t fPos = 0;
+  std::string fError;
+};
+
+} // namespace
+
+// Decoded value of a raw string member, empty if it is not a string
+static std::string decodeString(std::string_view raw) {
+  std::string decoded;
+  if (!raw.empty() && raw[0] == '"') {
+    Scanner(raw).string(&decoded);
+  }
+  return decoded;
+}
+
+bool scanRequest(std::string_view line, RequestFields &fields,
+                 std::string &error) {
+  fields = RequestFields();
+  Scanner scanner(line);
+  scanner.skipSpace();
+  bool valid;
+  if (scanner.peek() == '{') {
+    fields.isObject = true;
+    valid = scanner.object(0, [&](const std::string &key,
+                                  std::string_view raw) {
+      if (key == "id") {
+        fields.id = raw;
+      } else if (key == "method") {
+        fields.method = decodeString(raw);
+      } else if (key == "params") {
+        fields.params = raw;
+      }
+    });
+  } else {
+    valid = scanner.value(0);
+  }
+  if (valid) {
+    scanner.skipSpace();
+    if (!scanner.atEnd()) {
+      error = "syntax error: unexpected text after the request";
+      return false;
+    }
+  } else {
+    error = scanner.error();
+    return false;
+  }
+
+  // params were checked above
+  if (!fields.params.empty() && fields.params[0] == '{') {
+    Scanner(fields.params)
+        .object(0, [&](const std::string &key, std::string_view raw) {
+          if (key == "name") {
+            fields.toolName = decodeString(raw);
+          } else if (key == "arguments") {
+            fields.arguments = raw;
+          }
+        });
+  }
+  return true;
+}
+
+// ============================================================================
+// Protocol Version
+// ============================================================================
+
+// Versions supported by the server, latest first
+static const char *const PROTOCOL_VERSIONS[] = {"2025-06-18", "2024-11-05"};
+static const int PROTOCOL_VERSION_COUNT = 2;
+
+// Index of the session's version in PROTOCOL_VERSIONS (read by the tool
+// threads)
+static std::atomic<int> sessionVersion{PROTOCOL_VERSION_COUNT - 1};
+
+std::string negotiateProtocolVersion(const std::string &requested) {
+  int version = 0;
+  for (int i = 0; i < PROTOCOL_VERSION_COUNT; i++) {
+    if (requested == PROTOCOL_VERSIONS[i]) {
+      version = i;
+    }
+  }
+  sessionVersion.store(version);
+  return PROTOCOL_VERSIONS[version];
+}
+
+bool protocolAtLeast(const char *version) {
+  return strcmp(PROTOCOL_VERSIONS[sessionVersion.load()], version) >= 0;
+}
+
+// ============================================================================
+// Streamed Content
+// ============================================================================
+
+struct StreamedContent::Source {
+  StreamEncoding encoding;
+  int fd = -1; // range of an open file, or bytes
+  size_t fileOffset = 0;
+  size_t fileSize = 0;
+  std::string bytes;
+  std::vector<unsigned char> vector;
+
+  ~Source() {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+};
+
+// StreamedContent of the request handled by the thread (see Scope)
+static thread_local StreamedContent *tCurrentContent = nullptr;
+
+StreamedContent::StreamedContent() = default;
+StreamedContent::~StreamedContent() = default;
+
+json StreamedContent::add(std::unique_ptr<Source> source) {
+  fSources.push_back(std::move(source));
+  // An empty binary value tagged with the index of the source: tools never
+  // produce binary values otherwise
+  return json::binary(json::binary_t::container_type(), fSources.size() - 1);
+}
+
+const StreamedContent::Source *
+StreamedContent::source(const json &placeholder) const {
+  if (!placeholder.is_binary() || !placeholder.get_binary().has_subtype()) {
+    return nullptr;
+  }
+  size_t index = placeholder.get_binary().subtype();
+  return index < fSources.size() ? fSources[index].get() : nullptr;
+}
+
+size_t StreamedContent::size(const json &placeholder) const {
+  const Source *s = source(placeholder);
+  if (!s) {
+    return 0;
+  }
+  return s->fd >= 0 ? s->fileSize
+                    : (s->vector.empty() ? s->bytes.size() : s->vector.size());
+}
+
+// Writes a whole buffer, retrying after partial writes
+static bool writeAll(int fd, const void *data, size_t size) {
+  const char *p = (const char *)data;
+  while (size > 0) {
+    ssize_t written = write(fd, p, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    p += written;
+    size -= written;
+  }
+  return true;
+}
+
+bool StreamedContent::copy(const json &placeholder, int fd) const {
+  const Source *s = source(placeholder);
+  if (!s) {
+    return false;
+  }
+  if (s->fd < 0) {
+    return s->vector.empty()
+               ? writeAll(fd, s->bytes.data(), s->bytes.size())
+               : writeAll(fd, s->vector.data(), s->vector.size());
+  }
+  // File to file, in the kernel
+  off_t offset = s->fileOffset;
+  size_t left = s->fileSize;
+  while (left > 0) {
+    ssize_t sent = sendfile(fd, s->fd, &offset, left);
+    if (sent <= 0) {
+      if (sent < 0 && errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    left -= sent;
+  }
+  return true;
+}
+
+StreamedContent::Scope::Scope(StreamedContent &content)
+    : fPrevious(tCurrentContent) {
+  tCurrentContent = &content;
+}
+
+StreamedContent::Scope::~Scope() { tCurrentContent = fPrevious; }
+
+// String value of bytes, for callers without a StreamedContent
+static json encodedValue(const std::string &bytes, StreamEncoding encoding) {
+  return encoding == StreamEncoding::Base64 ? json(base64_encode(bytes))
+                                            : json(bytes);
+}
+
+json streamFile(const std::string &path, StreamEncoding encoding,
+                size_t offset, size_t length) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return json();
+  }
+
+  auto source = std::make_unique<StreamedContent::Source>();
+  source->encoding = encoding;
+  source->fd = fd;
+  source->fileOffset = std::min<size_t>(offset, st.st_size);
+  source->fileSize =
+      std::min<size_t>(length, st.st_size - source->fileOffset);
+  if (tCurrentContent) {
+    return tCurrentContent->add(std::move(source));
+  }
+
+  std::string bytes(source->fileSize, '\0');
+  ssize_t got = bytes.empty()
+                    ? 0
+                    : pread(fd, &bytes[0], bytes.size(), source->fileOffset);
+  bytes.resize(got > 0 ? got : 0);
+  return encodedValue(bytes, encoding);
+}
+
+json streamBytes(std::string bytes, StreamEncoding encoding) {
+  if (!tCurrentContent) {
+    return encodedValue(bytes, encoding);
+  }
+  auto source = std::make_unique<StreamedContent::Source>();
+  source->encoding = encoding;
+  source->bytes = std::move(bytes);
+  return tCurrentContent->add(std::move(source));
+}
+
+json streamBytes(std::vector<unsigned char> bytes, StreamEncoding encoding) {
+  if (!tCurrentContent) {
+    return encodedValue(std::string(bytes.begin(), bytes.end()), encoding);
+  }
+  auto source = std::make_unique<StreamedContent::Source>();
+  source->encoding = encoding;
+  source->vector = std::move(bytes);
+  return tCurrentContent->add(std::move(source));
+}
+
+// ============================================================================
+// Writer
+// ============================================================================
+
+JsonWriter &JsonWriter::raw(std::string_view text) {
+  if (text.size() > sizeof(fBuffer) - fUsed) {
+    flush();
+    if (text.size() >= sizeof(fBuffer)) {
+      fOut.write(text.data(), text.size());
+      fWritten += text.size();
+      return *this;
+    }
+  }
+  std::memcpy(fBuffer + fUsed, text.data(), text.size());
+  fUsed += text.size();
+  return *this;
+}
+
+JsonWriter &JsonWriter::string(std::string_view text) {
+  put('"');
+  const unsigned char *p = (const unsigned char *)text.data();
+  size_t size = text.size();
+  size_t i = 0;
+  while (i < size) {
+    // Run of characters written as they are (ASCII and valid UTF-8)
+    size_t run = i;
+    while (run < size) {
+      unsigned char c = p[run];
+      if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') {
+        run++;
+      } else if (c >= 0x80 && utf8Length(p + run, size - run) > 0) {
+        run += utf8Length(p + run, size - run);
+      } else {
+        break;
+      }
+    }
+    raw(text.substr(i, run - i));
+    if (run == size) {
+      break;
+    }
+
+    unsigned char c = p[run];
+    switch (c) {
+    case '"':
+      raw("\\\"");
+      break;
+    case '\\':
+      raw("\\\\");
+      break;
+    case '\b':
+      raw("\\b");
+      break;
+    case '\f':
+      raw("\\f");
+      break;
+    case '\n':
+      raw("\\n");
+      break;
+    case '\r':
+      raw("\\r");
+      break;
+    case '\t':
+      raw("\\t");
+      break;
+    default:
+      if (c < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        raw(escaped);
+      } else {
+        // Invalid UTF-8: one U+FFFD for the bytes of a truncated sequence,
+        // or for a byte that starts none (as json::dump() replaces them)
+        size_t length;
+        raw("\xEF\xBF\xBD");
+        i = run + std::max<size_t>(1, utf8Prefix(p + run, size - run, length));
+        continue;
+      }
+    }
+    i = run + 1;
+  }
+  put('"');
+  return *this;
+}
+
+JsonWriter &JsonWriter::value(const json &value) {
+  switch (value.type()) {
+  case json::value_t::object: {
+    put('{');
+    bool first = true;
+    for (auto it = value.begin(); it != value.end(); ++it) {
+      if (!first) {
+        put(',');
+      }
+      first = false;
+      string(it.key());
+      put(':');
+      this->value(it.value());
+    }
+    put('}');
+    break;
+  }
+  case json::value_t::array: {
+    put('[');
+    bool first = true;
+    for (const auto &element : value) {
+      if (!first) {
+        put(',');
+      }
+      first = false;
+      this->value(element);
+    }
+    put(']');
+    break;
+  }
+  case json::value_t::string:
+    string(value.get_ref<const std::string &>());
+    break;
+  case json::value_t::binary:
+    if (fStreamed && fStreamed->source(value)) {
+      streamed(*fStreamed->source(value));
+    } else {
+      raw(value.dump());
+    }
+    break;
+  default:
+    // Numbers, booleans and null, formatted by json::dump()
+    raw(value.dump());
+  }
+  return *this;
+}
+
+void JsonWriter::flush() {
+  if (fUsed > 0) {
+    fOut.write(fBuffer, fUsed);
+    fWritten += fUsed;
+    fUsed = 0;
+  }
+}
+
+void JsonWriter::streamed(const StreamedContent::Source &source) {
+  const unsigned char *data;
+  size_t size;
+  void *map = MAP_FAILED;
+  size_t mapSize = 0;
+  std::string fileBytes;
+  if (source.fd >= 0) {
+    size = source.fileSize;
+    // Mappings start on a page boundary
+    size_t skip = source.fileOffset % sysconf(_SC_PAGESIZE);
+    mapSize = skip + size;
+    if (size > 0) {
+      map = mmap(nullptr, mapSize, PROT_READ, MAP_PRIVATE, source.fd,
+                 source.fileOffset - skip);
+    }
+    if (map != MAP_FAILED) {
+      madvise(map, mapSize, MADV_SEQUENTIAL);
+      data = (const unsigned char *)map + skip;
+    } else {
+      // Not mappable: read it whole
+      fileBytes.resize(size);
+      ssize_t got =
+          size ? pread(source.fd, &fileBytes[0], size, source.fileOffset) : 0;
+      fileBytes.resize(got > 0 ? got : 0);
+      data = (const unsigned char *)fileBytes.data();
+      size = fileBytes.size();
+    }
+  } else if (!source.vector.empty()) {
+    data = source.vector.data();
+    size = source.vector.size();
+  } else {
+    data = (const unsigned char *)source.bytes.data();
+    size = source.bytes.size();
+  }
+
+  if (source.encoding == StreamEncoding::Base64) {
+    put('"');
+    base64(data, size);
+    put('"');
+  } else {
+    string(std::string_view((const char *)data, size));
+  }
+
+  if (map != MAP_FAILED) {
+    munmap(map, mapSize);
+  }
+}
+
+void JsonWriter::base64(const unsigned char *data, size_t size) {
+  static const char chars[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t i = 0;
+  for (; i + 3 <= size; i += 3) {
+    if (sizeof(fBuffer) - fUsed < 4) {
+      flush();
+    }
+    unsigned long triple = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+    fBuffer[fUsed++] = chars[(triple >> 18) & 0x3F];
+    fBuffer[fUsed++] = chars[(triple >> 12) & 0x3F];
+    fBuffer[fUsed++] = chars[(triple >> 6) & 0x3F];
+    fBuffer[fUsed++] = chars[triple & 0x3F];
+  }
+  if (i < size) {
+    unsigned long triple = data[i] << 16;
+    if (i + 1 < size) {
+      triple |= data[i + 1] << 8;
+    }
+    put(chars[(triple >> 18) & 0x3F]);
+    put(chars[(triple >> 12) & 0x3F]);
+    put(i + 1 < size ? chars[(triple >> 6) & 0x3F] : '=');
+    put('=');
+  }
+}
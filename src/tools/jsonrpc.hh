@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// ============================================================================
+// JSON-RPC Request Scanner
+// ============================================================================
+
+/**
+ * @brief Members of a JSON-RPC request used by the server
+ *
+ * Raw members are views of the request line (the JSON text of the value,
+ * empty when the member is absent); method and toolName are decoded, and
+ * empty when absent or not strings.
+ */
+struct RequestFields {
+  bool isObject = false;       ///< false for a valid line that is no object
+  std::string_view id;         ///< raw "id"
+  std::string method;          ///< "method"
+  std::string_view params;     ///< raw "params"
+  std::string toolName;        ///< "params"."name"
+  std::string_view arguments;  ///< raw "params"."arguments"
+};
+
+/**
+ * @brief Validate a request line and locate its members, without building
+ *        a JSON tree
+ *
+ * The whole line is checked (syntax and UTF-8, as strictly as json::parse)
+ * in one pass; only the few members the server dispatches on are decoded,
+ * the tool arguments are left as text for the tool to parse. With duplicate
+ * keys, the last one wins (as with json::parse).
+ * @param error Position and cause when the line is not valid JSON
+ * @return false if the line is not valid JSON
+ */
+bool scanRequest(std::string_view line, RequestFields &fields,
+                 std::string &error);
+
+// ============================================================================
+// Protocol Version
+// ============================================================================
+
+/**
+ * @brief Chooses the MCP protocol version of the session (initialize)
+ *
+ * The server supports 2025-06-18 and 2024-11-05: the version requested by
+ * the client if it is one of them, the latest otherwise. Until initialize,
+ * the session is 2024-11-05.
+ * @return The version sent back to the client
+ */
+std::string negotiateProtocolVersion(const std::string &requested);
+
+/**
+ * @brief Whether the session's protocol version is 'version' or a later
+ *        one (versions are dates): tools only use the content types of
+ *        that version, e.g. audio since "2025-03-26"
+ */
+bool protocolAtLeast(const char *version);
+
+// ============================================================================
+// Streamed Content
+// ============================================================================
+
+// How streamed bytes are written as a JSON string
+enum class StreamEncoding { Text, Base64 };
+
+/**
+ * @brief Large string values written into the response straight from their
+ *        source
+ *
+ * Tools put the placeholder returned by streamFile() or streamBytes() where
+ * a string goes in their content (the "text" of a resource, the "data" of
+ * an image...). When the response is written, JsonWriter escapes (Text) or
+ * base64-encodes (Base64) the source in chunks, in place: a file is mapped
+ * and never read into a string, bytes are not encoded beforehand, so the
+ * memory used by a response does not grow with its payload.
+ *
+ * Placeholders refer to the StreamedContent of the calling thread, set up
+ * by the server for each tools/call (see Scope); without one, streamFile()
+ * and streamBytes() return the string value itself.
+ */
+class StreamedContent {
+public:
+  struct Source; // open file or bytes, and their encoding
+
+  StreamedContent();
+  ~StreamedContent();
+  StreamedContent(const StreamedContent &) = delete;
+  StreamedContent &operator=(const StreamedContent &) = delete;
+
+  // Registers a source, returns its placeholder
+  json add(std::unique_ptr<Source> source);
+
+  // Source of a placeholder, null if it is not one of ours
+  const Source *source(const json &placeholder) const;
+
+  // Size of the source of a placeholder (before encoding), 0 if unknown
+  size_t size(const json &placeholder) const;
+
+  // Writes the bytes of the source of a placeholder to a file descriptor
+  bool copy(const json &placeholder, int fd) const;
+
+  // Makes a StreamedContent the current one of the calling thread
+  class Scope {
+  public:
+    explicit Scope(StreamedContent &content);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    StreamedContent *fPrevious;
+  };
+
+private:
+  std::vector<std::unique_ptr<Source>> fSources;
+};
+
+/**
+ * @brief Placeholder of the content of a file (null if it cannot be read)
+ *
+ * The file is opened now, so it may be removed before the response is
+ * written (e.g. with its ScratchDir).
+ * @param offset, length Range of the file (clipped to its size)
+ */
+json streamFile(const std::string &path, StreamEncoding encoding,
+                size_t offset = 0, size_t length = SIZE_MAX);
+
+/**
+ * @brief Placeholder of bytes, encoded when the response is written
+ */
+json streamBytes(std::string bytes, StreamEncoding encoding);
+json streamBytes(std::vector<unsigned char> bytes, StreamEncoding encoding);
+
+// ============================================================================
+// Streaming JSON Writer
+// ============================================================================
+
+/**
+ * @brief Serializes JSON to a stream in one pass, through a fixed buffer
+ *
+ * Produces the same text as json::dump() (key order, numbers, escapes),
+ * without building the whole document as a string first, and copies the
+ * runs of a string that need no escaping in bulk, which matters for the
+ * multi-megabyte base64 images and generated code in tool results. Invalid
+ * UTF-8 is replaced by U+FFFD instead of throwing, as dump() does with
+ * error_handler_t::replace (one per truncated sequence or stray byte). The
+ * placeholders of 'streamed' are replaced by their content.
+ */
+class JsonWriter {
+public:
+  explicit JsonWriter(std::ostream &out,
+                      const StreamedContent *streamed = nullptr)
+      : fOut(out), fStreamed(streamed) {}
+  ~JsonWriter() { flush(); }
+  JsonWriter(const JsonWriter &) = delete;
+  JsonWriter &operator=(const JsonWriter &) = delete;
+
+  // JSON text written as is
+  JsonWriter &raw(std::string_view text);
+
+  // A string value, quoted and escaped
+  JsonWriter &string(std::string_view text);
+
+  JsonWriter &value(const json &value);
+
+  // Writes the buffer to the stream (not flushing the stream itself)
+  void flush();
+
+  // Bytes written so far
+  size_t size() const { return fWritten + fUsed; }
+
+private:
+  void streamed(const StreamedContent::Source &source);
+  void base64(const unsigned char *data, size_t size);
+
+  void put(char c) {
+    if (fUsed == sizeof(fBuffer)) {
+      flush();
+    }
+    fBuffer[fUsed++] = c;
+  }
+
+  std::ostream &fOut;
+  const StreamedContent *fStreamed;
+  char fBuffer[65536];
+  size_t fUsed = 0;
+  size_t fWritten = 0;
+};
@@ -0,0 +1,248 @@
+#include "logger.hh"
+#include "config.hh"
+#include "utils.hh"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Lines waiting for the writer thread (rounded up to a power of 2)
+static const size_t LOG_QUEUE_SIZE = 4096;
+
+// Sleep of the writer thread when the queue is empty
+static const std::chrono::milliseconds LOG_WRITER_IDLE(20);
+
+/**
+ * Bounded multi-producer queue of lines (D. Vyukov's array queue): each
+ * cell carries a sequence number telling whether it is free for the
+ * producer at a given position or ready for the consumer, so push() and
+ * pop() only need a compare-and-swap on their position, never a lock.
+ */
+class LineQueue {
+public:
+  explicit LineQueue(size_t size) {
+    size_t capacity = 1;
+    while (capacity < size) {
+      capacity <<= 1;
+    }
+    fMask = capacity - 1;
+    fCells.reset(new Cell[capacity]);
+    for (size_t i = 0; i < capacity; i++) {
+      fCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // false when the queue is full
+  bool push(std::string &line) {
+    size_t pos = fPushPos.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+      cell = &fCells[pos & fMask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+      if (diff == 0) {
+        if (fPushPos.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = fPushPos.load(std::memory_order_relaxed);
+      }
+    }
+    cell->line.swap(line);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // false when the queue is empty
+  bool pop(std::string &line) {
+    size_t pos = fPopPos.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+      cell = &fCells[pos & fMask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+      if (diff == 0) {
+        if (fPopPos.compare_exchange_weak(pos, pos + 1,
+                                          std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = fPopPos.load(std::memory_order_relaxed);
+      }
+    }
+    line.clear();
+    line.swap(cell->line);
+    cell->sequence.store(pos + fMask + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    std::string line;
+  };
+
+  std::unique_ptr<Cell[]> fCells;
+  size_t fMask;
+  alignas(64) std::atomic<size_t> fPushPos{0};
+  alignas(64) std::atomic<size_t> fPopPos{0};
+};
+
+// Current time as UTC ISO 8601 with milliseconds
+static std::string isoTime() {
+  auto now = std::chrono::system_clock::now();
+  std::time_t seconds = std::chrono::system_clock::to_time_t(now);
+  long ms = (long)(std::chrono::duration_cast<std::chrono::milliseconds>(
+                       now.time_since_epoch())
+                       .count() %
+                   1000);
+  struct tm utc;
+  gmtime_r(&seconds, &utc);
+  char buffer[64];
+  std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d:%02d:%02d.%03ldZ",
+                utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour,
+                utc.tm_min, utc.tm_sec, ms);
+  return buffer;
+}
+
+// Reads an integer setting
+static long intSetting(const std::string &key, long defaultValue) {
+  std::string value = configValue(key, std::to_string(defaultValue));
+  return value.empty() ? defaultValue : std::atol(value.c_str());
+}
+
+// The log file and its writer thread, started on first use and stopped
+// when the server exits (after writing what is queued)
+class RequestLog {
+public:
+  RequestLog()
+      : fPath(configValue("log_file", LOG_FILE)),
+        fMaxBytes(intSetting("log_max_mb", LOG_MAX_MB) * 1024 * 1024),
+        fKeptFiles((int)intSetting("log_files", LOG_FILES)),
+        fQueue(LOG_QUEUE_SIZE) {
+    if (!fPath.empty()) {
+      fWriter = std::thread([this]() { writeLoop(); });
+    }
+  }
+
+  ~RequestLog() {
+    fStop = true;
+    if (fWriter.joinable()) {
+      fWriter.join();
+    }
+  }
+
+  bool enabled() const { return !fPath.empty(); }
+
+  void push(std::string &line) {
+    if (fQueue.push(line)) {
+      fQueued++;
+    } else {
+      fDropped++;
+    }
+  }
+
+  void flush() {
+    while (fWritten.load() < fQueued.load() && fWriter.joinable()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+private:
+  void writeLoop() {
+    if (fPath.compare(0, WORK_DIR.size(), WORK_DIR) == 0) {
+      ensureWorkDir();
+    }
+    open();
+    std::string line;
+    for (;;) {
+      bool stopping = fStop.load();
+      bool wrote = false;
+      if (long dropped = fDropped.exchange(0)) {
+        write(json({{"time", isoTime()}, {"dropped", dropped}}).dump());
+      }
+      while (fQueue.pop(line)) {
+        write(line);
+        fWritten++;
+        wrote = true;
+      }
+      if (wrote) {
+        fFile.flush();
+      }
+      if (stopping) {
+        break;
+      }
+      if (!wrote) {
+        std::this_thread::sleep_for(LOG_WRITER_IDLE);
+      }
+    }
+  }
+
+  void open() {
+    fFile.open(fPath, std::ios::app | std::ios::binary);
+    fFile.seekp(0, std::ios::end);
+    fSize = fFile.good() ? (long)fFile.tellp() : 0;
+  }
+
+  void write(const std::string &line) {
+    if (fMaxBytes > 0 && fSize > 0 &&
+        fSize + (long)line.size() + 1 > fMaxBytes) {
+      rotate();
+    }
+    fFile << line << '\n';
+    fSize += (long)line.size() + 1;
+  }
+
+  // <file>.<n-1> -> <file>.<n>, ..., <file> -> <file>.1
+  void rotate() {
+    fFile.close();
+    if (fKeptFiles <= 0) {
+      std::remove(fPath.c_str());
+    }
+    for (int i = fKeptFiles; i >= 1; i--) {
+      std::string from = (i == 1) ? fPath : fPath + "." + std::to_string(i - 1);
+      std::rename(from.c_str(), (fPath + "." + std::to_string(i)).c_str());
+    }
+    open();
+  }
+
+  std::string fPath;
+  long fMaxBytes;
+  int fKeptFiles;
+  LineQueue fQueue;
+  std::ofstream fFile;
+  long fSize = 0;
+  std::atomic<bool> fStop{false};
+  std::atomic<long> fQueued{0};
+  std::atomic<long> fWritten{0};
+  std::atomic<long> fDropped{0};
+  std::thread fWriter;
+};
+
+static RequestLog &requestLog() {
+  static RequestLog log;
+  return log;
+}
+
+void logRequest(const json &entry) {
+  RequestLog &log = requestLog();
+  if (!log.enabled()) {
+    return;
+  }
+  json line = {{"time", isoTime()}};
+  line.update(entry);
+  std::string text = line.dump();
+  log.push(text);
+}
+
+void flushRequestLog() { requestLog().flush(); }
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// ============================================================================
+// Request Log
+// ============================================================================
+
+/**
+ * @brief Append one line to the request log, without blocking
+ *
+ * The entry is serialized by the caller and handed to the writer thread
+ * through a bounded lock-free queue: when the queue is full (the disk is
+ * slower than the requests), the line is dropped and counted instead of
+ * delaying the response, and the next written line notes the number of
+ * dropped lines ({"dropped": n}).
+ *
+ * Lines are JSON objects, one per request, appended to the log_file setting
+ * (default: requests.log in the work directory, empty disables the log).
+ * When the file exceeds log_max_mb, it is renamed to <file>.1 (the previous
+ * <file>.1 to <file>.2, and so on, keeping log_files old files) and a new
+ * file is started. A "time" field (UTC, ISO 8601) is added to each entry.
+ */
+void logRequest(const json &entry);
+
+/**
+ * @brief Wait until every line logged so far is written to the file
+ */
+void flushRequestLog();
@@ -9,6 +9,7 @@
 #include <unordered_map>
 
 #include "json.hpp"
+#include "cancellation.hh"
 
 using json = nlohmann::json;
 
@@ -42,7 +43,10 @@ public:
   /**
    * @brief Execute the tool with given arguments
    * @param arguments JSON string containing the tool's input parameters
+   * @param cancel Cancellation token of the request; tools pass it to the
+   *        child processes they launch so that those can be killed
    * @return JSON array containing MCP-structured content items
    */
-  virtual json call(const std::string &arguments) = 0;
+  virtual json call(const std::string &arguments,
+                    const CancellationToken &cancel) = 0;
 };
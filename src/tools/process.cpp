@@ -0,0 +1,356 @@
+#include "process.hh"
+#include "config.hh"
+#include "stats.hh"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Delay between SIGTERM and SIGKILL for cancelled children
+static const std::chrono::milliseconds KILL_GRACE_PERIOD(500);
+
+// Converts a waitpid() status into a shell-like exit code
+static int decodeStatus(int status) {
+  if (WIFEXITED(status)) {
+    return WEXITSTATUS(status);
+  }
+  if (WIFSIGNALED(status)) {
+    return 128 + WTERMSIG(status);
+  }
+  return -1;
+}
+
+// Resource ids are an enum in glibc and plain ints in musl
+typedef decltype(RLIMIT_CPU) ResourceId;
+
+// Sets one rlimit of the calling process (the child, before exec)
+static bool setLimit(ResourceId resource, rlim_t soft, rlim_t hard) {
+  struct rlimit rl;
+  rl.rlim_cur = soft;
+  rl.rlim_max = hard;
+  return setrlimit(resource, &rl) == 0;
+}
+
+// Steps of the child before exec, reported with errno when one fails
+enum SpawnStep { SPAWN_STDIO, SPAWN_DIRECTORY, SPAWN_LIMITS, SPAWN_EXEC };
+
+struct SpawnFailure {
+  int step;
+  int error;
+};
+
+// Applies the CPU and memory limits to the calling process. The CPU soft
+// limit sends SIGXCPU, the hard limit one second later SIGKILL
+static bool applyLimits(const ProcessLimits &limits) {
+  if (limits.cpuSeconds > 0 &&
+      !setLimit(RLIMIT_CPU, limits.cpuSeconds, limits.cpuSeconds + 1)) {
+    return false;
+  }
+  rlim_t bytes = (rlim_t)limits.memoryMB * 1024 * 1024;
+  return limits.memoryMB <= 0 || setLimit(RLIMIT_AS, bytes, bytes);
+}
+
+// Body of the vfork() child: sets up its process group, stdio, directory
+// and limits, then execs the program, so that the program never runs
+// without its limits. It shares the memory of the caller, so it only makes
+// system calls on data prepared beforehand, and reports a failure on
+// statusFd (close-on-exec: EOF means that the exec succeeded).
+static void childExec(char *const args[], const char *workDir,
+                      const ProcessLimits &limits, int outFd, int errFd,
+                      int statusFd, const sigset_t &signals) {
+  // Own process group so that cancel() reaches everything the child starts
+  setpgid(0, 0);
+  sigprocmask(SIG_SETMASK, &signals, nullptr);
+
+  SpawnFailure failure = {SPAWN_EXEC, 0};
+  int nullFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+  if (nullFd < 0 || dup2(nullFd, STDIN_FILENO) < 0 ||
+      dup2(outFd, STDOUT_FILENO) < 0 || dup2(errFd, STDERR_FILENO) < 0) {
+    failure.step = SPAWN_STDIO;
+  } else if (workDir && chdir(workDir) != 0) {
+    failure.step = SPAWN_DIRECTORY;
+  } else if (!applyLimits(limits)) {
+    failure.step = SPAWN_LIMITS;
+  } else {
+    execvp(args[0], args);
+  }
+  failure.error = errno;
+  if (write(statusFd, &failure, sizeof(failure)) < 0) {
+    // nothing more can be reported
+  }
+  _exit(127);
+}
+
+// Reads what is available on a non-blocking pipe (one buffer at most, so
+// that a fast writer does not hold the caller), closes it at EOF
+static void drainPipe(int &fd, std::string &output) {
+  char buffer[65536];
+  while (fd >= 0) {
+    ssize_t n = read(fd, buffer, sizeof(buffer));
+    if (n > 0) {
+      output.append(buffer, n);
+      return;
+    } else if (n == 0 || errno != EINTR) {
+      if (n == 0) {
+        close(fd);
+        fd = -1;
+      }
+      return;
+    }
+  }
+}
+
+// Spawns a program in its own process group, killable through the token
+ProcessResult runProcess(const std::vector<std::string> &argv,
+                         const CancellationToken &cancel,
+                         const ProcessLimits &limits,
+                         const std::string &workDir) {
+  ProcessResult result{-1, false, false, 0, "", ""};
+  auto startTime = std::chrono::steady_clock::now();
+
+  if (cancel.isCancelled()) {
+    result.cancelled = true;
+    return result;
+  }
+  if (argv.empty()) {
+    return result;
+  }
+
+  // Close-on-exec pipes, so that children spawned concurrently by other
+  // requests do not inherit them (and keep them open)
+  int outPipe[2], errPipe[2], statusPipe[2];
+  if (pipe2(outPipe, O_CLOEXEC) != 0) {
+    return result;
+  }
+  if (pipe2(errPipe, O_CLOEXEC) != 0) {
+    close(outPipe[0]);
+    close(outPipe[1]);
+    return result;
+  }
+  if (pipe2(statusPipe, O_CLOEXEC) != 0) {
+    close(outPipe[0]);
+    close(outPipe[1]);
+    close(errPipe[0]);
+    close(errPipe[1]);
+    return result;
+  }
+
+  std::vector<char *> args;
+  for (const auto &arg : argv) {
+    args.push_back(const_cast<char *>(arg.c_str()));
+  }
+  args.push_back(nullptr);
+  sigset_t noSignals;
+  sigemptyset(&noSignals);
+
+  // vfork: the caller is suspended until the child has exec'd (or exited),
+  // without copying its address space
+  pid_t pid = vfork();
+  if (pid == 0) {
+    childExec(args.data(), workDir.empty() ? nullptr : workDir.c_str(),
+              limits, outPipe[1], errPipe[1], statusPipe[1], noSignals);
+  }
+  int forkError = errno;
+  close(outPipe[1]);
+  close(errPipe[1]);
+  close(statusPipe[1]);
+
+  SpawnFailure failure = {SPAWN_EXEC, forkError};
+  bool started = pid > 0;
+  if (started) {
+    ssize_t n;
+    do {
+      n = read(statusPipe[0], &failure, sizeof(failure));
+    } while (n < 0 && errno == EINTR);
+    if (n > 0) {
+      waitpid(pid, nullptr, 0);
+      started = false;
+    }
+  }
+  close(statusPipe[0]);
+
+  if (!started) {
+    close(outPipe[0]);
+    close(errPipe[0]);
+    result.errorOutput = argv[0] + ": ";
+    if (failure.step == SPAWN_STDIO) {
+      result.errorOutput += "could not redirect its input and output: ";
+    } else if (failure.step == SPAWN_DIRECTORY) {
+      result.errorOutput += "could not enter " + workDir + ": ";
+    } else if (failure.step == SPAWN_LIMITS) {
+      result.errorOutput += "could not set its resource limits: ";
+    }
+    result.errorOutput += strerror(failure.error);
+    return result;
+  }
+
+  bool attached = cancel.attach(pid);
+  if (!attached) {
+    kill(-pid, SIGTERM);
+  }
+
+  int outFd = outPipe[0];
+  int errFd = errPipe[0];
+  fcntl(outFd, F_SETFL, O_NONBLOCK);
+  fcntl(errFd, F_SETFL, O_NONBLOCK);
+
+  bool terminated = !attached;
+  bool killed = false;
+  bool exited = false;
+  auto terminateTime = std::chrono::steady_clock::now();
+  int status = 0;
+  struct rusage usage = {};
+
+  // A pidfd becomes readable when the child exits, so that the loop wakes
+  // up immediately instead of at the next tick (Linux >= 5.3)
+#ifdef SYS_pidfd_open
+  int pidFd = (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+  int pidFd = -1;
+#endif
+
+  // The child is only reaped at the end: until then it stays a zombie, so
+  // its pid cannot be reused and kill(-pid) reaches its group and no other
+  while (!(exited && outFd < 0 && errFd < 0)) {
+    // Wait for output or exit, or for the next cancellation/timeout check.
+    // Without pidfd, check more often once both pipes are closed
+    struct pollfd pfds[3] = {{outFd, POLLIN, 0},
+                             {errFd, POLLIN, 0},
+                             {exited ? -1 : pidFd, POLLIN, 0}};
+    bool pipesClosed = outFd < 0 && errFd < 0;
+    int ready = poll(pfds, 3, (pipesClosed && pidFd < 0) ? 1 : 10);
+
+    drainPipe(outFd, result.output);
+    drainPipe(errFd, result.errorOutput);
+
+    auto now = std::chrono::steady_clock::now();
+    if (limits.timeoutMs > 0 && !result.timedOut &&
+        now - startTime > std::chrono::milliseconds(limits.timeoutMs)) {
+      result.timedOut = true;
+    }
+    bool stopping = cancel.isCancelled() || result.timedOut;
+
+    // Once the child is gone, stop when nothing more arrives, or when the
+    // request is cancelled or out of time (a detached grandchild may keep
+    // the pipes open and keep writing)
+    if (exited) {
+      if (ready == 0 || stopping) {
+        break;
+      }
+      continue;
+    }
+
+    siginfo_t info = {};
+    if (waitid(P_PID, pid, &info, WEXITED | WNOHANG | WNOWAIT) != 0) {
+      status = -1;
+      exited = true;
+      continue;
+    }
+    if (info.si_pid == pid) {
+      exited = true;
+      continue; // one more poll to collect the last output
+    }
+
+    // Cancellation or timeout: SIGTERM once, then SIGKILL after grace period
+    if (stopping) {
+      if (!terminated) {
+        kill(-pid, SIGTERM);
+        terminated = true;
+        terminateTime = now;
+      } else if (!killed && now - terminateTime > KILL_GRACE_PERIOD) {
+        kill(-pid, SIGKILL);
+        killed = true;
+      }
+    }
+  }
+
+  // Kill any leftover process of the group (e.g. background grandchildren)
+  // while the child is not reaped, then reap it
+  if (cancel.isCancelled() || result.timedOut) {
+    kill(-pid, SIGKILL);
+  }
+  if (status != -1 && wait4(pid, &status, 0, &usage) != pid) {
+    status = -1;
+  }
+  cancel.detach(pid);
+
+  if (pidFd >= 0) {
+    close(pidFd);
+  }
+  if (outFd >= 0) {
+    close(outFd);
+  }
+  if (errFd >= 0) {
+    close(errFd);
+  }
+
+  result.exitCode = (status == -1) ? -1 : decodeStatus(status);
+  result.cancelled = cancel.isCancelled();
+  auto elapsed = std::chrono::steady_clock::now() - startTime;
+  result.elapsedMs =
+      std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+  result.cpuMs = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000L +
+                 (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+  if (!limits.stage.empty()) {
+    recordStageTime(
+        limits.stage,
+        std::chrono::duration<double, std::milli>(elapsed).count(),
+        (double)result.cpuMs, result.exitCode);
+  }
+  return result;
+}
+
+// Reads an integer setting (or keeps the default)
+static int limitSetting(const std::string &prefix, const std::string &stage,
+                        int defaultValue) {
+  std::string value = configValue(prefix + stage, "");
+  return value.empty() ? defaultValue : std::atoi(value.c_str());
+}
+
+// Returns the limits of a stage: config.hh defaults + settings overrides
+ProcessLimits stageLimits(const std::string &stage) {
+  int timeout = 0, cpu = 0, memory = 0;
+  for (const auto &d : STAGE_LIMIT_DEFAULTS) {
+    if (stage == d.stage) {
+      timeout = d.timeout;
+      cpu = d.cpu;
+      memory = d.memory;
+    }
+  }
+
+  ProcessLimits limits;
+  limits.stage = stage;
+  limits.timeoutMs = limitSetting("timeout_", stage, timeout) * 1000;
+  limits.cpuSeconds = limitSetting("cpu_", stage, cpu);
+  limits.memoryMB = limitSetting("memory_", stage, memory);
+  return limits;
+}
+
+// A child killed by SIGXCPU has used up its CPU time (RLIMIT_CPU, or the
+// docker --ulimit cpu of the Faust container, whose exit code is forwarded)
+bool limitExceeded(const ProcessResult &result) {
+  return !result.cancelled &&
+         (result.timedOut || result.exitCode == 128 + SIGXCPU);
+}
+
+// Builds the structured error returned when a stage exceeds its limits
+json limitErrorContent(const std::string &stage, const ProcessResult &result,
+                       const ProcessLimits &limits) {
+  json error = {
+      {"error", result.timedOut ? "timeout" : "cpu_limit"},
+      {"stage", stage},
+      {"elapsed_ms", result.elapsedMs},
+      {"limits",
+       {{"timeout_ms", limits.timeoutMs},
+        {"cpu_s", limits.cpuSeconds},
+        {"memory_mb", limits.memoryMB}}}};
+
+  return json::array({{{"type", "text"}, {"text", error.dump()}}});
+}
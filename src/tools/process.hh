@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+#include "cancellation.hh"
+
+using json = nlohmann::json;
+
+// ============================================================================
+// Child Process Runner
+// ============================================================================
+
+// Resource limits applied to a child process (0 means unlimited)
+struct ProcessLimits {
+  int timeoutMs = 0;  // wall-clock time, enforced by the runner
+  int cpuSeconds = 0; // CPU time (RLIMIT_CPU, child gets SIGXCPU)
+  int memoryMB = 0;   // address space (RLIMIT_AS)
+  std::string stage;  // timings recorded under this stage (see stats.hh)
+};
+
+struct ProcessResult {
+  int exitCode;        // exit status, 128+signal if killed, -1 if not started
+  bool cancelled;      // true if the request was cancelled while running
+  bool timedOut;       // true if killed for exceeding the wall-clock limit
+  long elapsedMs;      // wall-clock time until the child was reaped
+  std::string output;      // captured stdout
+  std::string errorOutput; // captured stderr
+  long cpuMs = 0;          // user + system CPU time of the child and of the
+                           // descendants it waited for
+};
+
+/**
+ * @brief Run a program as a killable child process and capture its output
+ *
+ * The program is started with vfork() and execvp() from an argv vector (no
+ * shell, so arguments are never interpreted) in its own process group,
+ * registered with the cancellation token. stdout and stderr are captured
+ * through pipes drained with poll(), stdin is /dev/null. If the request is
+ * cancelled, the whole group gets SIGTERM, then SIGKILL after a short grace
+ * period, and the call returns with cancelled = true as soon as the child
+ * has been reaped. The same termination sequence is used when the
+ * wall-clock limit is exceeded (timedOut = true). Output still arriving
+ * after the child exits (from a grandchild holding the pipes) is collected
+ * until the request is cancelled or out of time, and the group is killed
+ * before the child is reaped, while its process group id cannot be reused.
+ * CPU and memory limits are set by the child before exec (the run fails,
+ * with exitCode -1 and the cause in errorOutput, if they cannot be set) and
+ * are inherited by everything it launches. The wall-clock and CPU time of
+ * the run are recorded under limits.stage (see recordStageTime()).
+ *
+ * @param argv Program (looked up in PATH) followed by its arguments
+ * @param cancel Cancellation token of the calling request
+ * @param limits Wall-clock, CPU and memory limits for this stage
+ * @param workDir Current directory of the child (empty: inherited)
+ */
+ProcessResult runProcess(const std::vector<std::string> &argv,
+                         const CancellationToken &cancel,
+                         const ProcessLimits &limits = ProcessLimits(),
+                         const std::string &workDir = "");
+
+/**
+ * @brief Limits of a processing stage, e.g. "spectrogram_run"
+ *
+ * Defaults come from config.hh and can be overridden per stage with the
+ * settings timeout_<stage> (seconds), cpu_<stage> (seconds) and
+ * memory_<stage> (MB), i.e. the environment variables
+ * FAUST_MCP_TIMEOUT_<STAGE>, FAUST_MCP_CPU_<STAGE>, FAUST_MCP_MEMORY_<STAGE>
+ * or the same keys in the config file (see configValue()). The stage name
+ * is kept in the limits, so that runs are timed per stage.
+ */
+ProcessLimits stageLimits(const std::string &stage);
+
+/**
+ * @brief Whether a run was stopped by one of its limits
+ */
+bool limitExceeded(const ProcessResult &result);
+
+/**
+ * @brief Structured MCP error content for a run stopped by its limits
+ *
+ * The text item holds a JSON object such as
+ * {"error":"timeout","stage":"spectrogram_run","elapsed_ms":30012,
+ *  "limits":{"timeout_ms":30000,"cpu_s":20,"memory_mb":1024}}
+ * where error is "timeout" (wall clock) or "cpu_limit" (SIGXCPU).
+ */
+json limitErrorContent(const std::string &stage, const ProcessResult &result,
+                       const ProcessLimits &limits);
@@ -0,0 +1,188 @@
+/************************************************************************
+ IMPORTANT NOTE : this file contains two clearly delimited sections :
+ the ARCHITECTURE section (in two parts) and the USER section. Each section
+ is governed by its own copyright and license. Please check individually
+ each section for license and copyright information.
+ *************************************************************************/
+
+/******************* BEGIN render.cpp ****************/
+/************************************************************************
+ FAUST Architecture File - Audio Renderer
+ Copyright (C) 2026 Yann Orlarey
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************
+ ************************************************************************/
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "faust_dsp.hh"
+
+/******************************************************************************
+ *******************************************************************************
+
+ VECTOR INTRINSICS
+
+ *******************************************************************************
+ *******************************************************************************/
+
+<< includeIntrinsic >>
+
+/********************END ARCHITECTURE SECTION (part 1/2)****************/
+
+/**************************BEGIN USER SECTION **************************/
+
+<< includeclass >>
+
+/***************************END USER SECTION ***************************/
+
+/*******************BEGIN ARCHITECTURE SECTION (part 2/2)***************/
+
+//==============================================================================
+// Note Synthesis and Audio Encoding
+//==============================================================================
+
+// Shared with the spectrogram architecture and the in-process engines of
+// the MCP server (the g++ command line gets -I with the directory of this
+// architecture file)
+#include "audio_encoding.hh"
+#include "spectrogram_synth.hh"
+
+//==============================================================================
+// Command Line Parser
+//==============================================================================
+
+struct RenderOptions {
+  Options note;       // duration, gate_duration, frequency, gain, sample_rate
+  int block_size;     // samples per compute() call
+  std::string format; // wav or flac
+  int bits;           // 16 or 24
+
+  RenderOptions() : block_size(RENDER_BLOCK_SIZE), format("wav"), bits(16) {}
+};
+
+void printUsage(const char *program_name) {
+  std::cerr << "Usage: " << program_name
+            << " [OPTIONS] <duration> <gate_duration> <frequency> <gain>\n\n";
+  std::cerr << "Renders one note (gate on for gate_duration seconds) and "
+               "writes the encoded\naudio of all output channels to "
+               "stdout.\n\n";
+  std::cerr << "Options:\n";
+  std::cerr << "  -sr <rate>       Sample rate (default: 44100)\n";
+  std::cerr << "  -block <size>    Samples per compute() call (default: "
+            << RENDER_BLOCK_SIZE << ")\n";
+  std::cerr << "  -format <type>   wav|flac (default: wav)\n";
+  std::cerr << "  -bits <n>        16|24 (default: 16)\n\n";
+}
+
+bool parseCommandLine(int argc, char *argv[], RenderOptions &opts) {
+  int pos_arg_index = 0;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+
+    if (arg == "-sr" && i + 1 < argc) {
+      opts.note.sample_rate = atoi(argv[++i]);
+    } else if (arg == "-block" && i + 1 < argc) {
+      opts.block_size = atoi(argv[++i]);
+    } else if (arg == "-format" && i + 1 < argc) {
+      opts.format = argv[++i];
+    } else if (arg == "-bits" && i + 1 < argc) {
+      opts.bits = atoi(argv[++i]);
+    } else if (arg[0] == '-' && !(arg.size() > 1 && isdigit(arg[1]))) {
+      std::cerr << "Unknown option: " << arg << std::endl;
+      return false;
+    } else {
+      // Positional arguments
+      switch (pos_arg_index) {
+      case 0:
+        opts.note.duration = atof(argv[i]);
+        break;
+      case 1:
+        opts.note.gate_duration = atof(argv[i]);
+        break;
+      case 2:
+        opts.note.frequency = atof(argv[i]);
+        break;
+      case 3:
+        opts.note.gain = atof(argv[i]);
+        break;
+      default:
+        std::cerr << "Too many positional arguments" << std::endl;
+        return false;
+      }
+      pos_arg_index++;
+    }
+  }
+
+  if (pos_arg_index != 4) {
+    printUsage(argv[0]);
+    return false;
+  }
+
+  return true;
+}
+
+//==============================================================================
+// Main
+//==============================================================================
+
+int main(int argc, char *argv[]) {
+  RenderOptions opts;
+  if (!parseCommandLine(argc, argv, opts)) {
+    return 1;
+  }
+
+  // Create DSP instance and collect its parameters (gate, freq and gain are
+  // driven when present)
+  mydsp dsp;
+  SpectrogramUI ui;
+  dsp.buildUserInterface(&ui);
+  dsp.init(opts.note.sample_rate);
+
+  std::vector<std::vector<float>> channels;
+  renderAudio(dsp, ui, opts.note, opts.block_size, channels);
+
+  std::vector<unsigned char> encoded;
+  if (!encodeAudio(opts.format, channels, opts.note.sample_rate, opts.bits,
+                   encoded)) {
+    std::cerr << "Error: cannot encode " << channels.size()
+              << " channel(s) as " << opts.bits << "-bit " << opts.format
+              << std::endl;
+    return 1;
+  }
+
+  // The encoded file goes to stdout, captured by the server
+  if (fwrite(encoded.data(), 1, encoded.size(), stdout) != encoded.size() ||
+      fflush(stdout) != 0) {
+    return 1;
+  }
+
+  return 0;
+}
+
+/******************* END render.cpp ****************/
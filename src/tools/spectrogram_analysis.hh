@@ -0,0 +1,1400 @@
+/************************************************************************
+ FAUST Architecture File - Spectrogram Analysis
+ Copyright (C) 2026 Yann Orlarey
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************
+ ************************************************************************/
+
+/*
+ Analysis part of the spectrogram generator: window, STFT, mel filterbank,
+ dB scaling, colormaps and PNG encoding. It does not depend on Faust and
+ is shared by the spectrogram.cpp architecture (compiled per request) and
+ the in-process engines of the MCP server, so nothing here writes to
+ stdout.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <csetjmp>
+#include <cstdio>
+#include <fftw3.h>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <png.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+//==============================================================================
+// Options
+//==============================================================================
+
+struct Options {
+  // Positional arguments
+  float duration;
+  float gate_duration;
+  float frequency;
+  float gain;
+
+  // Audio options
+  int sample_rate;
+  std::string channel_mode;
+
+  // FFT options
+  int fft_size;
+  int hop_size;
+  std::string window_type;
+  std::string padding;
+
+  // Transform: "stft" (frequency_scale rows) or "cqt" (constant-Q,
+  // bins_per_octave bins per octave from fmin)
+  std::string transform;
+  int bins_per_octave;
+
+  // Rows of the STFT: "mel" (mel filterbank of mel_bands bands), "linear"
+  // or "log" (mel_bands rows of FFT bins, see createFrequencyRows())
+  std::string frequency_scale;
+
+  // Mel options
+  int mel_bands;
+  float fmin;
+  float fmax;
+
+  // Image options
+  std::string output_file;
+  float scale;
+  float hscale;
+  float vscale;
+  std::string colormap;
+  std::string layout;
+
+  // Visual elements
+  bool colorbar;
+  bool title;
+  bool axes;
+  bool legend;
+  bool gate_line;
+  std::string gate_color;
+  std::string gate_style;
+
+  // Amplitude
+  bool use_db;
+  float db_min;
+
+  // Numeric output instead of an image: "float32" or "float16" matrix
+  // (spectrogram_matrix.hh), optionally zlib-compressed
+  std::string matrix_type;
+  bool matrix_zlib;
+
+  // Constructor with defaults
+  Options()
+      : duration(0), gate_duration(0), frequency(0), gain(0),
+        sample_rate(44100), channel_mode("first"), fft_size(2048),
+        hop_size(512), window_type("hann"), padding("none"),
+        transform("stft"), bins_per_octave(24), frequency_scale("mel"),
+        mel_bands(128), fmin(0), fmax(-1), output_file(""), scale(1.0),
+        hscale(1.0), vscale(1.0), colormap("hot"), layout("full"),
+        colorbar(true), title(true), axes(true), legend(true), gate_line(true),
+        gate_color("red"), gate_style("dashed"), use_db(false), db_min(-80.0),
+        matrix_type(""), matrix_zlib(false) {}
+};
+
+//==============================================================================
+// DSP and Signal Processing Functions
+//==============================================================================
+
+// Window functions
+inline std::vector<float> createWindow(int size, const std::string &type) {
+  std::vector<float> window(size);
+
+  for (int i = 0; i < size; i++) {
+    float x = (float)i / (size - 1);
+
+    if (type == "hann") {
+      window[i] = 0.5f * (1.0f - std::cos(2.0f * M_PI * x));
+    } else if (type == "hamming") {
+      window[i] = 0.54f - 0.46f * std::cos(2.0f * M_PI * x);
+    } else if (type == "blackman") {
+      window[i] = 0.42f - 0.5f * std::cos(2.0f * M_PI * x) +
+                  0.08f * std::cos(4.0f * M_PI * x);
+    } else {
+      window[i] = 1.0f; // Rectangular
+    }
+  }
+
+  return window;
+}
+
+// Hz to Mel conversion
+inline float hzToMel(float hz) {
+  return 2595.0f * std::log10(1.0f + hz / 700.0f);
+}
+
+// Mel to Hz conversion
+inline float melToHz(float mel) {
+  return 700.0f * (std::pow(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+// Edges of the mel bands in Hz, equally spaced on the mel scale (n_mels + 2
+// points: band i rises from edge i, peaks at i + 1 and falls to i + 2)
+inline std::vector<float> melBandEdges(int n_mels, float fmin, float fmax) {
+  // Convert to mel scale
+  float mel_min = hzToMel(fmin);
+  float mel_max = hzToMel(fmax);
+
+  std::vector<float> edges(n_mels + 2);
+  for (int i = 0; i < n_mels + 2; i++) {
+    edges[i] = melToHz(mel_min + (mel_max - mel_min) * i / (n_mels + 1));
+  }
+  return edges;
+}
+
+// Create mel filterbank
+inline std::vector<std::vector<float>>
+createMelFilterbank(int n_mels, int fft_size, int sample_rate, float fmin,
+                    float fmax) {
+
+  // Mel points (n_mels + 2 for edges) in Hz, then FFT bins
+  std::vector<float> edges = melBandEdges(n_mels, fmin, fmax);
+  std::vector<int> bin_points(n_mels + 2);
+  int n_fft_bins = fft_size / 2 + 1;
+  for (int i = 0; i < n_mels + 2; i++) {
+    bin_points[i] = (int)std::floor((fft_size + 1) * edges[i] / sample_rate);
+  }
+
+  // Create triangular filters
+  std::vector<std::vector<float>> filterbank(n_mels);
+  for (int i = 0; i < n_mels; i++) {
+    filterbank[i].resize(n_fft_bins, 0.0f);
+
+    int left = bin_points[i];
+    int center = bin_points[i + 1];
+    int right = bin_points[i + 2];
+
+    // Rising slope
+    for (int j = left; j < center; j++) {
+      filterbank[i][j] = (float)(j - left) / (center - left);
+    }
+
+    // Falling slope
+    for (int j = center; j < right; j++) {
+      filterbank[i][j] = (float)(right - j) / (right - center);
+    }
+  }
+
+  return filterbank;
+}
+
+// Rows of a linear or log frequency scale, lowest first. Instead of a
+// filterbank, each row takes the largest magnitude of its STFT bins
+// [first, last], so no partial falls between two rows and a frame costs
+// one comparison per bin.
+struct FrequencyRows {
+  std::vector<int> first;
+  std::vector<int> last;
+  std::vector<float> centers; // Hz
+};
+
+// linear: the bins from fmin to fmax split into n_rows consecutive groups
+//         (one bin per row, without interpolation, when n_rows is at least
+//         the number of bins)
+// log:    n_rows geometrically spaced centers from fmin (at least one bin)
+//         to fmax, each row covering the bins closer to its center than to
+//         the neighbouring ones, or the nearest bin
+inline FrequencyRows createFrequencyRows(const std::string &scale, int n_rows,
+                                         int fft_size, int sample_rate,
+                                         float fmin, float fmax) {
+  FrequencyRows rows;
+  float bin_hz = (float)sample_rate / fft_size;
+  int n_fft_bins = fft_size / 2 + 1;
+  int lo = std::min(n_fft_bins - 1, std::max(0, (int)std::ceil(fmin / bin_hz)));
+  int hi = std::min(n_fft_bins - 1, (int)std::floor(fmax / bin_hz));
+  hi = std::max(lo, hi);
+  n_rows = std::max(1, n_rows);
+
+  if (scale != "log") {
+    int count = hi - lo + 1;
+    n_rows = std::min(n_rows, count);
+    for (int r = 0; r < n_rows; r++) {
+      int first = lo + (int)((long)r * count / n_rows);
+      int last = lo + (int)((long)(r + 1) * count / n_rows) - 1;
+      rows.first.push_back(first);
+      rows.last.push_back(last);
+      rows.centers.push_back(0.5f * (first + last) * bin_hz);
+    }
+    return rows;
+  }
+
+  lo = std::min(std::max(lo, 1), hi);
+  float f_lo = lo * bin_hz;
+  float f_hi = hi * bin_hz;
+  for (int r = 0; r < n_rows; r++) {
+    float t = (n_rows > 1) ? (float)r / (n_rows - 1) : 0.0f;
+    rows.centers.push_back(f_lo * std::pow(f_hi / f_lo, t));
+  }
+  for (int r = 0; r < n_rows; r++) {
+    // Boundaries halfway (geometrically) between neighbouring centers
+    float lower = (r == 0) ? f_lo
+                           : std::sqrt(rows.centers[r - 1] * rows.centers[r]);
+    float upper = (r == n_rows - 1)
+                      ? f_hi + bin_hz
+                      : std::sqrt(rows.centers[r] * rows.centers[r + 1]);
+    int first = std::max(lo, (int)std::ceil(lower / bin_hz));
+    int last = std::min(hi, (int)std::ceil(upper / bin_hz) - 1);
+    if (first > last) {
+      first = last = std::min(hi, std::max(lo, (int)std::lround(
+                                                   rows.centers[r] / bin_hz)));
+    }
+    rows.first.push_back(first);
+    rows.last.push_back(last);
+  }
+  return rows;
+}
+
+// Rows of a frame of STFT magnitudes
+inline void applyFrequencyRows(const std::vector<float> &magnitudes,
+                               const FrequencyRows &rows,
+                               std::vector<float> &frame) {
+  frame.resize(rows.first.size());
+  for (size_t r = 0; r < rows.first.size(); r++) {
+    float value = magnitudes[rows.first[r]];
+    for (int bin = rows.first[r] + 1; bin <= rows.last[r]; bin++) {
+      value = std::max(value, magnitudes[bin]);
+    }
+    frame[r] = value;
+  }
+}
+
+// FFTW planning is not thread-safe: plans are created and destroyed under
+// this lock (executing a plan is safe)
+inline std::mutex &fftwPlannerMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// Framing of the STFT (Options::padding):
+//  none     frames start at k * hop_size and lie inside the signal: the tail
+//           after the last full frame is dropped, and a signal shorter than
+//           fft_size has no frame
+//  zero     frames are centered on k * hop_size, the signal being extended
+//  reflect  by fft_size / 2 samples on each side, with silence (zero) or its
+//           mirror image without repeating the edge sample (reflect); a
+//           signal of n samples has 1 + n / hop_size frames, the last ones
+//           covering the tail
+inline bool isCenteredPadding(const std::string &padding) {
+  return padding == "zero" || padding == "reflect";
+}
+
+// Number of frames of a signal of num_samples samples
+inline int stftFrameCount(size_t num_samples, int fft_size, int hop_size,
+                          const std::string &padding) {
+  if (hop_size <= 0 || num_samples == 0) {
+    return 0;
+  }
+  if (isCenteredPadding(padding)) {
+    return 1 + num_samples / hop_size;
+  }
+  if (num_samples < (size_t)fft_size) {
+    return 0;
+  }
+  return (num_samples - fft_size) / hop_size + 1;
+}
+
+// Index of the first sample of a frame (negative for the first centered
+// frames)
+inline long stftFrameStart(int frame, int fft_size, int hop_size,
+                           const std::string &padding) {
+  return (long)frame * hop_size -
+         (isCenteredPadding(padding) ? fft_size / 2 : 0);
+}
+
+// Index of the sample read at position i of a signal of n samples extended
+// by padding: i itself inside the signal, -1 (silence) outside with zero
+// padding, the mirrored sample with reflect padding (folded again when the
+// signal is shorter than the padding)
+inline long paddedIndex(long i, long n, bool reflect) {
+  if (i >= 0 && i < n) {
+    return i;
+  }
+  if (!reflect || n <= 0) {
+    return -1;
+  }
+  if (n == 1) {
+    return 0;
+  }
+  long period = 2 * (n - 1);
+  i = ((i % period) + period) % period;
+  return (i < n) ? i : period - i;
+}
+
+// Streams the STFT: calls frame_fn(frame, samples, magnitudes) for each
+// frame in order, with the input samples of the frame (fft_size, before
+// windowing) and its magnitude spectrum (fft_size / 2 + 1 bins), without
+// storing the spectrogram. Frames inside the signal are read in place; only
+// the frames overlapping the padding are assembled in a frame buffer.
+template <typename FrameFn>
+inline void forEachSTFTFrame(const std::vector<float> &audio, int fft_size,
+                             int hop_size, const std::vector<float> &window,
+                             const std::string &padding, FrameFn frame_fn) {
+  int n_frames = stftFrameCount(audio.size(), fft_size, hop_size, padding);
+  if (n_frames == 0) {
+    return;
+  }
+  long n = audio.size();
+  bool reflect = (padding == "reflect");
+  int n_bins = fft_size / 2 + 1;
+
+  float *in = (float *)fftwf_malloc(sizeof(float) * fft_size);
+  fftwf_complex *out =
+      (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n_bins);
+  fftwf_plan plan;
+  {
+    std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+    plan = fftwf_plan_dft_r2c_1d(fft_size, in, out, FFTW_ESTIMATE);
+  }
+
+  std::vector<float> padded(fft_size);
+  std::vector<float> magnitudes(n_bins);
+  for (int frame = 0; frame < n_frames; frame++) {
+    long start = stftFrameStart(frame, fft_size, hop_size, padding);
+    const float *samples;
+    if (start >= 0 && start + fft_size <= n) {
+      samples = &audio[start];
+    } else {
+      for (int i = 0; i < fft_size; i++) {
+        long index = paddedIndex(start + i, n, reflect);
+        padded[i] = (index < 0) ? 0.0f : audio[index];
+      }
+      samples = padded.data();
+    }
+
+    // Apply window and copy to FFT input
+    for (int i = 0; i < fft_size; i++) {
+      in[i] = samples[i] * window[i];
+    }
+
+    // Execute FFT
+    fftwf_execute(plan);
+
+    // Compute magnitude spectrum
+    for (int i = 0; i < n_bins; i++) {
+      float real = out[i][0];
+      float imag = out[i][1];
+      magnitudes[i] = std::sqrt(real * real + imag * imag);
+    }
+    frame_fn(frame, samples, magnitudes);
+  }
+
+  // Cleanup
+  {
+    std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+    fftwf_destroy_plan(plan);
+  }
+  fftwf_free(in);
+  fftwf_free(out);
+}
+
+// STFT computation (magnitudes, one vector per frame; no frame when the
+// signal is too short for the framing)
+inline std::vector<std::vector<float>>
+computeSTFT(const std::vector<float> &audio, int fft_size, int hop_size,
+            const std::vector<float> &window,
+            const std::string &padding = "none") {
+  std::vector<std::vector<float>> spectrogram;
+  forEachSTFTFrame(audio, fft_size, hop_size, window, padding,
+                   [&](int, const float *,
+                       const std::vector<float> &magnitudes) {
+                     spectrogram.push_back(magnitudes);
+                   });
+  return spectrogram;
+}
+
+// Apply mel filterbank to spectrogram
+inline std::vector<std::vector<float>>
+applyMelFilterbank(const std::vector<std::vector<float>> &spectrogram,
+                   const std::vector<std::vector<float>> &filterbank) {
+
+  int n_frames = spectrogram.size();
+  int n_mels = filterbank.size();
+
+  std::vector<std::vector<float>> mel_spec(n_frames);
+
+  for (int frame = 0; frame < n_frames; frame++) {
+    mel_spec[frame].resize(n_mels);
+
+    for (int mel = 0; mel < n_mels; mel++) {
+      float sum = 0.0f;
+      for (size_t bin = 0; bin < spectrogram[frame].size(); bin++) {
+        sum += spectrogram[frame][bin] * filterbank[mel][bin];
+      }
+      mel_spec[frame][mel] = sum;
+    }
+  }
+
+  return mel_spec;
+}
+
+// Convert to dB scale
+inline void convertToDb(std::vector<std::vector<float>> &mel_spec,
+                        float db_min) {
+  for (auto &frame : mel_spec) {
+    for (auto &val : frame) {
+      if (val > 0) {
+        val = 20.0f * std::log10(val);
+        val = std::max(val, db_min);
+      } else {
+        val = db_min;
+      }
+    }
+  }
+}
+
+// Normalize spectrogram to [0, 1]
+inline void normalizeSpectrogram(std::vector<std::vector<float>> &mel_spec) {
+  float min_val = 1e10f;
+  float max_val = -1e10f;
+
+  for (const auto &frame : mel_spec) {
+    for (float val : frame) {
+      min_val = std::min(min_val, val);
+      max_val = std::max(max_val, val);
+    }
+  }
+
+  float range = max_val - min_val;
+  if (range > 0) {
+    for (auto &frame : mel_spec) {
+      for (auto &val : frame) {
+        val = (val - min_val) / range;
+      }
+    }
+  }
+}
+
+// Normalize several spectrograms to [0, 1] with one common range, so that
+// their levels can be compared
+inline void
+normalizeSpectrograms(std::vector<std::vector<std::vector<float>>> &mel_specs) {
+  float min_val = 1e10f;
+  float max_val = -1e10f;
+
+  for (const auto &mel_spec : mel_specs) {
+    for (const auto &frame : mel_spec) {
+      for (float val : frame) {
+        min_val = std::min(min_val, val);
+        max_val = std::max(max_val, val);
+      }
+    }
+  }
+
+  float range = max_val - min_val;
+  if (range > 0) {
+    for (auto &mel_spec : mel_specs) {
+      for (auto &frame : mel_spec) {
+        for (auto &val : frame) {
+          val = (val - min_val) / range;
+        }
+      }
+    }
+  }
+}
+
+// Mel spectrogram of a signal, ready for display: STFT, mel filterbank (or
+// linear/log rows, see Options::frequency_scale), optional dB conversion,
+// normalized to [0, 1] unless 'normalize' is false
+inline std::vector<std::vector<float>>
+computeMelSpectrogram(const std::vector<float> &audio, const Options &opts,
+                      bool normalize = true) {
+  std::vector<float> window = createWindow(opts.fft_size, opts.window_type);
+  auto spectrogram = computeSTFT(audio, opts.fft_size, opts.hop_size, window,
+                                 opts.padding);
+  std::vector<std::vector<float>> mel_spec;
+  if (opts.frequency_scale == "mel") {
+    auto filterbank = createMelFilterbank(
+        opts.mel_bands, opts.fft_size, opts.sample_rate, opts.fmin, opts.fmax);
+    mel_spec = applyMelFilterbank(spectrogram, filterbank);
+  } else {
+    FrequencyRows rows =
+        createFrequencyRows(opts.frequency_scale, opts.mel_bands, opts.fft_size,
+                            opts.sample_rate, opts.fmin, opts.fmax);
+    mel_spec.resize(spectrogram.size());
+    for (size_t frame = 0; frame < spectrogram.size(); frame++) {
+      applyFrequencyRows(spectrogram[frame], rows, mel_spec[frame]);
+    }
+  }
+  if (opts.use_db) {
+    convertToDb(mel_spec, opts.db_min);
+  }
+  if (normalize) {
+    normalizeSpectrogram(mel_spec);
+  }
+  return mel_spec;
+}
+
+// Streaming mel spectrogram: samples are pushed as they are synthesized
+// into a ring buffer of fft_size + 1 samples; as soon as a frame is
+// complete it is windowed, transformed and projected on the mel
+// filterbank (or gathered into frequency rows), and only its bands are
+// kept. Memory is
+// O(fft_size + mel_bands x frames) whatever the duration, and the frames
+// are those of computeMelSpectrogram() on the whole signal (same framing,
+// same arithmetic). With centered padding, the frames overlapping the end
+// of the signal are computed by finish(), once its length is known.
+class MelSpectrogramStream {
+public:
+  explicit MelSpectrogramStream(const Options &opts)
+      : fft_size_(opts.fft_size), hop_size_(std::max(1, opts.hop_size)),
+        padding_(opts.padding), reflect_(opts.padding == "reflect"),
+        use_db_(opts.use_db), db_min_(opts.db_min),
+        window_(createWindow(opts.fft_size, opts.window_type)),
+        ring_(opts.fft_size + 1, 0.0f), received_(0), next_frame_(0),
+        magnitudes_(opts.fft_size / 2 + 1) {
+    if (opts.frequency_scale == "mel") {
+      filterbank_ = createMelFilterbank(opts.mel_bands, opts.fft_size,
+                                        opts.sample_rate, opts.fmin, opts.fmax);
+    } else {
+      rows_ = createFrequencyRows(opts.frequency_scale, opts.mel_bands,
+                                  opts.fft_size, opts.sample_rate, opts.fmin,
+                                  opts.fmax);
+    }
+    in_ = (float *)fftwf_malloc(sizeof(float) * fft_size_);
+    out_ = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) *
+                                         magnitudes_.size());
+    std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+    plan_ = fftwf_plan_dft_r2c_1d(fft_size_, in_, out_, FFTW_ESTIMATE);
+  }
+
+  ~MelSpectrogramStream() {
+    {
+      std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+      fftwf_destroy_plan(plan_);
+    }
+    fftwf_free(in_);
+    fftwf_free(out_);
+  }
+
+  MelSpectrogramStream(const MelSpectrogramStream &) = delete;
+  MelSpectrogramStream &operator=(const MelSpectrogramStream &) = delete;
+
+  // Appends samples (any sample type, e.g. FAUSTFLOAT) and analyses the
+  // frames they complete
+  template <typename Sample> void push(const Sample *samples, int count) {
+    for (int i = 0; i < count; i++) {
+      ring_[received_ % ring_.size()] = (float)samples[i];
+      received_++;
+      while (frameReady()) {
+        analyzeFrame();
+      }
+    }
+  }
+
+  // Appends count zero samples (a DSP without outputs)
+  void pushSilence(int count) {
+    float zero = 0.0f;
+    for (int i = 0; i < count; i++) {
+      push(&zero, 1);
+    }
+  }
+
+  // Analyses the frames left at the end of the signal and returns all the
+  // mel frames (in dB when use_db is set, not normalized); the stream is
+  // left empty
+  std::vector<std::vector<float>> finish() {
+    int n_frames = stftFrameCount(received_, fft_size_, hop_size_, padding_);
+    while (next_frame_ < n_frames) {
+      analyzeFrame();
+    }
+    return std::move(mel_spec_);
+  }
+
+private:
+  // A frame can be analysed once its last sample is received and, for
+  // reflect padding, the samples mirrored before the start (frame 0 needs
+  // one sample more than it covers)
+  bool frameReady() const {
+    long start = stftFrameStart(next_frame_, fft_size_, hop_size_, padding_);
+    return received_ >= start + fft_size_ && received_ > -start;
+  }
+
+  // Windows the next frame from the ring buffer, then FFT, magnitudes and
+  // mel projection (or frequency rows)
+  void analyzeFrame() {
+    long start = stftFrameStart(next_frame_, fft_size_, hop_size_, padding_);
+    long size = ring_.size();
+    if (start >= 0 && start + fft_size_ <= received_) {
+      // Inside the signal: at most two runs of the ring buffer
+      long pos = start % size;
+      int tail = (int)std::min<long>(fft_size_, size - pos);
+      for (int i = 0; i < tail; i++) {
+        in_[i] = ring_[pos + i] * window_[i];
+      }
+      for (int i = tail; i < fft_size_; i++) {
+        in_[i] = ring_[i - tail] * window_[i];
+      }
+    } else {
+      for (int i = 0; i < fft_size_; i++) {
+        long index = paddedIndex(start + i, received_, reflect_);
+        in_[i] = (index < 0) ? 0.0f : ring_[index % size] * window_[i];
+      }
+    }
+    fftwf_execute(plan_);
+    next_frame_++;
+
+    for (size_t i = 0; i < magnitudes_.size(); i++) {
+      float real = out_[i][0];
+      float imag = out_[i][1];
+      magnitudes_[i] = std::sqrt(real * real + imag * imag);
+    }
+
+    std::vector<float> frame(filterbank_.size());
+    if (filterbank_.empty()) {
+      applyFrequencyRows(magnitudes_, rows_, frame);
+    }
+    for (size_t mel = 0; mel < filterbank_.size(); mel++) {
+      float sum = 0.0f;
+      for (size_t bin = 0; bin < magnitudes_.size(); bin++) {
+        sum += magnitudes_[bin] * filterbank_[mel][bin];
+      }
+      frame[mel] = sum;
+    }
+    if (use_db_) {
+      for (float &val : frame) {
+        val = (val > 0) ? std::max(20.0f * std::log10(val), db_min_) : db_min_;
+      }
+    }
+    mel_spec_.push_back(std::move(frame));
+  }
+
+  int fft_size_;
+  int hop_size_;
+  std::string padding_;
+  bool reflect_;
+  bool use_db_;
+  float db_min_;
+  std::vector<float> window_;
+  std::vector<std::vector<float>> filterbank_; // mel scale
+  FrequencyRows rows_;                         // linear and log scales
+  std::vector<float> ring_;
+  long received_;
+  int next_frame_;
+  std::vector<float> magnitudes_;
+  float *in_;
+  fftwf_complex *out_;
+  fftwf_plan plan_;
+  std::vector<std::vector<float>> mel_spec_;
+};
+
+//==============================================================================
+// Constant-Q Transform
+//==============================================================================
+
+// Lowest bin of the constant-Q transform when fmin is not set (C1)
+const float CQT_DEFAULT_FMIN = 32.703f;
+
+// Highest bin, as a fraction of the sample rate: the octaves below the top
+// one are computed on signals decimated by 2, which must stay below the
+// passband edge of the decimation filter
+const float CQT_MAX_FREQUENCY = 0.4f;
+
+// Coefficients of a spectral kernel smaller than this fraction of its peak
+// are dropped
+const float CQT_KERNEL_THRESHOLD = 0.0054f;
+
+// Half-length of the decimation filter (2 * CQT_DECIMATOR_HALF + 1 taps)
+const int CQT_DECIMATOR_HALF = 64;
+
+// Spectral kernels of one constant-Q configuration (Brown & Puckette): each
+// bin is the correlation of a frame with a windowed complex exponential of
+// Q periods, computed as a sparse product with the FFT of the frame. Only
+// the kernels of the top octave are stored: each lower octave applies the
+// same kernels, with the same FFT size, to the signal decimated by 2 once
+// more, so every octave costs one small FFT per frame.
+struct CQTKernel {
+  struct Coefficient {
+    int bin;
+    float re;
+    float im;
+  };
+
+  int fft_size;
+  int bins_per_octave;
+  int octaves;
+  std::vector<float> frequencies;                // bin centers in Hz, ascending
+  std::vector<std::vector<Coefficient>> kernels; // top octave, highest first
+  std::vector<float> decimator;                  // lowpass FIR, unity DC gain
+};
+
+inline std::shared_ptr<const CQTKernel>
+createCQTKernel(int sample_rate, float fmin, float fmax, int bins_per_octave,
+                const std::string &window_type) {
+  auto kernel = std::make_shared<CQTKernel>();
+  int b = std::max(1, bins_per_octave);
+  float limit = CQT_MAX_FREQUENCY * sample_rate;
+  fmin = (fmin > 0) ? fmin : CQT_DEFAULT_FMIN;
+  fmax = (fmax > 0) ? std::min(fmax, limit) : limit;
+  int n_bins = std::max(1, (int)std::floor(b * std::log2(fmax / fmin)) + 1);
+
+  kernel->bins_per_octave = b;
+  kernel->octaves = (n_bins + b - 1) / b;
+  for (int k = 0; k < n_bins; k++) {
+    kernel->frequencies.push_back(fmin * std::pow(2.0f, (float)k / b));
+  }
+
+  // The FFT holds the longest kernel of the top octave (its lowest bin)
+  double q = 1.0 / (std::pow(2.0, 1.0 / b) - 1.0);
+  float top = kernel->frequencies.back();
+  double lowest = top * std::pow(2.0, -(b - 1.0) / b);
+  int longest = (int)std::ceil(q * sample_rate / lowest);
+  int n = 1;
+  while (n < longest) {
+    n *= 2;
+  }
+  kernel->fft_size = n;
+  int n_fft_bins = n / 2 + 1;
+
+  // Kernels centered in the frame, scaled so that a sinusoid of amplitude A
+  // gives a magnitude of A / 2; real and imaginary parts are transformed
+  // separately with the real FFT
+  float *in = (float *)fftwf_malloc(sizeof(float) * n);
+  fftwf_complex *re_fft =
+      (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n_fft_bins);
+  fftwf_complex *im_fft =
+      (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * n_fft_bins);
+  fftwf_plan re_plan, im_plan;
+  {
+    std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+    re_plan = fftwf_plan_dft_r2c_1d(n, in, re_fft, FFTW_ESTIMATE);
+    im_plan = fftwf_plan_dft_r2c_1d(n, in, im_fft, FFTW_ESTIMATE);
+  }
+
+  for (int j = 0; j < std::min(b, n_bins); j++) {
+    double f = top * std::pow(2.0, -(double)j / b);
+    int length = std::min(n, (int)std::ceil(q * sample_rate / f));
+    std::vector<float> window = createWindow(length, window_type);
+    double sum = 0;
+    for (float w : window) {
+      sum += w;
+    }
+    int offset = (n - length) / 2;
+
+    std::fill(in, in + n, 0.0f);
+    for (int i = 0; i < length; i++) {
+      double phase = 2.0 * M_PI * f * i / sample_rate;
+      in[offset + i] = window[i] / sum * std::cos(phase);
+    }
+    fftwf_execute(re_plan);
+    for (int i = 0; i < length; i++) {
+      double phase = 2.0 * M_PI * f * i / sample_rate;
+      in[offset + i] = window[i] / sum * std::sin(phase);
+    }
+    fftwf_execute(im_plan);
+
+    // FFT of re + i im, from the two real transforms
+    std::vector<CQTKernel::Coefficient> row;
+    float peak = 0.0f;
+    for (int i = 0; i < n_fft_bins; i++) {
+      float re = re_fft[i][0] - im_fft[i][1];
+      float im = re_fft[i][1] + im_fft[i][0];
+      row.push_back({i, re, im});
+      peak = std::max(peak, std::sqrt(re * re + im * im));
+    }
+    row.erase(std::remove_if(row.begin(), row.end(),
+                             [&](const CQTKernel::Coefficient &c) {
+                               return std::sqrt(c.re * c.re + c.im * c.im) <
+                                      CQT_KERNEL_THRESHOLD * peak;
+                             }),
+              row.end());
+    kernel->kernels.push_back(row);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+    fftwf_destroy_plan(re_plan);
+    fftwf_destroy_plan(im_plan);
+  }
+  fftwf_free(in);
+  fftwf_free(re_fft);
+  fftwf_free(im_fft);
+
+  // Windowed-sinc lowpass cut at 0.45 of the decimated Nyquist frequency
+  // (Blackman window: the passband reaches 0.4 of the input sample rate)
+  int taps = 2 * CQT_DECIMATOR_HALF + 1;
+  std::vector<float> window = createWindow(taps, "blackman");
+  double cutoff = 0.225;
+  double gain = 0;
+  kernel->decimator.resize(taps);
+  for (int i = 0; i < taps; i++) {
+    int m = i - CQT_DECIMATOR_HALF;
+    double sinc = (m == 0) ? 2 * cutoff
+                           : std::sin(2 * M_PI * cutoff * m) / (M_PI * m);
+    kernel->decimator[i] = sinc * window[i];
+    gain += kernel->decimator[i];
+  }
+  for (float &tap : kernel->decimator) {
+    tap /= gain;
+  }
+
+  return kernel;
+}
+
+// Kernels of a configuration, created once and shared by the analyses
+// using it (sweep notes, channels, in-process requests)
+inline std::shared_ptr<const CQTKernel> cqtKernel(const Options &opts) {
+  static std::mutex mutex;
+  static std::map<std::string, std::shared_ptr<const CQTKernel>> cache;
+  std::string key = std::to_string(opts.sample_rate) + " " +
+                    std::to_string(opts.fmin) + " " +
+                    std::to_string(opts.fmax) + " " +
+                    std::to_string(opts.bins_per_octave) + " " +
+                    opts.window_type;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  auto found = cache.find(key);
+  if (found != cache.end()) {
+    return found->second;
+  }
+  if (cache.size() >= 16) {
+    cache.clear();
+  }
+  auto kernel = createCQTKernel(opts.sample_rate, opts.fmin, opts.fmax,
+                                opts.bins_per_octave, opts.window_type);
+  cache[key] = kernel;
+  return kernel;
+}
+
+// Halves the sample rate of a signal: lowpass FIR, then every other sample
+// (output sample j is centered on input sample 2j)
+inline std::vector<float> decimate(const std::vector<float> &signal,
+                                   const std::vector<float> &fir) {
+  long n = signal.size();
+  int half = fir.size() / 2;
+  std::vector<float> out((n + 1) / 2);
+  for (long j = 0; j < (long)out.size(); j++) {
+    long center = 2 * j;
+    float sum = 0.0f;
+    if (center >= half && center + half < n) {
+      const float *x = &signal[center - half];
+      for (size_t m = 0; m < fir.size(); m++) {
+        sum += fir[m] * x[m];
+      }
+    } else {
+      for (size_t m = 0; m < fir.size(); m++) {
+        long i = center - half + m;
+        if (i >= 0 && i < n) {
+          sum += fir[m] * signal[i];
+        }
+      }
+    }
+    out[j] = sum;
+  }
+  return out;
+}
+
+// Constant-Q spectrogram of a signal, ready for display: one frame per hop
+// with bins_per_octave bins per octave from fmin (C1 by default) up to
+// fmax (at most 0.4 x the sample rate), lowest bin first, optionally in
+// dB, normalized to [0, 1] unless 'normalize' is false. Frames are always
+// centered on k * hop_size (the low kernels are much longer than a hop):
+// the signal is extended by reflection with reflect padding, by silence
+// otherwise.
+inline std::vector<std::vector<float>>
+computeCQTSpectrogram(const std::vector<float> &audio, const Options &opts,
+                      bool normalize = true) {
+  std::shared_ptr<const CQTKernel> kernel = cqtKernel(opts);
+  int n = kernel->fft_size;
+  int b = kernel->bins_per_octave;
+  int n_bins = kernel->frequencies.size();
+  bool reflect = (opts.padding == "reflect");
+  int n_frames = stftFrameCount(audio.size(), n, opts.hop_size, "zero");
+
+  // Signal of each octave, top one first
+  std::vector<std::vector<float>> decimated(kernel->octaves - 1);
+  for (int o = 0; o + 1 < kernel->octaves; o++) {
+    decimated[o] = decimate(o == 0 ? audio : decimated[o - 1],
+                            kernel->decimator);
+  }
+
+  float *in = (float *)fftwf_malloc(sizeof(float) * n);
+  fftwf_complex *out =
+      (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * (n / 2 + 1));
+  fftwf_plan plan;
+  {
+    std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+    plan = fftwf_plan_dft_r2c_1d(n, in, out, FFTW_ESTIMATE);
+  }
+
+  std::vector<std::vector<float>> spec(n_frames, std::vector<float>(n_bins));
+  for (int frame = 0; frame < n_frames; frame++) {
+    long center = (long)frame * opts.hop_size;
+    for (int o = 0; o < kernel->octaves; o++) {
+      const std::vector<float> &signal = (o == 0) ? audio : decimated[o - 1];
+      long size = signal.size();
+      long start = ((center + ((1L << o) >> 1)) >> o) - n / 2;
+      if (start >= 0 && start + n <= size) {
+        std::copy(&signal[start], &signal[start] + n, in);
+      } else {
+        for (int i = 0; i < n; i++) {
+          long index = paddedIndex(start + i, size, reflect);
+          in[i] = (index < 0) ? 0.0f : signal[index];
+        }
+      }
+      fftwf_execute(plan);
+
+      // Bins of this octave, from its highest one down
+      for (int j = 0; j < b; j++) {
+        int k = n_bins - 1 - o * b - j;
+        if (k < 0) {
+          break;
+        }
+        float re = 0.0f;
+        float im = 0.0f;
+        for (const auto &c : kernel->kernels[j]) {
+          re += out[c.bin][0] * c.re + out[c.bin][1] * c.im;
+          im += out[c.bin][1] * c.re - out[c.bin][0] * c.im;
+        }
+        spec[frame][k] = std::sqrt(re * re + im * im) / n;
+      }
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(fftwPlannerMutex());
+    fftwf_destroy_plan(plan);
+  }
+  fftwf_free(in);
+  fftwf_free(out);
+
+  if (opts.use_db) {
+    convertToDb(spec, opts.db_min);
+  }
+  if (normalize) {
+    normalizeSpectrogram(spec);
+  }
+  return spec;
+}
+
+// Spectrogram of a signal with the transform of the options: mel STFT or
+// constant-Q
+inline std::vector<std::vector<float>>
+computeSpectrogram(const std::vector<float> &audio, const Options &opts,
+                   bool normalize = true) {
+  if (opts.transform == "cqt") {
+    return computeCQTSpectrogram(audio, opts, normalize);
+  }
+  return computeMelSpectrogram(audio, opts, normalize);
+}
+
+// Edges of the frequency bands of the spectrograms of the options, in Hz
+// (bins + 2 points, band i spans edges i to i + 2 and peaks at i + 1)
+inline std::vector<float> spectrogramBandEdges(const Options &opts) {
+  if (opts.transform == "cqt") {
+    std::shared_ptr<const CQTKernel> kernel = cqtKernel(opts);
+    float step = std::pow(2.0f, 1.0f / kernel->bins_per_octave);
+    std::vector<float> edges = {kernel->frequencies.front() / step};
+    edges.insert(edges.end(), kernel->frequencies.begin(),
+                 kernel->frequencies.end());
+    edges.push_back(kernel->frequencies.back() * step);
+    return edges;
+  }
+  if (opts.frequency_scale == "mel") {
+    return melBandEdges(opts.mel_bands, opts.fmin, opts.fmax);
+  }
+
+  // Row centers, extended by one row spacing (linear) or ratio (log) on
+  // each side
+  std::vector<float> centers =
+      createFrequencyRows(opts.frequency_scale, opts.mel_bands, opts.fft_size,
+                          opts.sample_rate, opts.fmin, opts.fmax)
+          .centers;
+  float bin_hz = (float)opts.sample_rate / opts.fft_size;
+  float low = centers.front();
+  float high = centers.back();
+  if (centers.size() < 2) {
+    low -= bin_hz;
+    high += bin_hz;
+  } else if (opts.frequency_scale == "log") {
+    low = low * low / centers[1];
+    high = high * high / centers[centers.size() - 2];
+  } else {
+    low -= centers[1] - centers[0];
+    high += high - centers[centers.size() - 2];
+  }
+  std::vector<float> edges = {std::max(0.0f, low)};
+  edges.insert(edges.end(), centers.begin(), centers.end());
+  edges.push_back(high);
+  return edges;
+}
+
+//==============================================================================
+// Colormap Functions
+//==============================================================================
+
+struct RGB {
+  unsigned char r, g, b;
+};
+
+inline RGB applyColormap(float value, const std::string &colormap) {
+  // Clamp value to [0, 1]
+  value = std::max(0.0f, std::min(1.0f, value));
+
+  RGB color;
+
+  if (colormap == "viridis") {
+    // Simplified viridis approximation
+    if (value < 0.25f) {
+      float t = value / 0.25f;
+      color.r = (unsigned char)(68 * (1 - t) + 59 * t);
+      color.g = (unsigned char)(1 * (1 - t) + 82 * t);
+      color.b = (unsigned char)(84 * (1 - t) + 139 * t);
+    } else if (value < 0.5f) {
+      float t = (value - 0.25f) / 0.25f;
+      color.r = (unsigned char)(59 * (1 - t) + 33 * t);
+      color.g = (unsigned char)(82 * (1 - t) + 145 * t);
+      color.b = (unsigned char)(139 * (1 - t) + 140 * t);
+    } else if (value < 0.75f) {
+      float t = (value - 0.5f) / 0.25f;
+      color.r = (unsigned char)(33 * (1 - t) + 94 * t);
+      color.g = (unsigned char)(145 * (1 - t) + 201 * t);
+      color.b = (unsigned char)(140 * (1 - t) + 98 * t);
+    } else {
+      float t = (value - 0.75f) / 0.25f;
+      color.r = (unsigned char)(94 * (1 - t) + 253 * t);
+      color.g = (unsigned char)(201 * (1 - t) + 231 * t);
+      color.b = (unsigned char)(98 * (1 - t) + 37 * t);
+    }
+  } else if (colormap == "magma") {
+    // Simplified magma
+    color.r = (unsigned char)(value * 252);
+    color.g = (unsigned char)(value * value * 180);
+    color.b = (unsigned char)(std::pow(value, 0.5f) * 200);
+  } else if (colormap == "hot") {
+    // Hot colormap
+    if (value < 0.33f) {
+      color.r = (unsigned char)(value / 0.33f * 255);
+      color.g = 0;
+      color.b = 0;
+    } else if (value < 0.66f) {
+      color.r = 255;
+      color.g = (unsigned char)((value - 0.33f) / 0.33f * 255);
+      color.b = 0;
+    } else {
+      color.r = 255;
+      color.g = 255;
+      color.b = (unsigned char)((value - 0.66f) / 0.34f * 255);
+    }
+  } else if (colormap == "gray") {
+    // Grayscale
+    unsigned char gray = (unsigned char)(value * 255);
+    color.r = gray;
+    color.g = gray;
+    color.b = gray;
+  } else {
+    // Default to hot
+    return applyColormap(value, "hot");
+  }
+
+  return color;
+}
+
+//==============================================================================
+// PNG Generation
+//==============================================================================
+
+// libpng write callback appending to a byte vector
+inline void appendPNGData(png_structp png, png_bytep data, png_size_t length) {
+  std::vector<unsigned char> *buffer =
+      (std::vector<unsigned char> *)png_get_io_ptr(png);
+  buffer->insert(buffer->end(), data, data + length);
+}
+
+// RGB image, one vector per row
+typedef std::vector<std::vector<RGB>> Image;
+
+// Renders the spectrogram as an RGB image (empty on error)
+inline Image renderImage(const std::vector<std::vector<float>> &mel_spec,
+                         const Options &opts) {
+
+  if (mel_spec.empty()) {
+    std::cerr << "Error: Signal shorter than one FFT frame" << std::endl;
+    return Image();
+  }
+
+  int n_frames = mel_spec.size();
+  int n_mels = mel_spec[0].size();
+
+  // Apply scaling
+  int width = (int)(n_frames * opts.hscale * opts.scale);
+  int height = (int)(n_mels * opts.vscale * opts.scale);
+
+  // Simple check
+  if (width <= 0 || height <= 0) {
+    std::cerr << "Error: Invalid image dimensions" << std::endl;
+    return Image();
+  }
+
+  // Create image buffer
+  Image image(height);
+  for (int y = 0; y < height; y++) {
+    image[y].resize(width);
+  }
+
+  // Fill image with nearest-neighbor interpolation (simple)
+  for (int y = 0; y < height; y++) {
+    int mel_idx = (int)((height - 1 - y) * n_mels / height);
+    mel_idx = std::min(mel_idx, n_mels - 1);
+
+    for (int x = 0; x < width; x++) {
+      int frame_idx = (int)(x * n_frames / width);
+      frame_idx = std::min(frame_idx, n_frames - 1);
+
+      float value = mel_spec[frame_idx][mel_idx];
+      image[y][x] = applyColormap(value, opts.colormap);
+    }
+  }
+
+  return image;
+}
+
+// Lays out images on a grid, row by row, 'columns' images per row, separated
+// by 'gap' pixels of mid gray. Cells have the size of the largest image.
+inline Image composeContactSheet(const std::vector<Image> &tiles, int columns,
+                                 int gap = 4) {
+  int cell_width = 0;
+  int cell_height = 0;
+  for (const auto &tile : tiles) {
+    cell_height = std::max(cell_height, (int)tile.size());
+    if (!tile.empty()) {
+      cell_width = std::max(cell_width, (int)tile[0].size());
+    }
+  }
+  if (tiles.empty() || cell_width == 0 || cell_height == 0) {
+    return Image();
+  }
+
+  columns = std::max(1, std::min(columns, (int)tiles.size()));
+  int rows = ((int)tiles.size() + columns - 1) / columns;
+  int width = columns * cell_width + (columns - 1) * gap;
+  int height = rows * cell_height + (rows - 1) * gap;
+
+  RGB background = {128, 128, 128};
+  Image sheet(height, std::vector<RGB>(width, background));
+  for (size_t t = 0; t < tiles.size(); t++) {
+    int x0 = (int)(t % columns) * (cell_width + gap);
+    int y0 = (int)(t / columns) * (cell_height + gap);
+    for (size_t y = 0; y < tiles[t].size(); y++) {
+      std::copy(tiles[t][y].begin(), tiles[t][y].end(),
+                sheet[y0 + y].begin() + x0);
+    }
+  }
+  return sheet;
+}
+
+// Encodes an RGB image as a PNG in memory
+inline bool encodeImagePNG(const Image &image,
+                           std::vector<unsigned char> &png_data) {
+  if (image.empty() || image[0].empty()) {
+    return false;
+  }
+  int height = image.size();
+  int width = image[0].size();
+
+  png_structp png =
+      png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  if (!png) {
+    return false;
+  }
+
+  png_infop info = png_create_info_struct(png);
+  if (!info) {
+    png_destroy_write_struct(&png, NULL);
+    return false;
+  }
+
+  if (setjmp(png_jmpbuf(png))) {
+    png_destroy_write_struct(&png, &info);
+    return false;
+  }
+
+  png_data.clear();
+  png_set_write_fn(png, &png_data, appendPNGData, NULL);
+
+  // Set image attributes
+  png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGB,
+               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+               PNG_FILTER_TYPE_DEFAULT);
+
+  png_write_info(png, info);
+
+  // Write image data
+  std::vector<png_byte *> row_pointers(height);
+  for (int y = 0; y < height; y++) {
+    row_pointers[y] = (png_byte *)&image[y][0];
+  }
+
+  png_write_image(png, &row_pointers[0]);
+  png_write_end(png, NULL);
+
+  // Cleanup
+  png_destroy_write_struct(&png, &info);
+
+  return true;
+}
+
+// Encodes the spectrogram as a PNG image in memory
+inline bool encodePNG(const std::vector<std::vector<float>> &mel_spec,
+                      const Options &opts, std::vector<unsigned char> &png_data) {
+  Image image = renderImage(mel_spec, opts);
+  return !image.empty() && encodeImagePNG(image, png_data);
+}
+
+// Writes encoded data (PNG, matrix) to a file
+inline bool writeFileBytes(const std::string &filename,
+                           const std::vector<unsigned char> &data) {
+  FILE *fp = fopen(filename.c_str(), "wb");
+  if (!fp) {
+    std::cerr << "Error: Could not open file " << filename << std::endl;
+    return false;
+  }
+  bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+  ok = (fclose(fp) == 0) && ok;
+
+  return ok;
+}
+
+inline bool writePNG(const std::string &filename,
+                     const std::vector<std::vector<float>> &mel_spec,
+                     const Options &opts) {
+  std::vector<unsigned char> png_data;
+  return encodePNG(mel_spec, opts, png_data) &&
+         writeFileBytes(filename, png_data);
+}
+
+//==============================================================================
+// Multichannel Analysis
+//==============================================================================
+
+// Signals to analyse from the output channels of a DSP (planar):
+//  first     channel 0 only
+//  each      every channel
+//  mid_side  (L + R) / 2 and (L - R) / 2 of the first two channels
+//  sum       sum of all channels
+// Returns false (with an error message) for an unknown mode or too few
+// channels.
+inline bool channelSignals(const std::vector<std::vector<float>> &channels,
+                           const std::string &mode,
+                           std::vector<std::vector<float>> &signals,
+                           std::vector<std::string> &labels,
+                           std::string &error) {
+  signals.clear();
+  labels.clear();
+  size_t min_channels = (mode == "mid_side") ? 2 : 1;
+  if (mode != "first" && mode != "each" && mode != "mid_side" &&
+      mode != "sum") {
+    error = "Unknown channel mode '" + mode +
+            "' (first, each, mid_side or sum)";
+    return false;
+  }
+  if (channels.size() < min_channels) {
+    error = "Channel mode '" + mode + "' needs " +
+            std::to_string(min_channels) + " output channel(s), the DSP has " +
+            std::to_string(channels.size());
+    return false;
+  }
+
+  if (mode == "first") {
+    signals.push_back(channels[0]);
+    labels.push_back("0");
+  } else if (mode == "each") {
+    signals = channels;
+    for (size_t c = 0; c < channels.size(); c++) {
+      labels.push_back(std::to_string(c));
+    }
+  } else if (mode == "mid_side") {
+    const std::vector<float> &left = channels[0];
+    const std::vector<float> &right = channels[1];
+    signals.assign(2, std::vector<float>(left.size()));
+    for (size_t i = 0; i < left.size(); i++) {
+      signals[0][i] = 0.5f * (left[i] + right[i]);
+      signals[1][i] = 0.5f * (left[i] - right[i]);
+    }
+    labels = {"mid", "side"};
+  } else {
+    signals.assign(1, std::vector<float>(channels[0].size(), 0.0f));
+    for (const auto &channel : channels) {
+      for (size_t i = 0; i < channel.size(); i++) {
+        signals[0][i] += channel[i];
+      }
+    }
+    labels.push_back("sum");
+  }
+  return true;
+}
+
+// Spectrograms of several signals (computeSpectrogram()), one thread per
+// signal, normalized together (unless 'normalize' is false) so that the
+// levels of the channels can be compared
+inline std::vector<std::vector<std::vector<float>>>
+computeSpectrograms(const std::vector<std::vector<float>> &signals,
+                       const Options &opts, bool normalize = true) {
+  std::vector<std::vector<std::vector<float>>> mel_specs(signals.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < signals.size(); i++) {
+    threads.emplace_back([&, i]() {
+      mel_specs[i] = computeSpectrogram(signals[i], opts, false);
+    });
+  }
+  if (!signals.empty()) {
+    mel_specs[0] = computeSpectrogram(signals[0], opts, false);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  if (normalize) {
+    normalizeSpectrograms(mel_specs);
+  }
+  return mel_specs;
+}
+
+// Spectrograms of the signals of a channel mode, side by side, left to
+// right in the order of 'labels' (empty image on error)
+inline Image channelSpectrogramImage(
+    const std::vector<std::vector<float>> &channels, const Options &opts,
+    const std::string &mode, std::vector<std::string> &labels,
+    std::string &error) {
+  std::vector<std::vector<float>> signals;
+  if (!channelSignals(channels, mode, signals, labels, error)) {
+    return Image();
+  }
+
+  std::vector<Image> tiles;
+  for (const auto &mel_spec : computeSpectrograms(signals, opts)) {
+    tiles.push_back(renderImage(mel_spec, opts));
+    if (tiles.back().empty()) {
+      error = "Signal shorter than one FFT frame";
+      return Image();
+    }
+  }
+  return composeContactSheet(tiles, (int)tiles.size());
+}
@@ -0,0 +1,231 @@
+/************************************************************************
+ FAUST Architecture File - Spectrogram Matrix
+ Copyright (C) 2026 Yann Orlarey
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************
+ ************************************************************************/
+
+/*
+ Numeric output of the spectrogram generator: the mel (or constant-Q)
+ magnitudes as a binary float matrix, without building an image. Shared by the
+ spectrogram.cpp architecture and the in-process engines of the MCP server.
+
+ Layout (little-endian):
+   offset  size  field
+        0     4  magic "FSPM"
+        4     1  version (1)
+        5     1  sample type: 1 = float32, 2 = float16 (IEEE half)
+        6     1  frequency scale: 0 = mel, 1 = constant-Q, 2 = linear,
+                 3 = log (linear and log: FFT bins grouped into rows)
+        7     1  flags: bit 0 = values in dB, bit 1 = zlib-compressed data,
+                 bit 2 = centered frames (frame k centered on sample
+                 k * hop, else starting at k * hop)
+        8     4  signals (e.g. output channels)
+       12     4  frames per signal
+       16     4  bins per frame
+       20     4  sample rate (Hz)
+       24     4  FFT size (samples; for constant-Q, the FFT of each octave)
+       28     4  hop size (samples)
+       32     4  data size in bytes (after compression)
+       36  4*(bins+2)  band edges in Hz, float32 (band i spans edges i to
+                       i + 2 and peaks at i + 1)
+        …        data: signals x frames x bins samples, bins varying
+                 fastest, compressed as one zlib stream when flagged
+ Values are the filterbank magnitudes (or dB, floored at db_min), not
+ normalized.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include "spectrogram_analysis.hh"
+
+const uint8_t MATRIX_FLOAT32 = 1;
+const uint8_t MATRIX_FLOAT16 = 2;
+const uint8_t MATRIX_SCALE_MEL = 0;
+const uint8_t MATRIX_SCALE_CQT = 1;
+const uint8_t MATRIX_SCALE_LINEAR = 2;
+const uint8_t MATRIX_SCALE_LOG = 3;
+const uint8_t MATRIX_FLAG_DB = 1;
+const uint8_t MATRIX_FLAG_ZLIB = 2;
+const uint8_t MATRIX_FLAG_CENTERED = 4;
+const size_t MATRIX_HEADER_SIZE = 36;
+
+// IEEE 754 half precision, rounded to nearest even (overflow gives
+// infinity, tiny values subnormals or zero)
+inline uint16_t floatToHalf(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  uint16_t sign = (bits >> 16) & 0x8000;
+  uint32_t exponent = (bits >> 23) & 0xff;
+  uint32_t mantissa = bits & 0x7fffff;
+
+  if (exponent == 0xff) {
+    // Infinity or NaN (kept quiet)
+    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+  }
+  int half_exponent = (int)exponent - 127 + 15;
+  if (half_exponent >= 0x1f) {
+    return sign | 0x7c00;
+  }
+  if (half_exponent <= 0) {
+    if (half_exponent < -10) {
+      return sign;
+    }
+    // Subnormal: shift the mantissa (with its implicit bit) into place
+    mantissa |= 0x800000;
+    int shift = 14 - half_exponent;
+    uint32_t half_mantissa = mantissa >> shift;
+    uint32_t rest = mantissa & ((1u << shift) - 1);
+    uint32_t halfway = 1u << (shift - 1);
+    if (rest > halfway || (rest == halfway && (half_mantissa & 1))) {
+      half_mantissa++;
+    }
+    return sign | half_mantissa;
+  }
+
+  uint16_t half = sign | (half_exponent << 10) | (mantissa >> 13);
+  uint32_t rest = mantissa & 0x1fff;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+    half++; // may carry into the exponent, up to infinity: still correct
+  }
+  return half;
+}
+
+inline void appendU32(std::vector<unsigned char> &out, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    out.push_back((value >> (8 * i)) & 0xff);
+  }
+}
+
+inline void appendF32(std::vector<unsigned char> &out, float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  appendU32(out, bits);
+}
+
+// Frequency scale field of the options
+inline uint8_t matrixScale(const Options &opts) {
+  if (opts.transform == "cqt") {
+    return MATRIX_SCALE_CQT;
+  }
+  if (opts.frequency_scale == "linear") {
+    return MATRIX_SCALE_LINEAR;
+  }
+  if (opts.frequency_scale == "log") {
+    return MATRIX_SCALE_LOG;
+  }
+  return MATRIX_SCALE_MEL;
+}
+
+// Encodes spectrograms of the same shape (one per signal, computed with
+// 'opts') as a matrix file. float16 halves the size; compress deflates the
+// data with zlib. Returns false if there is nothing to encode.
+inline bool encodeMatrix(
+    const std::vector<std::vector<std::vector<float>>> &mel_specs,
+    const Options &opts, bool float16, bool compress,
+    std::vector<unsigned char> &out) {
+  if (mel_specs.empty() || mel_specs[0].empty()) {
+    return false;
+  }
+  size_t frames = mel_specs[0].size();
+  size_t bins = mel_specs[0][0].size();
+
+  // Samples, signal by signal, frame by frame
+  std::vector<unsigned char> data;
+  data.reserve(mel_specs.size() * frames * bins * (float16 ? 2 : 4));
+  for (const auto &mel_spec : mel_specs) {
+    if (mel_spec.size() != frames) {
+      return false;
+    }
+    for (const auto &frame : mel_spec) {
+      for (float value : frame) {
+        if (float16) {
+          uint16_t half = floatToHalf(value);
+          data.push_back(half & 0xff);
+          data.push_back(half >> 8);
+        } else {
+          appendF32(data, value);
+        }
+      }
+    }
+  }
+
+  if (compress) {
+    uLongf size = compressBound(data.size());
+    std::vector<unsigned char> deflated(size);
+    if (compress2(deflated.data(), &size, data.data(), data.size(),
+                  Z_DEFAULT_COMPRESSION) != Z_OK) {
+      return false;
+    }
+    deflated.resize(size);
+    data.swap(deflated);
+  }
+
+  std::vector<float> edges = spectrogramBandEdges(opts);
+  out.clear();
+  out.reserve(MATRIX_HEADER_SIZE + 4 * edges.size() + data.size());
+  out.insert(out.end(), {'F', 'S', 'P', 'M', 1});
+  out.push_back(float16 ? MATRIX_FLOAT16 : MATRIX_FLOAT32);
+  out.push_back(matrixScale(opts));
+  out.push_back((opts.use_db ? MATRIX_FLAG_DB : 0) |
+                (compress ? MATRIX_FLAG_ZLIB : 0) |
+                (isCenteredPadding(opts.padding) || opts.transform == "cqt"
+                     ? MATRIX_FLAG_CENTERED
+                     : 0));
+  appendU32(out, mel_specs.size());
+  appendU32(out, frames);
+  appendU32(out, bins);
+  appendU32(out, opts.sample_rate);
+  appendU32(out, opts.transform == "cqt" ? cqtKernel(opts)->fft_size
+                                         : opts.fft_size);
+  appendU32(out, opts.hop_size);
+  appendU32(out, data.size());
+  for (float edge : edges) {
+    appendF32(out, edge);
+  }
+  out.insert(out.end(), data.begin(), data.end());
+  return true;
+}
+
+// Matrix of the signals of a channel mode (see channelSignals()):
+// spectrograms computed in parallel, without normalization or image
+inline bool channelSpectrogramMatrix(
+    const std::vector<std::vector<float>> &channels, const Options &opts,
+    const std::string &mode, bool float16, bool compress,
+    std::vector<unsigned char> &out, std::string &error) {
+  std::vector<std::vector<float>> signals;
+  std::vector<std::string> labels;
+  if (!channelSignals(channels, mode, signals, labels, error)) {
+    return false;
+  }
+  if (!encodeMatrix(computeSpectrograms(signals, opts, false), opts,
+                    float16, compress, out)) {
+    error = "Signal shorter than one FFT frame";
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,482 @@
+/************************************************************************
+ FAUST Architecture File - Spectrogram Synthesis
+ Copyright (C) 2026 Yann Orlarey
+ ---------------------------------------------------------------------
+ This Architecture section is free software; you can redistribute it
+ and/or modify it under the terms of the GNU General Public License
+ as published by the Free Software Foundation; either version 3 of
+ the License, or (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program; If not, see <http://www.gnu.org/licenses/>.
+
+ EXCEPTION : As a special exception, you may create a larger work
+ that contains this FAUST architecture section and distribute
+ that work under terms of your choice, so long as this FAUST
+ architecture section is not modified.
+
+ ************************************************************************
+ ************************************************************************/
+
+/*
+ Synthesis part of the spectrogram generator: collects the gate/freq/gain
+ parameters of a DSP and renders a note. The UI and dsp classes and
+ FAUSTFLOAT must be declared before this file is included: by the
+ spectrogram.cpp architecture, or by the Faust headers (faust/gui/UI.h,
+ faust/dsp/dsp.h) for DSPs compiled in-process with libfaust.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spectrogram_analysis.hh"
+
+//==============================================================================
+// Parameter Collector UI
+//==============================================================================
+
+class SpectrogramUI : public UI {
+public:
+  struct Parameter {
+    FAUSTFLOAT *zone;
+    FAUSTFLOAT min;
+    FAUSTFLOAT max;
+    FAUSTFLOAT init;
+    std::string type;
+    bool found;
+
+    Parameter()
+        : zone(nullptr), min(0), max(1), init(0), type(""), found(false) {}
+  };
+
+private:
+  std::map<std::string, Parameter> params_;
+
+public:
+  SpectrogramUI() {}
+
+  // UI interface implementation
+  virtual void openTabBox(const char *label) {}
+  virtual void openHorizontalBox(const char *label) {}
+  virtual void openVerticalBox(const char *label) {}
+  virtual void closeBox() {}
+
+  virtual void declare(FAUSTFLOAT *zone, const char *key, const char *value) {}
+
+  virtual void addButton(const char *label, FAUSTFLOAT *zone) {
+    if (strcmp(label, "gate") == 0) {
+      params_["gate"].zone = zone;
+      params_["gate"].min = 0;
+      params_["gate"].max = 1;
+      params_["gate"].init = 0;
+      params_["gate"].type = "button";
+      params_["gate"].found = true;
+    }
+  }
+
+  virtual void addCheckButton(const char *label, FAUSTFLOAT *zone) {
+    if (strcmp(label, "gate") == 0) {
+      params_["gate"].zone = zone;
+      params_["gate"].min = 0;
+      params_["gate"].max = 1;
+      params_["gate"].init = 0;
+      params_["gate"].type = "checkbox";
+      params_["gate"].found = true;
+    }
+  }
+
+  virtual void addVerticalSlider(const char *label, FAUSTFLOAT *zone,
+                                 FAUSTFLOAT init, FAUSTFLOAT min,
+                                 FAUSTFLOAT max, FAUSTFLOAT step) {
+    std::string lbl(label);
+    if (lbl == "freq" || lbl == "gain") {
+      params_[lbl].zone = zone;
+      params_[lbl].min = min;
+      params_[lbl].max = max;
+      params_[lbl].init = init;
+      params_[lbl].type = "vslider";
+      params_[lbl].found = true;
+    }
+  }
+
+  virtual void addHorizontalSlider(const char *label, FAUSTFLOAT *zone,
+                                   FAUSTFLOAT init, FAUSTFLOAT min,
+                                   FAUSTFLOAT max, FAUSTFLOAT step) {
+    std::string lbl(label);
+    if (lbl == "freq" || lbl == "gain") {
+      params_[lbl].zone = zone;
+      params_[lbl].min = min;
+      params_[lbl].max = max;
+      params_[lbl].init = init;
+      params_[lbl].type = "hslider";
+      params_[lbl].found = true;
+    }
+  }
+
+  virtual void addNumEntry(const char *label, FAUSTFLOAT *zone, FAUSTFLOAT init,
+                           FAUSTFLOAT min, FAUSTFLOAT max, FAUSTFLOAT step) {
+    std::string lbl(label);
+    if (lbl == "freq" || lbl == "gain") {
+      params_[lbl].zone = zone;
+      params_[lbl].min = min;
+      params_[lbl].max = max;
+      params_[lbl].init = init;
+      params_[lbl].type = "nentry";
+      params_[lbl].found = true;
+    }
+  }
+
+  virtual void addHorizontalBargraph(const char *label, FAUSTFLOAT *zone,
+                                     FAUSTFLOAT min, FAUSTFLOAT max) {}
+  virtual void addVerticalBargraph(const char *label, FAUSTFLOAT *zone,
+                                   FAUSTFLOAT min, FAUSTFLOAT max) {}
+
+  virtual void addSoundfile(const char *label, const char *filename,
+                            Soundfile **sf_zone) {}
+
+  // Validation
+  bool validate(std::string &error_msg) {
+    if (!params_["gate"].found) {
+      error_msg = "Error: DSP must expose parameter \"gate\"\n"
+                  "Expected widget: button or checkbox with label \"gate\"";
+      return false;
+    }
+
+    if (!params_["freq"].found) {
+      error_msg =
+          "Error: DSP must expose parameter \"freq\"\n"
+          "Expected widget: nentry, hslider, or vslider with label \"freq\"";
+      return false;
+    }
+
+    if (!params_["gain"].found) {
+      error_msg =
+          "Error: DSP must expose parameter \"gain\"\n"
+          "Expected widget: nentry, hslider, or vslider with label \"gain\"";
+      return false;
+    }
+
+    return true;
+  }
+
+  // Set parameter with clamping
+  void setParameter(const std::string &name, FAUSTFLOAT value) {
+    if (params_.find(name) == params_.end() || !params_[name].found) {
+      return;
+    }
+
+    Parameter &p = params_[name];
+    FAUSTFLOAT clamped = std::max(p.min, std::min(value, p.max));
+
+    if (clamped != value && name != "gate") {
+      std::cerr << "Warning: " << name << "=" << value << " exceeds range ["
+                << p.min << ", " << p.max << "], clamped to " << clamped
+                << std::endl;
+    }
+
+    *p.zone = clamped;
+  }
+
+  // Get parameter info
+  const Parameter &getParameter(const std::string &name) const {
+    static Parameter dummy;
+    auto it = params_.find(name);
+    return (it != params_.end()) ? it->second : dummy;
+  }
+};
+
+//==============================================================================
+// Audio Synthesis
+//==============================================================================
+
+// Block size of the synthesis loops (DSP compute() calls)
+const int RENDER_BLOCK_SIZE = 256;
+
+// Number of samples of 'seconds' of audio (0 for a negative duration).
+// Callers bound the duration (render_max_seconds), the count is computed in
+// long so that long notes at high sample rates do not overflow an int
+inline long noteSamples(double seconds, int sample_rate) {
+  return seconds > 0 ? (long)(seconds * sample_rate) : 0;
+}
+
+// Renders the note, gate on for gate_duration then off until duration,
+// and hands every computed block to consume(outputs, count). The DSP
+// computes up to block_size samples per call; blocks are split at the gate
+// release so that the gate changes on the exact sample, as when computing
+// one sample at a time. Inputs, if any, are fed with silence.
+// 'interrupted' (optional) is polled between blocks; rendering stops and
+// returns false as soon as it returns true.
+inline bool
+renderBlocks(dsp &dsp, SpectrogramUI &ui, const Options &opts, int block_size,
+             const std::function<void(FAUSTFLOAT **outputs, int count)> &consume,
+             const std::function<bool()> &interrupted = nullptr) {
+  long num_samples = noteSamples(opts.duration, opts.sample_rate);
+  long gate_samples = noteSamples(
+      std::min(opts.gate_duration, opts.duration), opts.sample_rate);
+  block_size = std::max(1, block_size);
+
+  // Set frequency and gain (constant during synthesis)
+  ui.setParameter("freq", opts.frequency);
+  ui.setParameter("gain", opts.gain);
+
+  // Allocate DSP buffers
+  int num_inputs = dsp.getNumInputs();
+  int num_outputs = dsp.getNumOutputs();
+  std::vector<std::vector<FAUSTFLOAT>> input_buffers(
+      num_inputs, std::vector<FAUSTFLOAT>(block_size, 0));
+  std::vector<std::vector<FAUSTFLOAT>> output_buffers(
+      num_outputs, std::vector<FAUSTFLOAT>(block_size, 0));
+  std::vector<FAUSTFLOAT *> inputs(num_inputs);
+  std::vector<FAUSTFLOAT *> outputs(num_outputs);
+  for (int c = 0; c < num_inputs; c++) {
+    inputs[c] = input_buffers[c].data();
+  }
+  for (int c = 0; c < num_outputs; c++) {
+    outputs[c] = output_buffers[c].data();
+  }
+
+  // Synthesis loop (block by block)
+  long next_check = 0;
+  for (long pos = 0; pos < num_samples;) {
+    if (interrupted && pos >= next_check) {
+      if (interrupted()) {
+        return false;
+      }
+      next_check = pos + 4096;
+    }
+
+    // Update gate
+    bool gate_on = pos < gate_samples;
+    long end = std::min(num_samples, pos + block_size);
+    if (gate_on) {
+      end = std::min(end, gate_samples);
+    }
+    ui.setParameter("gate", gate_on ? 1.0f : 0.0f);
+
+    // Compute one block
+    int count = (int)(end - pos);
+    dsp.compute(count, inputs.data(), outputs.data());
+    consume(outputs.data(), count);
+    pos = end;
+  }
+
+  return true;
+}
+
+// Renders the note into one buffer per output channel (planar)
+inline bool renderAudio(dsp &dsp, SpectrogramUI &ui, const Options &opts,
+                        int block_size,
+                        std::vector<std::vector<float>> &channels,
+                        const std::function<bool()> &interrupted = nullptr) {
+  size_t num_samples = noteSamples(opts.duration, opts.sample_rate);
+  channels.assign(dsp.getNumOutputs(), std::vector<float>(num_samples));
+
+  size_t pos = 0;
+  auto store = [&](FAUSTFLOAT **outputs, int count) {
+    for (size_t c = 0; c < channels.size(); c++) {
+      std::copy(outputs[c], outputs[c] + count, channels[c].begin() + pos);
+    }
+    pos += count;
+  };
+  return renderBlocks(dsp, ui, opts, block_size, store, interrupted);
+}
+
+// Time spent rendering and analysing a note, in milliseconds
+struct SpectrogramTimes {
+  double synthesis_ms = 0;
+  double analysis_ms = 0;
+};
+
+// Milliseconds elapsed since 'start'
+inline double millisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+// Renders the note and computes the spectrogram of its first output channel
+// (silence for a DSP without outputs). The mel spectrogram is computed on
+// the fly (MelSpectrogramStream): no buffer of the whole note is allocated,
+// so memory does not grow with the duration beyond the mel frames, with the
+// same result as computeMelSpectrogram() on the rendered channel. The
+// constant-Q transform needs the whole signal (octaves are computed on
+// decimated copies), so the channel is rendered first.
+// 'times' (optional) receives the time spent in synthesis (DSP compute()
+// calls) and in analysis, measured block by block when they are interleaved.
+inline bool
+renderSpectrogram(dsp &dsp, SpectrogramUI &ui, const Options &opts,
+                  std::vector<std::vector<float>> &mel_spec,
+                  bool normalize = true,
+                  const std::function<bool()> &interrupted = nullptr,
+                  SpectrogramTimes *times = nullptr) {
+  auto start = std::chrono::steady_clock::now();
+  double analysis_ms = 0;
+
+  if (opts.transform == "cqt") {
+    std::vector<std::vector<float>> channels;
+    if (!renderAudio(dsp, ui, opts, RENDER_BLOCK_SIZE, channels,
+                     interrupted)) {
+      return false;
+    }
+    if (channels.empty()) {
+      channels.emplace_back(noteSamples(opts.duration, opts.sample_rate),
+                            0.0f);
+    }
+    auto analysis_start = std::chrono::steady_clock::now();
+    mel_spec = computeCQTSpectrogram(channels[0], opts, normalize);
+    analysis_ms = millisecondsSince(analysis_start);
+  } else {
+    MelSpectrogramStream stream(opts);
+    bool has_output = dsp.getNumOutputs() > 0;
+    auto analyze = [&](FAUSTFLOAT **outputs, int count) {
+      auto analysis_start = times ? std::chrono::steady_clock::now()
+                                  : std::chrono::steady_clock::time_point();
+      if (has_output) {
+        stream.push(outputs[0], count);
+      } else {
+        stream.pushSilence(count);
+      }
+      if (times) {
+        analysis_ms += millisecondsSince(analysis_start);
+      }
+    };
+    if (!renderBlocks(dsp, ui, opts, RENDER_BLOCK_SIZE, analyze,
+                      interrupted)) {
+      return false;
+    }
+
+    auto analysis_start = std::chrono::steady_clock::now();
+    mel_spec = stream.finish();
+    if (normalize) {
+      normalizeSpectrogram(mel_spec);
+    }
+    analysis_ms += millisecondsSince(analysis_start);
+  }
+
+  if (times) {
+    times->analysis_ms = analysis_ms;
+    times->synthesis_ms = millisecondsSince(start) - analysis_ms;
+  }
+  return true;
+}
+
+//==============================================================================
+// Parameter Sweep
+//==============================================================================
+
+// One note of a sweep
+struct SweepPoint {
+  float frequency;
+  float gain;
+  float gate_duration;
+};
+
+// All combinations of the lists, frequency varying fastest, then gain, then
+// gate duration (contact sheets have one column per frequency)
+inline std::vector<SweepPoint>
+sweepPoints(const std::vector<float> &frequencies,
+            const std::vector<float> &gains,
+            const std::vector<float> &gate_durations) {
+  std::vector<SweepPoint> points;
+  for (float gate_duration : gate_durations) {
+    for (float gain : gains) {
+      for (float frequency : frequencies) {
+        points.push_back({frequency, gain, gate_duration});
+      }
+    }
+  }
+  return points;
+}
+
+// Instances for a parallel sweep: the prototype and threads - 1 clones
+// (threads <= 0: one per core). The clones are owned by the caller.
+inline std::vector<dsp *> cloneInstances(dsp &prototype, int threads) {
+  if (threads <= 0) {
+    threads = std::max(1, (int)std::thread::hardware_concurrency());
+  }
+  std::vector<dsp *> instances = {&prototype};
+  for (int i = 1; i < threads; i++) {
+    instances.push_back(prototype.clone());
+  }
+  return instances;
+}
+
+// Renders and analyses every point of a sweep, one thread per instance
+// (instances of the same DSP, e.g. from cloneInstances()); each thread
+// takes the next pending point until none is left. Each instance is
+// re-initialized before every note so notes do not leak into each other.
+// The mel spectrograms are normalized together, so that levels can be
+// compared across points. 'interrupted' is called from the worker threads
+// (one call at a time); every thread stops and false is returned as soon
+// as it returns true.
+inline bool
+renderSweep(const std::vector<dsp *> &instances, const Options &opts,
+            const std::vector<SweepPoint> &points,
+            std::vector<std::vector<std::vector<float>>> &mel_specs,
+            const std::function<bool()> &interrupted = nullptr) {
+  mel_specs.assign(points.size(), std::vector<std::vector<float>>());
+  std::atomic<size_t> next(0);
+  std::atomic<bool> stopped(false);
+  std::mutex interrupted_mutex;
+
+  auto check = [&]() {
+    if (stopped) {
+      return true;
+    }
+    std::lock_guard<std::mutex> lock(interrupted_mutex);
+    if (interrupted && interrupted()) {
+      stopped = true;
+    }
+    return (bool)stopped;
+  };
+
+  auto worker = [&](dsp *instance) {
+    SpectrogramUI ui;
+    instance->buildUserInterface(&ui);
+    for (size_t i = next++; i < points.size() && !stopped; i = next++) {
+      Options note = opts;
+      note.frequency = points[i].frequency;
+      note.gain = points[i].gain;
+      note.gate_duration = points[i].gate_duration;
+      instance->init(note.sample_rate);
+      if (!renderSpectrogram(*instance, ui, note, mel_specs[i], false,
+                             check)) {
+        return;
+      }
+    }
+  };
+
+  size_t count = std::min(instances.size(), points.size());
+  std::vector<std::thread> threads;
+  for (size_t t = 1; t < count; t++) {
+    threads.emplace_back(worker, instances[t]);
+  }
+  if (count > 0) {
+    worker(instances[0]);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  if (stopped) {
+    return false;
+  }
+  normalizeSpectrograms(mel_specs);
+  return true;
+}
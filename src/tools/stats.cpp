@@ -0,0 +1,210 @@
+#include "stats.hh"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <time.h>
+
+typedef std::chrono::steady_clock Clock;
+
+// Buckets of the histograms: 8 per octave from 1 us, the last one also
+// holds everything longer
+static const int BUCKETS_PER_OCTAVE = 8;
+static const int BUCKET_COUNT = 32 * BUCKETS_PER_OCTAVE;
+static const double FIRST_BUCKET_MS = 0.001;
+
+// Milliseconds rounded to the microsecond
+static double roundMs(double ms) { return std::round(ms * 1000) / 1000; }
+
+// Distribution of one kind of timing
+struct Histogram {
+  uint64_t count = 0;
+  double total = 0;
+  double min = 0;
+  double max = 0;
+  std::array<uint32_t, BUCKET_COUNT> buckets{};
+
+  void add(double ms) {
+    min = (count == 0) ? ms : std::min(min, ms);
+    max = (count == 0) ? ms : std::max(max, ms);
+    count++;
+    total += ms;
+    int bucket = 0;
+    if (ms > FIRST_BUCKET_MS) {
+      bucket = (int)(BUCKETS_PER_OCTAVE * std::log2(ms / FIRST_BUCKET_MS));
+    }
+    buckets[std::min(bucket, BUCKET_COUNT - 1)]++;
+  }
+
+  // Geometric middle of the bucket holding the q quantile, within the
+  // observed range
+  double quantile(double q) const {
+    uint64_t rank = (uint64_t)std::ceil(q * count);
+    uint64_t seen = 0;
+    for (int b = 0; b < BUCKET_COUNT; b++) {
+      seen += buckets[b];
+      if (seen >= rank && seen > 0) {
+        double value = FIRST_BUCKET_MS *
+                       std::exp2((b + 0.5) / BUCKETS_PER_OCTAVE);
+        return std::min(max, std::max(min, value));
+      }
+    }
+    return max;
+  }
+
+  json toJson() const {
+    return {{"count", count},
+            {"total_ms", roundMs(total)},
+            {"mean_ms", roundMs(count ? total / count : 0.0)},
+            {"min_ms", roundMs(min)},
+            {"p50_ms", roundMs(quantile(0.50))},
+            {"p95_ms", roundMs(quantile(0.95))},
+            {"p99_ms", roundMs(quantile(0.99))},
+            {"max_ms", roundMs(max)}};
+  }
+};
+
+// Wall-clock and (when known) CPU time of a stage
+struct StageStats {
+  Histogram wall;
+  Histogram cpu;
+};
+
+// Lookups of a cache
+struct CacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+};
+
+static std::mutex gStatsMutex;
+static std::map<std::string, Histogram> gTools;
+static std::map<std::string, StageStats> gStages;
+static std::map<std::string, CacheStats> gCaches;
+static Clock::time_point gStatsStart = Clock::now();
+
+// Trace of the request handled by the thread (see RequestTrace::Scope)
+static thread_local RequestTrace *tCurrentTrace = nullptr;
+
+// CPU time of the calling thread
+static double threadCpuMs() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+    return 0;
+  }
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+void recordToolTime(const std::string &tool, double wallMs) {
+  std::lock_guard<std::mutex> lock(gStatsMutex);
+  gTools[tool].add(wallMs);
+}
+
+void recordStageTime(const std::string &stage, double wallMs, double cpuMs,
+                     int exitCode) {
+  if (tCurrentTrace) {
+    json event = {{"stage", stage}, {"ms", roundMs(wallMs)}};
+    if (cpuMs >= 0) {
+      event["cpu_ms"] = roundMs(cpuMs);
+    }
+    if (exitCode != NO_EXIT_CODE) {
+      event["exit"] = exitCode;
+    }
+    tCurrentTrace->stages.push_back(event);
+  }
+
+  std::lock_guard<std::mutex> lock(gStatsMutex);
+  StageStats &stats = gStages[stage];
+  stats.wall.add(wallMs);
+  if (cpuMs >= 0) {
+    stats.cpu.add(cpuMs);
+  }
+}
+
+void recordCacheLookup(const std::string &cache, bool hit) {
+  if (tCurrentTrace) {
+    tCurrentTrace->caches[cache] = hit ? "hit" : "miss";
+  }
+
+  std::lock_guard<std::mutex> lock(gStatsMutex);
+  CacheStats &stats = gCaches[cache];
+  (hit ? stats.hits : stats.misses)++;
+}
+
+void recordReportedTimes(const std::string &prefix,
+                         const std::string &output) {
+  static const std::string marker = "Timing: ";
+  std::istringstream lines(output);
+  std::string line;
+  while (std::getline(lines, line)) {
+    size_t found = line.find(marker);
+    if (found == std::string::npos) {
+      continue;
+    }
+    std::istringstream fields(line.substr(found + marker.size()));
+    std::string step;
+    double ms;
+    if (fields >> step >> ms) {
+      recordStageTime(prefix + "_" + step, ms);
+    }
+  }
+}
+
+json statsSnapshot(bool reset) {
+  std::lock_guard<std::mutex> lock(gStatsMutex);
+  json tools = json::object();
+  for (const auto &tool : gTools) {
+    tools[tool.first] = tool.second.toJson();
+  }
+  json stages = json::object();
+  for (const auto &stage : gStages) {
+    json entry = stage.second.wall.toJson();
+    if (stage.second.cpu.count > 0) {
+      entry["cpu"] = stage.second.cpu.toJson();
+    }
+    stages[stage.first] = entry;
+  }
+
+  json caches = json::object();
+  for (const auto &cache : gCaches) {
+    caches[cache.first] = {{"hits", cache.second.hits},
+                           {"misses", cache.second.misses}};
+  }
+
+  json snapshot = {
+      {"period_s",
+       std::chrono::duration<double>(Clock::now() - gStatsStart).count()},
+      {"tools", tools},
+      {"stages", stages},
+      {"caches", caches}};
+  if (reset) {
+    gTools.clear();
+    gStages.clear();
+    gCaches.clear();
+    gStatsStart = Clock::now();
+  }
+  return snapshot;
+}
+
+StageTimer::StageTimer(const std::string &stage)
+    : fStage(stage), fStart(Clock::now()), fStartCpuMs(threadCpuMs()) {}
+
+void StageTimer::stop() {
+  if (fStopped || fStage.empty()) {
+    return;
+  }
+  fStopped = true;
+  recordStageTime(
+      fStage,
+      std::chrono::duration<double, std::milli>(Clock::now() - fStart).count(),
+      threadCpuMs() - fStartCpuMs);
+}
+
+RequestTrace::Scope::Scope(RequestTrace &trace) : fPrevious(tCurrentTrace) {
+  tCurrentTrace = &trace;
+}
+
+RequestTrace::Scope::~Scope() { tCurrentTrace = fPrevious; }
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// ============================================================================
+// Timing Statistics
+// ============================================================================
+
+// Timings are aggregated in memory as they are recorded: a count, a sum and
+// a histogram of logarithmic buckets (8 per octave, from 1 us to about
+// 70 minutes) per tool and per stage. Recording costs a lock and a bucket
+// increment; percentiles are only computed when the statistics are read.
+
+/**
+ * @brief Record the duration of a tools/call (from the call to the response)
+ */
+void recordToolTime(const std::string &tool, double wallMs);
+
+// Exit code of a stage that is not a child process
+const int NO_EXIT_CODE = -1000;
+
+/**
+ * @brief Record the duration of a processing stage
+ *
+ * Stages are the limit stages of the child processes (e.g.
+ * "spectrogram_cxx", recorded by runProcess()) and in-process steps (e.g.
+ * "spectrogram_png"). cpuMs is the CPU time of the stage (child process or
+ * calling thread), negative when unknown. The stage is also added to the
+ * trace of the calling thread's request, if any, with its exit code.
+ */
+void recordStageTime(const std::string &stage, double wallMs,
+                     double cpuMs = -1, int exitCode = NO_EXIT_CODE);
+
+/**
+ * @brief Record a lookup in one of the server's caches, e.g. "jit"
+ */
+void recordCacheLookup(const std::string &cache, bool hit);
+
+/**
+ * @brief Record the stage timings reported by an architecture program
+ *
+ * Programs print lines "  Timing: <step> <milliseconds> ms" on stdout; each
+ * one is recorded as the stage <prefix>_<step>, e.g. spectrogram_synthesis.
+ */
+void recordReportedTimes(const std::string &prefix, const std::string &output);
+
+/**
+ * @brief Statistics as JSON
+ *
+ * {"period_s": 42.1,
+ *  "tools": {"FaustSpectrogramTool": {"count": 3, "total_ms": ...,
+ *            "mean_ms": ..., "min_ms": ..., "p50_ms": ..., "p95_ms": ...,
+ *            "p99_ms": ..., "max_ms": ...}},
+ *  "stages": {"spectrogram_cxx": {same fields, "cpu": {same fields}}},
+ *  "caches": {"jit": {"hits": 5, "misses": 2}}}
+ *
+ * period_s is the time covered: since the server started, or since the
+ * last reset. Percentiles are bucket midpoints (within 5% of the exact
+ * value).
+ * @param reset Clear the statistics once read
+ */
+json statsSnapshot(bool reset = false);
+
+/**
+ * @brief Records the wall-clock and thread CPU time of a scope as a stage
+ *
+ * Nothing is recorded for an empty stage name.
+ */
+class StageTimer {
+public:
+  explicit StageTimer(const std::string &stage);
+  ~StageTimer() { stop(); }
+  StageTimer(const StageTimer &) = delete;
+  StageTimer &operator=(const StageTimer &) = delete;
+
+  // Records the stage now instead of at the end of the scope
+  void stop();
+
+private:
+  std::string fStage;
+  std::chrono::steady_clock::time_point fStart;
+  double fStartCpuMs;
+  bool fStopped = false;
+};
+
+/**
+ * @brief Stages and cache lookups of one request
+ *
+ * While a RequestTrace::Scope is alive, recordStageTime() and
+ * recordCacheLookup() calls made on the same thread are also appended here,
+ * e.g. [{"stage": "spectrogram_cxx", "ms": 7143.1, "cpu_ms": 6986,
+ * "exit": 0}] and {"jit": "hit"}.
+ */
+struct RequestTrace {
+  json stages = json::array();
+  json caches = json::object();
+
+  // Makes a trace the current one of the calling thread
+  class Scope {
+  public:
+    explicit Scope(RequestTrace &trace);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    RequestTrace *fPrevious;
+  };
+};
@@ -1,4 +1,10 @@
 #include "utils.hh"
+#include "jsonrpc.hh"
+
+#include <cctype>
+#include <cstdlib>
+#include <ftw.h>
+#include <unistd.h>
 
 // Creates work directory if it doesn't exist
 bool ensureWorkDir() {
@@ -15,14 +21,54 @@ std::string getWorkPath(const std::string &filename) {
   return WORK_DIR + "/" + filename;
 }
 
+// Creates a unique directory (WORK_DIR/<prefix>-XXXXXX)
+ScratchDir::ScratchDir(const std::string &prefix) {
+  if (!ensureWorkDir()) {
+    return;
+  }
+  std::string pattern = getWorkPath(prefix + "-XXXXXX");
+  std::vector<char> buffer(pattern.begin(), pattern.end());
+  buffer.push_back('\0');
+  if (mkdtemp(buffer.data()) != nullptr) {
+    fPath = buffer.data();
+    // Readable by the Faust container, like the work directory itself
+    chmod(fPath.c_str(), 0755);
+  }
+}
+
+// Callback for nftw: removes files and (post-order) directories
+static int removeEntry(const char *path, const struct stat *, int,
+                       struct FTW *) {
+  return std::remove(path);
+}
+
+// Removes the request directory and everything generated in it
+ScratchDir::~ScratchDir() {
+  if (valid()) {
+    nftw(fPath.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+  }
+}
+
+// Same directory as seen from the host, for Docker-in-Docker mounts
+std::string ScratchDir::hostPath() const {
+  return configValue("host_shared_dir", HOST_SHARED_DIR) +
+         fPath.substr(WORK_DIR.size());
+}
+
+// Returns full path for a file in the request directory
+std::string ScratchDir::file(const std::string &filename) const {
+  return fPath + "/" + filename;
+}
+
 // Encodes binary data to base64 string
-std::string base64_encode(const std::vector<unsigned char> &data) {
+static std::string base64_encode(const unsigned char *data, size_t size) {
   const std::string chars =
       "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
   std::string result;
+  result.reserve((size + 2) / 3 * 4);
   int val = 0, valb = -6;
-  for (unsigned char c : data) {
-    val = (val << 8) + c;
+  for (size_t i = 0; i < size; i++) {
+    val = (val << 8) + data[i];
     valb += 8;
     while (valb >= 0) {
       result.push_back(chars[(val >> valb) & 0x3F]);
@@ -36,30 +82,20 @@ std::string base64_encode(const std::vector<unsigned char> &data) {
   return result;
 }
 
-// Reads a file and returns its content as JSON (text or base64 depending on type)
-std::optional<json> encodeFile(const std::string &filepath) {
-  std::ifstream file(filepath, std::ios::binary);
-  if (!file.is_open()) {
-    return std::nullopt;
-  }
-
-  // Read file content
-  std::vector<unsigned char> buffer((std::istreambuf_iterator<char>(file)),
-                                    std::istreambuf_iterator<char>());
-  file.close();
-
-  if (buffer.empty()) {
-    return std::nullopt;
-  }
+std::string base64_encode(const std::vector<unsigned char> &data) {
+  return base64_encode(data.data(), data.size());
+}
 
-  // Encode to base64
-  std::string encoded = base64_encode(buffer);
+std::string base64_encode(const std::string &data) {
+  return base64_encode((const unsigned char *)data.data(), data.size());
+}
 
-  // Determine MIME type based on file extension
+// MIME type of a file, from its extension
+static std::string fileMimeType(const std::string &path) {
   std::string mimeType = "application/octet-stream";
-  size_t dotPos = filepath.find_last_of('.');
+  size_t dotPos = path.find_last_of('.');
   if (dotPos != std::string::npos) {
-    std::string ext = filepath.substr(dotPos + 1);
+    std::string ext = path.substr(dotPos + 1);
     // Images
     if (ext == "png")
       mimeType = "image/png";
@@ -106,69 +142,90 @@ std::optional<json> encodeFile(const std::string &filepath) {
     else if (ext == "pdf")
       mimeType = "application/pdf";
   }
+  return mimeType;
+}
+
+// Text types are returned as text, the others as base64 data
+static bool isTextMimeType(const std::string &mimeType) {
+  return mimeType.substr(0, 5) == "text/" || mimeType == "application/json" ||
+         mimeType == "image/svg+xml" || mimeType == "application/x-faust";
+}
+
+// Reads a file and returns its content as JSON (text or base64 depending on type)
+std::optional<json> encodeFile(const std::string &filepath) {
+  std::ifstream file(filepath, std::ios::binary);
+  if (!file.is_open()) {
+    return std::nullopt;
+  }
+
+  // Read file content
+  std::vector<unsigned char> buffer((std::istreambuf_iterator<char>(file)),
+                                    std::istreambuf_iterator<char>());
+  file.close();
+
+  if (buffer.empty()) {
+    return std::nullopt;
+  }
 
   // Create JSON response - use text for text files, base64 for binary
+  std::string mimeType = fileMimeType(filepath);
   json result = {{"mimeType", mimeType}};
-
-  if (mimeType.substr(0, 5) == "text/" || mimeType == "application/json" ||
-      mimeType == "image/svg+xml" || mimeType == "application/x-faust") {
-    // For text files, return as plain text
-    std::string textContent(buffer.begin(), buffer.end());
-    result["text"] = textContent;
+  if (isTextMimeType(mimeType)) {
+    result["text"] = std::string(buffer.begin(), buffer.end());
   } else {
-    // For binary files, return as base64
-    result["data"] = encoded;
+    result["data"] = base64_encode(buffer);
   }
-
   return result;
 }
 
-// Helper function to read a file into a string
-static std::string readFileToString(const std::string& filepath) {
-  std::ifstream file(filepath);
-  if (!file.is_open()) {
-    return "";
+// Same JSON as encodeFile, with the content streamed from the open file
+std::optional<json> streamFileContent(const std::string &filepath) {
+  struct stat st;
+  if (stat(filepath.c_str(), &st) != 0 || st.st_size == 0) {
+    return std::nullopt;
+  }
+  std::string mimeType = fileMimeType(filepath);
+  bool text = isTextMimeType(mimeType);
+  json content = streamFile(filepath, text ? StreamEncoding::Text
+                                           : StreamEncoding::Base64);
+  if (content.is_null()) {
+    return std::nullopt;
   }
-  std::string content((std::istreambuf_iterator<char>(file)),
-                      std::istreambuf_iterator<char>());
-  return content;
+  json result = {{"mimeType", mimeType}};
+  result[text ? "text" : "data"] = std::move(content);
+  return result;
 }
 
-// Runs Faust compiler via docker run command (Docker-in-Docker architecture)
-// This works because the MCP container has docker CLI and socket mounted
-FaustDockerResult runFaustDocker(const std::string& faustArgs,
-                                  const std::string& workDir) {
-  FaustDockerResult result;
-
-  // Ensure work directory exists
-  ensureWorkDir();
-
-  // Paths for capturing stdout/stderr (in the MCP container's filesystem)
-  std::string stdoutPath = workDir + "/.faust_stdout";
-  std::string stderrPath = workDir + "/.faust_stderr";
-
-  // Build Docker command
-  // The trick: we need to mount HOST_SHARED_DIR from the HOST (not from MCP container)
-  // Since MCP container has HOST_SHARED_DIR mounted at WORK_DIR,
-  // we need to mount the HOST path HOST_SHARED_DIR to the Faust container
-  std::string dockerCmd =
-    "docker run --rm "
-    "-v " + HOST_SHARED_DIR + ":/tmp " +
-    FAUST_DOCKER_IMAGE + " " +
-    faustArgs +
-    " > " + stdoutPath +
-    " 2> " + stderrPath;
-
-  // Execute command
-  result.exitCode = std::system(dockerCmd.c_str());
-
-  // Read stdout and stderr
-  result.output = readFileToString(stdoutPath);
-  result.errorOutput = readFileToString(stderrPath);
-
-  // Clean up temporary files
-  std::remove(stdoutPath.c_str());
-  std::remove(stderrPath.c_str());
-
-  return result;
+// Splits an options string into arguments, honoring simple quoting
+std::vector<std::string> splitArguments(const std::string &options) {
+  std::vector<std::string> args;
+  std::string current;
+  bool inWord = false;
+  char quote = 0;
+
+  for (char c : options) {
+    if (quote) {
+      if (c == quote) {
+        quote = 0;
+      } else {
+        current += c;
+      }
+    } else if (c == '\'' || c == '"') {
+      quote = c;
+      inWord = true;
+    } else if (std::isspace((unsigned char)c)) {
+      if (inWord) {
+        args.push_back(current);
+        current.clear();
+        inWord = false;
+      }
+    } else {
+      current += c;
+      inWord = true;
+    }
+  }
+  if (inWord) {
+    args.push_back(current);
+  }
+  return args;
 }
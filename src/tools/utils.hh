@@ -8,6 +8,8 @@
 #include <sys/types.h>
 
 #include "json.hpp"
+#include "cancellation.hh"
+#include "process.hh"
 #include "config.hh"
 
 using json = nlohmann::json;
@@ -16,20 +18,37 @@ using json = nlohmann::json;
 bool ensureWorkDir();
 std::string getWorkPath(const std::string &filename);
 
+// Per-request scratch directory inside the work directory, removed with
+// all its content when the object goes out of scope (including when the
+// request is cancelled), so that concurrent requests never share files.
+// Named <prefix>-XXXXXX.
+class ScratchDir {
+public:
+  explicit ScratchDir(const std::string &prefix = "req");
+  ~ScratchDir();
+  ScratchDir(const ScratchDir &) = delete;
+  ScratchDir &operator=(const ScratchDir &) = delete;
+
+  bool valid() const { return !fPath.empty(); }
+  const std::string &path() const { return fPath; }   // MCP container path
+  std::string hostPath() const;                       // host path for mounts
+  std::string file(const std::string &filename) const;
+
+private:
+  std::string fPath;
+};
+
 // Base64 encoding function
 std::string base64_encode(const std::vector<unsigned char> &data);
+std::string base64_encode(const std::string &data); // binary-safe
 
 // Encode file to base64 and return JSON
 std::optional<json> encodeFile(const std::string &filepath);
 
-// Docker Faust integration
-struct FaustDockerResult {
-  int exitCode;
-  std::string output;      // stdout
-  std::string errorOutput; // stderr
-};
+// Same as encodeFile, the content being a placeholder streamed from the
+// file when the response is written (see StreamedContent in jsonrpc.hh)
+std::optional<json> streamFileContent(const std::string &filepath);
 
-FaustDockerResult runFaustDocker(
-    const std::string& faustArgs,
-    const std::string& workDir = WORK_DIR
-);
+// Splits user-provided compilation options into separate arguments
+// (whitespace separated, single or double quotes group words, no expansion)
+std::vector<std::string> splitArguments(const std::string &options);
@@ -0,0 +1,279 @@
+/************************************************************************
+ Artifact store of artifacts.cpp
+
+ Stores tool results through linkArtifacts() (and reads them back with
+ findArtifact() and artifactContent()), with a small store (inline_max_kb
+ = 1, artifact_max_mb = 1), and checks:
+ - identical contents, in one result or in two, share one content file
+ - two contents with the same 64-bit FNV-1a hash and size (a real
+   collision) are stored in separate files and read back unchanged
+ - when the store is over its size, the oldest results are removed as a
+   whole, a content shared with a kept result stays readable, and the
+   last result is kept even when it is larger than the store
+ - range reads of text and binary artifacts: inside, at the end and past
+   the end, and ranges that cut a UTF-8 sequence (bytes, written as
+   U+FFFD by JsonWriter)
+ - clients of protocol 2024-11-05 receive an embedded resource instead of
+   a resource_link
+ ctest runs it twice, the second time with artifact_gzip = 1.
+
+ Usage (run by ctest):
+   [FAUST_MCP_ARTIFACT_GZIP=1] ./artifacts_test
+ ************************************************************************/
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "artifacts.hh"
+#include "utils.hh"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what) {
+  std::cout << (condition ? "PASS: " : "FAIL: ") << what << std::endl;
+  failures += condition ? 0 : 1;
+}
+
+// Two 16-byte strings with the same 64-bit FNV-1a hash; so are any two
+// strings made of them followed by the same bytes
+static const char COLLISION_A[] = "59e6572e36e3e78c";
+static const char COLLISION_B[] = "396972b904754d50";
+
+static uint64_t fnv1a(const std::string &bytes) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned char c : bytes) {
+    hash ^= c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static std::string randomBytes(size_t size, unsigned seed) {
+  std::mt19937 random(seed);
+  std::string bytes(size, '\0');
+  for (char &c : bytes) {
+    c = (char)(random() & 0xFF);
+  }
+  return bytes;
+}
+
+static json textItem(const std::string &text) {
+  return {{"type", "resource"},
+          {"resource",
+           {{"uri", "file:///output.txt"},
+            {"mimeType", "text/plain"},
+            {"text", text}}}};
+}
+
+// Stores a tool result, returns its artifacts (found by the URIs of the
+// result's links or embedded resources)
+static std::vector<Artifact> storeResult(json content,
+                                         const StreamedContent &streamed,
+                                         json *linked = nullptr) {
+  json result = linkArtifacts("FaustTestTool", std::move(content), streamed);
+  std::vector<Artifact> artifacts;
+  for (const auto &item : result) {
+    std::string uri;
+    if (item["type"] == "resource_link") {
+      uri = item["uri"];
+    } else if (item["type"] == "resource") {
+      uri = item["resource"]["uri"];
+    }
+    if (auto artifact = findArtifact(uri)) {
+      artifacts.push_back(*artifact);
+    }
+  }
+  if (linked) {
+    *linked = result;
+  }
+  return artifacts;
+}
+
+static std::vector<Artifact>
+storeTexts(const std::vector<std::string> &texts) {
+  StreamedContent streamed;
+  json content = json::array();
+  for (const auto &text : texts) {
+    content.push_back(textItem(text));
+  }
+  return storeResult(content, streamed);
+}
+
+// Content of an artifact, decoded (text, or base64 for binary artifacts)
+static std::string read(const Artifact &artifact, size_t offset = 0,
+                        size_t length = SIZE_MAX) {
+  json value = artifactContent(artifact, offset, length);
+  return value.is_string() ? value.get<std::string>() : "<null>";
+}
+
+static bool readable(const Artifact &artifact) {
+  return findArtifact(artifact.uri).has_value();
+}
+
+//==============================================================================
+// Checks
+//==============================================================================
+
+static void checkSharing() {
+  std::string text = randomBytes(5000, 1);
+  auto first = storeTexts({text, text, randomBytes(5000, 2)});
+  auto second = storeTexts({text});
+  check(first.size() == 3 && second.size() == 1, "results stored");
+  if (first.size() != 3 || second.size() != 1) {
+    return;
+  }
+  check(first[0].path == first[1].path && first[0].path == second[0].path &&
+            first[0].uri != first[1].uri && first[0].uri != second[0].uri,
+        "identical contents share one file (" + first[0].path + ")");
+  check(first[2].path != first[0].path, "other contents have their own file");
+  check(read(first[1]) == text && read(second[0]) == text,
+        "shared content read back");
+}
+
+static void checkCollision() {
+  std::string a = COLLISION_A, b = COLLISION_B;
+  check(a != b && a.size() == b.size() && fnv1a(a) == fnv1a(b),
+        "the colliding strings collide");
+  // Long enough to be stored, the same tail keeping the hashes equal
+  std::string tail(3000, 'x');
+  auto stored = storeTexts({a + tail, b + tail, a + tail});
+  check(stored.size() == 3, "colliding contents stored");
+  if (stored.size() != 3) {
+    return;
+  }
+  check(stored[0].path != stored[1].path && stored[0].path == stored[2].path,
+        "colliding contents in separate files (" + stored[0].path + ", " +
+            stored[1].path + ")");
+  check(read(stored[0]) == a + tail && read(stored[1]) == b + tail &&
+            read(stored[2]) == a + tail,
+        "colliding contents read back unchanged");
+}
+
+static void checkPruning() {
+  const size_t kb = 1024;
+  std::string shared = randomBytes(300 * kb, 10);
+  auto old = storeTexts({shared, randomBytes(300 * kb, 11)});
+  auto kept = storeTexts({shared, randomBytes(500 * kb, 12)});
+  check(old.size() == 2 && kept.size() == 2, "results stored");
+  if (old.size() != 2 || kept.size() != 2) {
+    return;
+  }
+  // 1.1 MB: the oldest results go, as a whole
+  check(!readable(old[0]) && !readable(old[1]),
+        "the oldest result is removed as a whole");
+  check(readable(kept[0]) && readable(kept[1]) &&
+            read(kept[0]) == shared,
+        "the newer result is kept, with the content it shared");
+  size_t listed = listArtifacts().size();
+  check(listed == 2, "2 artifacts listed (" + std::to_string(listed) + ")");
+
+  std::string large = randomBytes(1536 * kb, 13);
+  auto last = storeTexts({large});
+  check(last.size() == 1 && readable(last[0]) && read(last[0]) == large &&
+            !readable(kept[0]) && !readable(kept[1]),
+        "the last result is kept even larger than the store");
+}
+
+static void checkRanges() {
+  // Text, with a 3-byte character at 10..12
+  std::string text = std::string(10, 'a') + "\xE2\x82\xAC" +
+                     std::string(2000, 'b') + "end";
+  auto stored = storeTexts({text});
+  check(stored.size() == 1, "text artifact stored");
+  if (stored.size() != 1) {
+    return;
+  }
+  const Artifact &artifact = stored[0];
+  size_t size = text.size();
+  check(artifact.size == size, "artifact size");
+  check(read(artifact, 5, 20) == text.substr(5, 20), "range inside");
+  check(read(artifact, size - 3, 100) == "end", "range over the end");
+  check(read(artifact, size - 3, 3) == "end", "range up to the end");
+  check(read(artifact, size, 10).empty(), "range at the end");
+  check(read(artifact, size + 100, 10).empty(), "range past the end");
+  check(read(artifact, 0, 0).empty(), "empty range");
+  check(read(artifact, 3, SIZE_MAX) == text.substr(3), "rest of the artifact");
+
+  // Offsets count bytes: a range may cut a character
+  std::string cut = read(artifact, 8, 4);
+  check(cut == "aa\xE2\x82", "range cutting a character holds its bytes");
+  std::ostringstream out;
+  {
+    JsonWriter writer(out);
+    writer.value(json(cut));
+  }
+  check(out.str() == "\"aa\xEF\xBF\xBD\"", "and is written with U+FFFD");
+
+  // Binary (a streamed image), read as base64
+  std::string bytes = randomBytes(3000, 20);
+  StreamedContent streamed;
+  std::vector<Artifact> images;
+  {
+    StreamedContent::Scope scope(streamed);
+    json content = json::array(
+        {{{"type", "image"},
+          {"mimeType", "image/png"},
+          {"data", streamBytes(bytes, StreamEncoding::Base64)}}});
+    images = storeResult(content, streamed);
+  }
+  check(images.size() == 1 && !images[0].text && images[0].size == 3000,
+        "binary artifact stored");
+  if (images.size() != 1) {
+    return;
+  }
+  check(read(images[0]) == base64_encode(bytes), "whole binary artifact");
+  check(read(images[0], 1000, 500) == base64_encode(bytes.substr(1000, 500)),
+        "binary range inside");
+  check(read(images[0], 2900, 500) == base64_encode(bytes.substr(2900)),
+        "binary range over the end");
+  check(read(images[0], 3000, 10).empty() && read(images[0], 5000).empty(),
+        "binary ranges at and past the end");
+}
+
+static void checkProtocols() {
+  std::string text = randomBytes(4000, 30);
+  StreamedContent streamed;
+  json linked;
+
+  negotiateProtocolVersion("2024-11-05");
+  auto old = storeResult(json::array({textItem(text)}), streamed, &linked);
+  bool links = false, embedded = false;
+  for (const auto &item : linked) {
+    links |= item["type"] == "resource_link";
+    embedded |= item["type"] == "resource" && old.size() == 1 &&
+                item["resource"]["uri"] == old[0].uri;
+  }
+  check(!links && embedded,
+        "2024-11-05: an embedded resource, no resource_link");
+
+  negotiateProtocolVersion("2025-06-18");
+  auto recent = storeResult(json::array({textItem(text)}), streamed, &linked);
+  links = false;
+  for (const auto &item : linked) {
+    links |= item["type"] == "resource_link" && recent.size() == 1 &&
+             item["uri"] == recent[0].uri;
+  }
+  check(links, "2025-06-18: a resource_link");
+}
+
+int main() {
+  // Settings read by the store when it is created (on first use)
+  setenv("FAUST_MCP_INLINE_MAX_KB", "1", 1);
+  setenv("FAUST_MCP_ARTIFACT_MAX_MB", "1", 1);
+  setenv("FAUST_MCP_ARTIFACT_TTL", "600", 1);
+  const char *gzip = std::getenv("FAUST_MCP_ARTIFACT_GZIP");
+  std::cout << "artifact_gzip = " << (gzip ? gzip : "0") << std::endl;
+
+  negotiateProtocolVersion("2025-06-18");
+  checkSharing();
+  checkCollision();
+  checkRanges();
+  checkProtocols();
+  // Last: removes the results stored above
+  checkPruning();
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,329 @@
+/************************************************************************
+ Cancellation of a tools/call in the middle of a compilation
+
+ Starts mcpFaustServer with the local backend, whose Faust compiler is
+ this program acting as a stub that never finishes: it records its pid
+ (the process group of the compilation, see runProcess()) and its current
+ directory (the request's ScratchDir), starts a background child, and
+ sleeps. The test sends a FaustCompileTool call, waits for the stub, sends
+ notifications/cancelled and checks that, within the kill grace period:
+ - no process of the group is left (the stub and its child)
+ - the request directory has been removed
+ and that the server sends no response to the cancelled request but
+ keeps answering others.
+
+ Usage (run by ctest):
+   ./cancellation_test <server>
+ ************************************************************************/
+
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <poll.h>
+#include <spawn.h>
+#include <string>
+#include <sys/prctl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+extern char **environ;
+
+typedef std::chrono::steady_clock Clock;
+
+// Set in the server's environment: this program then acts as the Faust
+// compiler of the local backend, and writes "<pid> <cwd>" to this file
+static const char *STUB_VARIABLE = "FAUST_MCP_TEST_STUB";
+
+// Delay between SIGTERM and SIGKILL of the process runner (process.cpp),
+// plus a margin for the server to reap the group and remove the directory
+static const std::chrono::milliseconds GRACE_PERIOD(500 + 1000);
+
+// Longest wait for the stub to start, or for a response
+static const std::chrono::seconds START_TIMEOUT(20);
+
+//==============================================================================
+// Faust stub
+//==============================================================================
+
+static int stubFaust() {
+  // A child in the same process group, as faust -> g++ or docker would
+  if (fork() == 0) {
+    pause();
+    _exit(0);
+  }
+
+  char cwd[PATH_MAX];
+  if (!getcwd(cwd, sizeof(cwd))) {
+    return 1;
+  }
+  // Written then renamed, so that the test never reads half a record
+  std::string path = std::getenv(STUB_VARIABLE);
+  {
+    std::ofstream record(path + ".tmp");
+    record << getpid() << " " << cwd << std::endl;
+  }
+  std::rename((path + ".tmp").c_str(), path.c_str());
+
+  for (;;) {
+    pause();
+  }
+}
+
+//==============================================================================
+// Server process
+//==============================================================================
+
+class ServerProcess {
+public:
+  bool start(const std::string &path, const std::vector<std::string> &env) {
+    int in[2], out[2];
+    if (pipe(in) != 0 || pipe(out) != 0) {
+      return false;
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, in[1]);
+    posix_spawn_file_actions_addclose(&actions, out[0]);
+
+    std::vector<char *> envp;
+    for (const auto &variable : env) {
+      envp.push_back(const_cast<char *>(variable.c_str()));
+    }
+    envp.push_back(nullptr);
+    char *argv[] = {const_cast<char *>(path.c_str()), nullptr};
+    int error = posix_spawn(&fPid, path.c_str(), &actions, nullptr, argv,
+                            envp.data());
+    posix_spawn_file_actions_destroy(&actions);
+    close(in[0]);
+    close(out[1]);
+    if (error != 0) {
+      close(in[1]);
+      close(out[0]);
+      return false;
+    }
+    fInput = in[1];
+    fOutput = out[0];
+    return true;
+  }
+
+  void send(const json &message) {
+    std::string line = message.dump() + "\n";
+    if (write(fInput, line.data(), line.size()) != (ssize_t)line.size()) {
+      std::cerr << "Could not write to the server" << std::endl;
+    }
+  }
+
+  // Next response line, false at end of output or after the timeout
+  bool receive(json &message, std::chrono::milliseconds timeout) {
+    auto deadline = Clock::now() + timeout;
+    for (;;) {
+      size_t end = fBuffer.find('\n');
+      if (end != std::string::npos) {
+        message = json::parse(fBuffer.substr(0, end), nullptr, false);
+        fBuffer.erase(0, end + 1);
+        return true;
+      }
+      auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+          deadline - Clock::now());
+      struct pollfd pfd = {fOutput, POLLIN, 0};
+      if (left.count() <= 0 || poll(&pfd, 1, (int)left.count()) <= 0) {
+        return false;
+      }
+      char buffer[65536];
+      ssize_t n = read(fOutput, buffer, sizeof(buffer));
+      if (n <= 0) {
+        return false;
+      }
+      fBuffer.append(buffer, n);
+    }
+  }
+
+  // Closes stdin (the server finishes its calls and exits), returns the
+  // exit status
+  int finish() {
+    close(fInput);
+    int status = 0;
+    waitpid(fPid, &status, 0);
+    close(fOutput);
+    return status;
+  }
+
+  pid_t pid() const { return fPid; }
+
+private:
+  pid_t fPid = -1;
+  int fInput = -1;
+  int fOutput = -1;
+  std::string fBuffer;
+};
+
+// Environment of the server: ours, with the settings of the test
+static std::vector<std::string>
+serverEnvironment(const std::map<std::string, std::string> &settings) {
+  std::vector<std::string> env;
+  for (char **variable = environ; *variable; variable++) {
+    std::string entry = *variable;
+    std::string name = entry.substr(0, entry.find('='));
+    if (settings.find(name) == settings.end()) {
+      env.push_back(entry);
+    }
+  }
+  for (const auto &setting : settings) {
+    env.push_back(setting.first + "=" + setting.second);
+  }
+  return env;
+}
+
+//==============================================================================
+// Checks
+//==============================================================================
+
+static bool groupAlive(pid_t pgid) {
+  return kill(-pgid, 0) == 0 || errno != ESRCH;
+}
+
+static bool exists(const std::string &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0;
+}
+
+// Reaps the children of the stub that were re-parented to this process
+// (see PR_SET_CHILD_SUBREAPER): a killed process stays in its group as a
+// zombie until it is reaped
+static void reapOrphans(pid_t server) {
+  pid_t pid;
+  int status;
+  while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+    if (pid == server) {
+      std::cerr << "The server exited" << std::endl;
+      std::exit(1);
+    }
+  }
+}
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what) {
+  std::cout << (condition ? "PASS: " : "FAIL: ") << what << std::endl;
+  failures += condition ? 0 : 1;
+}
+
+//==============================================================================
+// Main
+//==============================================================================
+
+int main(int argc, char *argv[]) {
+  if (std::getenv(STUB_VARIABLE)) {
+    return stubFaust();
+  }
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " <server>" << std::endl;
+    return 1;
+  }
+  std::string server = argv[1];
+
+  // Orphaned processes of the stub's group are re-parented to us
+  prctl(PR_SET_CHILD_SUBREAPER, 1);
+
+  // The stub is this program, found through /proc/self/exe
+  char self[PATH_MAX];
+  ssize_t length = readlink("/proc/self/exe", self, sizeof(self) - 1);
+  self[std::max<ssize_t>(length, 0)] = '\0';
+  char recordPattern[] = "/tmp/faust-mcp-test-XXXXXX";
+  if (!mkdtemp(recordPattern)) {
+    std::cerr << "Could not create a temporary directory" << std::endl;
+    return 1;
+  }
+  std::string recordDir = recordPattern;
+  std::string record = recordDir + "/stub";
+
+  ServerProcess process;
+  if (!process.start(server, serverEnvironment(
+                                 {{"FAUST_MCP_BACKEND", "local"},
+                                  {"FAUST_MCP_FAUST_BINARY", self},
+                                  {"FAUST_MCP_LOG_FILE", ""},
+                                  {STUB_VARIABLE, record}}))) {
+    std::cerr << "Could not start " << server << std::endl;
+    return 1;
+  }
+
+  process.send({{"jsonrpc", "2.0"},
+                {"id", 1},
+                {"method", "tools/call"},
+                {"params",
+                 {{"name", "FaustCompileTool"},
+                  {"arguments", {{"value", "process = _;"}}}}}});
+
+  // Wait for the stub to be running
+  pid_t pgid = 0;
+  std::string requestDir;
+  auto deadline = Clock::now() + START_TIMEOUT;
+  while (Clock::now() < deadline) {
+    std::ifstream file(record);
+    if (file >> pgid && std::getline(file >> std::ws, requestDir)) {
+      break;
+    }
+    pgid = 0;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  check(pgid > 0, "the compilation started");
+  if (pgid <= 0) {
+    process.finish();
+    return 1;
+  }
+  check(groupAlive(pgid) && exists(requestDir),
+        "the process group and the request directory exist");
+
+  // Cancel, then wait at most for the grace period
+  process.send({{"jsonrpc", "2.0"},
+                {"method", "notifications/cancelled"},
+                {"params", {{"requestId", 1}, {"reason", "test"}}}});
+  auto cancelled = Clock::now();
+  bool groupGone = false, dirGone = false;
+  while (Clock::now() - cancelled < GRACE_PERIOD) {
+    reapOrphans(process.pid());
+    groupGone = !groupAlive(pgid);
+    dirGone = !exists(requestDir);
+    if (groupGone && dirGone) {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  long ms = (long)std::chrono::duration_cast<std::chrono::milliseconds>(
+                Clock::now() - cancelled)
+                .count();
+  check(groupGone, "the process group is gone (" + std::to_string(ms) +
+                       " ms after the cancellation)");
+  check(dirGone, "the request directory " + requestDir + " is removed");
+
+  // The next response is that of a later request, not of the cancelled one
+  process.send({{"jsonrpc", "2.0"}, {"id", 2}, {"method", "tools/list"}});
+  json response;
+  bool received =
+      process.receive(response, std::chrono::milliseconds(START_TIMEOUT));
+  check(received && response.value("id", json()) == 2,
+        "no response to the cancelled request, the server still answers");
+
+  int status = process.finish();
+  check(WIFEXITED(status) && WEXITSTATUS(status) == 0,
+        "the server exits normally at the end of its input");
+
+  std::remove(record.c_str());
+  rmdir(recordDir.c_str());
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,91 @@
+/************************************************************************
+ Constant-Q transform of spectrogram_analysis.hh
+
+ Analyses pure tones tuned to CQT bins, in every octave from the lowest
+ (computed on the most decimated signal) to the top one, and checks that
+ the frames in the middle of the tone peak in the tone's bin, with the
+ magnitude the kernels are scaled for (A / 2 for a sinusoid of amplitude
+ A, within 2%), and that the bins one octave away hold little energy. For
+ several sample rates, numbers of bins per octave and lowest frequencies.
+
+ Usage (run by ctest):
+   ./cqt_test
+ ************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "spectrogram_analysis.hh"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what) {
+  std::cout << (condition ? "PASS: " : "FAIL: ") << what << std::endl;
+  failures += condition ? 0 : 1;
+}
+
+static void checkTones(int sample_rate, int bins_per_octave, float fmin) {
+  Options opts;
+  opts.transform = "cqt";
+  opts.sample_rate = sample_rate;
+  opts.bins_per_octave = bins_per_octave;
+  opts.fmin = fmin;
+  opts.hop_size = 1024;
+  std::shared_ptr<const CQTKernel> kernel = cqtKernel(opts);
+  const std::vector<float> &frequencies = kernel->frequencies;
+  int n_bins = frequencies.size();
+  int b = bins_per_octave;
+  std::string config = std::to_string(sample_rate) + " Hz, " +
+                       std::to_string(b) + " bins/octave, fmin " +
+                       std::to_string((int)std::round(frequencies[0])) +
+                       " Hz: ";
+
+  // Long enough for the longest kernel (the lowest bin) on each side of
+  // the middle frame
+  double q = 1.0 / (std::pow(2.0, 1.0 / b) - 1.0);
+  size_t length = (size_t)(3 * q * sample_rate / frequencies[0]);
+  const float amplitude = 0.5f;
+
+  // One tone per octave, at a different position in each, and the lowest
+  // and highest bins
+  std::vector<int> bins = {0, n_bins - 1};
+  for (int k = b / 3; k < n_bins; k += b + 1) {
+    bins.push_back(k);
+  }
+  for (int k : bins) {
+    std::vector<float> audio(length);
+    for (size_t i = 0; i < length; i++) {
+      audio[i] = amplitude *
+                 (float)std::sin(2 * M_PI * frequencies[k] * i / sample_rate);
+    }
+    std::vector<std::vector<float>> spec =
+        computeCQTSpectrogram(audio, opts, false);
+    const std::vector<float> &frame = spec[spec.size() / 2];
+    int peak = std::max_element(frame.begin(), frame.end()) - frame.begin();
+    std::string name = config + "tone at bin " + std::to_string(k) + " (" +
+                       std::to_string(frequencies[k]) + " Hz)";
+    check(peak == k, name + ": peak in bin " + std::to_string(peak));
+    check(std::fabs(frame[k] - amplitude / 2) < 0.02 * amplitude / 2,
+          name + ": magnitude " + std::to_string(frame[k]) + ", expected " +
+              std::to_string(amplitude / 2));
+    float octave_away = 0.0f;
+    for (int other : {k - b, k + b}) {
+      if (other >= 0 && other < n_bins) {
+        octave_away = std::max(octave_away, frame[other]);
+      }
+    }
+    check(octave_away < 0.01f * frame[k],
+          name + ": bins an octave away below 1% (" +
+              std::to_string(octave_away / frame[k]) + ")");
+  }
+}
+
+int main() {
+  checkTones(44100, 24, 0);
+  checkTones(48000, 12, 55);
+  checkTones(22050, 36, 100);
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,445 @@
+/************************************************************************
+ FLAC and WAV encoding of audio_encoding.hh
+
+ Decodes the output of encodeFLAC() with a decoder written independently
+ of the encoder (bit reader, table-driven CRCs, FLAC format specification)
+ and checks, for signals that exercise every subframe type:
+ - the STREAMINFO fields (block sizes, sample rate, channels, sample size,
+   total samples)
+ - each frame header: sync code, coded fields, UTF-8 frame number
+   (multi-byte past frame 127), CRC-8
+ - each frame's CRC-16
+ - the decoded samples, equal to the quantized input
+ It also checks the CRCs against the check values of the FLAC CRC-8 and
+ CRC-16 (the CRC of "123456789"), the WAV header fields, and that
+ streams FLAC cannot code are refused.
+
+ Usage (run by ctest):
+   ./flac_test
+ ************************************************************************/
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "audio_encoding.hh"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what) {
+  std::cout << (condition ? "PASS: " : "FAIL: ") << what << std::endl;
+  failures += condition ? 0 : 1;
+}
+
+//==============================================================================
+// Reference CRCs (table-driven)
+//==============================================================================
+
+static uint8_t crc8(const unsigned char *data, size_t size) {
+  static uint8_t table[256];
+  static bool ready = false;
+  if (!ready) {
+    for (int i = 0; i < 256; i++) {
+      uint8_t crc = (uint8_t)i;
+      for (int b = 0; b < 8; b++) {
+        crc = (uint8_t)((crc << 1) ^ ((crc & 0x80) ? 0x07 : 0));
+      }
+      table[i] = crc;
+    }
+    ready = true;
+  }
+  uint8_t crc = 0;
+  for (size_t i = 0; i < size; i++) {
+    crc = table[crc ^ data[i]];
+  }
+  return crc;
+}
+
+static uint16_t crc16(const unsigned char *data, size_t size) {
+  static uint16_t table[256];
+  static bool ready = false;
+  if (!ready) {
+    for (int i = 0; i < 256; i++) {
+      uint16_t crc = (uint16_t)(i << 8);
+      for (int b = 0; b < 8; b++) {
+        crc = (uint16_t)((crc << 1) ^ ((crc & 0x8000) ? 0x8005 : 0));
+      }
+      table[i] = crc;
+    }
+    ready = true;
+  }
+  uint16_t crc = 0;
+  for (size_t i = 0; i < size; i++) {
+    crc = (uint16_t)((crc << 8) ^ table[(crc >> 8) ^ data[i]]);
+  }
+  return crc;
+}
+
+//==============================================================================
+// Decoder
+//==============================================================================
+
+class BitReader {
+public:
+  BitReader(const std::vector<unsigned char> &data, size_t byte)
+      : fData(data), fBit(byte * 8) {}
+
+  // Reads 'bits' bits (<= 32), false past the end of the data
+  bool read(int bits, uint32_t &value) {
+    value = 0;
+    for (int i = 0; i < bits; i++) {
+      if (fBit >= fData.size() * 8) {
+        return false;
+      }
+      value = (value << 1) | ((fData[fBit / 8] >> (7 - fBit % 8)) & 1);
+      fBit++;
+    }
+    return true;
+  }
+
+  bool readSigned(int bits, int32_t &value) {
+    uint32_t raw;
+    if (!read(bits, raw)) {
+      return false;
+    }
+    value = (bits < 32 && (raw >> (bits - 1)))
+                ? (int32_t)(raw | ~((1u << bits) - 1))
+                : (int32_t)raw;
+    return true;
+  }
+
+  // Zeros before the next one
+  bool readUnary(uint32_t &count) {
+    count = 0;
+    uint32_t bit;
+    while (read(1, bit)) {
+      if (bit) {
+        return true;
+      }
+      count++;
+    }
+    return false;
+  }
+
+  void align() { fBit = (fBit + 7) / 8 * 8; }
+  size_t byte() const { return fBit / 8; }
+
+private:
+  const std::vector<unsigned char> &fData;
+  size_t fBit;
+};
+
+struct StreamInfo {
+  uint32_t minBlock, maxBlock, sampleRate, channels, bits;
+  uint64_t totalSamples;
+  int constant = 0, verbatim = 0, fixed = 0; ///< subframes decoded
+};
+
+// Decodes a stream of fixed-blocksize frames with independent channels,
+// as encodeFLAC() writes them; error describes the first inconsistency
+static bool decodeFLAC(const std::vector<unsigned char> &data,
+                       StreamInfo &info,
+                       std::vector<std::vector<int32_t>> &channels,
+                       std::string &error) {
+  if (data.size() < 42 || memcmp(data.data(), "fLaC", 4) != 0) {
+    error = "no fLaC marker";
+    return false;
+  }
+  BitReader header(data, 4);
+  uint32_t last, type, length, high, low, md5;
+  header.read(1, last);
+  header.read(7, type);
+  header.read(24, length);
+  if (!last || type != 0 || length != 34) {
+    error = "STREAMINFO is not the only metadata block";
+    return false;
+  }
+  uint32_t minFrame, maxFrame;
+  header.read(16, info.minBlock);
+  header.read(16, info.maxBlock);
+  header.read(24, minFrame);
+  header.read(24, maxFrame);
+  header.read(20, info.sampleRate);
+  header.read(3, info.channels);
+  header.read(5, info.bits);
+  header.read(4, high);
+  header.read(32, low);
+  info.channels++;
+  info.bits++;
+  info.totalSamples = ((uint64_t)high << 32) | low;
+  for (int i = 0; i < 4; i++) {
+    header.read(32, md5);
+  }
+
+  channels.assign(info.channels, {});
+  size_t pos = 42;
+  for (uint32_t frame = 0; pos < data.size(); frame++) {
+    size_t start = pos;
+    BitReader reader(data, pos);
+    uint32_t sync, blockCode, rateCode, assignment, sizeCode, reserved;
+    reader.read(16, sync);
+    reader.read(4, blockCode);
+    reader.read(4, rateCode);
+    reader.read(4, assignment);
+    reader.read(3, sizeCode);
+    reader.read(1, reserved);
+    uint32_t expectedSize = (info.bits == 16) ? 4 : (info.bits == 24) ? 6 : 0;
+    if (sync != 0xFFF8 || blockCode != 7 || rateCode != 0 ||
+        assignment != info.channels - 1 || sizeCode != expectedSize ||
+        reserved != 0) {
+      error = "frame " + std::to_string(frame) + ": bad header fields";
+      return false;
+    }
+
+    // UTF-8 coded frame number
+    uint32_t lead, number;
+    reader.read(8, lead);
+    int extra = 0;
+    while (extra < 7 && (lead & (0x80 >> extra))) {
+      extra++;
+    }
+    if (extra == 1 || extra > 6) {
+      error = "frame " + std::to_string(frame) + ": bad UTF-8 lead byte";
+      return false;
+    }
+    number = (extra == 0) ? lead : (lead & (0x7F >> extra));
+    for (int i = 1; i < extra; i++) {
+      uint32_t next;
+      reader.read(8, next);
+      if ((next & 0xC0) != 0x80) {
+        error = "frame " + std::to_string(frame) + ": bad UTF-8 byte";
+        return false;
+      }
+      number = (number << 6) | (next & 0x3F);
+    }
+    if (number != frame) {
+      error = "frame " + std::to_string(frame) + ": numbered " +
+              std::to_string(number);
+      return false;
+    }
+
+    uint32_t blockSize, headerCrc;
+    reader.read(16, blockSize);
+    blockSize++;
+    size_t crcPos = reader.byte();
+    reader.read(8, headerCrc);
+    if (headerCrc != crc8(&data[start], crcPos - start)) {
+      error = "frame " + std::to_string(frame) + ": bad CRC-8";
+      return false;
+    }
+
+    for (uint32_t c = 0; c < info.channels; c++) {
+      uint32_t pad, subType, wasted;
+      reader.read(1, pad);
+      reader.read(6, subType);
+      reader.read(1, wasted);
+      if (pad != 0 || wasted != 0) {
+        error = "frame " + std::to_string(frame) + ": bad subframe header";
+        return false;
+      }
+      std::vector<int32_t> x(blockSize);
+      if (subType == 0) {
+        int32_t value;
+        reader.readSigned(info.bits, value);
+        std::fill(x.begin(), x.end(), value);
+        info.constant++;
+      } else if (subType == 1) {
+        for (auto &sample : x) {
+          reader.readSigned(info.bits, sample);
+        }
+        info.verbatim++;
+      } else if (subType >= 8 && subType <= 12) {
+        uint32_t order = subType & 7;
+        info.fixed++;
+        for (uint32_t i = 0; i < order; i++) {
+          reader.readSigned(info.bits, x[i]);
+        }
+        uint32_t method, partitionOrder;
+        reader.read(2, method);
+        reader.read(4, partitionOrder);
+        if (method > 1) {
+          error = "frame " + std::to_string(frame) + ": bad residual coding";
+          return false;
+        }
+        int paramBits = method ? 5 : 4;
+        uint32_t partitions = 1u << partitionOrder;
+        uint32_t i = order;
+        for (uint32_t part = 0; part < partitions; part++) {
+          uint32_t k;
+          reader.read(paramBits, k);
+          if (k == (1u << paramBits) - 1) {
+            error = "frame " + std::to_string(frame) + ": escaped partition";
+            return false;
+          }
+          uint32_t count =
+              (blockSize >> partitionOrder) - (part == 0 ? order : 0);
+          for (uint32_t j = 0; j < count; j++, i++) {
+            uint32_t high, low = 0;
+            if (!reader.readUnary(high) || !reader.read(k, low)) {
+              error = "frame " + std::to_string(frame) + ": truncated";
+              return false;
+            }
+            uint32_t folded = (high << k) | low;
+            int64_t residual = (folded >> 1) ^ -(int64_t)(folded & 1);
+            // Fixed predictors of orders 0 to 4
+            int64_t prediction = 0;
+            switch (order) {
+            case 1:
+              prediction = x[i - 1];
+              break;
+            case 2:
+              prediction = 2 * (int64_t)x[i - 1] - x[i - 2];
+              break;
+            case 3:
+              prediction =
+                  3 * (int64_t)x[i - 1] - 3 * (int64_t)x[i - 2] + x[i - 3];
+              break;
+            case 4:
+              prediction = 4 * (int64_t)x[i - 1] - 6 * (int64_t)x[i - 2] +
+                           4 * (int64_t)x[i - 3] - x[i - 4];
+              break;
+            }
+            x[i] = (int32_t)(prediction + residual);
+          }
+        }
+      } else {
+        error = "frame " + std::to_string(frame) + ": subframe type " +
+                std::to_string(subType);
+        return false;
+      }
+      channels[c].insert(channels[c].end(), x.begin(), x.end());
+    }
+
+    reader.align();
+    uint32_t frameCrc;
+    size_t end = reader.byte();
+    if (!reader.read(16, frameCrc) ||
+        frameCrc != crc16(&data[start], end - start)) {
+      error = "frame " + std::to_string(frame) + ": bad CRC-16";
+      return false;
+    }
+    pos = end + 2;
+  }
+  return true;
+}
+
+//==============================================================================
+// Checks
+//==============================================================================
+
+// Encodes a signal, decodes it and compares everything with the input;
+// returns the stream information
+static StreamInfo roundTrip(const std::string &name,
+                      const std::vector<std::vector<float>> &signal,
+                      int sample_rate, int bits) {
+  std::vector<unsigned char> encoded;
+  StreamInfo info;
+  if (!encodeFLAC(signal, sample_rate, bits, encoded)) {
+    check(false, name + ": encoded");
+    return info;
+  }
+  std::vector<std::vector<int32_t>> decoded;
+  std::string error;
+  bool ok = decodeFLAC(encoded, info, decoded, error);
+  check(ok, name + ": frame headers, CRC-8 and CRC-16 " +
+                (ok ? "valid" : "(" + error + ")"));
+  if (!ok) {
+    return info;
+  }
+  check(info.minBlock == FLAC_BLOCK_SIZE && info.maxBlock == FLAC_BLOCK_SIZE &&
+            info.sampleRate == (uint32_t)sample_rate &&
+            info.channels == signal.size() && info.bits == (uint32_t)bits &&
+            info.totalSamples == signal[0].size(),
+        name + ": STREAMINFO fields");
+
+  bool same = true;
+  for (size_t c = 0; c < signal.size() && same; c++) {
+    same = decoded[c].size() == signal[c].size();
+    for (size_t i = 0; i < signal[c].size() && same; i++) {
+      same = decoded[c][i] == quantizeSample(signal[c][i], bits);
+    }
+  }
+  check(same, name + ": decoded samples equal the quantized input");
+  return info;
+}
+
+static uint32_t readLE(const std::vector<unsigned char> &data, size_t pos,
+                       int bytes) {
+  uint32_t value = 0;
+  for (int i = bytes - 1; i >= 0; i--) {
+    value = (value << 8) | data[pos + i];
+  }
+  return value;
+}
+
+int main() {
+  // Check values of the CRCs (CRC-8 and CRC-16/UMTS of "123456789")
+  const unsigned char digits[] = "123456789";
+  check(flacCRC8(digits, 9) == 0xF4 && crc8(digits, 9) == 0xF4,
+        "CRC-8 check value 0xF4");
+  check(flacCRC16(digits, 9) == 0xFEE8 && crc16(digits, 9) == 0xFEE8,
+        "CRC-16 check value 0xFEE8");
+
+  // A tone (fixed predictors), noise (verbatim subframes), silence and a
+  // constant (constant subframes), with a last partial frame
+  const int rate = 48000;
+  const size_t length = 3 * FLAC_BLOCK_SIZE + 1000;
+  std::vector<float> tone(length), noise(length), silence(length, 0.0f),
+      constant(length, 0.25f), ramp(length);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < length; i++) {
+    tone[i] = 0.8f * std::sin(2 * M_PI * 440.0 * i / rate);
+    seed = seed * 1664525u + 1013904223u;
+    noise[i] = (float)((int32_t)seed) / 2147483648.0f;
+    ramp[i] = -1.0f + 2.0f * i / length;
+  }
+  roundTrip("16-bit stereo tone and noise", {tone, noise}, rate, 16);
+  StreamInfo info =
+      roundTrip("24-bit tone, noise, silence, constant, ramp",
+                {tone, noise, silence, constant, ramp}, 96000, 24);
+  check(info.constant > 0 && info.verbatim > 0 && info.fixed > 0,
+        "constant, verbatim and fixed subframes decoded");
+  roundTrip("one sample", {{0.5f}}, 44100, 16);
+  roundTrip("highest sample rate", {tone}, FLAC_MAX_SAMPLE_RATE, 16);
+
+  // More than 127 frames: multi-byte UTF-8 frame numbers
+  std::vector<float> long_tone(130 * FLAC_BLOCK_SIZE + 17);
+  for (size_t i = 0; i < long_tone.size(); i++) {
+    long_tone[i] = 0.5f * std::sin(2 * M_PI * 1000.0 * i / rate);
+  }
+  roundTrip("131 frames", {long_tone}, rate, 16);
+
+  // A corrupted stream is detected by the decoder's CRC checks
+  std::vector<unsigned char> out;
+  encodeFLAC({tone}, rate, 16, out);
+  out[out.size() / 2] ^= 0x10;
+  std::vector<std::vector<int32_t>> decoded;
+  std::string error;
+  bool decoded_ok = decodeFLAC(out, info, decoded, error);
+  check(!decoded_ok, "corruption detected (" + error + ")");
+
+  // Streams FLAC cannot code
+  check(!encodeFLAC({tone}, FLAC_MAX_SAMPLE_RATE + 1, 16, out) &&
+            !encodeFLAC(std::vector<std::vector<float>>(9, tone), rate, 16,
+                        out) &&
+            !encodeAudio("flac", {tone}, 1000000, 16, out),
+        "sample rates over 655350 Hz and 9 channels are refused");
+
+  // WAV header fields
+  check(encodeWAV({tone, ramp}, rate, 24, out), "WAV encoded");
+  uint32_t data_size = length * 2 * 3;
+  check(out.size() == 44 + data_size && readLE(out, 4, 4) == 36 + data_size &&
+            readLE(out, 22, 2) == 2 && readLE(out, 24, 4) == (uint32_t)rate &&
+            readLE(out, 28, 4) == (uint32_t)rate * 2 * 3 &&
+            readLE(out, 32, 2) == 6 && readLE(out, 34, 2) == 24 &&
+            readLE(out, 40, 4) == data_size,
+        "WAV header fields");
+  check((readLE(out, 44 + 3, 3) | 0xFF000000u) ==
+            (uint32_t)quantizeSample(ramp[0], 24),
+        "WAV samples interleaved");
+
+  return failures == 0 ? 0 : 1;
+}
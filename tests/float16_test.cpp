@@ -0,0 +1,132 @@
+/************************************************************************
+ Half-precision conversion of spectrogram_matrix.hh
+
+ Checks floatToHalf() (the float16 matrices of matrix_type) against known
+ bit patterns: zeros, one, the largest finite half (65504) and the values
+ that round to it or overflow to infinity, infinities, NaN, the smallest
+ normal, subnormals down to the smallest (2^-24) and the values that round
+ to it or to zero. Then, for every half value, against a reference decoder
+ (ldexp of the fields): the half itself converts back to the same bits,
+ and the midpoint between it and the next half rounds to the even one of
+ the two, values just below and above the midpoint to the nearest.
+
+ Usage (run by ctest):
+   ./float16_test
+ ************************************************************************/
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include "spectrogram_matrix.hh"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what) {
+  std::cout << (condition ? "PASS: " : "FAIL: ") << what << std::endl;
+  failures += condition ? 0 : 1;
+}
+
+static std::string hex(uint16_t bits) {
+  char text[8];
+  std::snprintf(text, sizeof(text), "0x%04X", bits);
+  return text;
+}
+
+// Value of a finite half (not infinity or NaN)
+static double halfValue(uint16_t half) {
+  int exponent = (half >> 10) & 0x1f;
+  int mantissa = half & 0x3ff;
+  double value = (exponent == 0)
+                     ? std::ldexp((double)mantissa, -24)
+                     : std::ldexp((double)(mantissa | 0x400), exponent - 25);
+  return (half & 0x8000) ? -value : value;
+}
+
+static void checkBits(float value, uint16_t expected, const std::string &what) {
+  uint16_t half = floatToHalf(value);
+  check(half == expected, what + ": " + hex(half) + ", expected " +
+                              hex(expected));
+}
+
+int main() {
+  const float inf = std::numeric_limits<float>::infinity();
+
+  checkBits(0.0f, 0x0000, "0");
+  checkBits(-0.0f, 0x8000, "-0");
+  checkBits(1.0f, 0x3C00, "1");
+  checkBits(-2.0f, 0xC000, "-2");
+  checkBits(0.5f, 0x3800, "0.5");
+  checkBits(0.333333343f, 0x3555, "1/3");
+  checkBits(1.0f + std::ldexp(1.0f, -10), 0x3C01, "1 + 2^-10");
+  checkBits(1.0f + std::ldexp(1.0f, -11), 0x3C00, "1 + 2^-11 (tie, even)");
+  checkBits(1.0f + 3 * std::ldexp(1.0f, -11), 0x3C02,
+            "1 + 3 x 2^-11 (tie, even)");
+  checkBits(65504.0f, 0x7BFF, "65504");
+  checkBits(-65504.0f, 0xFBFF, "-65504");
+  checkBits(65519.0f, 0x7BFF, "65519 (rounds to 65504)");
+  checkBits(65520.0f, 0x7C00, "65520 (tie, overflows)");
+  checkBits(1e6f, 0x7C00, "1e6");
+  checkBits(-1e6f, 0xFC00, "-1e6");
+  checkBits(std::numeric_limits<float>::max(), 0x7C00, "FLT_MAX");
+  checkBits(inf, 0x7C00, "inf");
+  checkBits(-inf, 0xFC00, "-inf");
+  checkBits(std::nanf(""), 0x7E00, "NaN");
+  checkBits(std::ldexp(1.0f, -14), 0x0400, "2^-14 (smallest normal)");
+  checkBits(std::ldexp(1023.0f, -24), 0x03FF, "largest subnormal");
+  checkBits(std::ldexp(1.0f, -24), 0x0001, "2^-24 (smallest subnormal)");
+  checkBits(-std::ldexp(1.0f, -24), 0x8001, "-2^-24");
+  checkBits(std::ldexp(3.0f, -25), 0x0002, "3 x 2^-25 (tie, even)");
+  checkBits(std::ldexp(5.0f, -25), 0x0002, "5 x 2^-25 (tie, even)");
+  checkBits(std::ldexp(1.0f, -25), 0x0000, "2^-25 (tie, even: zero)");
+  checkBits(std::nextafter(std::ldexp(1.0f, -25), 1.0f), 0x0001,
+            "just above 2^-25");
+  checkBits(-std::ldexp(1.0f, -26), 0x8000, "-2^-26");
+  checkBits(std::numeric_limits<float>::denorm_min(), 0x0000,
+            "smallest float subnormal");
+  checkBits(std::ldexp(2047.0f, -25), 0x0400,
+            "largest subnormal + half ulp (rounds to the smallest normal)");
+
+  // Every half: itself, and the midpoints to the next one
+  int wrong_exact = 0, wrong_midpoint = 0, wrong_near = 0;
+  std::string example;
+  for (uint32_t bits = 0; bits < 0x10000; bits++) {
+    uint16_t half = (uint16_t)bits;
+    if ((half & 0x7C00) == 0x7C00) {
+      continue; // infinities and NaNs, checked above
+    }
+    double value = halfValue(half);
+    if (floatToHalf((float)value) != half) {
+      wrong_exact++;
+      example = hex(half);
+    }
+    // Next half away from zero (0x7C00 for the largest: infinity)
+    uint16_t next = half + 1;
+    double next_value = ((next & 0x7C00) == 0x7C00)
+                            ? std::copysign(65536.0, value)
+                            : halfValue(next);
+    float midpoint = (float)((value + next_value) / 2);
+    uint16_t even = (half & 1) ? next : half;
+    if (floatToHalf(midpoint) != even) {
+      wrong_midpoint++;
+      example = hex(half) + " (midpoint)";
+    }
+    float below = std::nextafter(midpoint, (float)value);
+    float above = std::nextafter(midpoint, (float)next_value);
+    if (floatToHalf(below) != half || floatToHalf(above) != next) {
+      wrong_near++;
+      example = hex(half) + " (near the midpoint)";
+    }
+  }
+  check(wrong_exact == 0, "every finite half converts back to itself" +
+                              (wrong_exact ? ", not " + example : ""));
+  check(wrong_midpoint == 0, "midpoints round to even" +
+                                 (wrong_midpoint ? ", not " + example : ""));
+  check(wrong_near == 0, "values around the midpoints round to nearest" +
+                             (wrong_near ? ", not " + example : ""));
+
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,337 @@
+/************************************************************************
+ JSON-RPC scanner and JSON writer of jsonrpc.cpp
+
+ scanRequest() must accept exactly the lines json::parse accepts and
+ extract the same members. For a corpus of valid requests (escaped member
+ names and values, members of the same names nested in params or in
+ other values, duplicate keys, spaces, surrogate pairs) it checks id,
+ method, params, params.name and params.arguments against the parsed
+ document; for a corpus of malformed lines (syntax, numbers, escapes,
+ control characters, invalid UTF-8, trailing text) that both refuse
+ them; and for random mutations of the valid lines that both take the
+ same decision.
+
+ JsonWriter must write the same text as json::dump() (invalid UTF-8
+ being replaced by U+FFFD, as dump() does with error_handler_t::replace):
+ checked on values with every control character, quotes and
+ backslashes, valid and invalid UTF-8 (stray continuation bytes,
+ truncated, overlong and surrogate sequences, bytes above 0xF4), numbers,
+ nested containers, strings longer than the writer's buffer, and random
+ byte strings.
+
+ Usage (run by ctest):
+   ./jsonrpc_test
+ ************************************************************************/
+
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "jsonrpc.hh"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what) {
+  std::cout << (condition ? "PASS: " : "FAIL: ") << what << std::endl;
+  failures += condition ? 0 : 1;
+}
+
+// Whether json::parse accepts a line
+static bool parses(const std::string &line) {
+  try {
+    json::parse(line).type();
+    return true;
+  } catch (const json::exception &) {
+    return false;
+  }
+}
+
+// A line as a quoted ASCII string, for the messages
+static std::string printable(const std::string &line) {
+  return json(line).dump(-1, ' ', true, json::error_handler_t::replace);
+}
+
+// A raw member of RequestFields against the parsed value (absent when the
+// view is empty)
+static bool sameMember(std::string_view raw, const json &object,
+                       const char *key) {
+  if (!object.is_object() || !object.contains(key)) {
+    return raw.empty();
+  }
+  return !raw.empty() && json::parse(raw) == object[key];
+}
+
+static std::string decodedString(const json &object, const char *key) {
+  if (object.is_object() && object.contains(key) && object[key].is_string()) {
+    return object[key].get<std::string>();
+  }
+  return "";
+}
+
+//==============================================================================
+// scanRequest
+//==============================================================================
+
+// Whether scanRequest accepts a valid line and extracts the members
+// json::parse finds
+static bool sameFields(const std::string &line, std::string &error) {
+  RequestFields fields;
+  if (!scanRequest(line, fields, error)) {
+    return false;
+  }
+  json request = json::parse(line);
+  json params = request.is_object() && request.contains("params")
+                    ? request["params"]
+                    : json();
+  return fields.isObject == request.is_object() &&
+         sameMember(fields.id, request, "id") &&
+         fields.method == decodedString(request, "method") &&
+         sameMember(fields.params, request, "params") &&
+         fields.toolName == decodedString(params, "name") &&
+         sameMember(fields.arguments, params, "arguments");
+}
+
+static const char *VALID_REQUESTS[] = {
+    R"({"jsonrpc":"2.0","id":1,"method":"tools/list"})",
+    R"({"jsonrpc":"2.0","id":"abc","method":"tools/call",)"
+    R"("params":{"name":"faust_compile","arguments":{"code":"process=_;"}}})",
+    R"(  {  "id" : -12.5e+3 , "method" : "ping" , "params" : [ 1 , 2 ] }  )",
+    "\t{\r\n\"id\":null,\n\"method\":\"initialize\"}\r\n",
+    // Escaped member names and values
+    R"({"id":7,"method":"tools\/call",)"
+    R"("params":{"name":"a\"b\\c","arguments":"x"}})",
+    R"({"\u0069d":"\ud83c\udfb5\u00e9\n\t","method":"\u00e9t\u00e9"})",
+    R"({"i\u0064":1,"m\u0065thod":"tools/call",)"
+    R"("par\u0061ms":{"n\u0061me":"\u0078","\u0061rguments":[]}})",
+    "{\"id\":\"\xC3\xA9\xE2\x82\xAC\xF0\x9F\x8E\xB5\","
+    "\"method\":\"\xE2\x82\xAC\"}",
+    // Members of the same names nested in other values
+    R"({"params":{"id":1,"method":"inner","params":{"name":"x"}},)"
+    R"("id":2,"method":"outer"})",
+    R"({"id":[{"id":3}],"method":"m",)"
+    R"("params":{"arguments":{"name":"n","arguments":1},"name":"t"}})",
+    R"({"data":{"method":"x"},"list":[{"params":{}}],"id":{"method":"y"}})",
+    // Duplicate keys: the last one wins
+    R"({"id":1,"id":2,"method":"a","method":"b",)"
+    R"("params":{"name":"x","name":"y"}})",
+    R"({"method":"tools/call","params":{"name":"x"},)"
+    R"("params":{"arguments":[]}})",
+    R"({"method":7,"params":{"name":false}})",
+    // Valid JSON that is no object, and an empty object
+    R"([1,{"id":2}])",
+    R"("just a string")",
+    "42",
+    "{}",
+    R"({"id":0,"method":"","params":null})",
+    R"({"id":1E2,"method":"x","params":{"name":"","arguments":{}}})",
+};
+
+static const char *INVALID_REQUESTS[] = {
+    "",
+    "   ",
+    "{",
+    R"({"id":1,})",
+    R"({"id":1 "method":"x"})",
+    R"({'id':1})",
+    R"({id:1})",
+    R"({"id":01})",
+    R"({"id":1.})",
+    R"({"id":.5})",
+    R"({"id":-})",
+    R"({"id":1e})",
+    R"({"id":+1})",
+    R"({"id":NaN})",
+    R"({"id":tru})",
+    R"({"id":1}})",
+    R"({"id":1} x)",
+    R"({"id":1}{})",
+    R"([1,])",
+    R"({"method":"a\qb"})",
+    R"({"method":"\u12G4"})",
+    R"({"method":"\ud800"})",
+    R"({"method":"\udc00\ud800"})",
+    R"({"method":"\ud800A"})",
+    "{\"method\":\"a\tb\"}",
+    "{\"method\":\"a\nb\"}",
+    "{\"method\":\"unterminated}",
+    "{\"method\":\"\x80\"}",
+    "{\"method\":\"\xC3\"}",
+    "{\"method\":\"\xC0\xAF\"}",
+    "{\"method\":\"\xE0\x80\xAF\"}",
+    "{\"method\":\"\xED\xA0\x80\"}",
+    "{\"method\":\"\xF4\x90\x80\x80\"}",
+    "{\"method\":\"\xF5\x80\x80\x80\"}",
+    "{\"method\":\"\xFF\"}",
+    "{\"id\xE2\x82\":1}",
+};
+
+static void checkScanner() {
+  for (const char *line : VALID_REQUESTS) {
+    std::string error;
+    check(sameFields(line, error),
+          "scanRequest fields of " + printable(line) + " " + error);
+  }
+
+  for (const char *line : INVALID_REQUESTS) {
+    RequestFields fields;
+    std::string error;
+    bool scanned = scanRequest(line, fields, error);
+    check(!scanned && !error.empty() && !parses(line),
+          "both refuse " + printable(line) + " (" + error + ")");
+  }
+  // A NUL byte inside a string (not expressible as a C string above)
+  std::string nul("{\"method\":\"a\0b\"}", 16);
+  RequestFields fields;
+  std::string error;
+  check(!scanRequest(nul, fields, error) && !parses(nul),
+        "both refuse a NUL byte in a string");
+
+  // Random mutations of the valid lines: replaced, inserted and deleted
+  // bytes, drawn from the characters that matter to the grammar
+  static const char alphabet[] = "{}[]\":,\\ \tu0123456789.eE+-tfnlrsabd\x80"
+                                 "\xBF\xC3\xE2\xED\xF0\xFF";
+  std::mt19937 random(1234);
+  int disagreements = 0, accepted = 0;
+  std::string example;
+  for (int round = 0; round < 20000; round++) {
+    std::string line =
+        VALID_REQUESTS[random() % (sizeof(VALID_REQUESTS) /
+                                   sizeof(VALID_REQUESTS[0]))];
+    int edits = 1 + random() % 3;
+    for (int e = 0; e < edits && !line.empty(); e++) {
+      size_t pos = random() % line.size();
+      char c = alphabet[random() % (sizeof(alphabet) - 1)];
+      switch (random() % 3) {
+      case 0:
+        line[pos] = c;
+        break;
+      case 1:
+        line.insert(line.begin() + pos, c);
+        break;
+      default:
+        line.erase(pos, 1);
+      }
+    }
+    bool valid = parses(line);
+    accepted += valid ? 1 : 0;
+    if (valid ? !sameFields(line, error)
+              : scanRequest(line, fields, error)) {
+      disagreements++;
+      example = line;
+    }
+  }
+  check(disagreements == 0,
+        "scanRequest and json::parse agree on 20000 mutated lines (" +
+            std::to_string(accepted) + " valid)" +
+            (disagreements ? ", " + std::to_string(disagreements) +
+                                 " disagree, e.g. " + printable(example)
+                           : ""));
+}
+
+//==============================================================================
+// JsonWriter
+//==============================================================================
+
+static std::string written(const json &value) {
+  std::ostringstream out;
+  {
+    JsonWriter writer(out);
+    writer.value(value);
+  }
+  return out.str();
+}
+
+static std::string dumped(const json &value) {
+  return value.dump(-1, ' ', false, json::error_handler_t::replace);
+}
+
+static void checkWriter(const json &value, const std::string &what) {
+  std::string text = written(value);
+  std::string expected = dumped(value);
+  check(text == expected, "JsonWriter writes " + what + " as dump()" +
+                              (text == expected ? "" : ": " + printable(text)));
+}
+
+static void checkWriters() {
+  std::string controls;
+  for (int c = 0; c < 0x20; c++) {
+    controls += (char)c;
+  }
+  controls += "\x7F\"\\/";
+  checkWriter(controls, "every control character");
+  checkWriter(json::object({{controls, controls}}),
+              "control characters in a key");
+
+  const char *utf8[] = {
+      "\xC3\xA9t\xC3\xA9",          // valid 2 bytes
+      "\xE2\x82\xAC",               // valid 3 bytes
+      "\xF0\x9F\x8E\xB5",           // valid 4 bytes
+      "\xEF\xBF\xBF\xF4\x8F\xBF\xBF", // highest code points
+      "a\x80z",                     // stray continuation byte
+      "a\xBF\xBFz",                 // two of them
+      "a\xC3z",                     // truncated 2 bytes
+      "a\xE2\x82z",                 // truncated 3 bytes
+      "a\xF0\x9F\x8Ez",             // truncated 4 bytes
+      "\xE2\x82",                   // truncated at the end
+      "\xC0\xAF",                   // overlong '/'
+      "\xE0\x80\xAF",               // overlong 3 bytes
+      "\xF0\x80\x80\xAF",           // overlong 4 bytes
+      "\xED\xA0\x80",               // surrogate
+      "\xF4\x90\x80\x80",           // above U+10FFFF
+      "\xF5\x80\x80\x80",           // invalid lead byte
+      "\xFE\xFF",                   // never in UTF-8
+      "\xC3\xA9\x80\xE2\x82\xAC\xFF\"\n", // mixed
+  };
+  for (const char *text : utf8) {
+    checkWriter(std::string(text), "the bytes of " + printable(text));
+  }
+
+  checkWriter(json::parse(R"({"b":[1,-2,3.5,1e300,-0.0,0.1,true,false,null],
+                              "a":{"z":{},"y":[],"x":""},
+                              "c":18446744073709551615,
+                              "d":-9223372036854775808})"),
+              "numbers and nested containers");
+  checkWriter(json(std::nan("")), "NaN");
+
+  // Longer than the writer's buffer, escapes and invalid bytes straddling
+  // its boundary
+  std::string large;
+  for (int i = 0; i < 200000; i++) {
+    large += (i % 997 == 0) ? "\n" : (i % 1009 == 0) ? "\xE2\x82\xAC" : "x";
+    if (i % 65531 == 0) {
+      large += "\xE2\x82";
+    }
+  }
+  checkWriter(json::array({large, json::object({{"k", large}})}),
+              "strings longer than the buffer");
+
+  // Random byte strings
+  std::mt19937 random(99);
+  int mismatches = 0;
+  std::string example;
+  for (int round = 0; round < 5000; round++) {
+    std::string bytes(random() % 24, '\0');
+    for (char &c : bytes) {
+      // Biased towards the bytes that start or continue UTF-8 sequences
+      int r = random() % 4;
+      c = (char)(r == 0   ? random() % 0x80
+                 : r == 1 ? 0x80 + random() % 0x40
+                          : 0xC0 + random() % 0x40);
+    }
+    if (written(bytes) != dumped(bytes)) {
+      mismatches++;
+      example = printable(written(bytes));
+    }
+  }
+  check(mismatches == 0, "JsonWriter writes 5000 random byte strings as "
+                         "dump()" +
+                             (mismatches ? ", e.g. " + example : ""));
+}
+
+int main() {
+  checkScanner();
+  checkWriters();
+  return failures == 0 ? 0 : 1;
+}
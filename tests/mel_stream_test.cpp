@@ -0,0 +1,123 @@
+/************************************************************************
+ Streaming mel spectrogram of spectrogram_analysis.hh
+
+ Pushes a signal into MelSpectrogramStream in chunks of odd sizes (one
+ sample, primes, more than a frame, some of them silence through
+ pushSilence()) and compares the frames of finish() element by element
+ with computeMelSpectrogram() on the whole signal (not normalized), which
+ the stream must equal exactly: same framing, same arithmetic. For the
+ none, zero and reflect paddings, the mel, linear and log rows, with and
+ without dB conversion, hop sizes below and above the frame size, and
+ signals from empty to shorter than half a frame to many frames.
+
+ Usage (run by ctest):
+   ./mel_stream_test
+ ************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "spectrogram_analysis.hh"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what) {
+  std::cout << (condition ? "PASS: " : "FAIL: ") << what << std::endl;
+  failures += condition ? 0 : 1;
+}
+
+// Two tones and noise, with a stretch of silence (pushed with
+// pushSilence()) between 40% and 50% of the signal
+static std::vector<float> testSignal(size_t n, size_t *silence_start,
+                                     size_t *silence_end) {
+  std::vector<float> signal(n);
+  std::mt19937 random(7);
+  std::uniform_real_distribution<float> noise(-0.01f, 0.01f);
+  *silence_start = n * 4 / 10;
+  *silence_end = n / 2;
+  for (size_t i = 0; i < n; i++) {
+    if (i >= *silence_start && i < *silence_end) {
+      continue;
+    }
+    signal[i] = (float)(0.5 * std::sin(2 * M_PI * 440 * i / 44100.0) +
+                        0.25 * std::sin(2 * M_PI * 3000 * i / 44100.0)) +
+                noise(random);
+  }
+  return signal;
+}
+
+static void checkStream(size_t n, const Options &opts) {
+  std::string name = opts.padding + " " + opts.frequency_scale +
+                     (opts.use_db ? " dB" : "") + " n=" + std::to_string(n) +
+                     " fft=" + std::to_string(opts.fft_size) +
+                     " hop=" + std::to_string(opts.hop_size);
+  size_t silence_start, silence_end;
+  std::vector<float> signal = testSignal(n, &silence_start, &silence_end);
+
+  static const int chunks[] = {1, 3, 7, 13, 31, 127, 509, 1031};
+  MelSpectrogramStream stream(opts);
+  size_t pos = 0;
+  for (int c = 0; pos < n; c++) {
+    size_t count = std::min<size_t>(chunks[c % 8], n - pos);
+    if (pos >= silence_start && pos < silence_end) {
+      count = std::min(count, silence_end - pos);
+      stream.pushSilence((int)count);
+    } else {
+      if (pos < silence_start) {
+        count = std::min(count, silence_start - pos);
+      }
+      stream.push(&signal[pos], (int)count);
+    }
+    pos += count;
+  }
+  std::vector<std::vector<float>> streamed = stream.finish();
+  std::vector<std::vector<float>> expected =
+      computeMelSpectrogram(signal, opts, false);
+
+  bool same = (streamed.size() == expected.size());
+  size_t mismatches = 0;
+  for (size_t frame = 0; same && frame < expected.size(); frame++) {
+    same = (streamed[frame].size() == expected[frame].size());
+    for (size_t row = 0; same && row < expected[frame].size(); row++) {
+      mismatches += (streamed[frame][row] != expected[frame][row]) ? 1 : 0;
+    }
+  }
+  check(same && mismatches == 0,
+        name + ": " + std::to_string(streamed.size()) + " frames (" +
+            std::to_string(expected.size()) + " expected), " +
+            std::to_string(mismatches) + " values differ");
+}
+
+int main() {
+  const char *paddings[] = {"none", "zero", "reflect"};
+  const char *scales[] = {"mel", "linear", "log"};
+  size_t lengths[] = {0, 1, 100, 300, 512, 513, 5003};
+  int hops[] = {128, 200, 700};
+  for (const char *padding : paddings) {
+    for (const char *scale : scales) {
+      for (size_t n : lengths) {
+        for (int hop : hops) {
+          Options opts;
+          opts.fft_size = 512;
+          opts.hop_size = hop;
+          opts.mel_bands = 40;
+          opts.padding = padding;
+          opts.frequency_scale = scale;
+          checkStream(n, opts);
+        }
+      }
+    }
+    Options opts;
+    opts.fft_size = 1024;
+    opts.hop_size = 256;
+    opts.padding = padding;
+    opts.use_db = true;
+    opts.db_min = -100;
+    checkStream(20011, opts);
+  }
+  return failures == 0 ? 0 : 1;
+}
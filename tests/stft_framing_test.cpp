@@ -0,0 +1,205 @@
+/************************************************************************
+ STFT framing of spectrogram_analysis.hh
+
+ Checks stftFrameCount(), stftFrameStart() and paddedIndex() against a
+ naive reference that builds the padded signal explicitly (fft_size / 2
+ samples of silence or of the mirror image on each side, the mirror image
+ being walked sample by sample, bouncing off both ends of the signal) and
+ slides a window over it. For the none, zero and reflect paddings and
+ signals from empty to several frames long, including signals shorter
+ than one frame and shorter than fft_size / 2:
+ - the number of frames
+ - the input samples of each frame passed by forEachSTFTFrame()
+ - the magnitudes of computeSTFT(), against a direct DFT
+
+ Usage (run by ctest):
+   ./stft_framing_test
+ ************************************************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "spectrogram_analysis.hh"
+
+static int failures = 0;
+
+static void check(bool condition, const std::string &what) {
+  std::cout << (condition ? "PASS: " : "FAIL: ") << what << std::endl;
+  failures += condition ? 0 : 1;
+}
+
+//==============================================================================
+// Naive reference
+//==============================================================================
+
+// Sample at position i (outside the signal) of the reflected signal: walks
+// from the nearest end one sample at a time, turning back at each end
+// without repeating the edge sample
+static float reflectedSample(const std::vector<float> &signal, long i) {
+  long n = signal.size();
+  if (n == 1) {
+    return signal[0];
+  }
+  long position = (i < 0) ? 0 : n - 1;
+  int direction = (i < 0) ? 1 : -1;
+  long steps = (i < 0) ? -i : i - (n - 1);
+  for (long s = 0; s < steps; s++) {
+    if (position + direction < 0 || position + direction >= n) {
+      direction = -direction;
+    }
+    position += direction;
+  }
+  return signal[position];
+}
+
+static std::vector<float> paddedSignal(const std::vector<float> &signal,
+                                       int fft_size,
+                                       const std::string &padding) {
+  if (padding == "none" || signal.empty()) {
+    return signal;
+  }
+  long pad = fft_size / 2;
+  long n = signal.size();
+  std::vector<float> padded;
+  for (long i = -pad; i < n + pad; i++) {
+    if (i >= 0 && i < n) {
+      padded.push_back(signal[i]);
+    } else {
+      padded.push_back(padding == "reflect" ? reflectedSample(signal, i)
+                                            : 0.0f);
+    }
+  }
+  return padded;
+}
+
+// Frames of fft_size samples every hop_size samples, as long as they fit
+static std::vector<std::vector<float>>
+naiveFrames(const std::vector<float> &signal, int fft_size, int hop_size,
+            const std::string &padding) {
+  std::vector<float> padded = paddedSignal(signal, fft_size, padding);
+  std::vector<std::vector<float>> frames;
+  for (size_t start = 0; start + fft_size <= padded.size();
+       start += hop_size) {
+    frames.emplace_back(padded.begin() + start,
+                        padded.begin() + start + fft_size);
+  }
+  return frames;
+}
+
+static std::vector<double> naiveMagnitudes(const std::vector<float> &frame,
+                                           const std::vector<float> &window) {
+  int size = frame.size();
+  std::vector<double> magnitudes(size / 2 + 1);
+  for (int k = 0; k <= size / 2; k++) {
+    double real = 0, imag = 0;
+    for (int i = 0; i < size; i++) {
+      double angle = -2 * M_PI * (double)k * i / size;
+      real += frame[i] * window[i] * std::cos(angle);
+      imag += frame[i] * window[i] * std::sin(angle);
+    }
+    magnitudes[k] = std::sqrt(real * real + imag * imag);
+  }
+  return magnitudes;
+}
+
+//==============================================================================
+// Checks
+//==============================================================================
+
+static void checkFraming(size_t n, int fft_size, int hop_size,
+                         const std::string &padding) {
+  std::vector<float> signal(n);
+  for (size_t i = 0; i < n; i++) {
+    signal[i] = (float)(i + 1) * ((i % 2) ? -1.0f : 1.0f);
+  }
+  std::string name = padding + " n=" + std::to_string(n) +
+                     " fft=" + std::to_string(fft_size) +
+                     " hop=" + std::to_string(hop_size);
+
+  std::vector<std::vector<float>> expected =
+      naiveFrames(signal, fft_size, hop_size, padding);
+  int n_frames = stftFrameCount(n, fft_size, hop_size, padding);
+  check(n_frames == (int)expected.size(),
+        name + ": " + std::to_string(n_frames) + " frames, expected " +
+            std::to_string(expected.size()));
+
+  // stftFrameStart() and paddedIndex() against the padded signal
+  bool reflect = (padding == "reflect");
+  long offset = isCenteredPadding(padding) ? fft_size / 2 : 0;
+  bool same_index = true;
+  for (int frame = 0; frame < n_frames && frame < (int)expected.size();
+       frame++) {
+    long start = stftFrameStart(frame, fft_size, hop_size, padding);
+    same_index &= (start + offset == (long)frame * hop_size);
+    for (int i = 0; i < fft_size; i++) {
+      long index = paddedIndex(start + i, n, reflect);
+      float value = (index < 0) ? 0.0f : signal[index];
+      same_index &= (value == expected[frame][i]);
+    }
+  }
+  check(same_index, name + ": stftFrameStart and paddedIndex");
+
+  std::vector<float> window = createWindow(fft_size, "hann");
+  bool same_samples = true;
+  int calls = 0;
+  forEachSTFTFrame(signal, fft_size, hop_size, window, padding,
+                   [&](int frame, const float *samples,
+                       const std::vector<float> &) {
+                     same_samples &= (frame == calls++) &&
+                                     frame < (int)expected.size() &&
+                                     std::equal(expected[frame].begin(),
+                                                expected[frame].end(),
+                                                samples);
+                   });
+  check(same_samples && calls == (int)expected.size(),
+        name + ": frame samples");
+
+  std::vector<std::vector<float>> stft =
+      computeSTFT(signal, fft_size, hop_size, window, padding);
+  bool close = (stft.size() == expected.size());
+  for (size_t frame = 0; close && frame < stft.size(); frame++) {
+    std::vector<double> reference = naiveMagnitudes(expected[frame], window);
+    double scale = 1.0 + n;
+    for (size_t k = 0; k < reference.size(); k++) {
+      close &= std::fabs(stft[frame][k] - reference[k]) <= 1e-4 * scale;
+    }
+  }
+  check(close, name + ": magnitudes equal a direct DFT");
+}
+
+int main() {
+  // reflectedSample() itself, on the numpy example pad([1, 2, 3], 4)
+  std::vector<float> abc = {1, 2, 3};
+  std::vector<float> padded = paddedSignal(abc, 8, "reflect");
+  check(padded == std::vector<float>({1, 2, 3, 2, 1, 2, 3, 2, 1, 2, 3}),
+        "reference reflect padding of [1 2 3] by 4");
+
+  const char *paddings[] = {"none", "zero", "reflect"};
+  size_t lengths[] = {0, 1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 40, 41, 64};
+  for (const char *padding : paddings) {
+    for (size_t n : lengths) {
+      checkFraming(n, 16, 4, padding);
+      checkFraming(n, 16, 5, padding);
+      checkFraming(n, 32, 7, padding);
+    }
+    // Hop larger than the frame
+    checkFraming(100, 16, 24, padding);
+  }
+
+  // paddedIndex() directly: folding over several periods
+  check(paddedIndex(-1, 3, true) == 1 && paddedIndex(-2, 3, true) == 2 &&
+            paddedIndex(-3, 3, true) == 1 && paddedIndex(-4, 3, true) == 0 &&
+            paddedIndex(3, 3, true) == 1 && paddedIndex(4, 3, true) == 0 &&
+            paddedIndex(5, 3, true) == 1 && paddedIndex(-9, 3, true) == 1,
+        "paddedIndex folds a 3-sample signal");
+  check(paddedIndex(-5, 1, true) == 0 && paddedIndex(7, 1, true) == 0,
+        "paddedIndex of a 1-sample signal");
+  check(paddedIndex(-1, 3, false) == -1 && paddedIndex(3, 3, false) == -1 &&
+            paddedIndex(-1, 0, true) == -1,
+        "paddedIndex outside the signal with zero padding");
+
+  return failures == 0 ? 0 : 1;
+}